@@ -39,6 +39,7 @@ check_include_files(malloc.h HAVE_MALLOC_H)
 check_include_files(netdb.h HAVE_NETDB_H)
 check_include_files(poll.h HAVE_POLL_H)
 check_include_files(sys/ioctl.h HAVE_SYS_IOCTL_H)
+check_include_files(sys/mman.h HAVE_SYS_MMAN_H)
 check_include_files(sys/param.h HAVE_SYS_PARAM_H)
 check_include_files(sys/select.h HAVE_SYS_SELECT_H)
 check_include_files(sys/stat.h HAVE_SYS_STAT_H)
@@ -58,6 +59,7 @@ check_symbol_exists(strnlen "string.h" HAVE_STRNLEN)
 check_symbol_exists(gettimeofday "sys/time.h" HAVE_GETTIMEOFDAY)
 check_symbol_exists(usleep "unistd.h" HAVE_USLEEP)
 check_symbol_exists(realpath "stdlib.h" HAVE_REALPATH)
+check_struct_member("struct stat" st_mtim.tv_nsec "sys/stat.h" HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC)
 
 # Check types
 check_type_exists("_Bool" "stdbool.h" HAVE__BOOL)
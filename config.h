@@ -0,0 +1,357 @@
+/* 0 if not building for Cygwin. */
+#define IS_CYGWIN 0
+
+/* 0 if not building for Darwin. */
+#define IS_DARWIN 0
+
+/* 1 if building for MinGW. */
+#define IS_MINGW 0
+
+/* 0 if not building for Win32. */
+#define IS_WIN32 0
+
+/* 0 if not building for ESP-IDF. */
+#define IS_ESPIDF 0
+
+/* Include malloc free space in logging */
+/* #undef _DEBUG_FREE_SPACE_ */
+
+/* Print verbose USB communication messages */
+/* #undef _DEBUG_USB_COMMS_ */
+
+/* Print verbose USB I/O messages */
+/* #undef _DEBUG_USB_IO_ */
+
+/* 0 if you don't want parport */
+#define BUILD_PARPORT 0
+
+/* 0 if you don't want to debug BlueField SoC via rshim */
+#define BUILD_RSHIM 0
+
+/* 0 if you don't want dmem */
+#define BUILD_DMEM 0
+
+/* 0 if you don't want dummy driver */
+#define BUILD_DUMMY 0
+
+/* 0 if you don't want ep93xx */
+#define BUILD_EP93XX 0
+
+/* 0 if you don't want at91rm9200 */
+#define BUILD_AT91RM9200 0
+
+/* 0 if you don't want bcm2835gpio */
+#define BUILD_BCM2835GPIO 0
+
+/* 0 if you don't want imx_gpio */
+#define BUILD_IMX_GPIO 0
+
+/* 0 if you don't want am335xgpio */
+#define BUILD_AM335XGPIO 0
+
+/* 0 if you don't want parport to use giveio */
+#define PARPORT_USE_PPDEV 1
+
+/* 0 if you don't want parport to use giveio */
+#define PARPORT_USE_GIVEIO 0
+
+/* 0 if you don't want JTAG VPI */
+#define BUILD_JTAG_VPI 0
+
+/* 0 if you don't want Cadence vdebug interface */
+#define BUILD_VDEBUG 0
+
+/* 0 if you don't want JTAG DPI */
+#define BUILD_JTAG_DPI 0
+
+/* 0 if you don't want the Amontec JTAG-Accelerator driver */
+#define BUILD_AMTJTAGACCEL 0
+
+/* 0 if you don't want the Gateworks GW16012 driver */
+#define BUILD_GW16012 0
+
+/* 0 if you don't want the Buspirate JTAG driver */
+#define BUILD_BUSPIRATE 0
+
+/* 0 if you don't want the Remote Bitbang driver */
+#define BUILD_REMOTE_BITBANG 1
+
+/* 0 if you don't want SysfsGPIO driver */
+#define BUILD_SYSFSGPIO 0
+
+/* 0 if you don't want Xilinx XVC/PCIe driver */
+#define BUILD_XLNX_PCIE_XVC 0
+
+/* 0 if you don't want ESP remote protocol driver */
+#define BUILD_ESP_REMOTE 1
+
+/* 0 if you don't want ESP compression support */
+#define BUILD_ESP_COMPRESSION 1
+
+/* 0 if you don't want ESP32 gpio driver support */
+#define BUILD_ESP_GPIO 0
+
+/* 0 if you don't want OpenOCD source code coverage support */
+#define BUILD_GCOV 0
+
+/* 0 if you don't want MPSSE mode of FTDI based devices */
+#define BUILD_FTDI 0
+
+/* 0 if you don't want ST-Link Programmer */
+#define BUILD_HLADAPTER_STLINK 0
+
+/* 0 if you don't want TI ICDI JTAG Programmer */
+#define BUILD_HLADAPTER_ICDI 0
+
+/* 0 if you want the High Level JTAG driver */
+#define BUILD_HLADAPTER 0
+
+/* 0 if you don't want Keil ULINK JTAG Programmer */
+#define BUILD_ULINK 0
+
+/* 0 if you do not want ANGIE USB-JTAG adapter */
+#define BUILD_ANGIE 0
+
+/* 0 if you don't want Altera USB-Blaster II Compatible */
+#define BUILD_USB_BLASTER_2 0
+
+/* 0 if you don't want Bitbang mode of FT232R based devices */
+#define BUILD_FT232R 0
+
+/* 0 if you don't want Versaloon-Link JTAG Programmer */
+#define BUILD_VSLLINK 0
+
+/* 0 if you don't want TI XDS110 Debug Probe */
+#define BUILD_XDS110 0
+
+/* 0 if you don't want CMSIS-DAP v2 Compliant Debugger */
+#define BUILD_CMSIS_DAP_USB 0
+
+/* 0 if you don't want OSBDM (JTAG only) Programmer */
+#define BUILD_OSBDM 0
+
+/* 0 if you don't want eStick/opendous JTAG Programmer */
+#define BUILD_OPENDOUS 0
+
+/* 0 if you don't want Olimex ARM-JTAG-EW Programmer */
+#define BUILD_ARMJTAGEW 0
+
+/* 0 if you don't want Raisonance RLink JTAG Programmer */
+#define BUILD_RLINK 0
+
+/* 0 if you don't want USBProg JTAG Programmer */
+#define BUILD_USBPROG 0
+
+/* 0 if you don't want Espressif JTAG Programmer */
+#define BUILD_ESP_USB_JTAG 0
+
+/* 0 if you don't want Andes JTAG Programmer */
+#define BUILD_AICE 0
+
+/* 0 if you don't want CMSIS-DAP Compliant Debugger */
+#define BUILD_CMSIS_DAP_HID 0
+
+/* 0 if you don't want Nu-Link Programmer */
+#define BUILD_HLADAPTER_NULINK 0
+
+/* 0 if you don't want Cypress KitProg Programmer */
+#define BUILD_KITPROG 0
+
+/* 0 if you don't want Altera USB-Blaster Compatible */
+#define BUILD_USB_BLASTER 0
+
+/* 0 if you don't want ASIX Presto Adapter */
+#define BUILD_PRESTO 0
+
+/* 0 if you don't want OpenJTAG Adapter */
+#define BUILD_OPENJTAG 0
+
+/* 0 if you don't want Linux GPIO bitbang through libgpiod */
+#define BUILD_LINUXGPIOD 0
+
+/* 0 if you don't want SEGGER J-Link Programmer */
+#define BUILD_JLINK 0
+
+/* 0 if you don't want Xilinx XVC/PCIe */
+#define BUILD_XLNX_PCIE_XVC 0
+
+/* 0 if you don't want Bus Pirate */
+#define BUILD_BUS_PIRATE 1
+
+/* 0 if you don't want to use Capstone disassembly framework */
+#define HAVE_CAPSTONE 0
+
+/* Define if you have the <stdint.h> header file */
+#define HAVE_STDINT_H
+
+/* Define if you have the <stdlib.h> header file */
+#define HAVE_STDLIB_H
+
+/* Define if you have the <strings.h> header file */
+#define HAVE_STRINGS_H
+
+/* Define if you have the <string.h> header file */
+#define HAVE_STRING_H
+
+/* Define to 1 if you have the `strndup' function. */
+#define HAVE_STRNDUP
+
+/* Define to 1 if you have the `strnlen' function. */
+#define HAVE_STRNLEN
+
+/* Define if you have the <memory.h> header file */
+#define HAVE_MEMORY_H
+
+/* Define if you have the <inttypes.h> header file */
+#define HAVE_INTTYPES_H
+
+/* Define if you have the <sys/socket.h> header file */
+#define HAVE_SYS_SOCKET_H
+
+/* Define if you have the <elf.h> header file */
+#define HAVE_ELF_H
+
+/* Define if you have struct Elf64_Ehdr in the <elf.h> header file */
+#define HAVE_ELF64
+
+/* Define if you have the <dirent.h> header file */
+#define HAVE_DIRENT_H
+
+/* Define if you have the <dlfcn.h> header file */
+#define HAVE_DLFCN_H
+
+/* Define if you have the <fcntl.h> header file */
+#define HAVE_FCNTL_H
+
+/* Define if you have the <malloc.h> header file */
+#define HAVE_MALLOC_H
+
+/* Define if you have the <netdb.h> header file */
+#define HAVE_NETDB_H
+
+/* Define if you have the <poll.h> header file */
+#define HAVE_POLL_H
+
+/* Define if you have the <pthread.h> header file */
+/* #undef HAVE_PTHREAD_H */
+
+/* Define if you have the <pthread.h> header file */
+/* #undef HAVE_PTHREAD_H */
+
+/* Define if you have the <sys/epoll.h> header file */
+#define HAVE_SYS_EPOLL_H
+
+/* Define if you have the <sys/ioctl.h> header file */
+#define HAVE_SYS_IOCTL_H
+
+/* Define if `st_mtim.tv_nsec' is a member of `struct stat' */
+#define HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+
+/* Define if you have the <sys/mman.h> header file */
+#define HAVE_SYS_MMAN_H
+
+/* Define if you have the <sys/param.h> header file */
+#define HAVE_SYS_PARAM_H
+
+/* Define if you have the <sys/select.h> header file */
+#define HAVE_SYS_SELECT_H
+
+/* Define if you have the <sys/stat.h> header file */
+#define HAVE_SYS_STAT_H
+
+/* Define if you have the <sys/sysctl.h> header file */
+/* #undef HAVE_SYS_SYSCTL_H */
+
+/* Define if you have the <sys/time.h> header file */
+#define HAVE_SYS_TIME_H
+
+/* Define if you have the <sys/types.h> header file */
+#define HAVE_SYS_TYPES_H
+
+/* Define if you have the <sys/unistd.h> header file */
+#define HAVE_UNISTD_H
+
+/* Define if you have the <arpa/inet.h> header file */
+#define HAVE_ARPA_INET_H
+
+/* Define if you have the <ifaddrs.h> header file */
+#define HAVE_IFADDRS_H
+
+/* Define if you have the <netinet/in.h> header file */
+#define HAVE_NETINET_IN_H
+
+/* Define if you have the <netinet/tcp.h> header file */
+#define HAVE_NETINET_TCP_H
+
+/* Define if you have the <net/if.h> header file */
+#define HAVE_NET_IF_H
+
+/* Define if you have the `gettimeofday' function. */
+#define HAVE_GETTIMEOFDAY
+
+/* Define if you have the `usleep' function. */
+#define HAVE_USLEEP
+
+/* Define if you have libusb-1.x */
+/* #undef HAVE_LIBUSB1 */
+
+/* Define if your libusb has libusb_get_port_numbers() */
+/* #undef HAVE_LIBUSB_GET_PORT_NUMBERS */
+
+/* Define if your libftdi has 'ftdi_tcioflush' function */
+/* #undef HAVE_LIBFTDI_TCIOFLUSH */
+
+/* Define if dynamic libraries supported */
+#define HAVE_DLOPEN
+
+/* Define if the system has the type 'long long int'. */
+#define HAVE_LONG_LONG_INT
+
+/* Define if the system has the type 'unsigned long long int'. */
+#define HAVE_UNSIGNED_LONG_LONG_INT
+
+/* Define WORDS_BIGENDIAN to 1 if your processor stores words with the most
+   significant byte first (like Motorola and SPARC, unlike Intel). */
+/* #undef WORDS_BIGENDIAN */
+
+/* Define if you have the ANSI C header files. */
+#define STDC_HEADERS
+
+/* Define to 1 if the system has the type `_Bool'. */
+#define HAVE__BOOL
+
+/* Define to 1 if stdbool.h conforms to C99. */
+#define HAVE_STDBOOL_H
+
+/* Define if assertions should be disabled. */
+/* #undef NDEBUG */
+
+/* Must declare 'environ' to use it. */
+#define NEED_ENVIRON_EXTERN 1
+
+/* Name of package */
+#define PACKAGE "openocd"
+
+/* Define to the address where bug reports for this package should be sent. */
+#define PACKAGE_BUGREPORT "OpenOCD Mailing List <openocd-devel@lists.sourceforge.net>"
+
+/* Define to the full name of this package. */
+#define PACKAGE_NAME "openocd"
+
+/* Define to the full name and version of this package. */
+#define PACKAGE_STRING "openocd 0.12.0"
+
+/* Define to the one symbol short name of this package. */
+#define PACKAGE_TARNAME "openocd"
+
+/* Define to the home page for this package. */
+#define PACKAGE_URL ""
+
+/* Define to the version of this package. */
+#define PACKAGE_VERSION "0.12.0"
+
+/* Version number of package */
+#define VERSION "0.12.0"
+
+/* Use GNU C library extensions (e.g. stdndup). */
+#define _GNU_SOURCE 1
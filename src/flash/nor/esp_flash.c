@@ -82,6 +82,9 @@ struct esp_flash_rw_args {
 	bool connected;
 	const struct esp_flash_apptrace_hw *apptrace;
 	target_addr_t apptrace_ctrl_addr;
+	/* number of consecutive polls when target was not ready for the next block */
+	int busy_num;
+	struct duration tmo_time;
 };
 
 struct esp_flash_write_state {
@@ -109,6 +112,44 @@ struct esp_flash_bp_op_state {
 	size_t num_bps;
 };
 
+enum esp_flash_multi_phase {
+	ESP_FLASH_MULTI_ERASE,
+	ESP_FLASH_MULTI_WRITE,
+	ESP_FLASH_MULTI_VERIFY,
+};
+
+/* Flash programming job for one target of the multi-target programming command */
+struct esp_flash_multi_job {
+	struct flash_bank *bank;
+	uint8_t *buffer;
+	uint32_t offset;
+	uint32_t size;
+	uint8_t hash[TC_SHA256_DIGEST_SIZE];
+	/* result of the last phase, failed jobs are skipped in the next phases */
+	int retval;
+	/* core running the stub and its data transfer state, NULL if there is nothing to transfer */
+	struct target *run_target;
+	struct esp_flash_rw_args *rw;
+	int xfer_ret;
+	struct duration xfer_time;
+};
+
+/* Stubs of all jobs run simultaneously. Every job starts the stub of the next one from its host side
+ * function, the last started job feeds data to all running stubs. When all transfers are done,
+ * the jobs wait for their stubs completion in reverse order. */
+struct esp_flash_multi {
+	enum esp_flash_multi_phase phase;
+	struct esp_flash_multi_job *jobs;
+	size_t num_jobs;
+	size_t next_job;
+	struct esp_flash_multi_job *current;
+};
+
+/* multi-target programming which is in progress, NULL if flash operations are run one by one */
+static struct esp_flash_multi *s_esp_flash_multi;
+
+static int esp_algo_flash_multi_usr_func(struct target *target, void *priv);
+
 #if BUILD_ESP_COMPRESSION
 #include <zlib.h>
 static int esp_algo_flash_compress(const uint8_t *in, uint32_t in_len, uint8_t **out, uint32_t *out_len)
@@ -203,8 +244,30 @@ static int esp_algo_calc_hash(const uint8_t *data, size_t datalen, uint8_t *hash
 	return ERROR_OK;
 }
 
+/* Stub supporting all commands is used when stub logs are enabled or stub session is active */
+static inline bool esp_algo_flash_stub_all_cmds(struct esp_flash_bank *esp_info)
+{
+	return esp_info->stub_log_enabled || esp_info->stub_session;
+}
+
+static const struct esp_flasher_stub_config *esp_algo_flash_get_stub(struct flash_bank *bank, int cmd)
+{
+	struct esp_flash_bank *esp_info = bank->driver_priv;
+
+	/* use the same stub for all commands, so it can stay loaded between them */
+	if (esp_info->stub_session)
+		cmd = ESP_STUB_CMD_FLASH_WITH_LOG;
+	return esp_info->get_stub(bank, cmd);
+}
+
+static uint32_t esp_algo_flash_stack_size(struct esp_flash_bank *esp_info,
+	const struct esp_flasher_stub_config *stub_cfg)
+{
+	return esp_algo_flash_stub_all_cmds(esp_info) ? stub_cfg->stack_default_sz * 2 : stub_cfg->stack_default_sz;
+}
+
 static int esp_algo_flasher_algorithm_init(struct esp_algorithm_run_data *algo,
-	const struct esp_algorithm_hw *stub_hw,
+	struct esp_flash_bank *esp_info,
 	const struct esp_flasher_stub_config *stub_cfg)
 {
 	if (!stub_cfg) {
@@ -213,7 +276,8 @@ static int esp_algo_flasher_algorithm_init(struct esp_algorithm_run_data *algo,
 	}
 
 	memset(algo, 0, sizeof(*algo));
-	algo->hw = stub_hw;
+	algo->hw = esp_info->stub_hw;
+	algo->use_session = esp_info->stub_session;
 	algo->reg_args.first_user_param = stub_cfg->first_user_reg_param;
 	algo->image.code_size = stub_cfg->code_sz;
 	algo->image.data_size = stub_cfg->data_sz;
@@ -223,8 +287,10 @@ static int esp_algo_flasher_algorithm_init(struct esp_algorithm_run_data *algo,
 	algo->image.dram_org = stub_cfg->dram_org;
 	algo->image.dram_len = stub_cfg->dram_len;
 	algo->image.reverse = stub_cfg->reverse;
-	algo->stub.log_buff_addr = stub_cfg->log_buff_addr;
-	algo->stub.log_buff_size = stub_cfg->log_buff_size;
+	if (esp_info->stub_log_enabled) {
+		algo->stub.log_buff_addr = stub_cfg->log_buff_addr;
+		algo->stub.log_buff_size = stub_cfg->log_buff_size;
+	}
 	memset(&algo->image.image, 0, sizeof(algo->image.image));
 	int ret = image_open(&algo->image.image, NULL, "build");
 	if (ret != ERROR_OK) {
@@ -295,16 +361,15 @@ int esp_algo_flash_blank_check(struct flash_bank *bank)
 {
 	struct esp_flash_bank *esp_info = bank->driver_priv;
 	struct esp_algorithm_run_data run;
-	const struct esp_flasher_stub_config *stub_cfg = esp_info->get_stub(bank, ESP_STUB_CMD_FLASH_ERASE_CHECK);
-	const uint32_t stack_size = esp_info->stub_log_enabled ?
-		stub_cfg->stack_default_sz * 2 : stub_cfg->stack_default_sz;
+	const struct esp_flasher_stub_config *stub_cfg = esp_algo_flash_get_stub(bank, ESP_STUB_CMD_FLASH_ERASE_CHECK);
+	const uint32_t stack_size = esp_algo_flash_stack_size(esp_info, stub_cfg);
 
 	if (bank->target->state != TARGET_HALTED) {
 		LOG_ERROR("Target not halted!");
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
-	int ret = esp_algo_flasher_algorithm_init(&run, esp_info->stub_hw, stub_cfg);
+	int ret = esp_algo_flasher_algorithm_init(&run, esp_info, stub_cfg);
 	if (ret != ERROR_OK)
 		return ret;
 
@@ -344,16 +409,15 @@ static int esp_algo_flash_get_mappings(struct flash_bank *bank,
 	uint32_t appimage_flash_base)
 {
 	struct esp_algorithm_run_data run;
-	const struct esp_flasher_stub_config *stub_cfg = esp_info->get_stub(bank, ESP_STUB_CMD_FLASH_MAP_GET);
-	const uint32_t stack_size = esp_info->stub_log_enabled ?
-		stub_cfg->stack_default_sz * 2 : stub_cfg->stack_default_sz;
+	const struct esp_flasher_stub_config *stub_cfg = esp_algo_flash_get_stub(bank, ESP_STUB_CMD_FLASH_MAP_GET);
+	const uint32_t stack_size = esp_algo_flash_stack_size(esp_info, stub_cfg);
 
-	int ret = esp_algo_flasher_algorithm_init(&run, esp_info->stub_hw, stub_cfg);
+	int ret = esp_algo_flasher_algorithm_init(&run, esp_info, stub_cfg);
 	if (ret != ERROR_OK)
 		return ret;
 
 	run.stack_size = stack_size;
-	run.check_preloaded_binary = esp_info->stub_log_enabled ? false : esp_info->check_preloaded_binary;
+	run.check_preloaded_binary = esp_algo_flash_stub_all_cmds(esp_info) ? false : esp_info->check_preloaded_binary;
 
 	struct mem_param mp;
 	init_mem_param(&mp,
@@ -430,9 +494,8 @@ int esp_algo_flash_erase(struct flash_bank *bank, unsigned int first, unsigned i
 {
 	struct esp_flash_bank *esp_info = bank->driver_priv;
 	struct esp_algorithm_run_data run;
-	const struct esp_flasher_stub_config *stub_cfg = esp_info->get_stub(bank, ESP_STUB_CMD_FLASH_READ);
-	const uint32_t stack_size = esp_info->stub_log_enabled ?
-		stub_cfg->stack_default_sz * 2 : stub_cfg->stack_default_sz;
+	const struct esp_flasher_stub_config *stub_cfg = esp_algo_flash_get_stub(bank, ESP_STUB_CMD_FLASH_READ);
+	const uint32_t stack_size = esp_algo_flash_stack_size(esp_info, stub_cfg);
 
 	if (bank->target->state != TARGET_HALTED) {
 		LOG_ERROR("Target not halted");
@@ -443,13 +506,15 @@ int esp_algo_flash_erase(struct flash_bank *bank, unsigned int first, unsigned i
 	struct duration bench;
 	duration_start(&bench);
 
-	int ret = esp_algo_flasher_algorithm_init(&run, esp_info->stub_hw,
-		esp_info->get_stub(bank, ESP_STUB_CMD_FLASH_ERASE));
+	int ret = esp_algo_flasher_algorithm_init(&run, esp_info,
+		esp_algo_flash_get_stub(bank, ESP_STUB_CMD_FLASH_ERASE));
 	if (ret != ERROR_OK)
 		return ret;
 
 	run.stack_size = stack_size;
 	run.timeout_ms = ESP_FLASH_ERASE_TMO;
+	if (s_esp_flash_multi)
+		run.usr_func = esp_algo_flash_multi_usr_func;
 	ret = esp_info->run_func_image(bank->target,
 		&run,
 		3,
@@ -475,65 +540,80 @@ int esp_algo_flash_erase(struct flash_bank *bank, unsigned int first, unsigned i
 	return ret;
 }
 
+/* Transfers one data block. Returns ERROR_OK if block has been transferred or target is not ready yet. */
+static int esp_algo_flash_rw_step(struct target *target, struct esp_flash_rw_args *rw)
+{
+	uint32_t block_id = 0, len = 0;
+
+	LOG_DEBUG("Transfer block on %s", target_name(target));
+	int retval = rw->apptrace->data_len_read(target, &block_id, &len);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Failed to read apptrace status (%d)!", retval);
+		return retval;
+	}
+	/* transfer block */
+	LOG_DEBUG("Transfer block %d, read %d bytes from target", block_id, len);
+	retval = rw->xfer(target, block_id, len, rw);
+	if (retval == ERROR_WAIT) {
+		LOG_DEBUG("Block not ready");
+		if (rw->busy_num++ == 0) {
+			if (duration_start(&rw->tmo_time) != 0) {
+				LOG_ERROR("Failed to start data write time measurement!");
+				return ERROR_FAIL;
+			}
+		} else {
+			/* if no transfer check tmo */
+			if (duration_measure(&rw->tmo_time) != 0) {
+				LOG_ERROR("Failed to stop algo run measurement!");
+				return ERROR_FAIL;
+			}
+			if (1000 * duration_elapsed(&rw->tmo_time) > ESP_FLASH_RW_TMO) {
+				LOG_ERROR("Transfer data tmo!");
+				return ERROR_WAIT;
+			}
+		}
+	} else if (retval != ERROR_OK) {
+		LOG_ERROR("Failed to transfer flash data block (%d)!", retval);
+		return retval;
+	} else {
+		rw->busy_num = 0;
+	}
+	if (rw->total_count < rw->count && target->state != TARGET_DEBUG_RUNNING) {
+		LOG_ERROR(
+			"Algorithm accidentally stopped (%d)! Transferred %" PRIu32 " of %"
+			PRIu32,
+			target->state,
+			rw->total_count,
+			rw->count);
+		return ERROR_FAIL;
+	}
+	return ERROR_OK;
+}
+
+static void esp_algo_flash_rw_poll(struct target *target)
+{
+	int smp = target->smp;
+	target->smp = 0;
+	target_poll(target);
+	target->smp = smp;
+}
+
 static int esp_algo_flash_rw_do(struct target *target, void *priv)
 {
-	struct duration algo_time, tmo_time;
+	struct duration algo_time;
 	struct esp_flash_rw_args *rw = (struct esp_flash_rw_args *)priv;
-	int retval = ERROR_OK, busy_num = 0;
 
 	if (duration_start(&algo_time) != 0) {
 		LOG_ERROR("Failed to start data write time measurement!");
 		return ERROR_FAIL;
 	}
+	rw->busy_num = 0;
 	while (rw->total_count < rw->count) {
-		uint32_t block_id = 0, len = 0;
-		LOG_DEBUG("Transfer block on %s", target_name(target));
-		retval = rw->apptrace->data_len_read(target, &block_id, &len);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Failed to read apptrace status (%d)!", retval);
-			return retval;
-		}
-		/* transfer block */
-		LOG_DEBUG("Transfer block %d, read %d bytes from target", block_id, len);
-		retval = rw->xfer(target, block_id, len, rw);
-		if (retval == ERROR_WAIT) {
-			LOG_DEBUG("Block not ready");
-			if (busy_num++ == 0) {
-				if (duration_start(&tmo_time) != 0) {
-					LOG_ERROR("Failed to start data write time measurement!");
-					return ERROR_FAIL;
-				}
-			} else {
-				/* if no transfer check tmo */
-				if (duration_measure(&tmo_time) != 0) {
-					LOG_ERROR("Failed to stop algo run measurement!");
-					return ERROR_FAIL;
-				}
-				if (1000 * duration_elapsed(&tmo_time) > ESP_FLASH_RW_TMO) {
-					LOG_ERROR("Transfer data tmo!");
-					return ERROR_WAIT;
-				}
-			}
-		} else if (retval != ERROR_OK) {
-			LOG_ERROR("Failed to transfer flash data block (%d)!", retval);
+		int retval = esp_algo_flash_rw_step(target, rw);
+		if (retval != ERROR_OK)
 			return retval;
-		} else {
-			busy_num = 0;
-		}
-		if (rw->total_count < rw->count && target->state != TARGET_DEBUG_RUNNING) {
-			LOG_ERROR(
-				"Algorithm accidentally stopped (%d)! Transferred %" PRIu32 " of %"
-				PRIu32,
-				target->state,
-				rw->total_count,
-				rw->count);
-			return ERROR_FAIL;
-		}
 		alive_sleep(10);
-		int smp = target->smp;
-		target->smp = 0;
-		target_poll(target);
-		target->smp = smp;
+		esp_algo_flash_rw_poll(target);
 	}
 	if (duration_measure(&algo_time) != 0) {
 		LOG_ERROR("Failed to stop data write measurement!");
@@ -698,12 +778,11 @@ int esp_algo_flash_write(struct flash_bank *bank, const uint8_t *buffer,
 	struct esp_flash_bank *esp_info = bank->driver_priv;
 	struct esp_algorithm_run_data run;
 	struct esp_flash_write_state wr_state;
-	const struct esp_flasher_stub_config *stub_cfg = esp_info->get_stub(bank,
+	const struct esp_flasher_stub_config *stub_cfg = esp_algo_flash_get_stub(bank,
 		esp_info->compression ? ESP_STUB_CMD_FLASH_WRITE_DEFLATED : ESP_STUB_CMD_FLASH_WRITE);
 	uint8_t *compressed_buff = NULL;
 	uint32_t compressed_len = 0;
-	uint32_t stack_size = esp_info->stub_log_enabled ?
-		stub_cfg->stack_default_sz * 2 : stub_cfg->stack_default_sz;
+	uint32_t stack_size = esp_algo_flash_stack_size(esp_info, stub_cfg);
 
 	if (offset & 0x3UL) {
 		LOG_ERROR("Unaligned offset!");
@@ -727,7 +806,7 @@ int esp_algo_flash_write(struct flash_bank *bank, const uint8_t *buffer,
 	if (ret != ERROR_OK)
 		return ret;
 
-	ret = esp_algo_flasher_algorithm_init(&run, esp_info->stub_hw, stub_cfg);
+	ret = esp_algo_flasher_algorithm_init(&run, esp_info, stub_cfg);
 	if (ret != ERROR_OK) {
 		esp_algo_flash_apptrace_info_restore(bank->target, esp_info, old_addr);
 		return ret;
@@ -753,7 +832,7 @@ int esp_algo_flash_write(struct flash_bank *bank, const uint8_t *buffer,
 	}
 
 	run.stack_size = stack_size + ESP_STUB_UNZIP_BUFF_SIZE + stub_cfg->stack_data_pool_sz;
-	run.usr_func = esp_algo_flash_rw_do;
+	run.usr_func = s_esp_flash_multi ? esp_algo_flash_multi_usr_func : esp_algo_flash_rw_do;
 	run.usr_func_arg = &wr_state;
 	run.usr_func_init = (esp_algorithm_usr_func_init_t)esp_algo_flash_write_state_init;
 	run.usr_func_done = (esp_algorithm_usr_func_done_t)esp_algo_flash_write_state_cleanup;
@@ -885,9 +964,8 @@ int esp_algo_flash_read(struct flash_bank *bank, uint8_t *buffer,
 	struct esp_flash_bank *esp_info = bank->driver_priv;
 	struct esp_algorithm_run_data run;
 	struct esp_flash_read_state rd_state;
-	const struct esp_flasher_stub_config *stub_cfg = esp_info->get_stub(bank, ESP_STUB_CMD_FLASH_READ);
-	const uint32_t stack_size = esp_info->stub_log_enabled ?
-		stub_cfg->stack_default_sz * 2 : stub_cfg->stack_default_sz;
+	const struct esp_flasher_stub_config *stub_cfg = esp_algo_flash_get_stub(bank, ESP_STUB_CMD_FLASH_READ);
+	const uint32_t stack_size = esp_algo_flash_stack_size(esp_info, stub_cfg);
 
 	if (offset & 0x3UL) {
 		LOG_ERROR("Unaligned offset!");
@@ -911,7 +989,7 @@ int esp_algo_flash_read(struct flash_bank *bank, uint8_t *buffer,
 	if (ret != ERROR_OK)
 		return ret;
 
-	ret = esp_algo_flasher_algorithm_init(&run, esp_info->stub_hw, stub_cfg);
+	ret = esp_algo_flasher_algorithm_init(&run, esp_info, stub_cfg);
 	if (ret != ERROR_OK) {
 		esp_algo_flash_apptrace_info_restore(bank->target, esp_info, old_addr);
 		return ret;
@@ -1165,9 +1243,8 @@ int esp_algo_flash_breakpoint_add(struct target *target, struct esp_flash_breakp
 	struct esp_flash_bp_op_state op_state;
 	struct mem_param mp[2]; /* in and out */
 	const size_t size_bp_inst = sizeof(sw_bp->bp_flash_addr);
-	const struct esp_flasher_stub_config *stub_cfg = esp_info->get_stub(bank, ESP_STUB_CMD_FLASH_BP_SET);
-	const uint32_t stack_size = esp_info->stub_log_enabled ?
-		stub_cfg->stack_default_sz * 2 : stub_cfg->stack_default_sz;
+	const struct esp_flasher_stub_config *stub_cfg = esp_algo_flash_get_stub(bank, ESP_STUB_CMD_FLASH_BP_SET);
+	const uint32_t stack_size = esp_algo_flash_stack_size(esp_info, stub_cfg);
 
 	op_state.esp_info = esp_info;
 	op_state.sw_bp = sw_bp;
@@ -1176,7 +1253,7 @@ int esp_algo_flash_breakpoint_add(struct target *target, struct esp_flash_breakp
 
 	LOG_DEBUG("SEC_SIZE % " PRId32 " num_bps:(%zu)", esp_info->sec_sz, num_bps);
 
-	int ret = esp_algo_flasher_algorithm_init(&run, esp_info->stub_hw, stub_cfg);
+	int ret = esp_algo_flasher_algorithm_init(&run, esp_info, stub_cfg);
 	if (ret != ERROR_OK)
 		return ret;
 
@@ -1184,7 +1261,7 @@ int esp_algo_flash_breakpoint_add(struct target *target, struct esp_flash_breakp
 	run.usr_func_arg = &op_state;
 	run.usr_func_init = (esp_algorithm_usr_func_init_t)esp_algo_flash_bp_op_state_init;
 	run.usr_func_done = (esp_algorithm_usr_func_done_t)esp_algo_flash_bp_op_state_cleanup;
-	run.check_preloaded_binary = esp_info->stub_log_enabled ? false : esp_info->check_preloaded_binary;
+	run.check_preloaded_binary = esp_algo_flash_stub_all_cmds(esp_info) ? false : esp_info->check_preloaded_binary;
 
 	init_mem_param(&mp[0], 1 /* First user arg */, num_bps * size_bp_inst /* size in bytes */, PARAM_OUT);
 	/* bp0_flash_addr + bp1_flash_addr + bp2_flash_addr + ... bpn_flash_addr */
@@ -1251,11 +1328,10 @@ int esp_algo_flash_breakpoint_remove(struct target *target, struct esp_flash_bre
 	struct esp_flash_bp_op_state op_state;
 	struct mem_param mp[2]; /* out and out */
 	const size_t size_bp_inst = sizeof(struct esp_flash_stub_bp_instructions);
-	const struct esp_flasher_stub_config *stub_cfg = esp_info->get_stub(bank, ESP_STUB_CMD_FLASH_BP_CLEAR);
-	const uint32_t stack_size = esp_info->stub_log_enabled ?
-		stub_cfg->stack_default_sz * 2 : stub_cfg->stack_default_sz;
+	const struct esp_flasher_stub_config *stub_cfg = esp_algo_flash_get_stub(bank, ESP_STUB_CMD_FLASH_BP_CLEAR);
+	const uint32_t stack_size = esp_algo_flash_stack_size(esp_info, stub_cfg);
 
-	int ret = esp_algo_flasher_algorithm_init(&run, esp_info->stub_hw, stub_cfg);
+	int ret = esp_algo_flasher_algorithm_init(&run, esp_info, stub_cfg);
 	if (ret != ERROR_OK)
 		return ret;
 
@@ -1268,7 +1344,7 @@ int esp_algo_flash_breakpoint_remove(struct target *target, struct esp_flash_bre
 	run.usr_func_arg = &op_state;
 	run.usr_func_init = (esp_algorithm_usr_func_init_t)esp_algo_flash_bp_op_state_init;
 	run.usr_func_done = (esp_algorithm_usr_func_done_t)esp_algo_flash_bp_op_state_cleanup;
-	run.check_preloaded_binary = esp_info->stub_log_enabled ? false : esp_info->check_preloaded_binary;
+	run.check_preloaded_binary = esp_algo_flash_stub_all_cmds(esp_info) ? false : esp_info->check_preloaded_binary;
 
 	init_mem_param(&mp[0], 1 /* First user arg */, 1 + num_bps * size_bp_inst /* size in bytes */, PARAM_OUT);
 	/* bp0_flash_addr + bp1_flash_addr + bp2_flash_addr + ... bpn_flash_addr */
@@ -1331,9 +1407,8 @@ static int esp_algo_flash_calc_hash(struct flash_bank *bank, uint8_t *hash,
 {
 	struct esp_flash_bank *esp_info = bank->driver_priv;
 	struct esp_algorithm_run_data run;
-	const struct esp_flasher_stub_config *stub_cfg = esp_info->get_stub(bank, ESP_STUB_CMD_FLASH_CALC_HASH);
-	const uint32_t stack_size = esp_info->stub_log_enabled ?
-		stub_cfg->stack_default_sz * 2 : stub_cfg->stack_default_sz;
+	const struct esp_flasher_stub_config *stub_cfg = esp_algo_flash_get_stub(bank, ESP_STUB_CMD_FLASH_CALC_HASH);
+	const uint32_t stack_size = esp_algo_flash_stack_size(esp_info, stub_cfg);
 
 	if (offset & 0x3UL) {
 		LOG_ERROR("Unaligned offset!");
@@ -1345,7 +1420,7 @@ static int esp_algo_flash_calc_hash(struct flash_bank *bank, uint8_t *hash,
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
-	int ret = esp_algo_flasher_algorithm_init(&run, esp_info->stub_hw, stub_cfg);
+	int ret = esp_algo_flasher_algorithm_init(&run, esp_info, stub_cfg);
 	if (ret != ERROR_OK)
 		return ret;
 
@@ -1358,6 +1433,8 @@ static int esp_algo_flash_calc_hash(struct flash_bank *bank, uint8_t *hash,
 		PARAM_IN);
 	run.mem_args.params = &mp;
 	run.mem_args.count = 1;
+	if (s_esp_flash_multi)
+		run.usr_func = esp_algo_flash_multi_usr_func;
 
 	struct duration bench;
 	duration_start(&bench);
@@ -1393,11 +1470,10 @@ static int esp_algo_flash_boost_clock_freq(struct flash_bank *bank, int boost)
 	struct esp_flash_bank *esp_info = bank->driver_priv;
 	struct esp_algorithm_run_data run;
 	int new_cpu_freq = -1;	/* set to max level */
-	const struct esp_flasher_stub_config *stub_cfg = esp_info->get_stub(bank, ESP_STUB_CMD_FLASH_CLOCK_CONFIGURE);
-	const uint32_t stack_size = esp_info->stub_log_enabled ?
-		stub_cfg->stack_default_sz * 2 : stub_cfg->stack_default_sz;
+	const struct esp_flasher_stub_config *stub_cfg = esp_algo_flash_get_stub(bank, ESP_STUB_CMD_FLASH_CLOCK_CONFIGURE);
+	const uint32_t stack_size = esp_algo_flash_stack_size(esp_info, stub_cfg);
 
-	int ret = esp_algo_flasher_algorithm_init(&run, esp_info->stub_hw, stub_cfg);
+	int ret = esp_algo_flasher_algorithm_init(&run, esp_info, stub_cfg);
 	if (ret != ERROR_OK)
 		return ret;
 
@@ -1567,6 +1643,18 @@ static int esp_algo_flash_set_stub_log(struct target *target, char *bank_name_su
 	return ERROR_OK;
 }
 
+static int esp_algo_flash_set_stub_session(struct target *target, char *bank_name_suffix, bool enable)
+{
+	struct flash_bank *bank;
+	int retval = esp_algo_target_to_flash_bank(target, &bank, bank_name_suffix, false);
+	if (retval != ERROR_OK)
+		return ERROR_FAIL;
+
+	struct esp_flash_bank *esp_info = (struct esp_flash_bank *)bank->driver_priv;
+	esp_info->stub_session = enable;
+	return ERROR_OK;
+}
+
 COMMAND_HELPER(esp_algo_flash_cmd_set_encryption, struct target *target)
 {
 	if (CMD_ARGC != 1) {
@@ -1671,6 +1759,257 @@ static int esp_flash_verify_bank_hash(struct target *target,
 	return differ ? ERROR_FAIL : ERROR_OK;
 }
 
+static int esp_algo_flash_multi_job_run(struct esp_flash_multi_job *job, enum esp_flash_multi_phase phase)
+{
+	struct esp_flash_bank *esp_info = job->bank->driver_priv;
+	uint8_t target_hash[TC_SHA256_DIGEST_SIZE];
+	int retval;
+
+	switch (phase) {
+	case ESP_FLASH_MULTI_ERASE:
+		return esp_algo_flash_erase(job->bank, job->offset / esp_info->sec_sz,
+			(job->offset + job->size - 1) / esp_info->sec_sz);
+	case ESP_FLASH_MULTI_WRITE:
+		return esp_algo_flash_write(job->bank, job->buffer, job->offset, job->size);
+	case ESP_FLASH_MULTI_VERIFY:
+		retval = esp_algo_flash_calc_hash(job->bank, target_hash, job->offset, job->size);
+		if (retval != ERROR_OK)
+			return retval;
+		if (memcmp(job->hash, target_hash, TC_SHA256_DIGEST_SIZE)) {
+			LOG_TARGET_ERROR(job->bank->target, "**** Verification failure! ****");
+			return ERROR_FAIL;
+		}
+		return ERROR_OK;
+	}
+	return ERROR_FAIL;
+}
+
+/* Starts stubs of all jobs which have not been started yet in the current phase */
+static void esp_algo_flash_multi_start_pending(struct esp_flash_multi *multi)
+{
+	while (multi->next_job < multi->num_jobs) {
+		struct esp_flash_multi_job *job = &multi->jobs[multi->next_job++];
+		if (job->retval != ERROR_OK)
+			continue;
+		job->rw = NULL;
+		job->xfer_ret = ERROR_OK;
+		multi->current = job;
+		/* returns when stubs of this and all the next jobs are done */
+		job->retval = esp_algo_flash_multi_job_run(job, multi->phase);
+	}
+}
+
+/* Feeds data to all running stubs in round-robin until all transfers are done */
+static void esp_algo_flash_multi_transfer(struct esp_flash_multi *multi)
+{
+	while (true) {
+		bool active = false;
+
+		for (size_t i = 0; i < multi->num_jobs; i++) {
+			struct esp_flash_multi_job *job = &multi->jobs[i];
+			if (!job->rw)
+				continue;
+			if (job->rw->total_count >= job->rw->count) {
+				duration_measure(&job->xfer_time);
+				LOG_TARGET_INFO(job->run_target, "PROF: Data transferred in %g ms @ %g KB/s",
+					duration_elapsed(&job->xfer_time) * 1000,
+					duration_kbps(&job->xfer_time, job->rw->total_count));
+				job->rw = NULL;
+				continue;
+			}
+			int retval = esp_algo_flash_rw_step(job->run_target, job->rw);
+			if (retval != ERROR_OK) {
+				job->xfer_ret = retval;
+				job->rw = NULL;
+				continue;
+			}
+			active = true;
+		}
+		if (!active)
+			break;
+
+		alive_sleep(10);
+		for (size_t i = 0; i < multi->num_jobs; i++) {
+			if (multi->jobs[i].rw)
+				esp_algo_flash_rw_poll(multi->jobs[i].run_target);
+		}
+	}
+}
+
+static int esp_algo_flash_multi_usr_func(struct target *target, void *priv)
+{
+	struct esp_flash_multi *multi = s_esp_flash_multi;
+	struct esp_flash_multi_job *job = multi->current;
+
+	job->run_target = target;
+	job->rw = priv;
+	if (job->rw) {
+		job->rw->busy_num = 0;
+		duration_start(&job->xfer_time);
+	}
+
+	esp_algo_flash_multi_start_pending(multi);
+	/* the last started job transfers data for all of them, for the others it is no-op */
+	esp_algo_flash_multi_transfer(multi);
+
+	return job->xfer_ret;
+}
+
+static int esp_algo_flash_multi_run_phase(struct esp_flash_multi *multi, enum esp_flash_multi_phase phase,
+	const char *name)
+{
+	struct duration bench;
+	int failed = 0;
+
+	duration_start(&bench);
+	multi->phase = phase;
+	multi->next_job = 0;
+	s_esp_flash_multi = multi;
+	esp_algo_flash_multi_start_pending(multi);
+	s_esp_flash_multi = NULL;
+	duration_measure(&bench);
+
+	for (size_t i = 0; i < multi->num_jobs; i++) {
+		if (multi->jobs[i].retval != ERROR_OK)
+			failed++;
+	}
+	LOG_INFO("PROF: %s on %zu targets done in %g ms, %d failed", name, multi->num_jobs,
+		duration_elapsed(&bench) * 1000, failed);
+	return failed ? ERROR_FAIL : ERROR_OK;
+}
+
+static int esp_algo_flash_multi_job_init(struct esp_flash_multi_job *job, struct esp_flash_multi *multi,
+	const char *target_name_str, const char *file_name, uint32_t offset)
+{
+	struct fileio *fileio;
+	size_t filesize, read_cnt;
+
+	struct target *target = get_target(target_name_str);
+	if (!target) {
+		LOG_ERROR("Target '%s' not found", target_name_str);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	/* stubs of the jobs run at the same time, so one chip can not be used twice */
+	for (size_t i = 0; i < multi->num_jobs; i++) {
+		struct target *other = multi->jobs[i].bank->target;
+		if (other == target || (target->smp && other->smp && other->smp_targets == target->smp_targets)) {
+			LOG_ERROR("Target '%s' is used more than once", target_name_str);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+
+	int retval = esp_algo_target_to_flash_bank(target, &job->bank, "flash", true);
+	if (retval != ERROR_OK)
+		return retval;
+	struct esp_flash_bank *esp_info = job->bank->driver_priv;
+
+	if (offset % esp_info->sec_sz) {
+		LOG_ERROR("Offset 0x%" PRIx32 " is not aligned to flash sector size", offset);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	retval = fileio_open(&fileio, file_name, FILEIO_READ, FILEIO_BINARY);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Could not open file '%s'", file_name);
+		return retval;
+	}
+	retval = fileio_size(fileio, &filesize);
+	if (retval != ERROR_OK) {
+		fileio_close(fileio);
+		return retval;
+	}
+	if (filesize == 0 || offset > job->bank->size || ALIGN_UP(filesize, 4) > job->bank->size - offset) {
+		LOG_ERROR("File '%s' does not fit into flash bank at 0x%" PRIx32, file_name, offset);
+		fileio_close(fileio);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	job->size = ALIGN_UP(filesize, 4);
+	job->buffer = malloc(job->size);
+	if (!job->buffer) {
+		LOG_ERROR("Out of memory");
+		fileio_close(fileio);
+		return ERROR_FAIL;
+	}
+	/* pad with erased flash value */
+	memset(job->buffer + filesize, 0xff, job->size - filesize);
+	retval = fileio_read(fileio, filesize, job->buffer, &read_cnt);
+	fileio_close(fileio);
+	if (retval != ERROR_OK || read_cnt != filesize) {
+		LOG_ERROR("File read failure");
+		return retval != ERROR_OK ? retval : ERROR_FAIL;
+	}
+
+	job->offset = offset;
+	job->retval = ERROR_OK;
+	return esp_algo_calc_hash(job->buffer, job->size, job->hash);
+}
+
+COMMAND_HANDLER(esp_algo_flash_cmd_program_multi)
+{
+	struct esp_flash_multi multi = { 0 };
+	bool verify = false;
+	unsigned int argc = CMD_ARGC;
+
+	if (argc > 0 && strcmp(CMD_ARGV[argc - 1], "verify") == 0) {
+		verify = true;
+		argc--;
+	}
+	if (argc == 0 || argc % 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	uint32_t offset;
+	for (unsigned int i = 0; i < argc; i += 3)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[i + 2], offset);
+
+	multi.jobs = calloc(argc / 3, sizeof(*multi.jobs));
+	if (!multi.jobs) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int retval = ERROR_OK;
+	for (unsigned int i = 0; i < argc; i += 3) {
+		parse_u32(CMD_ARGV[i + 2], &offset);
+		retval = esp_algo_flash_multi_job_init(&multi.jobs[multi.num_jobs], &multi,
+			CMD_ARGV[i], CMD_ARGV[i + 1], offset);
+		/* count the job in to free its buffer */
+		multi.num_jobs++;
+		if (retval != ERROR_OK)
+			goto _cleanup;
+	}
+
+	struct duration bench;
+	uint64_t total_size = 0;
+	duration_start(&bench);
+
+	esp_algo_flash_multi_run_phase(&multi, ESP_FLASH_MULTI_ERASE, "Erase");
+	esp_algo_flash_multi_run_phase(&multi, ESP_FLASH_MULTI_WRITE, "Write");
+	if (verify)
+		esp_algo_flash_multi_run_phase(&multi, ESP_FLASH_MULTI_VERIFY, "Verify");
+
+	duration_measure(&bench);
+
+	for (size_t i = 0; i < multi.num_jobs; i++) {
+		struct esp_flash_multi_job *job = &multi.jobs[i];
+		command_print(CMD, "%s: %s", target_name(job->bank->target), job->retval == ERROR_OK ? "OK" : "FAILED");
+		if (job->retval == ERROR_OK)
+			total_size += job->size;
+		else
+			retval = ERROR_FAIL;
+	}
+	command_print(CMD, "Programmed %" PRIu64 " bytes to %zu targets in %g ms @ %g KB/s",
+		total_size, multi.num_jobs,
+		duration_elapsed(&bench) * 1000,
+		duration_kbps(&bench, total_size));
+
+_cleanup:
+	for (size_t i = 0; i < multi.num_jobs; i++)
+		free(multi.jobs[i].buffer);
+	free(multi.jobs);
+	return retval;
+}
+
 COMMAND_HELPER(esp_algo_flash_parse_cmd_verify_bank_hash, struct target *target)
 {
 	if (CMD_ARGC < 2 || CMD_ARGC > 3)
@@ -1742,6 +2081,45 @@ COMMAND_HELPER(esp_algo_flash_parse_cmd_stub_log, struct target *target)
 	return esp_algo_flash_set_stub_log(target, "flash", log_stat);
 }
 
+COMMAND_HELPER(esp_algo_flash_parse_cmd_stub_session, struct target *target)
+{
+	struct esp_common *esp = target_to_esp_common(target);
+	if (!esp)
+		return ERROR_FAIL;
+
+	if (CMD_ARGC == 0) {
+		struct flash_bank *bank;
+		int ret = esp_algo_target_to_flash_bank(target, &bank, "flash", false);
+		if (ret != ERROR_OK)
+			return ret;
+		struct esp_flash_bank *esp_info = bank->driver_priv;
+		command_print(CMD, "%s: stub session %s, loads %" PRIu32 ", reuses %" PRIu32,
+			target_name(target),
+			esp_info->stub_session ? "on" : "off",
+			esp->algo_session.loads,
+			esp->algo_session.reuses);
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	bool enable = false;
+	COMMAND_PARSE_ON_OFF(CMD_ARGV[0], enable);
+
+	if (!enable)
+		esp_algorithm_session_close(target, &esp->algo_session);
+
+	int ret = esp_algo_flash_set_stub_session(target, "irom", enable);
+	if (ret != ERROR_OK)
+		return ret;
+	ret = esp_algo_flash_set_stub_session(target, "drom", enable);
+	if (ret != ERROR_OK)
+		return ret;
+
+	return esp_algo_flash_set_stub_session(target, "flash", enable);
+}
+
 COMMAND_HANDLER(esp_algo_flash_cmd_clock_boost)
 {
 	return CALL_COMMAND_HANDLER(esp_algo_flash_parse_cmd_clock_boost, get_current_target(CMD_CTX));
@@ -1769,6 +2147,7 @@ COMMAND_HANDLER(name) \
 }
 
 COMMAND_HANDLER_SMP(esp_algo_flash_cmd_stub_log, esp_algo_flash_parse_cmd_stub_log)
+COMMAND_HANDLER_SMP(esp_algo_flash_cmd_stub_session, esp_algo_flash_parse_cmd_stub_session)
 COMMAND_HANDLER_SMP(esp_algo_flash_cmd_encryption, esp_algo_flash_cmd_set_encryption)
 COMMAND_HANDLER_SMP(esp_algo_flash_cmd_compression, esp_algo_flash_cmd_set_compression)
 COMMAND_HANDLER_SMP(esp_algo_flash_cmd_appimage_flashoff, esp_algo_flash_cmd_appimage_flashoff_do)
@@ -1822,5 +2201,21 @@ const struct command_registration esp_flash_exec_flash_command_handlers[] = {
 		.help = "Enable stub flasher logs",
 		.usage = "['on'|'off']",
 	},
+	{
+		.name = "program_multi",
+		.handler = esp_algo_flash_cmd_program_multi,
+		.mode = COMMAND_EXEC,
+		.help = "Program binary files to flash of several targets simultaneously and optionally verify them. "
+			"Targets must be halted.",
+		.usage = "target filename offset [target filename offset]... ['verify']",
+	},
+	{
+		.name = "stub_session",
+		.handler = esp_algo_flash_cmd_stub_session,
+		.mode = COMMAND_ANY,
+		.help = "Keep stub flasher loaded between flash operations until target is resumed or reset. "
+			"Without arguments shows session state and stub load statistics",
+		.usage = "['on'|'off']",
+	},
 	COMMAND_REGISTRATION_DONE
 };
@@ -95,6 +95,8 @@ struct esp_flash_bank {
 	bool stub_log_enabled;
 	/* If exist at the target memory, allow to run preloaded stub code without loading again */
 	bool check_preloaded_binary;
+	/* Keep stub loaded on target between flash operations until target is resumed or reset */
+	bool stub_session;
 };
 
 enum esp_flash_bp_action {
@@ -20,12 +20,21 @@
 #include "fileio.h"
 #include "replacements.h"
 
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
 struct fileio {
 	char *url;
 	size_t size;
 	enum fileio_type type;
 	enum fileio_access access;
 	FILE *file;
+	/* read-only mapping of the whole file, or NULL */
+	void *map;
 };
 
 static inline int fileio_close_local(struct fileio *fileio)
@@ -117,6 +126,7 @@ int fileio_open(struct fileio **fileio, const char *url,
 	tmp->type = type;
 	tmp->access = access_type;
 	tmp->url = strdup(url);
+	tmp->map = NULL;
 
 	retval = fileio_open_local(tmp);
 
@@ -135,6 +145,11 @@ int fileio_close(struct fileio *fileio)
 {
 	int retval;
 
+#ifdef HAVE_SYS_MMAN_H
+	if (fileio->map)
+		munmap(fileio->map, fileio->size);
+#endif
+
 	retval = fileio_close_local(fileio);
 
 	free(fileio->url);
@@ -262,3 +277,58 @@ int fileio_size(struct fileio *fileio, size_t *size)
 
 	return ERROR_OK;
 }
+
+/**
+ * Maps a binary file opened for reading, read-only, so its content can be
+ * accessed without copying it. The mapping is valid until the file is closed,
+ * the file should not be truncated meanwhile.
+ * Fails with ERROR_FILEIO_OPERATION_NOT_SUPPORTED where files cannot be mapped,
+ * the caller then reads the file instead.
+ */
+int fileio_map(struct fileio *fileio, const uint8_t **data)
+{
+#ifdef HAVE_SYS_MMAN_H
+	if (!fileio->map) {
+		if (fileio->access != FILEIO_READ || fileio->type != FILEIO_BINARY || !fileio->size)
+			return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+
+		void *map = mmap(NULL, fileio->size, PROT_READ, MAP_PRIVATE, fileno(fileio->file), 0);
+		if (map == MAP_FAILED) {
+			LOG_DEBUG("couldn't map %s: %s", fileio->url, strerror(errno));
+			return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+		}
+		fileio->map = map;
+	}
+
+	*data = fileio->map;
+	return ERROR_OK;
+#else
+	return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Gets the modification time and the device and inode numbers of the file,
+ * to tell if its content may have changed since it was last read.
+ */
+int fileio_identity(struct fileio *fileio, struct fileio_identity *id)
+{
+#ifdef HAVE_SYS_STAT_H
+	struct stat st;
+
+	if (fstat(fileno(fileio->file), &st) != 0)
+		return ERROR_FILEIO_OPERATION_FAILED;
+
+	id->mtime = st.st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	id->mtime_nsec = st.st_mtim.tv_nsec;
+#else
+	id->mtime_nsec = -1;
+#endif
+	id->dev = st.st_dev;
+	id->ino = st.st_ino;
+	return ERROR_OK;
+#else
+	return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+#endif
+}
@@ -14,6 +14,7 @@
 #ifndef OPENOCD_HELPER_FILEIO_H
 #define OPENOCD_HELPER_FILEIO_H
 
+#include <time.h>
 #include "types.h"
 
 #define FILEIO_MAX_ERROR_STRING		(128)
@@ -34,6 +35,15 @@ enum fileio_access {
 
 struct fileio;
 
+/* identity of the file content, see fileio_identity() */
+struct fileio_identity {
+	time_t mtime;
+	/* nanoseconds of the modification time, -1 where the host does not provide them */
+	long mtime_nsec;
+	uint64_t dev;
+	uint64_t ino;
+};
+
 int fileio_open(struct fileio **fileio, const char *url,
 		enum fileio_access access_type, enum fileio_type type);
 int fileio_close(struct fileio *fileio);
@@ -50,6 +60,8 @@ int fileio_write(struct fileio *fileio,
 int fileio_read_u32(struct fileio *fileio, uint32_t *data);
 int fileio_write_u32(struct fileio *fileio, uint32_t data);
 int fileio_size(struct fileio *fileio, size_t *size);
+int fileio_map(struct fileio *fileio, const uint8_t **data);
+int fileio_identity(struct fileio *fileio, struct fileio_identity *id);
 
 #define ERROR_FILEIO_LOCATION_UNKNOWN			(-1200)
 #define ERROR_FILEIO_NOT_FOUND					(-1201)
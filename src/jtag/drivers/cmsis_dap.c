@@ -47,6 +47,8 @@ static const struct cmsis_dap_backend *const cmsis_dap_backends[] = {
 #if BUILD_CMSIS_DAP_HID == 1
 	&cmsis_dap_hid_backend,
 #endif
+
+	&cmsis_dap_tcp_backend,
 };
 
 /* USB Config */
@@ -214,17 +216,6 @@ static const char * const info_caps_str[INFO_CAPS__NUM_CAPS] = {
 	"UART via USB COM port supported",
 };
 
-struct pending_scan_result {
-	/** Offset in bytes in the CMD_DAP_JTAG_SEQ response buffer. */
-	unsigned int first;
-	/** Number of bits to read. */
-	unsigned int length;
-	/** Location to store the result */
-	uint8_t *buffer;
-	/** Offset in the destination buffer */
-	unsigned int buffer_offset;
-};
-
 /* Read mode */
 enum cmsis_dap_blocking {
 	CMSIS_DAP_NON_BLOCKING,
@@ -236,19 +227,18 @@ static unsigned int pending_queue_len;
 static unsigned int tfer_max_command_size;
 static unsigned int tfer_max_response_size;
 
-/* pointers to buffers that will receive jtag scan results on the next flush */
-#define MAX_PENDING_SCAN_RESULTS 256
-static int pending_scan_result_count;
-static struct pending_scan_result pending_scan_results[MAX_PENDING_SCAN_RESULTS];
-
-/* queued JTAG sequences that will be executed on the next flush */
+/* queued JTAG sequences that will be executed on the next flush,
+ * the scan results are kept in the pending block being filled */
 #define QUEUED_SEQ_BUF_LEN (cmsis_dap_handle->packet_usable_size - 3)
 static int queued_seq_count;
 static int queued_seq_buf_end;
 static int queued_seq_tdo_ptr;
-static uint8_t queued_seq_buf[1024]; /* TODO: make dynamic / move into cmsis object */
+static uint8_t *queued_seq_buf;
+/* the most sequences a CMD_DAP_JTAG_SEQ packet can hold */
+static unsigned int queued_seq_max;
 
 static int queued_retval;
+static int queued_jtag_retval;
 
 static uint8_t output_pins = SWJ_PIN_SRST | SWJ_PIN_TRST;
 
@@ -305,15 +295,54 @@ static void cmsis_dap_close(struct cmsis_dap *dap)
 
 	free(dap->packet_buffer);
 
-	for (unsigned int i = 0; i < MAX_PENDING_REQUESTS; i++) {
-		free(dap->pending_fifo[i].transfers);
-		dap->pending_fifo[i].transfers = NULL;
+	if (dap->pending_fifo) {
+		for (unsigned int i = 0; i < dap->packet_count; i++) {
+			free(dap->pending_fifo[i].transfers);
+			free(dap->pending_fifo[i].scans);
+		}
+		free(dap->pending_fifo);
+		dap->pending_fifo = NULL;
 	}
 
+	free(queued_seq_buf);
+	queued_seq_buf = NULL;
+
 	free(cmsis_dap_handle);
 	cmsis_dap_handle = NULL;
 }
 
+static int64_t cmsis_dap_time_us(void)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+/* Accounts a request written to the adapter */
+static void cmsis_dap_pending_push(struct cmsis_dap *dap, unsigned int transfers)
+{
+	if (!dap->pending_fifo_block_count)
+		dap->busy_since_us = cmsis_dap_time_us();
+	dap->pending_fifo_block_count++;
+	dap->stat_packets++;
+	dap->stat_transfers += transfers;
+	if (dap->pending_fifo_block_count > dap->stat_max_pending)
+		dap->stat_max_pending = dap->pending_fifo_block_count;
+}
+
+/* Accounts a response read, or all pending requests discarded */
+static void cmsis_dap_pending_pop(struct cmsis_dap *dap, bool all)
+{
+	if (!dap->pending_fifo_block_count)
+		return;
+	if (all)
+		dap->pending_fifo_block_count = 0;
+	else
+		dap->pending_fifo_block_count--;
+	if (!dap->pending_fifo_block_count)
+		dap->stat_busy_us += cmsis_dap_time_us() - dap->busy_since_us;
+}
+
 static void cmsis_dap_flush_read(struct cmsis_dap *dap)
 {
 	unsigned int i;
@@ -339,7 +368,7 @@ static int cmsis_dap_xfer(struct cmsis_dap *dap, int txlen)
 		LOG_ERROR("pending %u blocks, flushing", dap->pending_fifo_block_count);
 		while (dap->pending_fifo_block_count) {
 			dap->backend->read(dap, 10, NULL);
-			dap->pending_fifo_block_count--;
+			cmsis_dap_pending_pop(dap, false);
 		}
 		dap->pending_fifo_put_idx = 0;
 		dap->pending_fifo_get_idx = 0;
@@ -761,12 +790,14 @@ static int cmsis_dap_cmd_dap_swo_data(
 
 static void cmsis_dap_swd_discard_all_pending(struct cmsis_dap *dap)
 {
-	for (unsigned int i = 0; i < MAX_PENDING_REQUESTS; i++)
+	for (unsigned int i = 0; i < dap->packet_count; i++) {
 		dap->pending_fifo[i].transfer_count = 0;
+		dap->pending_fifo[i].scan_count = 0;
+	}
 
 	dap->pending_fifo_put_idx = 0;
 	dap->pending_fifo_get_idx = 0;
-	dap->pending_fifo_block_count = 0;
+	cmsis_dap_pending_pop(dap, true);
 }
 
 static void cmsis_dap_swd_cancel_transfers(struct cmsis_dap *dap)
@@ -863,7 +894,7 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 
 	unsigned int packet_count = dap->quirk_mode ? 1 : dap->packet_count;
 	dap->pending_fifo_put_idx = (dap->pending_fifo_put_idx + 1) % packet_count;
-	dap->pending_fifo_block_count++;
+	cmsis_dap_pending_push(dap, block->transfer_count);
 	if (dap->pending_fifo_block_count > packet_count)
 		LOG_ERROR("internal: too much pending writes %u", dap->pending_fifo_block_count);
 
@@ -987,7 +1018,7 @@ skip:
 	block->transfer_count = 0;
 	if (!dap->quirk_mode && dap->packet_count > 1)
 		dap->pending_fifo_get_idx = (dap->pending_fifo_get_idx + 1) % dap->packet_count;
-	dap->pending_fifo_block_count--;
+	cmsis_dap_pending_pop(dap, false);
 }
 
 static int cmsis_dap_swd_run_queue(void)
@@ -1393,11 +1424,32 @@ static int cmsis_dap_init(void)
 		LOG_DEBUG("CMSIS-DAP: Packet Count = %u", pkt_cnt);
 	}
 
+	if (cmsis_dap_handle->packet_count > 1) {
+		/* let the backend size its transfers for the whole pipeline */
+		unsigned int pkt_sz = cmsis_dap_handle->packet_size;
+		cmsis_dap_handle->backend->packet_buffer_free(cmsis_dap_handle);
+		retval = cmsis_dap_handle->backend->packet_buffer_alloc(cmsis_dap_handle, pkt_sz);
+		if (retval != ERROR_OK)
+			goto init_err;
+	}
+
+	/* every JTAG sequence takes a control byte and at least one data byte */
+	queued_seq_max = MIN(255, QUEUED_SEQ_BUF_LEN / 2);
+	queued_seq_buf = malloc(QUEUED_SEQ_BUF_LEN);
+
 	LOG_DEBUG("Allocating FIFO for %u pending packets", cmsis_dap_handle->packet_count);
+	cmsis_dap_handle->pending_fifo = calloc(cmsis_dap_handle->packet_count,
+									sizeof(struct pending_request_block));
+	if (!cmsis_dap_handle->pending_fifo || !queued_seq_buf) {
+		LOG_ERROR("Unable to allocate memory for CMSIS-DAP queue");
+		retval = ERROR_FAIL;
+		goto init_err;
+	}
 	for (unsigned int i = 0; i < cmsis_dap_handle->packet_count; i++) {
-		cmsis_dap_handle->pending_fifo[i].transfers = malloc(pending_queue_len
-									 * sizeof(struct pending_transfer_result));
-		if (!cmsis_dap_handle->pending_fifo[i].transfers) {
+		struct pending_request_block *block = &cmsis_dap_handle->pending_fifo[i];
+		block->transfers = malloc(pending_queue_len * sizeof(struct pending_transfer_result));
+		block->scans = malloc(queued_seq_max * sizeof(struct pending_scan_result));
+		if (!block->transfers || !block->scans) {
 			LOG_ERROR("Unable to allocate memory for CMSIS-DAP queue");
 			retval = ERROR_FAIL;
 			goto init_err;
@@ -1589,45 +1641,33 @@ static void debug_parse_cmsis_buf(const uint8_t *cmd, int cmdlen)
 }
 #endif
 
-static void cmsis_dap_flush(void)
+/* Reads the response of the oldest pending CMD_DAP_JTAG_SEQ and
+ * copies the scan results into client buffers */
+static void cmsis_dap_jtag_read_process(struct cmsis_dap *dap)
 {
-	if (!queued_seq_count)
-		return;
-
-	LOG_DEBUG_IO("Flushing %d queued sequences (%d bytes) with %d pending scan results to capture",
-		queued_seq_count, queued_seq_buf_end, pending_scan_result_count);
-
-	/* prepare CMSIS-DAP packet */
-	uint8_t *command = cmsis_dap_handle->command;
-	command[0] = CMD_DAP_JTAG_SEQ;
-	command[1] = queued_seq_count;
-	memcpy(&command[2], queued_seq_buf, queued_seq_buf_end);
-
-#ifdef CMSIS_DAP_JTAG_DEBUG
-	debug_parse_cmsis_buf(command, queued_seq_buf_end + 2);
-#endif
-
-	/* send command to USB device */
-	int retval = cmsis_dap_xfer(cmsis_dap_handle, queued_seq_buf_end + 2);
+	struct pending_request_block *block = &dap->pending_fifo[dap->pending_fifo_get_idx];
 
-	uint8_t *resp = cmsis_dap_handle->response;
-	if (retval != ERROR_OK || resp[1] != DAP_OK) {
+	int retval = dap->backend->read(dap, LIBUSB_TIMEOUT_MS, NULL);
+	uint8_t *resp = dap->response;
+	if (retval <= 0 || resp[0] != CMD_DAP_JTAG_SEQ || resp[1] != DAP_OK) {
 		LOG_ERROR("CMSIS-DAP command CMD_DAP_JTAG_SEQ failed.");
-		exit(-1);
+		queued_jtag_retval = ERROR_JTAG_DEVICE_ERROR;
+		/* the responses of the other pending requests can not be trusted */
+		cmsis_dap_swd_cancel_transfers(dap);
+		return;
 	}
 
 #ifdef CMSIS_DAP_JTAG_DEBUG
 	LOG_DEBUG_IO("USB response buf:");
-	for (int c = 0; c < queued_seq_buf_end + 3; ++c)
+	for (int c = 0; c < retval; ++c)
 		printf("%02X ", resp[c]);
 	printf("\n");
 #endif
 
-	/* copy scan results into client buffers */
-	for (int i = 0; i < pending_scan_result_count; ++i) {
-		struct pending_scan_result *scan = &pending_scan_results[i];
-		LOG_DEBUG_IO("Copying pending_scan_result %d/%d: %d bits from byte %d -> buffer + %d bits",
-			i, pending_scan_result_count, scan->length, scan->first + 2, scan->buffer_offset);
+	for (unsigned int i = 0; i < block->scan_count; ++i) {
+		struct pending_scan_result *scan = &block->scans[i];
+		LOG_DEBUG_IO("Copying pending_scan_result %u/%u: %u bits from byte %u -> buffer + %u bits",
+			i, block->scan_count, scan->length, scan->first + 2, scan->buffer_offset);
 #ifdef CMSIS_DAP_JTAG_DEBUG
 		for (uint32_t b = 0; b < DIV_ROUND_UP(scan->length, 8); ++b)
 			printf("%02X ", resp[2+scan->first+b]);
@@ -1636,11 +1676,76 @@ static void cmsis_dap_flush(void)
 		bit_copy(scan->buffer, scan->buffer_offset, &resp[2 + scan->first], 0, scan->length);
 	}
 
+	block->scan_count = 0;
+	unsigned int packet_count = dap->quirk_mode ? 1 : dap->packet_count;
+	dap->pending_fifo_get_idx = (dap->pending_fifo_get_idx + 1) % packet_count;
+	cmsis_dap_pending_pop(dap, false);
+}
+
+/* Sends the queued sequences without waiting for the response,
+ * up to packet_count packets are kept in flight */
+static void cmsis_dap_flush(void)
+{
+	if (!queued_seq_count)
+		return;
+
+	struct cmsis_dap *dap = cmsis_dap_handle;
+	struct pending_request_block *block = &dap->pending_fifo[dap->pending_fifo_put_idx];
+
+	LOG_DEBUG_IO("Flushing %d queued sequences (%d bytes) with %u pending scan results to capture",
+		queued_seq_count, queued_seq_buf_end, block->scan_count);
+
+	/* prepare CMSIS-DAP packet */
+	uint8_t *command = dap->command;
+	command[0] = CMD_DAP_JTAG_SEQ;
+	command[1] = queued_seq_count;
+	memcpy(&command[2], queued_seq_buf, queued_seq_buf_end);
+
+#ifdef CMSIS_DAP_JTAG_DEBUG
+	debug_parse_cmsis_buf(command, queued_seq_buf_end + 2);
+#endif
+
+	block->command = CMD_DAP_JTAG_SEQ;
+	if (queued_jtag_retval == ERROR_OK) {
+		/* send command to USB device */
+		int retval = dap->backend->write(dap, queued_seq_buf_end + 2, LIBUSB_TIMEOUT_MS);
+		if (retval < 0) {
+			LOG_ERROR("CMSIS-DAP command CMD_DAP_JTAG_SEQ failed.");
+			queued_jtag_retval = retval;
+			block->scan_count = 0;
+		} else {
+			unsigned int packet_count = dap->quirk_mode ? 1 : dap->packet_count;
+			dap->pending_fifo_put_idx = (dap->pending_fifo_put_idx + 1) % packet_count;
+			cmsis_dap_pending_push(dap, queued_seq_count);
+
+			/* the next block must be free to queue sequences */
+			if (dap->pending_fifo_block_count >= packet_count)
+				cmsis_dap_jtag_read_process(dap);
+		}
+	} else {
+		block->scan_count = 0;
+	}
+
 	/* reset */
 	queued_seq_count = 0;
 	queued_seq_buf_end = 0;
 	queued_seq_tdo_ptr = 0;
-	pending_scan_result_count = 0;
+}
+
+/* Sends the queued sequences and waits for the results of all pending ones */
+static void cmsis_dap_jtag_sync(void)
+{
+	/* the FIFO holds SWD requests in SWD mode */
+	if (swd_mode)
+		return;
+
+	cmsis_dap_flush();
+
+	while (cmsis_dap_handle->pending_fifo_block_count)
+		cmsis_dap_jtag_read_process(cmsis_dap_handle);
+
+	cmsis_dap_handle->pending_fifo_put_idx = 0;
+	cmsis_dap_handle->pending_fifo_get_idx = 0;
 }
 
 /* queue a sequence of bits to clock out TDI / in TDO, executing if the buffer is full.
@@ -1680,7 +1785,7 @@ static void cmsis_dap_add_jtag_sequence(unsigned int s_len, const uint8_t *seque
 	}
 
 	unsigned int cmd_len = 1 + DIV_ROUND_UP(s_len, 8);
-	if (queued_seq_count >= 255 || queued_seq_buf_end + cmd_len > QUEUED_SEQ_BUF_LEN)
+	if ((unsigned int)queued_seq_count >= queued_seq_max || queued_seq_buf_end + cmd_len > QUEUED_SEQ_BUF_LEN)
 		/* empty out the buffer */
 		cmsis_dap_flush();
 
@@ -1700,7 +1805,8 @@ static void cmsis_dap_add_jtag_sequence(unsigned int s_len, const uint8_t *seque
 	queued_seq_buf_end += cmd_len;
 
 	if (tdo_buffer) {
-		struct pending_scan_result *scan = &pending_scan_results[pending_scan_result_count++];
+		struct pending_request_block *block = &cmsis_dap_handle->pending_fifo[cmsis_dap_handle->pending_fifo_put_idx];
+		struct pending_scan_result *scan = &block->scans[block->scan_count++];
 		scan->first = queued_seq_tdo_ptr;
 		queued_seq_tdo_ptr += DIV_ROUND_UP(s_len, 8);
 		scan->length = s_len;
@@ -1917,20 +2023,20 @@ static void cmsis_dap_execute_stableclocks(struct jtag_command *cmd)
 static void cmsis_dap_execute_tms(struct jtag_command *cmd)
 {
 	LOG_DEBUG_IO("TMS: %u bits", cmd->cmd.tms->num_bits);
+	cmsis_dap_jtag_sync();
 	cmsis_dap_cmd_dap_swj_sequence(cmd->cmd.tms->num_bits, cmd->cmd.tms->bits);
 }
 
-/* TODO: Is there need to call cmsis_dap_flush() for the JTAG_PATHMOVE,
- * JTAG_RUNTEST, JTAG_STABLECLOCKS? */
+/* Commands not sent as CMD_DAP_JTAG_SEQ wait for the pending ones to complete */
 static void cmsis_dap_execute_command(struct jtag_command *cmd)
 {
 	switch (cmd->type) {
 		case JTAG_SLEEP:
-			cmsis_dap_flush();
+			cmsis_dap_jtag_sync();
 			cmsis_dap_execute_sleep(cmd);
 			break;
 		case JTAG_TLR_RESET:
-			cmsis_dap_flush();
+			cmsis_dap_jtag_sync();
 			cmsis_dap_execute_tlr_reset(cmd);
 			break;
 		case JTAG_SCAN:
@@ -1963,9 +2069,11 @@ static int cmsis_dap_execute_queue(struct jtag_command *cmd_queue)
 		cmd = cmd->next;
 	}
 
-	cmsis_dap_flush();
+	cmsis_dap_jtag_sync();
 
-	return ERROR_OK;
+	int retval = queued_jtag_retval;
+	queued_jtag_retval = ERROR_OK;
+	return retval;
 }
 
 static int cmsis_dap_speed(int speed)
@@ -2236,6 +2344,34 @@ COMMAND_HANDLER(cmsis_dap_handle_quirk_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(cmsis_dap_handle_stats_command)
+{
+	struct cmsis_dap *dap = cmsis_dap_handle;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		dap->stat_packets = 0;
+		dap->stat_transfers = 0;
+		dap->stat_max_pending = 0;
+		dap->stat_busy_us = 0;
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "%" PRIu64 " packets with %" PRIu64 " transfers, up to %u of %u packets in flight",
+		dap->stat_packets, dap->stat_transfers, dap->stat_max_pending,
+		dap->quirk_mode ? 1 : dap->packet_count);
+	if (dap->stat_busy_us)
+		command_print(CMD, "busy %.3f s: %.0f transfers/s, %.0f packets/s",
+			dap->stat_busy_us / 1e6,
+			dap->stat_transfers * 1e6 / dap->stat_busy_us,
+			dap->stat_packets * 1e6 / dap->stat_busy_us);
+	return ERROR_OK;
+}
+
 static const struct command_registration cmsis_dap_subcommand_handlers[] = {
 	{
 		.name = "info",
@@ -2262,8 +2398,8 @@ static const struct command_registration cmsis_dap_subcommand_handlers[] = {
 		.name = "backend",
 		.handler = &cmsis_dap_handle_backend_command,
 		.mode = COMMAND_CONFIG,
-		.help = "set the communication backend to use (USB bulk or HID).",
-		.usage = "(auto | usb_bulk | hid)",
+		.help = "set the communication backend to use (USB bulk, HID or TCP).",
+		.usage = "(auto | usb_bulk | hid | tcp)",
 	},
 	{
 		.name = "quirk",
@@ -2272,6 +2408,20 @@ static const struct command_registration cmsis_dap_subcommand_handlers[] = {
 		.help = "allow expensive workarounds of known adapter quirks.",
 		.usage = "[enable | disable]",
 	},
+	{
+		.name = "stats",
+		.handler = &cmsis_dap_handle_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "show or reset request pipeline statistics",
+		.usage = "[reset]",
+	},
+	{
+		.name = "tcp",
+		.chain = cmsis_dap_tcp_subcommand_handlers,
+		.mode = COMMAND_ANY,
+		.help = "TCP backend-specific commands",
+		.usage = "<cmd>",
+	},
 #if BUILD_CMSIS_DAP_USB
 	{
 		.name = "usb",
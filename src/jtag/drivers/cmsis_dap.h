@@ -14,13 +14,27 @@ struct pending_transfer_result {
 	void *buffer;
 };
 
-/* Up to MIN(packet_count, MAX_PENDING_REQUESTS) requests may be issued
- * until the first response arrives */
-#define MAX_PENDING_REQUESTS 4
+struct pending_scan_result {
+	/** Offset in bytes in the CMD_DAP_JTAG_SEQ response buffer. */
+	unsigned int first;
+	/** Number of bits to read. */
+	unsigned int length;
+	/** Location to store the result */
+	uint8_t *buffer;
+	/** Offset in the destination buffer */
+	unsigned int buffer_offset;
+};
+
+/* Up to packet_count requests, as reported by the adapter, may be issued
+ * until the first response arrives. The count is a byte in DAP_Info. */
+#define MAX_PENDING_REQUESTS 255
 
 struct pending_request_block {
 	struct pending_transfer_result *transfers;
 	unsigned int transfer_count;
+	/* TDO captures of a CMD_DAP_JTAG_SEQ request */
+	struct pending_scan_result *scans;
+	unsigned int scan_count;
 	uint8_t command;
 };
 
@@ -45,8 +59,9 @@ struct cmsis_dap {
 	uint8_t common_swd_cmd;
 	bool swd_cmds_differ;
 
-	/* Pending requests are organized as a FIFO - circular buffer */
-	struct pending_request_block pending_fifo[MAX_PENDING_REQUESTS];
+	/* Pending requests are organized as a FIFO - circular buffer
+	 * of packet_count blocks */
+	struct pending_request_block *pending_fifo;
 	unsigned int packet_count;
 	unsigned int pending_fifo_put_idx, pending_fifo_get_idx;
 	unsigned int pending_fifo_block_count;
@@ -56,6 +71,15 @@ struct cmsis_dap {
 
 	uint32_t swo_buf_sz;
 	bool trace_enabled;
+
+	/* pipeline statistics */
+	uint64_t stat_packets;
+	/* SWD transfers or JTAG sequences */
+	uint64_t stat_transfers;
+	unsigned int stat_max_pending;
+	/* time with at least one request pending */
+	int64_t stat_busy_us;
+	int64_t busy_since_us;
 };
 
 struct cmsis_dap_backend {
@@ -72,7 +96,9 @@ struct cmsis_dap_backend {
 
 extern const struct cmsis_dap_backend cmsis_dap_hid_backend;
 extern const struct cmsis_dap_backend cmsis_dap_usb_backend;
+extern const struct cmsis_dap_backend cmsis_dap_tcp_backend;
 extern const struct command_registration cmsis_dap_usb_subcommand_handlers[];
+extern const struct command_registration cmsis_dap_tcp_subcommand_handlers[];
 
 #define REPORT_ID_SIZE   1
 
@@ -0,0 +1,321 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ * CMSIS-DAP backend carrying the command and response packets over a TCP
+ * connection, for adapters reachable over the network and for software
+ * implementations of the protocol. Every packet is preceded by a header:
+ *
+ * - signature "DAP\0" (32-bit little endian 0x00504144)
+ * - packet length (16-bit little endian)
+ * - packet type, 1 for a command and 2 for a response
+ * - a reserved byte, 0
+ *
+ * The peer is expected to answer the commands in order, the same way an
+ * USB adapter does. Several commands can be sent before reading the first
+ * response, up to the packet count reported by DAP_Info.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#ifdef HAVE_NETDB_H
+#include <netdb.h>
+#endif
+#ifdef HAVE_NETINET_TCP_H
+#include <netinet/tcp.h>
+#endif
+#include <helper/log.h>
+#include <helper/replacements.h>
+#include <helper/system.h>
+#include <helper/time_support.h>
+#include <helper/types.h>
+
+#include "cmsis_dap.h"
+
+#define CMSIS_DAP_TCP_SIGNATURE		0x00504144
+#define CMSIS_DAP_TCP_HDR_SIZE		8
+#define CMSIS_DAP_TCP_TYPE_REQUEST	1
+#define CMSIS_DAP_TCP_TYPE_RESPONSE	2
+#define CMSIS_DAP_TCP_DEFAULT_PKT_SZ	1024
+
+struct cmsis_dap_backend_data {
+	int fd;
+	/* header followed by the packet being sent */
+	uint8_t *tx;
+	/* response being received, possibly over several reads */
+	unsigned int rx_len;
+	uint8_t rx[CMSIS_DAP_TCP_HDR_SIZE + UINT16_MAX];
+};
+
+static char *cmsis_dap_tcp_host;
+static char *cmsis_dap_tcp_port;
+
+static int cmsis_dap_tcp_alloc(struct cmsis_dap *dap, unsigned int pkt_sz);
+static void cmsis_dap_tcp_free(struct cmsis_dap *dap);
+
+static int cmsis_dap_tcp_connect(void)
+{
+	struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+	struct addrinfo *result, *rp;
+	int fd = -1;
+
+	LOG_INFO("Connecting to CMSIS-DAP at %s:%s",
+		cmsis_dap_tcp_host ? cmsis_dap_tcp_host : "localhost", cmsis_dap_tcp_port);
+
+	int s = getaddrinfo(cmsis_dap_tcp_host, cmsis_dap_tcp_port, &hints, &result);
+	if (s != 0) {
+		LOG_ERROR("getaddrinfo: %s", gai_strerror(s));
+		return -1;
+	}
+
+	for (rp = result; rp; rp = rp->ai_next) {
+		fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+		if (fd == -1)
+			continue;
+
+		if (connect(fd, rp->ai_addr, rp->ai_addrlen) != -1)
+			break;
+
+		close_socket(fd);
+		fd = -1;
+	}
+	freeaddrinfo(result);
+
+	if (fd == -1) {
+		log_socket_error("Failed to connect");
+		return -1;
+	}
+
+	/* commands are sent one packet at a time, none of them should wait */
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (const char *)&one, sizeof(one));
+	return fd;
+}
+
+static int cmsis_dap_tcp_open(struct cmsis_dap *dap, uint16_t vids[], uint16_t pids[], const char *serial)
+{
+	if (!cmsis_dap_tcp_port) {
+		/* not an error when all the backends are tried */
+		LOG_DEBUG("no CMSIS-DAP TCP port configured");
+		return ERROR_FAIL;
+	}
+
+	dap->bdata = calloc(1, sizeof(struct cmsis_dap_backend_data));
+	if (!dap->bdata) {
+		LOG_ERROR("unable to allocate memory");
+		return ERROR_FAIL;
+	}
+
+	dap->bdata->fd = cmsis_dap_tcp_connect();
+	if (dap->bdata->fd < 0) {
+		free(dap->bdata);
+		dap->bdata = NULL;
+		return ERROR_FAIL;
+	}
+
+	int retval = cmsis_dap_tcp_alloc(dap, CMSIS_DAP_TCP_DEFAULT_PKT_SZ);
+	if (retval != ERROR_OK) {
+		cmsis_dap_tcp_free(dap);
+		close_socket(dap->bdata->fd);
+		free(dap->bdata);
+		dap->bdata = NULL;
+	}
+	return retval;
+}
+
+static void cmsis_dap_tcp_close(struct cmsis_dap *dap)
+{
+	close_socket(dap->bdata->fd);
+	cmsis_dap_tcp_free(dap);
+	free(dap->bdata);
+	dap->bdata = NULL;
+}
+
+static int cmsis_dap_tcp_read(struct cmsis_dap *dap, int transfer_timeout_ms,
+							  struct timeval *wait_timeout)
+{
+	struct cmsis_dap_backend_data *bdata = dap->bdata;
+	int timeout_ms = wait_timeout ?
+		wait_timeout->tv_sec * 1000 + wait_timeout->tv_usec / 1000 : transfer_timeout_ms;
+	int64_t deadline = timeval_ms() + timeout_ms;
+	unsigned int len = 0;
+
+	while (true) {
+		unsigned int need = CMSIS_DAP_TCP_HDR_SIZE;
+		if (bdata->rx_len >= CMSIS_DAP_TCP_HDR_SIZE) {
+			len = le_to_h_u16(bdata->rx + 4);
+			if (le_to_h_u32(bdata->rx) != CMSIS_DAP_TCP_SIGNATURE
+				|| bdata->rx[6] != CMSIS_DAP_TCP_TYPE_RESPONSE
+				|| len > dap->packet_buffer_size) {
+				LOG_ERROR("invalid CMSIS-DAP TCP response header");
+				bdata->rx_len = 0;
+				return ERROR_FAIL;
+			}
+			need += len;
+			if (bdata->rx_len == need)
+				break;
+		}
+
+		int64_t left = deadline - timeval_ms();
+		if (left < 0)
+			left = 0;
+		struct timeval tv = {
+			.tv_sec = left / 1000,
+			.tv_usec = left % 1000 * 1000
+		};
+		fd_set fds;
+		FD_ZERO(&fds);
+		FD_SET(bdata->fd, &fds);
+		int retval = select(bdata->fd + 1, &fds, NULL, NULL, &tv);
+		if (retval < 0) {
+			log_socket_error("CMSIS-DAP select");
+			return ERROR_FAIL;
+		}
+		/* a partially received response is completed by the next call */
+		if (retval == 0)
+			return ERROR_TIMEOUT_REACHED;
+
+		retval = read_socket(bdata->fd, bdata->rx + bdata->rx_len, need - bdata->rx_len);
+		if (retval <= 0) {
+			if (retval == 0)
+				LOG_ERROR("CMSIS-DAP TCP connection closed by the peer");
+			else
+				log_socket_error("CMSIS-DAP read");
+			return ERROR_FAIL;
+		}
+		bdata->rx_len += retval;
+	}
+
+	memcpy(dap->packet_buffer, bdata->rx + CMSIS_DAP_TCP_HDR_SIZE, len);
+	memset(&dap->packet_buffer[len], 0, dap->packet_buffer_size - len);
+	bdata->rx_len = 0;
+	return len;
+}
+
+static int cmsis_dap_tcp_write(struct cmsis_dap *dap, int txlen, int timeout_ms)
+{
+	struct cmsis_dap_backend_data *bdata = dap->bdata;
+
+	/* header and packet in one write, to get one segment with TCP_NODELAY */
+	h_u32_to_le(bdata->tx, CMSIS_DAP_TCP_SIGNATURE);
+	h_u16_to_le(bdata->tx + 4, txlen);
+	bdata->tx[6] = CMSIS_DAP_TCP_TYPE_REQUEST;
+	bdata->tx[7] = 0;
+	memcpy(bdata->tx + CMSIS_DAP_TCP_HDR_SIZE, dap->packet_buffer, txlen);
+
+	unsigned int size = CMSIS_DAP_TCP_HDR_SIZE + txlen;
+	unsigned int sent = 0;
+	while (sent < size) {
+		int retval = write_socket(bdata->fd, bdata->tx + sent, size - sent);
+		if (retval <= 0) {
+			log_socket_error("CMSIS-DAP write");
+			return ERROR_FAIL;
+		}
+		sent += retval;
+	}
+	return ERROR_OK;
+}
+
+static int cmsis_dap_tcp_alloc(struct cmsis_dap *dap, unsigned int pkt_sz)
+{
+	dap->packet_buffer = malloc(pkt_sz);
+	dap->bdata->tx = malloc(CMSIS_DAP_TCP_HDR_SIZE + pkt_sz);
+	if (!dap->packet_buffer || !dap->bdata->tx) {
+		LOG_ERROR("unable to allocate CMSIS-DAP packet buffer");
+		return ERROR_FAIL;
+	}
+
+	dap->packet_size = pkt_sz;
+	dap->packet_buffer_size = pkt_sz;
+	dap->packet_usable_size = pkt_sz;
+
+	dap->command = dap->packet_buffer;
+	dap->response = dap->packet_buffer;
+
+	return ERROR_OK;
+}
+
+static void cmsis_dap_tcp_free(struct cmsis_dap *dap)
+{
+	free(dap->bdata->tx);
+	dap->bdata->tx = NULL;
+
+	free(dap->packet_buffer);
+	dap->packet_buffer = NULL;
+	dap->command = NULL;
+	dap->response = NULL;
+}
+
+static void cmsis_dap_tcp_cancel_all(struct cmsis_dap *dap)
+{
+	struct cmsis_dap_backend_data *bdata = dap->bdata;
+
+	/* Drop the rest of a partially received response together with everything else already
+	 * in the socket, so that the next read starts at a frame header. Responses still on their
+	 * way are flushed by the caller. */
+	while (true) {
+		struct timeval tv = { .tv_sec = 0, .tv_usec = 0 };
+		fd_set fds;
+		FD_ZERO(&fds);
+		FD_SET(bdata->fd, &fds);
+		if (select(bdata->fd + 1, &fds, NULL, NULL, &tv) <= 0)
+			break;
+		if (read_socket(bdata->fd, bdata->rx, sizeof(bdata->rx)) <= 0)
+			break;
+	}
+	bdata->rx_len = 0;
+}
+
+COMMAND_HANDLER(cmsis_dap_handle_tcp_host_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	free(cmsis_dap_tcp_host);
+	cmsis_dap_tcp_host = strdup(CMD_ARGV[0]);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(cmsis_dap_handle_tcp_port_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	uint16_t port;
+	COMMAND_PARSE_NUMBER(u16, CMD_ARGV[0], port);
+	free(cmsis_dap_tcp_port);
+	cmsis_dap_tcp_port = strdup(CMD_ARGV[0]);
+	return ERROR_OK;
+}
+
+const struct command_registration cmsis_dap_tcp_subcommand_handlers[] = {
+	{
+		.name = "host",
+		.handler = &cmsis_dap_handle_tcp_host_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the host name or address of the CMSIS-DAP server (default localhost)",
+		.usage = "<host>",
+	},
+	{
+		.name = "port",
+		.handler = &cmsis_dap_handle_tcp_port_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the TCP port of the CMSIS-DAP server, the TCP backend is only used when set",
+		.usage = "<port>",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct cmsis_dap_backend cmsis_dap_tcp_backend = {
+	.name = "tcp",
+	.open = cmsis_dap_tcp_open,
+	.close = cmsis_dap_tcp_close,
+	.read = cmsis_dap_tcp_read,
+	.write = cmsis_dap_tcp_write,
+	.packet_buffer_alloc = cmsis_dap_tcp_alloc,
+	.packet_buffer_free = cmsis_dap_tcp_free,
+	.cancel_all = cmsis_dap_tcp_cancel_all,
+};
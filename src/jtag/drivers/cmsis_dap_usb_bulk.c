@@ -53,8 +53,10 @@ struct cmsis_dap_backend_data {
 	unsigned int ep_in;
 	int interface;
 
-	struct cmsis_dap_bulk_transfer command_transfers[MAX_PENDING_REQUESTS];
-	struct cmsis_dap_bulk_transfer response_transfers[MAX_PENDING_REQUESTS];
+	/* one command and one response transfer per request in flight */
+	unsigned int transfer_count;
+	struct cmsis_dap_bulk_transfer *command_transfers;
+	struct cmsis_dap_bulk_transfer *response_transfers;
 };
 
 static int cmsis_dap_usb_interface = -1;
@@ -377,24 +379,6 @@ static int cmsis_dap_usb_open(struct cmsis_dap *dap, uint16_t vids[], uint16_t p
 			dap->bdata->ep_in = ep_in;
 			dap->bdata->interface = interface_num;
 
-			for (unsigned int idx = 0; idx < MAX_PENDING_REQUESTS; idx++) {
-				dap->bdata->command_transfers[idx].status = CMSIS_DAP_TRANSFER_IDLE;
-				dap->bdata->command_transfers[idx].transfer = libusb_alloc_transfer(0);
-				if (!dap->bdata->command_transfers[idx].transfer) {
-					LOG_ERROR("unable to allocate USB transfer");
-					cmsis_dap_usb_close(dap);
-					return ERROR_FAIL;
-				}
-
-				dap->bdata->response_transfers[idx].status = CMSIS_DAP_TRANSFER_IDLE;
-				dap->bdata->response_transfers[idx].transfer = libusb_alloc_transfer(0);
-				if (!dap->bdata->response_transfers[idx].transfer) {
-					LOG_ERROR("unable to allocate USB transfer");
-					cmsis_dap_usb_close(dap);
-					return ERROR_FAIL;
-				}
-			}
-
 			err = cmsis_dap_usb_alloc(dap, packet_size);
 			if (err != ERROR_OK)
 				cmsis_dap_usb_close(dap);
@@ -413,10 +397,6 @@ static int cmsis_dap_usb_open(struct cmsis_dap *dap, uint16_t vids[], uint16_t p
 
 static void cmsis_dap_usb_close(struct cmsis_dap *dap)
 {
-	for (unsigned int i = 0; i < MAX_PENDING_REQUESTS; i++) {
-		libusb_free_transfer(dap->bdata->command_transfers[i].transfer);
-		libusb_free_transfer(dap->bdata->response_transfers[i].transfer);
-	}
 	cmsis_dap_usb_free(dap);
 	libusb_release_interface(dap->bdata->dev_handle, dap->bdata->interface);
 	libusb_close(dap->bdata->dev_handle);
@@ -593,8 +573,29 @@ static int cmsis_dap_usb_alloc(struct cmsis_dap *dap, unsigned int pkt_sz)
 	dap->command = dap->packet_buffer;
 	dap->response = dap->packet_buffer;
 
+	/* The packet count is not known until the adapter has been asked for it,
+	 * cmsis_dap_init() reallocates once it is */
 	struct cmsis_dap_backend_data *bdata = dap->bdata;
-	for (unsigned int i = 0; i < MAX_PENDING_REQUESTS; i++) {
+	unsigned int count = MAX(1, dap->packet_count);
+	bdata->command_transfers = calloc(count, sizeof(*bdata->command_transfers));
+	bdata->response_transfers = calloc(count, sizeof(*bdata->response_transfers));
+	if (!bdata->command_transfers || !bdata->response_transfers) {
+		LOG_ERROR("unable to allocate CMSIS-DAP pending transfers");
+		return ERROR_FAIL;
+	}
+	bdata->transfer_count = count;
+
+	for (unsigned int i = 0; i < count; i++) {
+		bdata->command_transfers[i].status = CMSIS_DAP_TRANSFER_IDLE;
+		bdata->command_transfers[i].transfer = libusb_alloc_transfer(0);
+		bdata->response_transfers[i].status = CMSIS_DAP_TRANSFER_IDLE;
+		bdata->response_transfers[i].transfer = libusb_alloc_transfer(0);
+		if (!bdata->command_transfers[i].transfer
+			|| !bdata->response_transfers[i].transfer) {
+			LOG_ERROR("unable to allocate USB transfer");
+			return ERROR_FAIL;
+		}
+
 		bdata->command_transfers[i].buffer =
 			oocd_libusb_dev_mem_alloc(bdata->dev_handle, pkt_sz);
 
@@ -614,14 +615,19 @@ static void cmsis_dap_usb_free(struct cmsis_dap *dap)
 {
 	struct cmsis_dap_backend_data *bdata = dap->bdata;
 
-	for (unsigned int i = 0; i < MAX_PENDING_REQUESTS; i++) {
+	for (unsigned int i = 0; i < bdata->transfer_count; i++) {
+		libusb_free_transfer(bdata->command_transfers[i].transfer);
+		libusb_free_transfer(bdata->response_transfers[i].transfer);
 		oocd_libusb_dev_mem_free(bdata->dev_handle,
 			bdata->command_transfers[i].buffer, dap->packet_size);
 		oocd_libusb_dev_mem_free(bdata->dev_handle,
 			bdata->response_transfers[i].buffer, dap->packet_size);
-		bdata->command_transfers[i].buffer = NULL;
-		bdata->response_transfers[i].buffer = NULL;
 	}
+	free(bdata->command_transfers);
+	free(bdata->response_transfers);
+	bdata->command_transfers = NULL;
+	bdata->response_transfers = NULL;
+	bdata->transfer_count = 0;
 
 	free(dap->packet_buffer);
 	dap->packet_buffer = NULL;
@@ -631,7 +637,7 @@ static void cmsis_dap_usb_free(struct cmsis_dap *dap)
 
 static void cmsis_dap_usb_cancel_all(struct cmsis_dap *dap)
 {
-	for (unsigned int i = 0; i < MAX_PENDING_REQUESTS; i++) {
+	for (unsigned int i = 0; i < dap->bdata->transfer_count; i++) {
 		if (dap->bdata->command_transfers[i].status == CMSIS_DAP_TRANSFER_PENDING)
 			libusb_cancel_transfer(dap->bdata->command_transfers[i].transfer);
 		if (dap->bdata->response_transfers[i].status == CMSIS_DAP_TRANSFER_PENDING)
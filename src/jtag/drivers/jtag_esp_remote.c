@@ -25,6 +25,7 @@
 #include "config.h"
 #endif
 
+#include <helper/align.h>
 #include <jtag/adapter.h>
 #include <jtag/interface.h>
 #ifdef HAVE_ARPA_INET_H
@@ -55,12 +56,14 @@ struct esp_remote_cmd {
 	uint16_t reserved : 4;
 	uint16_t ver : 4;
 		#define ESP_REMOTE_CMD_VER_1    1
+		#define ESP_REMOTE_CMD_VER_2    2
 
 	uint16_t function : 8;
 		#define ESP_REMOTE_CMD_RESET    1
 		#define ESP_REMOTE_CMD_SCAN     2
 		#define ESP_REMOTE_CMD_TMS_SEQ  3
 		#define ESP_REMOTE_CMD_SET_CLK  4
+		#define ESP_REMOTE_CMD_BATCH    5	/* v2 only */
 	union {
 		uint16_t function_specific;
 		struct {
@@ -91,11 +94,44 @@ struct esp_remote_cmd {
 	var->ver = ESP_REMOTE_CMD_VER_1; \
 	var->function = func
 
-typedef int (*jtag_esp_remote_send_cmd_t)(struct esp_remote_cmd *);
-typedef int (*jtag_esp_remote_receive_cmd_t)(struct esp_remote_cmd *);
-
-static jtag_esp_remote_send_cmd_t jtag_esp_remote_send_cmd = NULL;
-static jtag_esp_remote_receive_cmd_t jtag_esp_remote_receive_cmd = NULL;
+/*
+ * Protocol v2 sends all commands of a queue flush in one batch:
+ *  - batch header: v1 style header with ver = 2 and function = ESP_REMOTE_CMD_BATCH,
+ *    followed by the payload length (u32),
+ *  - payload: sequence of commands, each is function (u8), flags (u8), reserved (u16),
+ *    number of bits (u32) and the data, if any (bits rounded up to bytes).
+ * Multi-byte fields are little-endian. After the batch is executed the server sends
+ * the TDO data of all the scans with ESP_REMOTE_V2_FLAG_READ set, in the command order
+ * and every scan rounded up to bytes. Nothing is sent back when no scan needs reading.
+ */
+#define ESP_REMOTE_V2_BATCH_HDR_SIZE    8
+#define ESP_REMOTE_V2_CMD_HDR_SIZE      8
+#define ESP_REMOTE_V2_FLAG_READ         0x01
+#define ESP_REMOTE_V2_FLAG_FLIP_TMS     0x02
+#define ESP_REMOTE_V2_FLAG_SRST         0x04
+#define ESP_REMOTE_V2_FLAG_TRST         0x08
+/* batch is sent before it grows over this size, a single command can still be bigger */
+#define ESP_REMOTE_V2_BATCH_MAX_SIZE    (256 * 1024)
+
+typedef int (*jtag_esp_remote_send_t)(const void *data, size_t size);
+typedef int (*jtag_esp_remote_receive_t)(void *data, size_t size);
+
+static jtag_esp_remote_send_t jtag_esp_remote_send;
+static jtag_esp_remote_receive_t jtag_esp_remote_receive;
+
+static unsigned int esp_remote_protocol_version = ESP_REMOTE_CMD_VER_1;
+
+/* v2: commands which are not sent yet, starts with the batch header */
+static uint8_t *s_batch_buf;
+static size_t s_batch_size;
+static size_t s_batch_capacity;
+/* v2: number of TDO bytes the server will send back for the batch */
+static size_t s_batch_read_bytes;
+/* v2: TDO data received for the current queue and the read position */
+static uint8_t *s_tdo_buf;
+static size_t s_tdo_size;
+static size_t s_tdo_capacity;
+static size_t s_tdo_pos;
 
 enum esp_remote_protocols {
 	ESP_REMOTE_TCP,
@@ -129,29 +165,30 @@ static inline size_t cmd_data_len_bytes(const struct esp_remote_cmd *cmd)
 		return 0;
 }
 
-static int jtag_esp_remote_send_cmd_tcp(struct esp_remote_cmd *cmd)
+static int jtag_esp_remote_send_tcp(const void *data, size_t size)
 {
-	const size_t data_len = cmd_data_len_bytes(cmd);
-	const size_t size = sizeof(struct esp_remote_cmd) + data_len;
-	const size_t retval = write_socket(sockfd, cmd, size);
-	if (retval != size)
-		return ERROR_FAIL;
+	const uint8_t *p = data;
+	while (size > 0) {
+		int retval = write_socket(sockfd, p, size);
+		if (retval <= 0)
+			return ERROR_FAIL;
+		p += retval;
+		size -= retval;
+	}
 	return ERROR_OK;
 }
 
-static int jtag_esp_remote_send_cmd_usb(struct esp_remote_cmd *cmd)
+static int jtag_esp_remote_send_usb(const void *data, size_t size)
 {
-	const size_t data_len = cmd_data_len_bytes(cmd);
-	const int size = sizeof(struct esp_remote_cmd) + data_len;
 	int tr, ret = jtag_libusb_bulk_write(usb_device,
 		USB_OUT_EP,
-		(char *)cmd,
+		(char *)data,
 		size,
 		1000 /*ms*/,
 		&tr);
 	if (ret != ERROR_OK)
 		return ERROR_FAIL;
-	if (tr != size) {
+	if ((size_t)tr != size) {
 		LOG_ERROR("jtag_esp_remote: usb sent only %d out of %d bytes.",
 			(int)tr,
 			(int)size);
@@ -160,57 +197,167 @@ static int jtag_esp_remote_send_cmd_usb(struct esp_remote_cmd *cmd)
 	return ERROR_OK;
 }
 
-static int jtag_esp_remote_receive_cmd_tcp(struct esp_remote_cmd *cmd)
+static int jtag_esp_remote_receive_tcp(void *data, size_t size)
 {
-	const size_t data_len = cmd_data_len_bytes(cmd);
-	const size_t ret_val = read_socket(sockfd, cmd->data, data_len);
-	if (ret_val != data_len)
-		return ERROR_FAIL;
+	uint8_t *p = data;
+	while (size > 0) {
+		int retval = read_socket(sockfd, p, size);
+		if (retval <= 0)
+			return ERROR_FAIL;
+		p += retval;
+		size -= retval;
+	}
 	return ERROR_OK;
 }
 
-static int jtag_esp_remote_receive_cmd_usb(struct esp_remote_cmd *cmd)
+static int jtag_esp_remote_receive_usb(void *data, size_t data_len)
 {
-	size_t data_len = cmd_data_len_bytes(cmd);
-	if (usb_device) {
-		if (data_len != 0) {
-			/* Need to keep an internal buffer because libusb can read the same amount
-			 * of bytes sent together. */
-			/* E.g. If 2 bytes were sent then it cannot read 1 byte. */
-			static char internal_buffer[64];/* 64 is the size of VENDOR class USB buffer
-							                                **/
-			static size_t internal_buffer_occupied = 0;
-			for (size_t i = 0; i < data_len; ) {
-				if (internal_buffer_occupied > 0) {
-					const size_t t =
-						MIN(data_len - i, internal_buffer_occupied);
-					memcpy(((char *)cmd->data) + i, internal_buffer, t);
-					memmove(internal_buffer,
-						internal_buffer + t,
-						internal_buffer_occupied - t);
-					i += t;
-					internal_buffer_occupied -= t;
-
-					if (i >= data_len)
-						break;
-				}
-				assert(internal_buffer_occupied == 0);
-				int tr, ret = jtag_libusb_bulk_read(usb_device,
-					USB_IN_EP,
-					internal_buffer,
-					sizeof(internal_buffer),
-					1000,	/*ms*/
-					&tr);
-				/* libusb will read groups of bytes which were send toghether and
-				 * not everything in the receive buffer */
-				if (ret != ERROR_OK || tr == 0) {
-					LOG_ERROR("jtag_esp_remote: usb receive error");
-					return ERROR_FAIL;
-				}
-				internal_buffer_occupied = tr;
+	if (!usb_device || data_len == 0)
+		return ERROR_OK;
+
+	/* Need to keep an internal buffer because libusb can read the same amount
+	 * of bytes sent together. */
+	/* E.g. If 2 bytes were sent then it cannot read 1 byte. */
+	static char internal_buffer[64];/* 64 is the size of VENDOR class USB buffer */
+	static size_t internal_buffer_occupied;
+	for (size_t i = 0; i < data_len; ) {
+		if (internal_buffer_occupied > 0) {
+			const size_t t = MIN(data_len - i, internal_buffer_occupied);
+			memcpy(((char *)data) + i, internal_buffer, t);
+			memmove(internal_buffer,
+				internal_buffer + t,
+				internal_buffer_occupied - t);
+			i += t;
+			internal_buffer_occupied -= t;
+
+			if (i >= data_len)
+				break;
+		}
+		assert(internal_buffer_occupied == 0);
+		int tr, ret;
+		/* whole packets can not overflow the destination, read them in place */
+		const size_t direct_len = ALIGN_DOWN(data_len - i, sizeof(internal_buffer));
+		if (direct_len > 0) {
+			ret = jtag_libusb_bulk_read(usb_device, USB_IN_EP, ((char *)data) + i,
+				direct_len, 1000 /*ms*/, &tr);
+			if (ret == ERROR_OK && tr > 0) {
+				i += tr;
+				continue;
 			}
+		} else {
+			ret = jtag_libusb_bulk_read(usb_device,
+				USB_IN_EP,
+				internal_buffer,
+				sizeof(internal_buffer),
+				1000,	/*ms*/
+				&tr);
+		}
+		/* libusb will read groups of bytes which were send toghether and
+		 * not everything in the receive buffer */
+		if (ret != ERROR_OK || tr == 0) {
+			LOG_ERROR("jtag_esp_remote: usb receive error");
+			return ERROR_FAIL;
+		}
+		internal_buffer_occupied = tr;
+	}
+	return ERROR_OK;
+}
+
+static int jtag_esp_remote_send_cmd(struct esp_remote_cmd *cmd)
+{
+	return jtag_esp_remote_send(cmd, sizeof(struct esp_remote_cmd) + cmd_data_len_bytes(cmd));
+}
+
+static int jtag_esp_remote_receive_cmd(struct esp_remote_cmd *cmd)
+{
+	return jtag_esp_remote_receive(cmd->data, cmd_data_len_bytes(cmd));
+}
+
+static int jtag_esp_remote_batch_reserve(size_t size)
+{
+	if (s_batch_size + size <= s_batch_capacity)
+		return ERROR_OK;
+	size_t new_capacity = MAX(s_batch_capacity * 2, s_batch_size + size);
+	uint8_t *new_buf = realloc(s_batch_buf, new_capacity);
+	if (!new_buf) {
+		LOG_ERROR("jtag_esp_remote: failed to alloc memory for commands batch");
+		return ERROR_FAIL;
+	}
+	s_batch_buf = new_buf;
+	s_batch_capacity = new_capacity;
+	return ERROR_OK;
+}
+
+/* Sends the pending v2 batch and receives its TDO data */
+static int jtag_esp_remote_batch_flush(void)
+{
+	if (s_batch_size <= ESP_REMOTE_V2_BATCH_HDR_SIZE)
+		return ERROR_OK;
+
+	s_batch_buf[0] = ESP_REMOTE_CMD_VER_2 << 4;
+	s_batch_buf[1] = ESP_REMOTE_CMD_BATCH;
+	s_batch_buf[2] = 0;
+	s_batch_buf[3] = 0;
+	h_u32_to_le(&s_batch_buf[4], s_batch_size - ESP_REMOTE_V2_BATCH_HDR_SIZE);
+	int retval = jtag_esp_remote_send(s_batch_buf, s_batch_size);
+	s_batch_size = ESP_REMOTE_V2_BATCH_HDR_SIZE;
+	if (retval != ERROR_OK)
+		return retval;
+
+	size_t read_bytes = s_batch_read_bytes;
+	s_batch_read_bytes = 0;
+	if (read_bytes == 0)
+		return ERROR_OK;
+
+	if (s_tdo_size + read_bytes > s_tdo_capacity) {
+		size_t new_capacity = MAX(s_tdo_capacity * 2, s_tdo_size + read_bytes);
+		uint8_t *new_buf = realloc(s_tdo_buf, new_capacity);
+		if (!new_buf) {
+			LOG_ERROR("jtag_esp_remote: failed to alloc memory for TDO data");
+			return ERROR_FAIL;
 		}
+		s_tdo_buf = new_buf;
+		s_tdo_capacity = new_capacity;
 	}
+	retval = jtag_esp_remote_receive(s_tdo_buf + s_tdo_size, read_bytes);
+	if (retval != ERROR_OK)
+		return retval;
+	s_tdo_size += read_bytes;
+	return ERROR_OK;
+}
+
+/* Appends a command to the v2 batch. If 'data' is NULL, the data is filled with ones. */
+static int jtag_esp_remote_batch_add(uint8_t function, uint8_t flags, uint32_t bits,
+	const uint8_t *data)
+{
+	const size_t data_len = DIV_ROUND_UP(bits, 8);
+	const size_t size = ESP_REMOTE_V2_CMD_HDR_SIZE + data_len;
+
+	if (s_batch_size > ESP_REMOTE_V2_BATCH_HDR_SIZE &&
+		s_batch_size + size > ESP_REMOTE_V2_BATCH_MAX_SIZE) {
+		int retval = jtag_esp_remote_batch_flush();
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	if (s_batch_size == 0)
+		s_batch_size = ESP_REMOTE_V2_BATCH_HDR_SIZE;
+	int retval = jtag_esp_remote_batch_reserve(size);
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint8_t *p = s_batch_buf + s_batch_size;
+	p[0] = function;
+	p[1] = flags;
+	p[2] = 0;
+	p[3] = 0;
+	h_u32_to_le(&p[4], bits);
+	if (data)
+		memcpy(p + ESP_REMOTE_V2_CMD_HDR_SIZE, data, data_len);
+	else
+		memset(p + ESP_REMOTE_V2_CMD_HDR_SIZE, 0xff, data_len);
+	s_batch_size += size;
+	if (flags & ESP_REMOTE_V2_FLAG_READ)
+		s_batch_read_bytes += data_len;
 	return ERROR_OK;
 }
 
@@ -221,6 +368,11 @@ static int jtag_esp_remote_receive_cmd_usb(struct esp_remote_cmd *cmd)
  */
 static int jtag_esp_remote_reset(int trst, int srst)
 {
+	if (esp_remote_protocol_version == ESP_REMOTE_CMD_VER_2)
+		return jtag_esp_remote_batch_add(ESP_REMOTE_CMD_RESET,
+			(srst ? ESP_REMOTE_V2_FLAG_SRST : 0) | (trst ? ESP_REMOTE_V2_FLAG_TRST : 0),
+			0, NULL);
+
 	ESP_REMOTE_CMD_DECL(cmd, ESP_REMOTE_CMD_RESET, 0);
 	cmd->reset.srst = srst;
 	cmd->reset.trst = trst;
@@ -241,6 +393,9 @@ static int jtag_esp_remote_reset(int trst, int srst)
  */
 static int jtag_esp_remote_tms_seq(const uint8_t *bits, int nb_bits)
 {
+	if (esp_remote_protocol_version == ESP_REMOTE_CMD_VER_2)
+		return jtag_esp_remote_batch_add(ESP_REMOTE_CMD_TMS_SEQ, 0, nb_bits, bits);
+
 	if (nb_bits > MAX_BITS) {
 		LOG_ERROR("%s: nb_bits too large: %d, max %d", __func__, nb_bits, MAX_BITS);
 		return ERROR_FAIL;
@@ -353,12 +508,22 @@ static int jtag_esp_remote_get_tdi_xfer_result(uint8_t *bits, int nb_bits)
 	cmd->scan.bits = nb_bits;
 	memset(cmd->data, 0xcc, nb_bytes);
 
-	int retval = jtag_esp_remote_receive_cmd(cmd);
-	if (retval != ERROR_OK)
-		return retval;
+	if (esp_remote_protocol_version == ESP_REMOTE_CMD_VER_2) {
+		if (s_tdo_pos + nb_bytes > s_tdo_size) {
+			LOG_ERROR("jtag_esp_remote: not enough TDO data received");
+			return ERROR_FAIL;
+		}
+		if (bits)
+			memcpy(bits, s_tdo_buf + s_tdo_pos, nb_bytes);
+		s_tdo_pos += nb_bytes;
+	} else {
+		int retval = jtag_esp_remote_receive_cmd(cmd);
+		if (retval != ERROR_OK)
+			return retval;
 
-	if (bits)
-		memcpy(bits, cmd->data, nb_bytes);
+		if (bits)
+			memcpy(bits, cmd->data, nb_bytes);
+	}
 
 	assert(s_read_bits_queued >= nb_bits);
 	s_read_bits_queued -= nb_bits;
@@ -376,6 +541,15 @@ static int jtag_esp_remote_queue_tdi(uint8_t *bits, int nb_bits, int tap_shift,
 	int nb_xfer = DIV_ROUND_UP(nb_bits, XFERT_MAX_SIZE * 8);
 	int retval;
 
+	/* v2 has 32-bit length, the scan is never split */
+	if (esp_remote_protocol_version == ESP_REMOTE_CMD_VER_2) {
+		uint8_t flags = (tap_shift ? ESP_REMOTE_V2_FLAG_FLIP_TMS : 0) |
+			(need_read ? ESP_REMOTE_V2_FLAG_READ : 0);
+		if (need_read)
+			s_read_bits_queued += nb_bits;
+		return jtag_esp_remote_batch_add(ESP_REMOTE_CMD_SCAN, flags, nb_bits, bits);
+	}
+
 	while (nb_xfer) {
 		if (nb_xfer == 1) {
 			retval =
@@ -492,20 +666,6 @@ jtag_esp_remote_scan_read_exit:
 	return retval;
 }
 
-static int jtag_esp_remote_runtest(int cycles, tap_state_t end_state)
-{
-	int retval;
-
-	retval = jtag_esp_remote_state_move(TAP_IDLE);
-	if (retval != ERROR_OK)
-		return retval;
-
-	for (int i = 0; i < cycles; i++)
-		jtag_esp_remote_clock_tms(0);
-
-	return jtag_esp_remote_state_move(end_state);
-}
-
 static int jtag_esp_remote_stableclocks(int cycles)
 {
 	uint8_t tms_bits[4];
@@ -531,6 +691,22 @@ static int jtag_esp_remote_stableclocks(int cycles)
 	return ERROR_OK;
 }
 
+static int jtag_esp_remote_runtest(int cycles, tap_state_t end_state)
+{
+	int retval;
+
+	retval = jtag_esp_remote_state_move(TAP_IDLE);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* TMS=0 in IDLE, send the cycles as a few TMS sequences instead of one per clock */
+	retval = jtag_esp_remote_stableclocks(cycles);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return jtag_esp_remote_state_move(end_state);
+}
+
 static int jtag_esp_remote_execute_queue(struct jtag_command *cmd_queue)
 {
 	struct jtag_command *cmd;
@@ -562,6 +738,9 @@ static int jtag_esp_remote_execute_queue(struct jtag_command *cmd_queue)
 			retval = jtag_esp_remote_tms(cmd->cmd.tms);
 			break;
 		case JTAG_SLEEP:
+			/* preceding commands must be executed before sleeping */
+			if (esp_remote_protocol_version == ESP_REMOTE_CMD_VER_2)
+				retval = jtag_esp_remote_batch_flush();
 			jtag_sleep(cmd->cmd.sleep->us);
 			break;
 		case JTAG_SCAN:
@@ -575,12 +754,22 @@ static int jtag_esp_remote_execute_queue(struct jtag_command *cmd_queue)
 		}
 	}
 
+	if (esp_remote_protocol_version == ESP_REMOTE_CMD_VER_2 && retval == ERROR_OK)
+		retval = jtag_esp_remote_batch_flush();
+
 	if (read_size > 0) {
 		for (cmd = cmd_queue; retval == ERROR_OK && cmd; cmd = cmd->next) {
 			if (cmd->type == JTAG_SCAN)
 				retval = jtag_esp_remote_scan_read(cmd->cmd.scan);
 		}
 	}
+	/* v2 state is reset also on errors, the next queue starts over */
+	s_batch_size = 0;
+	s_batch_read_bytes = 0;
+	s_tdo_size = 0;
+	s_tdo_pos = 0;
+	if (retval != ERROR_OK)
+		s_read_bits_queued = 0;
 	assert(s_read_bits_queued == 0);
 
 	return retval;
@@ -660,6 +849,13 @@ static int jtag_esp_remote_init(void)
 
 static int jtag_esp_remote_quit(void)
 {
+	free(s_batch_buf);
+	s_batch_buf = NULL;
+	s_batch_capacity = 0;
+	free(s_tdo_buf);
+	s_tdo_buf = NULL;
+	s_tdo_capacity = 0;
+
 	if (usb_device) {
 		libusb_release_interface(usb_device, USB_INTERFACE);
 		jtag_libusb_close(usb_device);
@@ -706,6 +902,14 @@ static int jtag_esp_remote_jtag_speed(int speed)
 		((uint32_t)speed >> 0) & 0xFF
 	};
 
+	if (esp_remote_protocol_version == ESP_REMOTE_CMD_VER_2) {
+		int retval = jtag_esp_remote_batch_add(ESP_REMOTE_CMD_SET_CLK, 0,
+			sizeof(speed_buff) * 8, speed_buff);
+		if (retval == ERROR_OK)
+			retval = jtag_esp_remote_batch_flush();
+		return retval;
+	}
+
 	ESP_REMOTE_CMD_DECL(cmd, ESP_REMOTE_CMD_SET_CLK, sizeof(speed_buff));
 
 	memcpy(cmd->data, &speed_buff, sizeof(speed_buff));
@@ -718,15 +922,15 @@ COMMAND_HANDLER(jtag_esp_remote_protocol)
 	if (CMD_ARGC > 0) {
 		if (strcmp(CMD_ARGV[0], "usb") == 0) {
 			esp_remote_protocol = ESP_REMOTE_USB;
-			jtag_esp_remote_send_cmd = jtag_esp_remote_send_cmd_usb;
-			jtag_esp_remote_receive_cmd = jtag_esp_remote_receive_cmd_usb;
+			jtag_esp_remote_send = jtag_esp_remote_send_usb;
+			jtag_esp_remote_receive = jtag_esp_remote_receive_usb;
 			LOG_INFO("USB protocol set for esp remote");
 			return ERROR_OK;
 		}
 		if (strcmp(CMD_ARGV[0], "tcp") == 0) {
 			esp_remote_protocol = ESP_REMOTE_TCP;
-			jtag_esp_remote_send_cmd = jtag_esp_remote_send_cmd_tcp;
-			jtag_esp_remote_receive_cmd = jtag_esp_remote_receive_cmd_tcp;
+			jtag_esp_remote_send = jtag_esp_remote_send_tcp;
+			jtag_esp_remote_receive = jtag_esp_remote_receive_tcp;
 			if (!server_address)
 				server_address = strdup(DEFAULT_SERVER_ADDRESS);
 			LOG_INFO("TCP protocol set for esp remote");
@@ -738,6 +942,25 @@ COMMAND_HANDLER(jtag_esp_remote_protocol)
 	return ERROR_FAIL;
 }
 
+COMMAND_HANDLER(jtag_esp_remote_protocol_version_cmd)
+{
+	if (CMD_ARGC == 0) {
+		command_print(CMD, "%u", esp_remote_protocol_version);
+		return ERROR_OK;
+	}
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	unsigned int ver;
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], ver);
+	if (ver != ESP_REMOTE_CMD_VER_1 && ver != ESP_REMOTE_CMD_VER_2) {
+		command_print(CMD, "Unsupported protocol version %u", ver);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	esp_remote_protocol_version = ver;
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(jtag_esp_remote_vid_pid)
 {
 	if (esp_remote_protocol != ESP_REMOTE_USB) {
@@ -803,6 +1026,14 @@ static const struct command_registration jtag_esp_remote_command_handlers[] = {
 		.help = "set communication protocol for ESP remote driver (tcp or usb)",
 		.usage = "description_string",
 	},
+	{
+		.name = "jtag_esp_remote_protocol_version",
+		.handler = &jtag_esp_remote_protocol_version_cmd,
+		.mode = COMMAND_CONFIG,
+		.help = "set version of the wire protocol: 1 sends every command separately, "
+			"2 sends all commands of a queue in one batch (needs server support)",
+		.usage = "[1|2]",
+	},
 	{
 		.name = "jtag_esp_remote_vid_pid",
 		.handler = &jtag_esp_remote_vid_pid,
@@ -27,9 +27,44 @@
 static char *remote_bitbang_host;
 static char *remote_bitbang_port;
 
+/* Vector extension, see doc/manual/jtag/drivers/remote_bitbang.txt */
+#define REMOTE_BITBANG_VECTOR_MAX_CYCLES	8192
+/* TDO samples in flight, replaces the classic limit given by the receive buffer */
+#define REMOTE_BITBANG_VECTOR_BUF_SIZE		32768
+#define REMOTE_BITBANG_VECTOR_SOCKBUF_SIZE	(256 * 1024)
+#define REMOTE_BITBANG_VECTOR_MAX_REPLIES	64
+
 static int remote_bitbang_fd;
-static uint8_t remote_bitbang_send_buf[512];
+static uint8_t remote_bitbang_send_buf[16384];
 static unsigned int remote_bitbang_send_buf_used;
+/* classic protocol sends at most this many characters at once */
+static unsigned int remote_bitbang_send_buf_limit = 512;
+
+static bool use_vector = true;
+static bool remote_bitbang_vector_active;
+
+/* Clock cycles collected from write() and sample() calls, not sent yet.
+ * Every cycle is: TCK low with TMS and TDI set, TDO sample if requested, TCK high. */
+static struct {
+	unsigned int cycles;
+	unsigned int captures;
+	uint8_t tms[REMOTE_BITBANG_VECTOR_MAX_CYCLES / 8];
+	uint8_t tdi[REMOTE_BITBANG_VECTOR_MAX_CYCLES / 8];
+	uint8_t capture[REMOTE_BITBANG_VECTOR_MAX_CYCLES / 8];
+	/* write with TCK low, which is waiting for the TCK rising edge to form a cycle */
+	bool low_pending;
+	bool low_capture;
+	int low_tms;
+	int low_tdi;
+	/* number of TDO samples in every reply which is not received yet */
+	unsigned int replies[REMOTE_BITBANG_VECTOR_MAX_REPLIES];
+	unsigned int replies_start;
+	unsigned int replies_num;
+	/* received TDO samples, not read by bitbang yet */
+	uint8_t tdo[REMOTE_BITBANG_VECTOR_MAX_CYCLES / 8];
+	unsigned int tdo_pos;
+	unsigned int tdo_num;
+} remote_bitbang_vec;
 
 static bool use_remote_sleep;
 
@@ -64,7 +99,7 @@ static unsigned int remote_bitbang_recv_buf_contiguous_available_space(void)
 	}
 }
 
-static int remote_bitbang_flush(void)
+static int remote_bitbang_flush_send_buf(void)
 {
 	if (remote_bitbang_send_buf_used <= 0)
 		return ERROR_OK;
@@ -84,6 +119,83 @@ static int remote_bitbang_flush(void)
 	return ERROR_OK;
 }
 
+static int remote_bitbang_queue_raw(const void *data, unsigned int size)
+{
+	assert(size <= sizeof(remote_bitbang_send_buf));
+	if (remote_bitbang_send_buf_used + size > sizeof(remote_bitbang_send_buf)) {
+		int retval = remote_bitbang_flush_send_buf();
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	memcpy(remote_bitbang_send_buf + remote_bitbang_send_buf_used, data, size);
+	remote_bitbang_send_buf_used += size;
+	if (remote_bitbang_send_buf_used >= remote_bitbang_send_buf_limit)
+		return remote_bitbang_flush_send_buf();
+	return ERROR_OK;
+}
+
+/* Sends the collected cycles as one 'V' request */
+static int remote_bitbang_vector_flush(void)
+{
+	unsigned int cycles = remote_bitbang_vec.cycles;
+	if (cycles == 0)
+		return ERROR_OK;
+
+	unsigned int nbytes = DIV_ROUND_UP(cycles, 8);
+	uint8_t hdr[5] = { 'V' };
+	h_u32_to_le(&hdr[1], cycles);
+	int retval = remote_bitbang_queue_raw(hdr, sizeof(hdr));
+	if (retval == ERROR_OK)
+		retval = remote_bitbang_queue_raw(remote_bitbang_vec.tms, nbytes);
+	if (retval == ERROR_OK)
+		retval = remote_bitbang_queue_raw(remote_bitbang_vec.tdi, nbytes);
+	if (retval == ERROR_OK)
+		retval = remote_bitbang_queue_raw(remote_bitbang_vec.capture, nbytes);
+
+	if (remote_bitbang_vec.captures > 0) {
+		/* bitbang reads the samples at least at the end of every scan, so only a few
+		 * replies can be pending */
+		assert(remote_bitbang_vec.replies_num < REMOTE_BITBANG_VECTOR_MAX_REPLIES);
+		unsigned int i = (remote_bitbang_vec.replies_start + remote_bitbang_vec.replies_num) %
+			REMOTE_BITBANG_VECTOR_MAX_REPLIES;
+		remote_bitbang_vec.replies[i] = remote_bitbang_vec.captures;
+		remote_bitbang_vec.replies_num++;
+	}
+
+	memset(remote_bitbang_vec.tms, 0, nbytes);
+	memset(remote_bitbang_vec.tdi, 0, nbytes);
+	memset(remote_bitbang_vec.capture, 0, nbytes);
+	remote_bitbang_vec.cycles = 0;
+	remote_bitbang_vec.captures = 0;
+	return retval;
+}
+
+/* Sends everything collected for vectors, must precede any classic request */
+static int remote_bitbang_vector_sync(void)
+{
+	int retval = remote_bitbang_vector_flush();
+	if (retval != ERROR_OK || !remote_bitbang_vec.low_pending)
+		return retval;
+
+	/* a write without the rising edge can't be a part of a cycle */
+	assert(!remote_bitbang_vec.low_capture);
+	remote_bitbang_vec.low_pending = false;
+	char c = '0' + ((remote_bitbang_vec.low_tms ? 0x2 : 0x0) | (remote_bitbang_vec.low_tdi ? 0x1 : 0x0));
+	return remote_bitbang_queue_raw(&c, 1);
+}
+
+static int remote_bitbang_flush(void)
+{
+	if (remote_bitbang_vector_active) {
+		int retval = remote_bitbang_vector_sync();
+		if (retval != ERROR_OK) {
+			remote_bitbang_send_buf_used = 0;
+			return retval;
+		}
+	}
+	return remote_bitbang_flush_send_buf();
+}
+
 enum block_bool {
 	NO_BLOCK,
 	BLOCK
@@ -152,13 +264,34 @@ typedef enum {
 
 static int remote_bitbang_queue(int c, flush_bool_t flush)
 {
-	remote_bitbang_send_buf[remote_bitbang_send_buf_used++] = c;
-	if (flush == FLUSH_SEND_BUF ||
-			remote_bitbang_send_buf_used >= ARRAY_SIZE(remote_bitbang_send_buf))
-		return remote_bitbang_flush();
+	if (remote_bitbang_vector_active) {
+		int retval = remote_bitbang_vector_sync();
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	uint8_t ch = c;
+	int retval = remote_bitbang_queue_raw(&ch, 1);
+	if (retval != ERROR_OK)
+		return retval;
+	if (flush == FLUSH_SEND_BUF)
+		return remote_bitbang_flush_send_buf();
 	return ERROR_OK;
 }
 
+/* Returns the next received character, or -1 on error */
+static int remote_bitbang_recv_char(void)
+{
+	if (remote_bitbang_recv_buf_empty()) {
+		if (remote_bitbang_fill_buf(BLOCK) != ERROR_OK)
+			return -1;
+	}
+	assert(!remote_bitbang_recv_buf_empty());
+	int c = (uint8_t)remote_bitbang_recv_buf[remote_bitbang_recv_buf_start];
+	remote_bitbang_recv_buf_start =
+		(remote_bitbang_recv_buf_start + 1) % sizeof(remote_bitbang_recv_buf);
+	return c;
+}
+
 static int remote_bitbang_quit(void)
 {
 	if (remote_bitbang_queue('Q', FLUSH_SEND_BUF) == ERROR_FAIL)
@@ -190,29 +323,102 @@ static bb_value_t char_to_int(int c)
 	}
 }
 
+static int remote_bitbang_write(int tck, int tms, int tdi);
+
 static int remote_bitbang_sample(void)
 {
 	if (remote_bitbang_fill_buf(NO_BLOCK) != ERROR_OK)
 		return ERROR_FAIL;
+	if (remote_bitbang_vector_active) {
+		/* bitbang always samples after setting TCK low, otherwise do it here */
+		if (!remote_bitbang_vec.low_pending &&
+				remote_bitbang_write(0, remote_bitbang_vec.low_tms, remote_bitbang_vec.low_tdi) != ERROR_OK)
+			return ERROR_FAIL;
+		remote_bitbang_vec.low_capture = true;
+		return ERROR_OK;
+	}
 	assert(!remote_bitbang_recv_buf_full());
 	return remote_bitbang_queue('R', NO_FLUSH);
 }
 
+/* Receives the next pending vector reply */
+static int remote_bitbang_vector_receive(void)
+{
+	assert(remote_bitbang_vec.replies_num > 0);
+	unsigned int samples = remote_bitbang_vec.replies[remote_bitbang_vec.replies_start];
+	remote_bitbang_vec.replies_start = (remote_bitbang_vec.replies_start + 1) %
+		REMOTE_BITBANG_VECTOR_MAX_REPLIES;
+	remote_bitbang_vec.replies_num--;
+
+	for (unsigned int i = 0; i < DIV_ROUND_UP(samples, 8); i++) {
+		int c = remote_bitbang_recv_char();
+		if (c < 0)
+			return ERROR_FAIL;
+		remote_bitbang_vec.tdo[i] = c;
+	}
+	remote_bitbang_vec.tdo_pos = 0;
+	remote_bitbang_vec.tdo_num = samples;
+	return ERROR_OK;
+}
+
 static bb_value_t remote_bitbang_read_sample(void)
 {
-	if (remote_bitbang_recv_buf_empty()) {
-		if (remote_bitbang_fill_buf(BLOCK) != ERROR_OK)
-			return BB_ERROR;
+	if (remote_bitbang_vector_active) {
+		if (remote_bitbang_vec.tdo_pos == remote_bitbang_vec.tdo_num) {
+			if (remote_bitbang_vec.replies_num == 0 && remote_bitbang_vec.captures > 0 &&
+					remote_bitbang_vector_flush() != ERROR_OK)
+				return BB_ERROR;
+			if (remote_bitbang_vec.replies_num > 0 && remote_bitbang_vector_receive() != ERROR_OK)
+				return BB_ERROR;
+		}
+		/* SWD reads use classic requests */
+		if (remote_bitbang_vec.tdo_pos < remote_bitbang_vec.tdo_num) {
+			unsigned int i = remote_bitbang_vec.tdo_pos++;
+			return (remote_bitbang_vec.tdo[i / 8] >> (i % 8)) & 1 ? BB_HIGH : BB_LOW;
+		}
 	}
-	assert(!remote_bitbang_recv_buf_empty());
-	int c = remote_bitbang_recv_buf[remote_bitbang_recv_buf_start];
-	remote_bitbang_recv_buf_start =
-		(remote_bitbang_recv_buf_start + 1) % sizeof(remote_bitbang_recv_buf);
+
+	int c = remote_bitbang_recv_char();
+	if (c < 0)
+		return BB_ERROR;
 	return char_to_int(c);
 }
 
 static int remote_bitbang_write(int tck, int tms, int tdi)
 {
+	if (remote_bitbang_vector_active) {
+		if (!tck) {
+			if (remote_bitbang_vec.low_pending) {
+				int retval = remote_bitbang_vector_sync();
+				if (retval != ERROR_OK)
+					return retval;
+			}
+			remote_bitbang_vec.low_pending = true;
+			remote_bitbang_vec.low_capture = false;
+			remote_bitbang_vec.low_tms = tms;
+			remote_bitbang_vec.low_tdi = tdi;
+			return ERROR_OK;
+		}
+		if (remote_bitbang_vec.low_pending && remote_bitbang_vec.low_tms == tms &&
+				remote_bitbang_vec.low_tdi == tdi) {
+			unsigned int i = remote_bitbang_vec.cycles++;
+			if (tms)
+				remote_bitbang_vec.tms[i / 8] |= BIT(i % 8);
+			if (tdi)
+				remote_bitbang_vec.tdi[i / 8] |= BIT(i % 8);
+			if (remote_bitbang_vec.low_capture) {
+				remote_bitbang_vec.capture[i / 8] |= BIT(i % 8);
+				remote_bitbang_vec.captures++;
+			}
+			remote_bitbang_vec.low_pending = false;
+			remote_bitbang_vec.low_capture = false;
+			if (remote_bitbang_vec.cycles == REMOTE_BITBANG_VECTOR_MAX_CYCLES)
+				return remote_bitbang_vector_flush();
+			return ERROR_OK;
+		}
+		/* not a cycle, goes as a classic request below */
+	}
+
 	char c = '0' + ((tck ? 0x4 : 0x0) | (tms ? 0x2 : 0x0) | (tdi ? 0x1 : 0x0));
 	return remote_bitbang_queue(c, NO_FLUSH);
 }
@@ -368,6 +574,46 @@ static int remote_bitbang_init_unix(void)
 	return fd;
 }
 
+/* Asks the server for the vector extension with 'X'. Classic servers ignore it and
+ * only answer the following 'R'. Extension aware ones reply 'X' and the version first. */
+static int remote_bitbang_vector_negotiate(void)
+{
+	if (remote_bitbang_queue_raw("XR", 2) != ERROR_OK ||
+			remote_bitbang_flush_send_buf() != ERROR_OK)
+		return ERROR_FAIL;
+
+	int c = remote_bitbang_recv_char();
+	if (c == '0' || c == '1') {
+		LOG_INFO("remote_bitbang: server does not support vector extension, using classic protocol");
+		return ERROR_OK;
+	}
+	if (c != 'X') {
+		LOG_ERROR("remote_bitbang: invalid reply to extension query: %c(%i), try 'remote_bitbang vector off'",
+			c, c);
+		return ERROR_FAIL;
+	}
+	int ver = remote_bitbang_recv_char();
+	c = remote_bitbang_recv_char();
+	if (ver < 0 || (c != '0' && c != '1')) {
+		LOG_ERROR("remote_bitbang: invalid reply to extension query");
+		return ERROR_FAIL;
+	}
+	if (ver != '1') {
+		LOG_WARNING("remote_bitbang: unsupported vector extension version %c, using classic protocol", ver);
+		return ERROR_OK;
+	}
+
+	/* replies of the vectors and the vectors themselves are bigger, let them flow */
+	int size = REMOTE_BITBANG_VECTOR_SOCKBUF_SIZE;
+	setsockopt(remote_bitbang_fd, SOL_SOCKET, SO_SNDBUF, (const char *)&size, sizeof(size));
+	setsockopt(remote_bitbang_fd, SOL_SOCKET, SO_RCVBUF, (const char *)&size, sizeof(size));
+	remote_bitbang_send_buf_limit = sizeof(remote_bitbang_send_buf);
+	remote_bitbang_bitbang.buf_size = REMOTE_BITBANG_VECTOR_BUF_SIZE;
+	remote_bitbang_vector_active = true;
+	LOG_INFO("remote_bitbang: using vector extension");
+	return ERROR_OK;
+}
+
 static int remote_bitbang_init(void)
 {
 	bitbang_interface = &remote_bitbang_bitbang;
@@ -386,6 +632,16 @@ static int remote_bitbang_init(void)
 
 	socket_nonblock(remote_bitbang_fd);
 
+	remote_bitbang_vector_active = false;
+	remote_bitbang_send_buf_limit = 512;
+	remote_bitbang_bitbang.buf_size = sizeof(remote_bitbang_recv_buf) - 1;
+	memset(&remote_bitbang_vec, 0, sizeof(remote_bitbang_vec));
+	if (use_vector) {
+		int retval = remote_bitbang_vector_negotiate();
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
 	LOG_INFO("remote_bitbang driver initialized");
 	return ERROR_OK;
 }
@@ -424,6 +680,16 @@ COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_use_remote_sleep_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_vector_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ON_OFF(CMD_ARGV[0], use_vector);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration remote_bitbang_subcommand_handlers[] = {
 	{
 		.name = "port",
@@ -449,6 +715,14 @@ static const struct command_registration remote_bitbang_subcommand_handlers[] =
 			"instruction stream for the remote host.",
 		.usage = "(on|off)",
 	},
+	{
+		.name = "vector",
+		.handler = remote_bitbang_handle_remote_bitbang_vector_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Use packed TMS/TDI vectors and TDO replies if the remote host "
+			"supports them. Enabled by default.",
+		.usage = "(on|off)",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
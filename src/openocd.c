@@ -27,6 +27,8 @@
 #include <target/arm_cti.h>
 #include <target/arm_adi_v5.h>
 #include <target/arm_tpiu_swo.h>
+#include <target/armv7m_trace.h>
+#include <target/image.h>
 #include <rtt/rtt.h>
 
 #include <server/server.h>
@@ -352,8 +354,10 @@ int openocd_main(int argc, char *argv[])
 	ret = openocd_thread(argc, argv, cmd_ctx);
 
 	flash_free_all_banks();
+	image_cache_cleanup();
 	gdb_service_free();
 	arm_tpiu_swo_cleanup_all();
+	armv7m_trace_decoder_cleanup();
 	server_free();
 
 	unregister_all_commands(cmd_ctx, NULL);
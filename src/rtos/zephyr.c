@@ -893,53 +893,36 @@ static int zephyr_fetch_thread(const struct rtos *rtos,
 
 	thread->ptr = ptr;
 
-	retval = target_read_u32(rtos->target, ptr + param->offsets[OFFSET_T_ENTRY],
-				 &thread->entry);
-	if (retval != ERROR_OK)
-		return retval;
-
-	retval = target_read_u32(rtos->target,
-				 ptr + param->offsets[OFFSET_T_NEXT_THREAD],
-				 &thread->next_ptr);
-	if (retval != ERROR_OK)
-		return retval;
+	/* all the fields are read at once, their order does not matter */
+	uint8_t entry[4], next_ptr[4], stack_pointer[4], prio;
+	struct target_memory_scatter fields[7] = {
+		{ ptr + param->offsets[OFFSET_T_ENTRY], 4, 1, entry },
+		{ ptr + param->offsets[OFFSET_T_NEXT_THREAD], 4, 1, next_ptr },
+		{ ptr + param->offsets[OFFSET_T_STATE], 1, 1, &thread->state },
+		{ ptr + param->offsets[OFFSET_T_USER_OPTIONS], 1, 1, &thread->user_options },
+		{ ptr + param->offsets[OFFSET_T_PRIO], 1, 1, &prio },
+	};
+	unsigned int num_fields = 5;
+
+	if (param->offsets[OFFSET_T_STACK_POINTER] != UNIMPLEMENTED)
+		fields[num_fields++] = (struct target_memory_scatter){
+			ptr + param->offsets[OFFSET_T_STACK_POINTER], 4, 1, stack_pointer };
 
-	if (param->offsets[OFFSET_T_STACK_POINTER] != UNIMPLEMENTED) {
-		retval = target_read_u32(rtos->target,
-					ptr + param->offsets[OFFSET_T_STACK_POINTER],
-					&thread->stack_pointer);
-		if (retval != ERROR_OK)
-			return retval;
-	}
-
-	retval = target_read_u8(rtos->target, ptr + param->offsets[OFFSET_T_STATE],
-				&thread->state);
-	if (retval != ERROR_OK)
-		return retval;
+	thread->name[0] = '\0';
+	if (param->offsets[OFFSET_T_NAME] != UNIMPLEMENTED)
+		fields[num_fields++] = (struct target_memory_scatter){
+			ptr + param->offsets[OFFSET_T_NAME], 1, sizeof(thread->name) - 1, (uint8_t *)thread->name };
 
-	retval = target_read_u8(rtos->target,
-				ptr + param->offsets[OFFSET_T_USER_OPTIONS],
-				&thread->user_options);
+	retval = target_read_memory_scatter(rtos->target, fields, num_fields);
 	if (retval != ERROR_OK)
 		return retval;
 
-	uint8_t prio;
-	retval = target_read_u8(rtos->target,
-				ptr + param->offsets[OFFSET_T_PRIO], &prio);
-	if (retval != ERROR_OK)
-		return retval;
+	thread->entry = target_buffer_get_u32(rtos->target, entry);
+	thread->next_ptr = target_buffer_get_u32(rtos->target, next_ptr);
+	if (param->offsets[OFFSET_T_STACK_POINTER] != UNIMPLEMENTED)
+		thread->stack_pointer = target_buffer_get_u32(rtos->target, stack_pointer);
 	thread->prio = prio;
-
-	thread->name[0] = '\0';
-	if (param->offsets[OFFSET_T_NAME] != UNIMPLEMENTED) {
-		retval = target_read_buffer(rtos->target,
-					ptr + param->offsets[OFFSET_T_NAME],
-					sizeof(thread->name) - 1, (uint8_t *)thread->name);
-		if (retval != ERROR_OK)
-			return retval;
-
-		thread->name[sizeof(thread->name) - 1] = '\0';
-	}
+	thread->name[sizeof(thread->name) - 1] = '\0';
 
 	LOG_DEBUG("Fetched thread%" PRIx32 ": {entry@0x%" PRIx32
 		", state=%" PRIu8 ", useropts=%" PRIu8 ", prio=%" PRId8 ", name=%s}",
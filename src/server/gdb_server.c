@@ -38,6 +38,8 @@
 #include "gdb_server.h"
 #include <target/image.h>
 #include <jtag/jtag.h>
+#include <helper/crc32.h>
+#include <helper/time_support.h>
 #include "rtos/rtos.h"
 #include "target/smp.h"
 
@@ -2418,11 +2420,10 @@ static int smp_reg_list_noread(struct target *target,
 	return ERROR_OK;
 }
 
-static int gdb_generate_target_description(struct target *target, char **tdesc_out)
+static int gdb_generate_target_description(struct target *target,
+		struct reg **reg_list, int reg_list_size, char **tdesc_out)
 {
 	int retval = ERROR_OK;
-	struct reg **reg_list = NULL;
-	int reg_list_size;
 	char const *architecture;
 	char const **features = NULL;
 	int feature_list_size = 0;
@@ -2430,22 +2431,6 @@ static int gdb_generate_target_description(struct target *target, char **tdesc_o
 	int pos = 0;
 	int size = 0;
 
-
-	retval = smp_reg_list_noread(target, &reg_list, &reg_list_size,
-			REG_CLASS_ALL);
-
-	if (retval != ERROR_OK) {
-		LOG_ERROR("get register list failed");
-		retval = ERROR_FAIL;
-		goto error;
-	}
-
-	if (reg_list_size <= 0) {
-		LOG_ERROR("get register list failed");
-		retval = ERROR_FAIL;
-		goto error;
-	}
-
 	/* Get a list of available target registers features */
 	retval = get_reg_features_list(target, &features, &feature_list_size, reg_list, reg_list_size);
 	if (retval != ERROR_OK) {
@@ -2548,7 +2533,6 @@ static int gdb_generate_target_description(struct target *target, char **tdesc_o
 
 error:
 	free(features);
-	free(reg_list);
 
 	if (retval == ERROR_OK)
 		*tdesc_out = tdesc;
@@ -2558,6 +2542,84 @@ error:
 	return retval;
 }
 
+static uint32_t gdb_tdesc_hash_str(uint32_t hash, const char *str)
+{
+	if (!str)
+		str = "";
+	return crc32_le(CRC32_POLY_LE, hash, str, strlen(str) + 1);
+}
+
+/* Hash of everything in the register list the target description depends on */
+static uint32_t gdb_target_description_hash(struct target *target,
+		struct reg **reg_list, int reg_list_size)
+{
+	uint32_t hash = gdb_tdesc_hash_str(0xffffffff, target_get_gdb_arch(target));
+
+	for (int i = 0; i < reg_list_size; i++) {
+		struct reg *reg = reg_list[i];
+		const struct reg_data_type *type = reg->reg_data_type;
+		uint32_t attrs[] = {
+			reg->size, reg->number, reg->exist, reg->hidden, reg->caller_save,
+			type ? type->type : REG_TYPE_INT,
+		};
+		uintptr_t type_ptr = (uintptr_t)type;
+
+		hash = crc32_le(CRC32_POLY_LE, hash, attrs, sizeof(attrs));
+		hash = crc32_le(CRC32_POLY_LE, hash, &type_ptr, sizeof(type_ptr));
+		hash = gdb_tdesc_hash_str(hash, reg->name);
+		hash = gdb_tdesc_hash_str(hash, reg->group);
+		hash = gdb_tdesc_hash_str(hash, reg->feature ? reg->feature->name : NULL);
+		hash = gdb_tdesc_hash_str(hash, type ? type->id : NULL);
+	}
+
+	return hash;
+}
+
+/* Returns a copy of the target description. The description is cached per
+ * target and generated again only when the register list has changed. */
+static int gdb_get_target_description(struct target *target, char **tdesc_out)
+{
+	struct reg **reg_list = NULL;
+	int reg_list_size;
+
+	int retval = smp_reg_list_noread(target, &reg_list, &reg_list_size,
+			REG_CLASS_ALL);
+	if (retval != ERROR_OK || reg_list_size <= 0) {
+		LOG_ERROR("get register list failed");
+		free(reg_list);
+		return ERROR_FAIL;
+	}
+
+	uint32_t hash = gdb_target_description_hash(target, reg_list, reg_list_size);
+	if (!target->gdb_tdesc_cache || target->gdb_tdesc_cache_hash != hash) {
+		char *tdesc = NULL;
+		int64_t start = timeval_ms();
+
+		retval = gdb_generate_target_description(target, reg_list, reg_list_size, &tdesc);
+		if (retval != ERROR_OK) {
+			free(reg_list);
+			return retval;
+		}
+		LOG_TARGET_DEBUG(target, "generated target description (%zu bytes) in %" PRId64 " ms",
+				strlen(tdesc), timeval_ms() - start);
+
+		free(target->gdb_tdesc_cache);
+		target->gdb_tdesc_cache = tdesc;
+		target->gdb_tdesc_cache_hash = hash;
+	} else {
+		LOG_TARGET_DEBUG(target, "using cached target description");
+	}
+	free(reg_list);
+
+	*tdesc_out = strdup(target->gdb_tdesc_cache);
+	if (!*tdesc_out) {
+		LOG_ERROR("Unable to allocate memory");
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
 static int gdb_get_target_description_chunk(struct target *target, struct target_desc_format *target_desc,
 		char **chunk, int32_t offset, uint32_t length)
 {
@@ -2570,7 +2632,7 @@ static int gdb_get_target_description_chunk(struct target *target, struct target
 	uint32_t tdesc_length = target_desc->tdesc_length;
 
 	if (!tdesc) {
-		int retval = gdb_generate_target_description(target, &tdesc);
+		int retval = gdb_get_target_description(target, &tdesc);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Unable to Generate Target Description");
 			return ERROR_FAIL;
@@ -4045,7 +4107,7 @@ COMMAND_HANDLER(handle_gdb_save_tdesc_command)
 	uint32_t tdesc_length;
 	struct target *target = get_current_target(CMD_CTX);
 
-	int retval = gdb_generate_target_description(target, &tdesc);
+	int retval = gdb_get_target_description(target, &tdesc);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("Unable to Generate Target Description");
 		return ERROR_FAIL;
@@ -35,8 +35,29 @@
 #include <netinet/tcp.h>
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 static struct service *services;
 
+/* set when a service or connection fd is added or removed */
+static bool server_fds_changed = true;
+
+/* used in select() */
+static fd_set server_read_fds;
+
+#ifdef HAVE_SYS_EPOLL_H
+#define SERVER_EPOLL_MAX_EVENTS 64
+
+static int server_epoll_fd = -1;
+/* epoll can not watch regular files (e.g. stdin redirected from a file),
+ * server_loop() falls back to select() for good in that case */
+static bool server_use_epoll = true;
+static struct epoll_event server_epoll_events[SERVER_EPOLL_MAX_EVENTS];
+static int server_epoll_nevents;
+#endif
+
 enum shutdown_reason {
 	CONTINUE_MAIN_LOOP,			/* stay in main event loop */
 	SHUTDOWN_REQUESTED,			/* set by shutdown command; exit the event loop and quit the debugger */
@@ -71,6 +92,8 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 	c->priv = NULL;
 	c->next = NULL;
 
+	server_fds_changed = true;
+
 	if (service->type == CONNECTION_TCP) {
 		address_size = sizeof(c->sin);
 
@@ -158,6 +181,8 @@ static int remove_connection(struct service *service, struct connection *connect
 	struct connection **p = &service->connections;
 	struct connection *c;
 
+	server_fds_changed = true;
+
 	/* find connection */
 	while ((c = *p)) {
 		if (c->fd == connection->fd) {
@@ -334,6 +359,8 @@ int add_service(const struct service_driver *driver, const char *port,
 		;
 	*p = c;
 
+	server_fds_changed = true;
+
 	return ERROR_OK;
 }
 
@@ -374,6 +401,7 @@ int remove_service(const char *name, const char *port)
 			free(tmp->priv);
 			free_service(tmp);
 
+			server_fds_changed = true;
 			return ERROR_OK;
 		}
 	}
@@ -407,6 +435,14 @@ static int remove_services(void)
 	}
 
 	services = NULL;
+	server_fds_changed = true;
+
+#ifdef HAVE_SYS_EPOLL_H
+	if (server_epoll_fd != -1) {
+		close(server_epoll_fd);
+		server_epoll_fd = -1;
+	}
+#endif
 
 	return ERROR_OK;
 }
@@ -419,16 +455,122 @@ void server_keep_clients_alive(void)
 				s->keep_client_alive(c);
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+static bool server_epoll_add(int fd)
+{
+	struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+
+	if (fd < 0 || epoll_ctl(server_epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0 || errno == EEXIST)
+		return true;
+
+	LOG_DEBUG("epoll can not watch fd %d (%s), using select()", fd, strerror(errno));
+	return false;
+}
+
+/* (re)creates the epoll set from the current services and connections */
+static void server_epoll_rebuild(void)
+{
+	if (server_epoll_fd != -1)
+		close(server_epoll_fd);
+
+	server_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (server_epoll_fd == -1) {
+		LOG_DEBUG("epoll_create1 failed (%s), using select()", strerror(errno));
+		server_use_epoll = false;
+		return;
+	}
+
+	for (struct service *service = services; service; service = service->next) {
+		bool ok = server_epoll_add(service->fd);
+
+		for (struct connection *c = service->connections; ok && c; c = c->next)
+			ok = server_epoll_add(c->fd);
+
+		if (!ok) {
+			close(server_epoll_fd);
+			server_epoll_fd = -1;
+			server_use_epoll = false;
+			return;
+		}
+	}
+
+	server_fds_changed = false;
+}
+#endif
+
+/* Waits for activity on service and connection fds. Returns the number of
+ * ready fds, 0 on timeout or -1 with errno set, like select() */
+static int server_wait_fds(int timeout_ms)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	server_epoll_nevents = 0;
+	if (server_use_epoll && server_fds_changed)
+		server_epoll_rebuild();
+
+	if (server_use_epoll) {
+		int n = epoll_wait(server_epoll_fd, server_epoll_events, SERVER_EPOLL_MAX_EVENTS, timeout_ms);
+		if (n > 0)
+			server_epoll_nevents = n;
+		return n;
+	}
+#endif
+
+	int fd_max = 0;
+	FD_ZERO(&server_read_fds);
+
+	/* add service and connection fds to read_fds */
+	for (struct service *service = services; service; service = service->next) {
+		if (service->fd != -1) {
+			/* listen for new connections */
+			FD_SET(service->fd, &server_read_fds);
+
+			if (service->fd > fd_max)
+				fd_max = service->fd;
+		}
+
+		for (struct connection *c = service->connections; c; c = c->next) {
+			if (c->fd < 0)
+				continue;
+			/* check for activity on the connection */
+			FD_SET(c->fd, &server_read_fds);
+			if (c->fd > fd_max)
+				fd_max = c->fd;
+		}
+	}
+
+	struct timeval tv;
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+	return socket_select(fd_max + 1, &server_read_fds, NULL, NULL, &tv);
+}
+
+static bool server_fd_is_ready(int fd)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	if (server_use_epoll) {
+		for (int i = 0; i < server_epoll_nevents; i++)
+			if (server_epoll_events[i].data.fd == fd)
+				return true;
+		return false;
+	}
+#endif
+	return FD_ISSET(fd, &server_read_fds);
+}
+
+static void server_clear_ready_fds(void)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	server_epoll_nevents = 0;
+#endif
+	FD_ZERO(&server_read_fds);
+}
+
 int server_loop(struct command_context *command_context)
 {
 	struct service *service;
 
 	bool poll_ok = true;
 
-	/* used in select() */
-	fd_set read_fds;
-	int fd_max;
-
 	/* used in accept() */
 	int retval;
 
@@ -441,48 +583,19 @@ int server_loop(struct command_context *command_context)
 
 	while (shutdown_openocd == CONTINUE_MAIN_LOOP) {
 		/* monitor sockets for activity */
-		fd_max = 0;
-		FD_ZERO(&read_fds);
-
-		/* add service and connection fds to read_fds */
-		for (service = services; service; service = service->next) {
-			if (service->fd != -1) {
-				/* listen for new connections */
-				FD_SET(service->fd, &read_fds);
-
-				if (service->fd > fd_max)
-					fd_max = service->fd;
-			}
-
-			if (service->connections) {
-				struct connection *c;
-
-				for (c = service->connections; c; c = c->next) {
-					/* check for activity on the connection */
-					FD_SET(c->fd, &read_fds);
-					if (c->fd > fd_max)
-						fd_max = c->fd;
-				}
-			}
-		}
-
-		struct timeval tv;
-		tv.tv_sec = 0;
 		if (poll_ok) {
 			/* we're just polling this iteration, this is faster on embedded
 			 * hosts */
-			tv.tv_usec = 0;
-			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+			retval = server_wait_fds(0);
 		} else {
-			/* Timeout socket_select() when a target timer expires or every polling_period */
+			/* Timeout the wait when a target timer expires or every polling_period */
 			int timeout_ms = next_event - timeval_ms();
 			if (timeout_ms < 0)
 				timeout_ms = 0;
 			else if (timeout_ms > polling_period)
 				timeout_ms = polling_period;
-			tv.tv_usec = timeout_ms * 1000;
 			/* Only while we're sleeping we'll let others run */
-			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+			retval = server_wait_fds(timeout_ms);
 		}
 
 		if (retval == -1) {
@@ -491,7 +604,7 @@ int server_loop(struct command_context *command_context)
 			errno = WSAGetLastError();
 
 			if (errno == WSAEINTR)
-				FD_ZERO(&read_fds);
+				server_clear_ready_fds();
 			else {
 				LOG_ERROR("error during select: %s", strerror(errno));
 				return ERROR_FAIL;
@@ -499,7 +612,7 @@ int server_loop(struct command_context *command_context)
 #else
 
 			if (errno == EINTR)
-				FD_ZERO(&read_fds);
+				server_clear_ready_fds();
 			else {
 				LOG_ERROR("error during select: %s", strerror(errno));
 				return ERROR_FAIL;
@@ -510,14 +623,14 @@ int server_loop(struct command_context *command_context)
 		if (retval == 0) {
 			/* Execute callbacks of expired timers when
 			 * - there was nothing to do if poll_ok was true
-			 * - socket_select() timed out if poll_ok was false, now one or more
+			 * - the wait timed out if poll_ok was false, now one or more
 			 *   timers expired or the polling period elapsed
 			 */
 			target_call_timer_callbacks();
 			next_event = target_timer_next_event();
 			process_jim_events(command_context);
 
-			FD_ZERO(&read_fds);	/* eCos leaves read_fds unchanged in this case!  */
+			server_clear_ready_fds();	/* eCos leaves read_fds unchanged in this case!  */
 
 			/* We timed out/there was nothing to do, timeout rather than poll next time
 			 **/
@@ -537,7 +650,7 @@ int server_loop(struct command_context *command_context)
 		for (service = services; service; service = service->next) {
 			/* handle new connections on listeners */
 			if ((service->fd != -1)
-				&& (FD_ISSET(service->fd, &read_fds))) {
+				&& server_fd_is_ready(service->fd)) {
 				if (service->max_connections != 0)
 					add_connection(service, command_context);
 				else {
@@ -561,7 +674,7 @@ int server_loop(struct command_context *command_context)
 				struct connection *c;
 
 				for (c = service->connections; c; ) {
-					if ((c->fd >= 0 && FD_ISSET(c->fd, &read_fds)) || c->input_pending) {
+					if ((c->fd >= 0 && server_fd_is_ready(c->fd)) || c->input_pending) {
 						retval = service->input(c);
 						if (retval != ERROR_OK) {
 							struct connection *next = c->next;
@@ -24,6 +24,9 @@
 #include <helper/time_support.h>
 #include <helper/nvp.h>
 #include <stdbool.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 /* SVF command */
 enum svf_command {
@@ -201,23 +204,31 @@ struct svf_check_tdo_para {
 	int bit_len;		/* bit length to check */
 };
 
+/* TDO checks are done in bulk once the queue has been executed, the array
+ * grows up to SVF_CHECK_TDO_PARA_MAX entries before the queue is flushed */
 #define SVF_CHECK_TDO_PARA_SIZE 1024
+#define SVF_CHECK_TDO_PARA_MAX	(64 * 1024)
 static struct svf_check_tdo_para *svf_check_tdo_para;
 static int svf_check_tdo_para_index;
+static int svf_check_tdo_para_size;
 
-static int svf_read_command_from_file(FILE *fd);
+static int svf_read_command_from_file(void);
 static int svf_check_tdo(void);
 static int svf_add_check_para(uint8_t enabled, int buffer_offset, int bit_len);
 static int svf_run_command(struct command_context *cmd_ctx, char *cmd_str);
 static int svf_execute_tap(void);
 
-static FILE *svf_fd;
+/* the whole file is mapped, or read into memory where mapping is not available */
+static char *svf_file_data;
+static size_t svf_file_size;
+static size_t svf_file_pos;
+static bool svf_file_mapped;
 static char *svf_read_line;
 static size_t svf_read_line_size;
 static char *svf_command_buffer;
 static size_t svf_command_buffer_size;
 static int svf_line_number;
-static int svf_getline(char **lineptr, size_t *n, FILE *stream);
+static int svf_getline(char **lineptr, size_t *n);
 
 #define SVF_MAX_BUFFER_SIZE_TO_COMMIT   (1024 * 1024)
 static uint8_t *svf_tdi_buffer, *svf_tdo_buffer, *svf_mask_buffer;
@@ -237,6 +248,7 @@ static int svf_progress_enabled;
 static long svf_total_lines;
 static int svf_percentage;
 static int svf_last_printed_percentage = -1;
+static uint64_t svf_scan_count;
 
 /*
  * macro is used to print the svf hex buffer at desired debug level
@@ -269,6 +281,61 @@ static void svf_hexbuf_print(int dbg_lvl, const char *file, unsigned line,
 	free(prbuf);
 }
 
+static void svf_file_close(void)
+{
+#ifndef _WIN32
+	if (svf_file_mapped)
+		munmap(svf_file_data, svf_file_size);
+	else
+#endif
+		free(svf_file_data);
+	svf_file_data = NULL;
+	svf_file_size = 0;
+	svf_file_pos = 0;
+	svf_file_mapped = false;
+}
+
+/* Makes the whole file available in memory, so lines are not read char by char */
+static int svf_file_open(const char *filename)
+{
+	FILE *fd = fopen(filename, "rb");
+	if (!fd)
+		return ERROR_FAIL;
+
+	int retval = ERROR_OK;
+	long size = -1;
+	if (fseek(fd, 0, SEEK_END) == 0)
+		size = ftell(fd);
+	if (size < 0 || fseek(fd, 0, SEEK_SET) != 0) {
+		retval = ERROR_FAIL;
+		goto done;
+	}
+	svf_file_size = size;
+	if (svf_file_size == 0)
+		goto done;
+
+#ifndef _WIN32
+	void *map = mmap(NULL, svf_file_size, PROT_READ, MAP_PRIVATE, fileno(fd), 0);
+	if (map != MAP_FAILED) {
+		svf_file_data = map;
+		svf_file_mapped = true;
+		goto done;
+	}
+#endif
+	svf_file_data = malloc(svf_file_size);
+	if (!svf_file_data || fread(svf_file_data, 1, svf_file_size, fd) != svf_file_size) {
+		free(svf_file_data);
+		svf_file_data = NULL;
+		svf_file_size = 0;
+		retval = ERROR_FAIL;
+	}
+
+done:
+	fclose(fd);
+	svf_file_pos = 0;
+	return retval;
+}
+
 static int svf_realloc_buffers(size_t len)
 {
 	void *ptr;
@@ -386,6 +453,7 @@ COMMAND_HANDLER(handle_svf_command)
 	int ret = ERROR_OK;
 	int64_t time_measure_ms;
 	int time_measure_s, time_measure_m;
+	bool file_opened = false;
 
 	/*
 	 * use NULL to indicate a "plain" svf file which accounts for
@@ -412,9 +480,7 @@ COMMAND_HANDLER(handle_svf_command)
 			svf_addcycles = atoi(CMD_ARGV[i + 1]);
 			if (svf_addcycles > SVF_MAX_ADDCYCLES) {
 				command_print(CMD, "addcycles: %s out of range", CMD_ARGV[i + 1]);
-				if (svf_fd)
-					fclose(svf_fd);
-				svf_fd = NULL;
+				svf_file_close();
 				return ERROR_COMMAND_ARGUMENT_INVALID;
 			}
 			i++;
@@ -424,9 +490,7 @@ COMMAND_HANDLER(handle_svf_command)
 			tap = jtag_tap_by_string(CMD_ARGV[i+1]);
 			if (!tap) {
 				command_print(CMD, "Tap: %s unknown", CMD_ARGV[i+1]);
-				if (svf_fd)
-					fclose(svf_fd);
-				svf_fd = NULL;
+				svf_file_close();
 				return ERROR_COMMAND_ARGUMENT_INVALID;
 			}
 			i++;
@@ -465,19 +529,20 @@ COMMAND_HANDLER(handle_svf_command)
 			break;
 
 		default:
-			svf_fd = fopen(CMD_ARGV[i], "r");
-			if (!svf_fd) {
+			svf_file_close();
+			if (svf_file_open(CMD_ARGV[i]) != ERROR_OK) {
 				int err = errno;
 				command_print(CMD, "open(\"%s\"): %s", CMD_ARGV[i], strerror(err));
 				/* no need to free anything now */
 				return ERROR_COMMAND_SYNTAX_ERROR;
 			}
+			file_opened = true;
 			LOG_USER("svf processing file: \"%s\"", CMD_ARGV[i]);
 			break;
 		}
 	}
 
-	if (!svf_fd)
+	if (!file_opened)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
 	/* get time */
@@ -486,9 +551,11 @@ COMMAND_HANDLER(handle_svf_command)
 	/* init */
 	svf_line_number = 0;
 	svf_command_buffer_size = 0;
+	svf_scan_count = 0;
 
 	svf_check_tdo_para_index = 0;
-	svf_check_tdo_para = malloc(sizeof(struct svf_check_tdo_para) * SVF_CHECK_TDO_PARA_SIZE);
+	svf_check_tdo_para_size = SVF_CHECK_TDO_PARA_SIZE;
+	svf_check_tdo_para = malloc(sizeof(struct svf_check_tdo_para) * svf_check_tdo_para_size);
 	if (!svf_check_tdo_para) {
 		LOG_ERROR("not enough memory");
 		ret = ERROR_FAIL;
@@ -562,19 +629,23 @@ COMMAND_HANDLER(handle_svf_command)
 
 	if (svf_progress_enabled) {
 		/* Count total lines in file. */
-		while (!feof(svf_fd)) {
-			svf_getline(&svf_command_buffer, &svf_command_buffer_size, svf_fd);
-			svf_total_lines++;
+		svf_total_lines = 1;
+		for (const char *p = svf_file_data; p; svf_total_lines++) {
+			p = memchr(p, '\n', svf_file_data + svf_file_size - p);
+			if (p)
+				p++;
 		}
-		rewind(svf_fd);
+		svf_last_printed_percentage = -1;
 	}
-	while (svf_read_command_from_file(svf_fd) == ERROR_OK) {
+	while (svf_read_command_from_file() == ERROR_OK) {
 		/* Log Output */
 		if (svf_quiet) {
 			if (svf_progress_enabled) {
 				svf_percentage = ((svf_line_number * 20) / svf_total_lines) * 5;
 				if (svf_last_printed_percentage != svf_percentage) {
-					LOG_USER_N("\r%d%%    ", svf_percentage);
+					int64_t elapsed_ms = timeval_ms() - time_measure_ms;
+					LOG_USER_N("\r%d%%  %" PRIu64 " scans/s    ", svf_percentage,
+						elapsed_ms > 0 ? svf_scan_count * 1000 / elapsed_ms : 0);
 					svf_last_printed_percentage = svf_percentage;
 				}
 			}
@@ -601,6 +672,9 @@ COMMAND_HANDLER(handle_svf_command)
 
 	/* print time */
 	time_measure_ms = timeval_ms() - time_measure_ms;
+	if (time_measure_ms > 0)
+		command_print(CMD, "\r\n%" PRIu64 " scans, %" PRIu64 " scans/s", svf_scan_count,
+			svf_scan_count * 1000 / time_measure_ms);
 	time_measure_s = time_measure_ms / 1000;
 	time_measure_ms %= 1000;
 	time_measure_m = time_measure_s / 60;
@@ -614,8 +688,7 @@ COMMAND_HANDLER(handle_svf_command)
 
 free_all:
 
-	fclose(svf_fd);
-	svf_fd = NULL;
+	svf_file_close();
 
 	/* free buffers */
 	free(svf_command_buffer);
@@ -625,6 +698,7 @@ free_all:
 	free(svf_check_tdo_para);
 	svf_check_tdo_para = NULL;
 	svf_check_tdo_para_index = 0;
+	svf_check_tdo_para_size = 0;
 
 	free(svf_tdi_buffer);
 	svf_tdi_buffer = NULL;
@@ -658,45 +732,43 @@ free_all:
 	return ret;
 }
 
-static int svf_getline(char **lineptr, size_t *n, FILE *stream)
+/* Copies the next line, including '\n', from the file data. Returns the line length, -1 at the end of file. */
+static int svf_getline(char **lineptr, size_t *n)
 {
-#define MIN_CHUNK 16	/* Buffer is increased by this size each time as required */
-	size_t i = 0;
-
-	if (!*lineptr) {
-		*n = MIN_CHUNK;
-		*lineptr = malloc(*n);
-		if (!*lineptr)
-			return -1;
+	if (svf_file_pos >= svf_file_size) {
+		if (*lineptr)
+			(*lineptr)[0] = 0;
+		return -1;
 	}
 
-	(*lineptr)[0] = fgetc(stream);
-	while ((*lineptr)[i] != '\n') {
-		(*lineptr)[++i] = fgetc(stream);
-		if (feof(stream)) {
-			(*lineptr)[0] = 0;
+	const char *start = svf_file_data + svf_file_pos;
+	size_t left = svf_file_size - svf_file_pos;
+	const char *end = memchr(start, '\n', left);
+	size_t len = end ? (size_t)(end - start) + 1 : left;
+
+	if (len + 1 > *n || !*lineptr) {
+		char *line = realloc(*lineptr, len + 1);
+		if (!line)
 			return -1;
-		}
-		if ((i + 2) > *n) {
-			*n += MIN_CHUNK;
-			*lineptr = realloc(*lineptr, *n);
-		}
+		*lineptr = line;
+		*n = len + 1;
 	}
+	memcpy(*lineptr, start, len);
+	(*lineptr)[len] = 0;
+	svf_file_pos += len;
 
-	(*lineptr)[++i] = 0;
-
-	return sizeof(*lineptr);
+	return len;
 }
 
 #define SVFP_CMD_INC_CNT 1024
-static int svf_read_command_from_file(FILE *fd)
+static int svf_read_command_from_file(void)
 {
 	unsigned char ch;
 	int i = 0;
 	size_t cmd_pos = 0;
 	int cmd_ok = 0, slash = 0;
 
-	if (svf_getline(&svf_read_line, &svf_read_line_size, svf_fd) <= 0)
+	if (svf_getline(&svf_read_line, &svf_read_line_size) <= 0)
 		return ERROR_FAIL;
 	svf_line_number++;
 	ch = svf_read_line[0];
@@ -704,7 +776,7 @@ static int svf_read_command_from_file(FILE *fd)
 		switch (ch) {
 			case '!':
 				slash = 0;
-				if (svf_getline(&svf_read_line, &svf_read_line_size, svf_fd) <= 0)
+				if (svf_getline(&svf_read_line, &svf_read_line_size) <= 0)
 					return ERROR_FAIL;
 				svf_line_number++;
 				i = -1;
@@ -712,8 +784,7 @@ static int svf_read_command_from_file(FILE *fd)
 			case '/':
 				if (++slash == 2) {
 					slash = 0;
-					if (svf_getline(&svf_read_line, &svf_read_line_size,
-						svf_fd) <= 0)
+					if (svf_getline(&svf_read_line, &svf_read_line_size) <= 0)
 						return ERROR_FAIL;
 					svf_line_number++;
 					i = -1;
@@ -725,7 +796,7 @@ static int svf_read_command_from_file(FILE *fd)
 				break;
 			case '\n':
 				svf_line_number++;
-				if (svf_getline(&svf_read_line, &svf_read_line_size, svf_fd) <= 0)
+				if (svf_getline(&svf_read_line, &svf_read_line_size) <= 0)
 					return ERROR_FAIL;
 				i = -1;
 				/* fallthrough */
@@ -953,9 +1024,19 @@ static int svf_check_tdo(void)
 
 static int svf_add_check_para(uint8_t enabled, int buffer_offset, int bit_len)
 {
-	if (svf_check_tdo_para_index >= SVF_CHECK_TDO_PARA_SIZE) {
-		LOG_ERROR("toooooo many operation undone");
-		return ERROR_FAIL;
+	if (svf_check_tdo_para_index >= svf_check_tdo_para_size) {
+		if (svf_check_tdo_para_size >= SVF_CHECK_TDO_PARA_MAX) {
+			LOG_ERROR("toooooo many operation undone");
+			return ERROR_FAIL;
+		}
+		struct svf_check_tdo_para *para = realloc(svf_check_tdo_para,
+			sizeof(*para) * 2 * svf_check_tdo_para_size);
+		if (!para) {
+			LOG_ERROR("not enough memory");
+			return ERROR_FAIL;
+		}
+		svf_check_tdo_para = para;
+		svf_check_tdo_para_size *= 2;
 	}
 
 	svf_check_tdo_para[svf_check_tdo_para_index].line_num = svf_line_number;
@@ -1262,9 +1343,11 @@ xxr_common:
 							svf_para.tdr_para.len);
 					i += svf_para.tdr_para.len;
 
-					svf_add_check_para(1, svf_buffer_index, i);
-				} else
-					svf_add_check_para(0, svf_buffer_index, i);
+					if (svf_add_check_para(1, svf_buffer_index, i) != ERROR_OK)
+						return ERROR_FAIL;
+				} else if (svf_add_check_para(0, svf_buffer_index, i) != ERROR_OK) {
+					return ERROR_FAIL;
+				}
 				field.num_bits = i;
 				field.out_value = &svf_tdi_buffer[svf_buffer_index];
 				field.in_value = (xxr_para_tmp->data_mask & XXR_TDO) ? &svf_tdi_buffer[svf_buffer_index] : NULL;
@@ -1280,6 +1363,7 @@ xxr_common:
 					jtag_add_clocks(svf_addcycles);
 
 				svf_buffer_index += (i + 7) >> 3;
+				svf_scan_count++;
 			} else if (command == SIR) {
 				/* check buffer size first, reallocate if necessary */
 				i = svf_para.hir_para.len + svf_para.sir_para.len +
@@ -1355,9 +1439,11 @@ xxr_common:
 							svf_para.tir_para.len);
 					i += svf_para.tir_para.len;
 
-					svf_add_check_para(1, svf_buffer_index, i);
-				} else
-					svf_add_check_para(0, svf_buffer_index, i);
+					if (svf_add_check_para(1, svf_buffer_index, i) != ERROR_OK)
+						return ERROR_FAIL;
+				} else if (svf_add_check_para(0, svf_buffer_index, i) != ERROR_OK) {
+					return ERROR_FAIL;
+				}
 				field.num_bits = i;
 				field.out_value = &svf_tdi_buffer[svf_buffer_index];
 				field.in_value = (xxr_para_tmp->data_mask & XXR_TDO) ? &svf_tdi_buffer[svf_buffer_index] : NULL;
@@ -1370,6 +1456,7 @@ xxr_common:
 				}
 
 				svf_buffer_index += (i + 7) >> 3;
+				svf_scan_count++;
 			}
 			break;
 		case PIO:
@@ -1618,9 +1705,9 @@ xxr_common:
 		}
 	} else {
 		/* for fast executing, execute tap if necessary */
-		/* half of the buffer is for the next command */
+		/* half of the buffer is for the next command, TDO of all queued scans is checked afterwards */
 		if (((svf_buffer_index >= SVF_MAX_BUFFER_SIZE_TO_COMMIT) ||
-				(svf_check_tdo_para_index >= SVF_CHECK_TDO_PARA_SIZE / 2)) &&
+				(svf_check_tdo_para_index >= SVF_CHECK_TDO_PARA_MAX)) &&
 				(((command != STATE) && (command != RUNTEST)) ||
 						((command == STATE) && (num_of_argu == 2))))
 			return svf_execute_tap();
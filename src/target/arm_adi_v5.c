@@ -67,6 +67,7 @@
 #include "arm_adi_v5.h"
 #include "arm_coresight.h"
 #include "jtag/swd.h"
+#include "target.h"
 #include "transport/transport.h"
 #include <helper/align.h>
 #include <helper/jep106.h>
@@ -745,6 +746,358 @@ int mem_ap_write_buf_noincr(struct adiv5_ap *ap,
 
 /*--------------------------------------------------------------------------*/
 
+/*
+ * Scatter list transfers
+ *
+ * The requests are sorted by access size, so that CSW changes once per size,
+ * then by address, so that TAR only moves forward and auto-increment carries
+ * it from one request to the next. Requests that touch or overlap are merged
+ * into runs. A word run lying within a 16 byte block is accessed through
+ * the banked data registers when the cached TAR already points to the block
+ * or the next run needs the same block, one TAR write then serves all of
+ * them. Everything is queued and run once.
+ */
+
+struct mem_ap_scatter_key {
+	target_addr_t address;
+	target_addr_t end;
+	uint32_t size;
+	/* index in the caller's list */
+	unsigned int idx;
+};
+
+/* Accesses of one size at consecutive addresses, covering one or more requests */
+struct mem_ap_run {
+	target_addr_t address;
+	uint32_t size;
+	uint32_t nbytes;
+	/* offset of the run data in the bounce buffer */
+	size_t offset;
+	/* first DRW or BD transfer of the run */
+	size_t transfer;
+	/* accessed through BD0-BD3 instead of DRW */
+	bool banked;
+};
+
+struct mem_ap_plan {
+	struct mem_ap_run *runs;
+	unsigned int run_count;
+	/* run holding each request of the list, UINT_MAX for empty requests */
+	unsigned int *request_run;
+	uint8_t *data;
+	/* one word per DRW or BD transfer */
+	uint32_t *transfers;
+};
+
+static int mem_ap_scatter_cmp_index(const void *a, const void *b)
+{
+	const struct mem_ap_scatter_key *ka = a, *kb = b;
+
+	return (ka->idx > kb->idx) - (ka->idx < kb->idx);
+}
+
+static int mem_ap_scatter_cmp_address(const void *a, const void *b)
+{
+	const struct mem_ap_scatter_key *ka = a, *kb = b;
+
+	if (ka->address != kb->address)
+		return ka->address < kb->address ? -1 : 1;
+	return mem_ap_scatter_cmp_index(a, b);
+}
+
+static int mem_ap_scatter_cmp(const void *a, const void *b)
+{
+	const struct mem_ap_scatter_key *ka = a, *kb = b;
+
+	if (ka->size != kb->size)
+		return ka->size < kb->size ? -1 : 1;
+	return mem_ap_scatter_cmp_address(a, b);
+}
+
+static void mem_ap_plan_free(struct mem_ap_plan *plan)
+{
+	free(plan->runs);
+	free(plan->request_run);
+	free(plan->data);
+	free(plan->transfers);
+}
+
+static int mem_ap_plan_scatter(const struct target_memory_scatter *list, unsigned int count,
+	bool write, struct mem_ap_plan *plan)
+{
+	struct mem_ap_scatter_key *keys = malloc(count * sizeof(*keys));
+	plan->runs = malloc(count * sizeof(*plan->runs));
+	plan->request_run = malloc(count * sizeof(*plan->request_run));
+	if (!keys || !plan->runs || !plan->request_run) {
+		LOG_ERROR("Failed to allocate scatter list plan");
+		free(keys);
+		return ERROR_FAIL;
+	}
+
+	unsigned int n = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		plan->request_run[i] = UINT_MAX;
+		if (!list[i].count)
+			continue;
+		keys[n].address = list[i].address;
+		keys[n].end = list[i].address + list[i].size * list[i].count;
+		keys[n].size = list[i].size;
+		keys[n].idx = i;
+		n++;
+	}
+
+	bool sort = true;
+	if (write) {
+		/* the order of writes to a same location must be kept */
+		qsort(keys, n, sizeof(*keys), mem_ap_scatter_cmp_address);
+		target_addr_t end = 0;
+		for (unsigned int i = 0; i < n && sort; i++) {
+			if (i && keys[i].address < end)
+				sort = false;
+			end = MAX(end, keys[i].end);
+		}
+		if (!sort)
+			qsort(keys, n, sizeof(*keys), mem_ap_scatter_cmp_index);
+	}
+	if (sort)
+		qsort(keys, n, sizeof(*keys), mem_ap_scatter_cmp);
+
+	size_t data_size = 0;
+	size_t transfers = 0;
+	plan->run_count = 0;
+	for (unsigned int i = 0; i < n; i++) {
+		const struct mem_ap_scatter_key *key = &keys[i];
+		struct mem_ap_run *run = plan->run_count ? &plan->runs[plan->run_count - 1] : NULL;
+		target_addr_t run_end = run ? run->address + run->nbytes : 0;
+
+		/* only reads, which are sorted, can join a run they overlap */
+		if (run && run->size == key->size
+				&& (key->address == run_end || (!write && key->address < run_end))) {
+			if (key->end > run_end)
+				run->nbytes = key->end - run->address;
+		} else {
+			run = &plan->runs[plan->run_count++];
+			run->address = key->address;
+			run->size = key->size;
+			run->nbytes = key->end - key->address;
+			run->banked = false;
+		}
+		plan->request_run[key->idx] = plan->run_count - 1;
+	}
+
+	for (unsigned int r = 0; r < plan->run_count; r++) {
+		struct mem_ap_run *run = &plan->runs[r];
+		run->offset = data_size;
+		run->transfer = transfers;
+		data_size += run->nbytes;
+		/* packing may need less */
+		transfers += run->nbytes / run->size;
+	}
+	free(keys);
+	if (!plan->run_count)
+		return ERROR_OK;
+
+	plan->data = malloc(data_size);
+	plan->transfers = malloc(transfers * sizeof(*plan->transfers));
+	if (!plan->data || !plan->transfers) {
+		LOG_ERROR("Failed to allocate scatter list buffers");
+		return ERROR_FAIL;
+	}
+	return ERROR_OK;
+}
+
+/* Whether a run is better accessed through the banked data registers */
+static bool mem_ap_run_banked(struct adiv5_ap *ap, const struct mem_ap_plan *plan, unsigned int r)
+{
+	const struct mem_ap_run *run = &plan->runs[r];
+	target_addr_t block = run->address & ~(target_addr_t)0xf;
+
+	if (run->size != 4 || ((run->address + run->nbytes - 1) & ~(target_addr_t)0xf) != block)
+		return false;
+	if (ap->tar_valid && (ap->tar_value & ~(target_addr_t)0xf) == block)
+		return true;
+	return r + 1 < plan->run_count && (plan->runs[r + 1].address & ~(target_addr_t)0xf) == block;
+}
+
+static int mem_ap_queue_scatter(struct adiv5_ap *ap, struct mem_ap_plan *plan, bool write)
+{
+	struct adiv5_dap *dap = ap->dap;
+	int retval;
+
+	for (unsigned int r = 0; r < plan->run_count; r++) {
+		struct mem_ap_run *run = &plan->runs[r];
+		uint8_t *data = plan->data + run->offset;
+		uint32_t *transfer = plan->transfers + run->transfer;
+		unsigned int this_size;
+
+		run->banked = mem_ap_run_banked(ap, plan, r);
+		if (run->banked) {
+			/* BD0-BD3 map to TAR[31:4], any TAR within the block will do */
+			target_addr_t block = run->address & ~(target_addr_t)0xf;
+			target_addr_t tar = ap->tar_valid && (ap->tar_value & ~(target_addr_t)0xf) == block ?
+				ap->tar_value : block;
+			retval = mem_ap_setup_transfer_verify_size_packing(ap, 4, tar, true, false, &this_size);
+			if (retval != ERROR_OK)
+				return retval;
+
+			for (uint32_t off = 0; off < run->nbytes; off += 4) {
+				unsigned int reg = MEM_AP_REG_BD0(dap) + ((run->address + off) & 0xc);
+				if (write)
+					retval = dap_queue_ap_write(ap, reg, le_to_h_u32(data + off));
+				else
+					retval = dap_queue_ap_read(ap, reg, transfer++);
+				if (retval != ERROR_OK)
+					return retval;
+			}
+			continue;
+		}
+
+		target_addr_t address = run->address;
+		uint32_t nbytes = run->nbytes;
+		while (nbytes > 0) {
+			retval = mem_ap_setup_transfer_verify_size_packing_fallback(ap,
+						run->size, address, true, nbytes >= 4, &this_size);
+			if (retval != ERROR_OK)
+				return retval;
+
+			if (write) {
+				uint32_t outvalue = 0;
+				for (unsigned int i = 0; i < this_size; i++)
+					outvalue |= (uint32_t)*data++ << 8 * ((address + i) & 3);
+				retval = dap_queue_ap_write(ap, MEM_AP_REG_DRW(dap), outvalue);
+			} else {
+				retval = dap_queue_ap_read(ap, MEM_AP_REG_DRW(dap), transfer++);
+			}
+			if (retval != ERROR_OK)
+				return retval;
+
+			mem_ap_update_tar_cache(ap);
+			nbytes -= this_size;
+			address += this_size;
+		}
+	}
+	return ERROR_OK;
+}
+
+/* Copies the data of the DRW or BD reads of a run to the bounce buffer */
+static void mem_ap_replay_run(struct adiv5_ap *ap, struct mem_ap_plan *plan, const struct mem_ap_run *run)
+{
+	uint8_t *data = plan->data + run->offset;
+	const uint32_t *transfer = plan->transfers + run->transfer;
+	target_addr_t address = run->address;
+	uint32_t nbytes = run->nbytes;
+
+	while (nbytes > 0) {
+		unsigned int this_size = run->size;
+		/* same decision as mem_ap_setup_transfer_verify_size_packing() */
+		if (!run->banked && this_size < 4 && ap->packed_transfers_supported && nbytes >= 4
+				&& max_tar_block_size(ap->tar_autoincr_block, address) >= 4)
+			this_size = 4;
+
+		for (unsigned int i = 0; i < this_size; i++, address++)
+			*data++ = *transfer >> 8 * (address & 3);
+		transfer++;
+		nbytes -= this_size;
+	}
+}
+
+static bool mem_ap_scatter_supported(struct adiv5_ap *ap,
+	const struct target_memory_scatter *list, unsigned int count, bool write)
+{
+	if (ap->dap->ti_be_32_quirks || (write && ap->dap->nu_npcx_quirks))
+		return false;
+
+	for (unsigned int i = 0; i < count; i++) {
+		uint32_t size = list[i].size;
+		if ((size != 1 && size != 2 && size != 4) || list[i].address % size)
+			return false;
+	}
+	return true;
+}
+
+static int mem_ap_scatter(struct adiv5_ap *ap, struct target_memory_scatter *list,
+	unsigned int count, bool write)
+{
+	if (!mem_ap_scatter_supported(ap, list, count, write)) {
+		/* quirks and unaligned or wide accesses take the usual way */
+		for (unsigned int i = 0; i < count; i++) {
+			int retval = write ?
+				mem_ap_write(ap, list[i].buffer, list[i].size, list[i].count, list[i].address, true) :
+				mem_ap_read(ap, list[i].buffer, list[i].size, list[i].count, list[i].address, true);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+		return ERROR_OK;
+	}
+
+	struct mem_ap_plan plan = { 0 };
+	int retval = mem_ap_plan_scatter(list, count, write, &plan);
+	if (retval != ERROR_OK) {
+		mem_ap_plan_free(&plan);
+		return retval;
+	}
+
+	if (write) {
+		for (unsigned int i = 0; i < count; i++) {
+			if (plan.request_run[i] == UINT_MAX)
+				continue;
+			const struct mem_ap_run *run = &plan.runs[plan.request_run[i]];
+			memcpy(plan.data + run->offset + (list[i].address - run->address),
+				list[i].buffer, list[i].size * list[i].count);
+		}
+	}
+
+	retval = mem_ap_queue_scatter(ap, &plan, write);
+	if (retval == ERROR_OK)
+		retval = dap_run(ap->dap);
+
+	if (retval != ERROR_OK) {
+		target_addr_t tar;
+		if (retval != ERROR_TARGET_SIZE_NOT_SUPPORTED && mem_ap_read_tar(ap, &tar) == ERROR_OK)
+			LOG_ERROR("Failed to %s memory at " TARGET_ADDR_FMT, write ? "write" : "read", tar);
+		mem_ap_plan_free(&plan);
+		return retval;
+	}
+
+	unsigned int banked = 0;
+	for (unsigned int r = 0; r < plan.run_count; r++) {
+		if (plan.runs[r].banked)
+			banked++;
+		if (!write)
+			mem_ap_replay_run(ap, &plan, &plan.runs[r]);
+	}
+	LOG_DEBUG_IO("AP#0x%" PRIx64 " scatter %s: %u requests in %u runs, %u banked",
+		ap->ap_num, write ? "write" : "read", count, plan.run_count, banked);
+
+	if (!write) {
+		for (unsigned int i = 0; i < count; i++) {
+			if (plan.request_run[i] == UINT_MAX)
+				continue;
+			const struct mem_ap_run *run = &plan.runs[plan.request_run[i]];
+			memcpy(list[i].buffer, plan.data + run->offset + (list[i].address - run->address),
+				list[i].size * list[i].count);
+		}
+	}
+
+	mem_ap_plan_free(&plan);
+	return ERROR_OK;
+}
+
+int mem_ap_read_buf_scatter(struct adiv5_ap *ap,
+		struct target_memory_scatter *list, unsigned int count)
+{
+	return mem_ap_scatter(ap, list, count, false);
+}
+
+int mem_ap_write_buf_scatter(struct adiv5_ap *ap,
+		const struct target_memory_scatter *list, unsigned int count)
+{
+	/* the buffers are only read */
+	return mem_ap_scatter(ap, (struct target_memory_scatter *)list, count, true);
+}
+
+/*--------------------------------------------------------------------------*/
+
 
 #define DAP_POWER_DOMAIN_TIMEOUT (10)
 
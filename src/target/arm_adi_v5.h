@@ -724,6 +724,13 @@ int mem_ap_read_buf_noincr(struct adiv5_ap *ap,
 int mem_ap_write_buf_noincr(struct adiv5_ap *ap,
 		const uint8_t *buffer, uint32_t size, uint32_t count, target_addr_t address);
 
+/* Synchronous scatter list functions, all the requests run in one DAP queue. */
+struct target_memory_scatter;
+int mem_ap_read_buf_scatter(struct adiv5_ap *ap,
+		struct target_memory_scatter *list, unsigned int count);
+int mem_ap_write_buf_scatter(struct adiv5_ap *ap,
+		const struct target_memory_scatter *list, unsigned int count);
+
 /* Initialisation of the debug system, power domains and registers */
 int dap_dp_init(struct adiv5_dap *dap);
 int dap_dp_init_or_reconnect(struct adiv5_dap *dap);
@@ -22,6 +22,7 @@
 #include "config.h"
 #endif
 
+#include <errno.h>
 #include <stdlib.h>
 #include <jim.h>
 
@@ -30,6 +31,8 @@
 #include <helper/jim-nvp.h>
 #include <helper/list.h>
 #include <helper/log.h>
+#include <helper/replacements.h>
+#include <helper/time_support.h>
 #include <helper/types.h>
 #include <jtag/interface.h>
 #include <server/server.h>
@@ -112,6 +115,16 @@ struct arm_tpiu_swo_object {
 	char *out_filename;
 	/** track TCP connections */
 	struct list_head connections;
+	/** captured data, shared by the file and all connections */
+	uint8_t *ring;
+	/** total bytes captured, the ring holds the last ARM_TPIU_SWO_RING_SIZE of them */
+	uint64_t ring_head;
+	/** captured bytes not yet written to the file */
+	uint64_t file_cursor;
+	int64_t file_flush_ms;
+	/** adaptive poll period of the adapter */
+	unsigned int poll_period_ms;
+	int64_t next_poll_ms;
 	/* START_DEPRECATED_TPIU */
 	bool recheck_ap_cur_target;
 	/* END_DEPRECATED_TPIU */
@@ -120,6 +133,10 @@ struct arm_tpiu_swo_object {
 struct arm_tpiu_swo_connection {
 	struct list_head lh;
 	struct connection *connection;
+	/** captured bytes sent to this client */
+	uint64_t cursor;
+	/** bytes overwritten before this client could take them */
+	uint64_t dropped;
 };
 
 struct arm_tpiu_swo_priv_connection {
@@ -128,25 +145,150 @@ struct arm_tpiu_swo_priv_connection {
 
 static LIST_HEAD(all_tpiu_swo);
 
+/* largest read from the adapter */
 #define ARM_TPIU_SWO_TRACE_BUF_SIZE	4096
+/* must be a power of 2 */
+#define ARM_TPIU_SWO_RING_SIZE		(1024 * 1024)
+/* the file is written when this much data is pending or after the delay below */
+#define ARM_TPIU_SWO_FILE_BATCH		(64 * 1024)
+#define ARM_TPIU_SWO_FILE_DELAY_MS	100
+/* the poll period doubles up to this while the adapter has no data */
+#define ARM_TPIU_SWO_POLL_MAX_MS	8
+/* reads in one poll while the adapter keeps filling the buffer */
+#define ARM_TPIU_SWO_POLL_BURST		16
+
+static int arm_tpiu_swo_ring_init(struct arm_tpiu_swo_object *obj)
+{
+	if (!obj->ring) {
+		obj->ring = malloc(ARM_TPIU_SWO_RING_SIZE);
+		if (!obj->ring) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+	obj->ring_head = 0;
+	obj->file_cursor = 0;
+	obj->file_flush_ms = timeval_ms();
+	obj->poll_period_ms = 1;
+	obj->next_poll_ms = 0;
+
+	struct arm_tpiu_swo_connection *c;
+	list_for_each_entry(c, &obj->connections, lh) {
+		c->cursor = 0;
+		c->dropped = 0;
+	}
+	return ERROR_OK;
+}
+
+/* Writes captured data not yet in the file, returns bytes written or -1 */
+static int arm_tpiu_swo_file_write(struct arm_tpiu_swo_object *obj)
+{
+	size_t done = 0;
+
+	while (obj->file_cursor < obj->ring_head) {
+		size_t offset = obj->file_cursor & (ARM_TPIU_SWO_RING_SIZE - 1);
+		size_t len = MIN(obj->ring_head - obj->file_cursor, ARM_TPIU_SWO_RING_SIZE - offset);
+		if (fwrite(obj->ring + offset, 1, len, obj->file) != len)
+			return -1;
+		obj->file_cursor += len;
+		done += len;
+	}
+	if (done && fflush(obj->file))
+		return -1;
+	obj->file_flush_ms = timeval_ms();
+	return done;
+}
+
+static bool arm_tpiu_swo_would_block(void)
+{
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+/* Sends as much pending data as the client takes without blocking */
+static void arm_tpiu_swo_connection_drain(struct arm_tpiu_swo_object *obj, struct arm_tpiu_swo_connection *c)
+{
+	if (obj->ring_head - c->cursor > ARM_TPIU_SWO_RING_SIZE) {
+		uint64_t lost = obj->ring_head - ARM_TPIU_SWO_RING_SIZE - c->cursor;
+		if (!c->dropped)
+			LOG_WARNING("TPIU/SWO %s: client on fd %d too slow, dropping trace data",
+				obj->name, c->connection->fd);
+		c->dropped += lost;
+		c->cursor += lost;
+	}
+
+	while (c->cursor < obj->ring_head) {
+		size_t offset = c->cursor & (ARM_TPIU_SWO_RING_SIZE - 1);
+		size_t len = MIN(obj->ring_head - c->cursor, ARM_TPIU_SWO_RING_SIZE - offset);
+		int written = connection_write(c->connection, obj->ring + offset, len);
+		if (written <= 0) {
+			if (written < 0 && !arm_tpiu_swo_would_block())
+				LOG_ERROR("TPIU/SWO %s: error writing to client on fd %d", obj->name, c->connection->fd);
+			return;
+		}
+		c->cursor += written;
+	}
+}
+
+/* Reads the adapter straight into the ring, *full tells if it filled the whole room */
+static int arm_tpiu_swo_ring_fill(struct arm_tpiu_swo_object *obj, bool *full)
+{
+	size_t offset = obj->ring_head & (ARM_TPIU_SWO_RING_SIZE - 1);
+	size_t room = MIN(ARM_TPIU_SWO_TRACE_BUF_SIZE, ARM_TPIU_SWO_RING_SIZE - offset);
+	size_t size = room;
+
+	*full = false;
+
+	/* never overwrite data still pending for the file */
+	if (obj->file && obj->ring_head + room - obj->file_cursor > ARM_TPIU_SWO_RING_SIZE)
+		if (arm_tpiu_swo_file_write(obj) < 0)
+			goto file_error;
+
+	int retval = adapter_poll_trace(obj->ring + offset, &size);
+	if (retval != ERROR_OK || !size)
+		return retval;
+
+	target_call_trace_callbacks(/*target*/NULL, size, obj->ring + offset);
+	obj->ring_head += size;
+	*full = size == room;
+	return ERROR_OK;
+
+file_error:
+	LOG_ERROR("Error writing to the SWO trace destination file");
+	return ERROR_FAIL;
+}
 
 static int arm_tpiu_swo_poll_trace(void *priv)
 {
 	struct arm_tpiu_swo_object *obj = priv;
-	uint8_t buf[ARM_TPIU_SWO_TRACE_BUF_SIZE];
-	size_t size = sizeof(buf);
 	struct arm_tpiu_swo_connection *c;
+	int64_t now = timeval_ms();
+	int retval = ERROR_OK;
 
-	int retval = adapter_poll_trace(buf, &size);
-	if (retval != ERROR_OK || !size)
-		return retval;
+	if (now >= obj->next_poll_ms) {
+		uint64_t head = obj->ring_head;
+		bool full = true;
+
+		/* a full read means more data is waiting in the adapter */
+		for (unsigned int i = 0; full && i < ARM_TPIU_SWO_POLL_BURST; i++) {
+			retval = arm_tpiu_swo_ring_fill(obj, &full);
+			if (retval != ERROR_OK)
+				break;
+		}
 
-	target_call_trace_callbacks(/*target*/NULL, size, buf);
+		if (obj->ring_head != head)
+			obj->poll_period_ms = 1;
+		else if (obj->poll_period_ms < ARM_TPIU_SWO_POLL_MAX_MS)
+			obj->poll_period_ms *= 2;
+		obj->next_poll_ms = now + obj->poll_period_ms;
+	}
 
-	if (obj->file) {
-		if (fwrite(buf, 1, size, obj->file) == size) {
-			fflush(obj->file);
-		} else {
+	if (obj->file && (obj->ring_head - obj->file_cursor >= ARM_TPIU_SWO_FILE_BATCH ||
+			(obj->ring_head != obj->file_cursor && now - obj->file_flush_ms >= ARM_TPIU_SWO_FILE_DELAY_MS))) {
+		if (arm_tpiu_swo_file_write(obj) < 0) {
 			LOG_ERROR("Error writing to the SWO trace destination file");
 			return ERROR_FAIL;
 		}
@@ -154,10 +296,9 @@ static int arm_tpiu_swo_poll_trace(void *priv)
 
 	if (obj->out_filename[0] == ':')
 		list_for_each_entry(c, &obj->connections, lh)
-			if (connection_write(c->connection, buf, size) != (int)size)
-				LOG_ERROR("Error writing to connection"); /* FIXME: which connection? */
+			arm_tpiu_swo_connection_drain(obj, c);
 
-	return ERROR_OK;
+	return retval;
 }
 
 static int arm_tpiu_swo_handle_event(struct arm_tpiu_swo_object *obj, enum arm_tpiu_swo_event event)
@@ -199,6 +340,8 @@ static int arm_tpiu_swo_handle_event(struct arm_tpiu_swo_object *obj, enum arm_t
 static void arm_tpiu_swo_close_output(struct arm_tpiu_swo_object *obj)
 {
 	if (obj->file) {
+		if (obj->ring && arm_tpiu_swo_file_write(obj) < 0)
+			LOG_ERROR("Error writing to the SWO trace destination file");
 		fclose(obj->file);
 		obj->file = NULL;
 	}
@@ -238,6 +381,7 @@ int arm_tpiu_swo_cleanup_all(void)
 		if (obj->ap)
 			dap_put_ap(obj->ap);
 
+		free(obj->ring);
 		free(obj->name);
 		free(obj->out_filename);
 		free(obj);
@@ -256,6 +400,11 @@ static int arm_tpiu_swo_service_new_connection(struct connection *connection)
 		return ERROR_FAIL;
 	}
 	c->connection = connection;
+	/* clients get live data, a stalled one must not block the server */
+	c->cursor = obj->ring_head;
+	c->dropped = 0;
+	if (connection->service->type == CONNECTION_TCP)
+		socket_nonblock(connection->fd_out);
 	list_add(&c->lh, &obj->connections);
 	return ERROR_OK;
 }
@@ -284,6 +433,9 @@ static int arm_tpiu_swo_service_connection_closed(struct connection *connection)
 
 	list_for_each_entry_safe(c, tmp, &obj->connections, lh)
 		if (c->connection == connection) {
+			if (c->dropped)
+				LOG_INFO("TPIU/SWO %s: client on fd %d dropped %" PRIu64 " bytes",
+					obj->name, connection->fd, c->dropped);
 			list_del(&c->lh);
 			free(c);
 			return ERROR_OK;
@@ -719,6 +871,10 @@ COMMAND_HANDLER(handle_arm_tpiu_swo_enable)
 	unsigned int swo_pin_freq = obj->swo_pin_freq; /* could be replaced */
 
 	if (!output_external) {
+		retval = arm_tpiu_swo_ring_init(obj);
+		if (retval != ERROR_OK)
+			return retval;
+
 		if (obj->out_filename[0] == ':') {
 			struct arm_tpiu_swo_priv_connection *priv = malloc(sizeof(*priv));
 			if (!priv) {
@@ -12,9 +12,14 @@
 #include <target/armv7m.h>
 #include <target/cortex_m.h>
 #include <target/armv7m_trace.h>
+#include <target/armv7m_trace_decoder.h>
 #include <jtag/interface.h>
 #include <helper/time_support.h>
 
+/* SWO data is not tied to a target, so there is a single decoder */
+static struct itm_decoder *itm_decoder;
+static bool itm_decoder_on;
+
 int armv7m_trace_itm_config(struct target *target)
 {
 	struct armv7m_common *armv7m = target_to_armv7m(target);
@@ -125,6 +130,335 @@ COMMAND_HANDLER(handle_itm_ports_command)
 	return armv7m_trace_itm_config(target);
 }
 
+static int itm_decoder_trace_callback(struct target *target, size_t len, uint8_t *data, void *priv)
+{
+	itm_decoder_feed(priv, data, len);
+	return ERROR_OK;
+}
+
+static struct itm_decoder *itm_decoder_get(void)
+{
+	if (!itm_decoder) {
+		itm_decoder = malloc(sizeof(*itm_decoder));
+		if (!itm_decoder) {
+			LOG_ERROR("Out of memory");
+			return NULL;
+		}
+		itm_decoder_init(itm_decoder);
+	}
+	return itm_decoder;
+}
+
+void armv7m_trace_decoder_cleanup(void)
+{
+	if (!itm_decoder)
+		return;
+
+	if (itm_decoder_on)
+		target_unregister_trace_callback(itm_decoder_trace_callback, itm_decoder);
+	itm_decoder_on = false;
+
+	itm_decoder_flush(itm_decoder);
+	for (unsigned int port = 0; port < ITM_DECODER_PORTS; port++)
+		if (itm_decoder->sinks[port].file)
+			fclose(itm_decoder->sinks[port].file);
+	free(itm_decoder);
+	itm_decoder = NULL;
+}
+
+COMMAND_HANDLER(handle_itm_decode_command)
+{
+	bool enable;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 0) {
+		command_print(CMD, "ITM decoder is %s", itm_decoder_on ? "on" : "off");
+		return ERROR_OK;
+	}
+
+	COMMAND_PARSE_ON_OFF(CMD_ARGV[0], enable);
+	if (enable == itm_decoder_on)
+		return ERROR_OK;
+
+	if (!enable) {
+		target_unregister_trace_callback(itm_decoder_trace_callback, itm_decoder);
+		itm_decoder_flush(itm_decoder);
+		itm_decoder_on = false;
+		return ERROR_OK;
+	}
+
+	struct itm_decoder *dec = itm_decoder_get();
+	if (!dec)
+		return ERROR_FAIL;
+	int retval = target_register_trace_callback(itm_decoder_trace_callback, dec);
+	if (retval != ERROR_OK)
+		return retval;
+	itm_decoder_on = true;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_itm_decode_port_command)
+{
+	unsigned int port;
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], port);
+	if (port >= ITM_DECODER_PORTS) {
+		command_print(CMD, "ITM stimulus port %u out of range", port);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct itm_decoder *dec = itm_decoder_get();
+	if (!dec)
+		return ERROR_FAIL;
+	struct itm_decoder_sink *sink = &dec->sinks[port];
+
+	FILE *file = NULL;
+	bool log = !strcmp(CMD_ARGV[1], "log");
+	if (!log && strcmp(CMD_ARGV[1], "off")) {
+		file = fopen(CMD_ARGV[1], "ab");
+		if (!file) {
+			command_print(CMD, "Can't open ITM port sink \"%s\"", CMD_ARGV[1]);
+			return ERROR_FAIL;
+		}
+	}
+
+	if (sink->line_len)
+		LOG_USER("ITM port %u: %.*s", port, (int)sink->line_len, sink->line);
+	if (sink->file)
+		fclose(sink->file);
+	sink->file = file;
+	sink->log = log;
+	sink->line_len = 0;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_itm_decode_stats_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct itm_decoder *dec = itm_decoder_get();
+	if (!dec)
+		return ERROR_FAIL;
+
+	command_print(CMD, "bytes: %" PRIu64 ", syncs: %" PRIu64 ", overflows: %" PRIu64 ", errors: %" PRIu64,
+		dec->bytes, dec->syncs, dec->overflows, dec->errors);
+	command_print(CMD, "instrumentation packets: %" PRIu64 ", hardware packets: %" PRIu64
+		", local timestamps: %" PRIu64 " (time %" PRIu64 ")",
+		dec->sw_packets, dec->hw_packets, dec->timestamps, dec->timestamp);
+	command_print(CMD, "PC samples: %" PRIu64 " (sleeping %" PRIu64 ", not counted %" PRIu64
+		"), exception events: %" PRIu64 ", event counter packets: %" PRIu64 ", data trace packets: %" PRIu64,
+		dec->pc_samples, dec->pc_sleep, dec->pc_lost, dec->exc_events, dec->event_counters, dec->data_trace);
+	for (unsigned int port = 0; port < ITM_DECODER_PORTS; port++)
+		if (dec->port_bytes[port])
+			command_print(CMD, "port %3u: %" PRIu64 " bytes", port, dec->port_bytes[port]);
+	return ERROR_OK;
+}
+
+static int itm_decoder_pc_cmp(const void *a, const void *b)
+{
+	const struct itm_decoder_pc_bucket *pa = a, *pb = b;
+
+	if (pa->count != pb->count)
+		return pa->count < pb->count ? 1 : -1;
+	return pa->pc < pb->pc ? -1 : pa->pc > pb->pc;
+}
+
+COMMAND_HANDLER(handle_itm_decode_pc_command)
+{
+	unsigned int count = 10;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], count);
+
+	struct itm_decoder *dec = itm_decoder_get();
+	if (!dec)
+		return ERROR_FAIL;
+
+	struct itm_decoder_pc_bucket *hist = malloc(sizeof(dec->pc_hist));
+	if (!hist) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	memcpy(hist, dec->pc_hist, sizeof(dec->pc_hist));
+	qsort(hist, ITM_DECODER_PC_BUCKETS, sizeof(*hist), itm_decoder_pc_cmp);
+
+	uint64_t total = dec->pc_samples + dec->pc_sleep;
+	command_print(CMD, "%" PRIu64 " samples, %" PRIu64 " sleeping", total, dec->pc_sleep);
+	for (unsigned int i = 0; i < count && i < ITM_DECODER_PC_BUCKETS && hist[i].count; i++)
+		command_print(CMD, "0x%08" PRIx32 " %10" PRIu32 " %6.2f%%", hist[i].pc, hist[i].count,
+			100.0 * hist[i].count / total);
+	free(hist);
+	return ERROR_OK;
+}
+
+static const char *itm_decoder_exc_name(unsigned int number, char *buf, size_t size)
+{
+	static const char * const names[16] = {
+		[1] = "Reset", [2] = "NMI", [3] = "HardFault", [4] = "MemManage",
+		[5] = "BusFault", [6] = "UsageFault", [7] = "SecureFault",
+		[11] = "SVCall", [12] = "DebugMonitor", [14] = "PendSV", [15] = "SysTick",
+	};
+
+	if (number < 16 && names[number])
+		return names[number];
+	if (number >= 16)
+		snprintf(buf, size, "IRQ %u", number - 16);
+	else
+		snprintf(buf, size, "exception %u", number);
+	return buf;
+}
+
+COMMAND_HANDLER(handle_itm_decode_exceptions_command)
+{
+	static const char * const functions[] = { "", "enter", "exit", "return" };
+	unsigned int count = 16;
+	char name[16];
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], count);
+
+	struct itm_decoder *dec = itm_decoder_get();
+	if (!dec)
+		return ERROR_FAIL;
+
+	command_print(CMD, "%-16s %10s %10s %10s", "exception", "entered", "exited", "returned");
+	for (unsigned int i = 0; i < ITM_DECODER_EXCEPTIONS; i++) {
+		const struct itm_decoder_exc_stats *exc = &dec->exc[i];
+		if (exc->entered || exc->exited || exc->returned)
+			command_print(CMD, "%-16s %10" PRIu32 " %10" PRIu32 " %10" PRIu32,
+				itm_decoder_exc_name(i, name, sizeof(name)), exc->entered, exc->exited, exc->returned);
+	}
+
+	/* the timeline, oldest first */
+	count = MIN(count, ITM_DECODER_TIMELINE);
+	uint64_t first = dec->exc_events > count ? dec->exc_events - count : 0;
+	for (uint64_t n = first; n < dec->exc_events; n++) {
+		const struct itm_decoder_exc_event *ev = &dec->timeline[n & (ITM_DECODER_TIMELINE - 1)];
+		command_print(CMD, "%12" PRIu64 " %-6s %s", ev->timestamp, functions[ev->function],
+			itm_decoder_exc_name(ev->number, name, sizeof(name)));
+	}
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_itm_decode_reset_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (itm_decoder)
+		itm_decoder_reset(itm_decoder);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_itm_decode_replay_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct itm_decoder *dec = itm_decoder_get();
+	if (!dec)
+		return ERROR_FAIL;
+
+	FILE *file = fopen(CMD_ARGV[0], "rb");
+	if (!file) {
+		command_print(CMD, "Can't open trace capture \"%s\"", CMD_ARGV[0]);
+		return ERROR_FAIL;
+	}
+
+	const size_t buf_size = 64 * 1024;
+	uint8_t *buf = malloc(buf_size);
+	if (!buf) {
+		LOG_ERROR("Out of memory");
+		fclose(file);
+		return ERROR_FAIL;
+	}
+
+	/* only the decoding is timed */
+	struct duration bench;
+	float elapsed = 0;
+	size_t total = 0;
+	size_t n;
+	while ((n = fread(buf, 1, buf_size, file)) > 0) {
+		duration_start(&bench);
+		itm_decoder_feed(dec, buf, n);
+		duration_measure(&bench);
+		elapsed += duration_elapsed(&bench);
+		total += n;
+	}
+	bool failed = ferror(file);
+	fclose(file);
+	free(buf);
+	itm_decoder_flush(dec);
+
+	if (failed) {
+		command_print(CMD, "Error reading trace capture \"%s\"", CMD_ARGV[0]);
+		return ERROR_FAIL;
+	}
+
+	if (elapsed > 0)
+		command_print(CMD, "decoded %zu bytes in %.3f s (%.1f MiB/s)", total, elapsed,
+			total / elapsed / (1024 * 1024));
+	else
+		command_print(CMD, "decoded %zu bytes", total);
+	return ERROR_OK;
+}
+
+static const struct command_registration itm_decode_command_handlers[] = {
+	{
+		.name = "port",
+		.handler = handle_itm_decode_port_command,
+		.mode = COMMAND_ANY,
+		.help = "Send the data of an ITM stimulus port to a file or to the log",
+		.usage = "<port> (filename|log|off)",
+	},
+	{
+		.name = "stats",
+		.handler = handle_itm_decode_stats_command,
+		.mode = COMMAND_ANY,
+		.help = "Display ITM decoder statistics",
+		.usage = "",
+	},
+	{
+		.name = "pc",
+		.handler = handle_itm_decode_pc_command,
+		.mode = COMMAND_ANY,
+		.help = "Display the most frequent DWT PC samples",
+		.usage = "[count]",
+	},
+	{
+		.name = "exceptions",
+		.handler = handle_itm_decode_exceptions_command,
+		.mode = COMMAND_ANY,
+		.help = "Display DWT exception trace counters and the last events",
+		.usage = "[count]",
+	},
+	{
+		.name = "reset",
+		.handler = handle_itm_decode_reset_command,
+		.mode = COMMAND_ANY,
+		.help = "Clear ITM decoder statistics",
+		.usage = "",
+	},
+	{
+		.name = "replay",
+		.handler = handle_itm_decode_replay_command,
+		.mode = COMMAND_ANY,
+		.help = "Decode a recorded SWO capture and report the decoding speed",
+		.usage = "filename",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 static const struct command_registration itm_command_handlers[] = {
 	{
 		.name = "port",
@@ -140,6 +474,14 @@ static const struct command_registration itm_command_handlers[] = {
 		.help = "Enable or disable all ITM stimulus ports",
 		.usage = "(0|1|on|off)",
 	},
+	{
+		.name = "decode",
+		.handler = handle_itm_decode_command,
+		.mode = COMMAND_ANY,
+		.help = "Enable or disable decoding of the SWO trace data",
+		.usage = "[(0|1|on|off)]",
+		.chain = itm_decode_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -44,4 +44,9 @@ extern const struct command_registration armv7m_trace_command_handlers[];
  */
 int armv7m_trace_itm_config(struct target *target);
 
+/**
+ * Release the ITM decoder and close its sinks
+ */
+void armv7m_trace_decoder_cleanup(void);
+
 #endif /* OPENOCD_TARGET_ARMV7M_TRACE_H */
@@ -0,0 +1,263 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ * Decodes ITM/DWT packets byte by byte, so the data can be fed in chunks of
+ * any size as it arrives from the adapter. Instrumentation packets go to the
+ * sink of their stimulus port, DWT PC samples are counted in a fixed size
+ * histogram and exception trace packets update per exception counters and
+ * a timeline of the last events. Nothing is allocated while decoding.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stddef.h>
+#include <string.h>
+#include <helper/log.h>
+#include <helper/types.h>
+#include "armv7m_trace_decoder.h"
+
+#define ITM_HDR_OVERFLOW		0x70
+#define ITM_HDR_GTS1			0x94
+#define ITM_HDR_GTS2			0xb4
+
+/* hardware source packet discriminators */
+#define DWT_ID_EVENT_COUNTER	0
+#define DWT_ID_EXCEPTION		1
+#define DWT_ID_PC_SAMPLE		2
+#define DWT_ID_DATA_FIRST		8
+#define DWT_ID_DATA_LAST		23
+
+/* probes before a PC sample is given up */
+#define ITM_DECODER_PC_PROBES	32
+
+void itm_decoder_init(struct itm_decoder *dec)
+{
+	memset(dec, 0, sizeof(*dec));
+}
+
+void itm_decoder_reset(struct itm_decoder *dec)
+{
+	itm_decoder_flush(dec);
+	memset(dec, 0, offsetof(struct itm_decoder, sinks));
+	memset(dec->pc_hist, 0, sizeof(*dec) - offsetof(struct itm_decoder, pc_hist));
+}
+
+static void itm_decoder_line_flush(unsigned int port, struct itm_decoder_sink *sink)
+{
+	if (!sink->line_len)
+		return;
+	LOG_USER("ITM port %u: %.*s", port, (int)sink->line_len, sink->line);
+	sink->line_len = 0;
+}
+
+void itm_decoder_flush(struct itm_decoder *dec)
+{
+	for (unsigned int port = 0; port < ITM_DECODER_PORTS; port++) {
+		struct itm_decoder_sink *sink = &dec->sinks[port];
+		itm_decoder_line_flush(port, sink);
+		if (sink->file)
+			fflush(sink->file);
+	}
+}
+
+static void itm_decoder_stimulus(struct itm_decoder *dec)
+{
+	unsigned int port = dec->page * 32 + (dec->header >> 3);
+	struct itm_decoder_sink *sink = &dec->sinks[port];
+
+	dec->sw_packets++;
+	dec->port_bytes[port] += dec->payload_len;
+
+	if (sink->file && fwrite(dec->payload, 1, dec->payload_len, sink->file) != dec->payload_len) {
+		LOG_ERROR("ITM port %u: error writing to the sink, closing it", port);
+		fclose(sink->file);
+		sink->file = NULL;
+	}
+
+	if (!sink->log)
+		return;
+	for (unsigned int i = 0; i < dec->payload_len; i++) {
+		char c = dec->payload[i];
+		if (c == '\n') {
+			/* empty lines are printed too */
+			if (!sink->line_len)
+				sink->line[sink->line_len++] = ' ';
+			itm_decoder_line_flush(port, sink);
+		} else if (c != '\r') {
+			if (sink->line_len == ITM_DECODER_LINE_MAX)
+				itm_decoder_line_flush(port, sink);
+			sink->line[sink->line_len++] = c;
+		}
+	}
+}
+
+static void itm_decoder_pc_sample(struct itm_decoder *dec, uint32_t pc)
+{
+	/* Fibonacci hashing, the low bit of a Thumb PC carries no information */
+	unsigned int idx = ((pc >> 1) * 2654435761u) >> 20;
+
+	dec->pc_samples++;
+	for (unsigned int i = 0; i < ITM_DECODER_PC_PROBES; i++) {
+		struct itm_decoder_pc_bucket *b = &dec->pc_hist[(idx + i) & (ITM_DECODER_PC_BUCKETS - 1)];
+		if (!b->count)
+			b->pc = pc;
+		if (b->pc == pc) {
+			b->count++;
+			return;
+		}
+	}
+	dec->pc_lost++;
+}
+
+static void itm_decoder_exception(struct itm_decoder *dec)
+{
+	unsigned int number = dec->payload[0] | (dec->payload[1] & 1) << 8;
+	unsigned int function = (dec->payload[1] >> 4) & 3;
+	struct itm_decoder_exc_stats *exc = &dec->exc[number];
+
+	switch (function) {
+	case ITM_DECODER_EXC_ENTER:
+		exc->entered++;
+		break;
+	case ITM_DECODER_EXC_EXIT:
+		exc->exited++;
+		break;
+	case ITM_DECODER_EXC_RETURN:
+		exc->returned++;
+		break;
+	default:
+		dec->errors++;
+		return;
+	}
+
+	struct itm_decoder_exc_event *ev = &dec->timeline[dec->exc_events & (ITM_DECODER_TIMELINE - 1)];
+	ev->timestamp = dec->timestamp;
+	ev->number = number;
+	ev->function = function;
+	dec->exc_events++;
+}
+
+static void itm_decoder_hardware(struct itm_decoder *dec)
+{
+	unsigned int id = dec->header >> 3;
+
+	dec->hw_packets++;
+	if (id == DWT_ID_EVENT_COUNTER) {
+		dec->event_counters++;
+	} else if (id == DWT_ID_EXCEPTION && dec->payload_len == 2) {
+		itm_decoder_exception(dec);
+	} else if (id == DWT_ID_PC_SAMPLE && dec->payload_len == 4) {
+		itm_decoder_pc_sample(dec, le_to_h_u32(dec->payload));
+	} else if (id == DWT_ID_PC_SAMPLE && dec->payload_len == 1) {
+		dec->pc_sleep++;
+	} else if (id >= DWT_ID_DATA_FIRST && id <= DWT_ID_DATA_LAST) {
+		dec->data_trace++;
+	} else {
+		dec->errors++;
+	}
+}
+
+/* Handles a complete packet whose header needs a payload */
+static void itm_decoder_packet(struct itm_decoder *dec)
+{
+	uint8_t hdr = dec->header;
+
+	if (hdr & 3) {
+		if (hdr & 4)
+			itm_decoder_hardware(dec);
+		else
+			itm_decoder_stimulus(dec);
+	} else if ((hdr & 0xcf) == 0xc0) {
+		/* local timestamp format 1, 7 bits per byte */
+		uint64_t delta = 0;
+		for (unsigned int i = 0; i < dec->payload_len; i++)
+			delta |= (uint64_t)(dec->payload[i] & 0x7f) << (7 * i);
+		dec->timestamp += delta;
+		dec->timestamps++;
+	} else if ((hdr & 0x0b) == 0x08) {
+		/* extension with the stimulus port page in its first bits */
+		if (!(hdr & 4))
+			dec->page = ((hdr >> 4) & 7) | ((dec->payload[0] & 0x7f) << 3);
+		if (dec->page >= ITM_DECODER_PORTS / 32) {
+			dec->page = 0;
+			dec->errors++;
+		}
+	}
+	/* global timestamps are not used */
+}
+
+/* Starts a packet, returns false for packets without payload */
+static bool itm_decoder_header(struct itm_decoder *dec, uint8_t hdr)
+{
+	dec->header = hdr;
+	dec->payload_len = 0;
+	dec->payload_size = 0;
+
+	if (hdr & 3) {
+		/* source packet with 1, 2 or 4 bytes of payload */
+		dec->payload_size = 1 << ((hdr & 3) - 1);
+		return true;
+	}
+	if (hdr == ITM_HDR_OVERFLOW) {
+		dec->overflows++;
+		return false;
+	}
+	if ((hdr & 0x8f) == 0) {
+		/* local timestamp format 2 */
+		dec->timestamp += (hdr >> 4) & 7;
+		dec->timestamps++;
+		return false;
+	}
+	if ((hdr & 0xcf) == 0xc0 || hdr == ITM_HDR_GTS1 || hdr == ITM_HDR_GTS2)
+		return true;
+	if ((hdr & 0x0b) == 0x08) {
+		if (hdr & 0x80)
+			return true;
+		if (!(hdr & 4))
+			dec->page = (hdr >> 4) & 7;
+		return false;
+	}
+	dec->errors++;
+	return false;
+}
+
+void itm_decoder_feed(struct itm_decoder *dec, const uint8_t *data, size_t len)
+{
+	dec->bytes += len;
+
+	for (size_t i = 0; i < len; i++) {
+		uint8_t b = data[i];
+
+		if (dec->in_packet) {
+			dec->payload[dec->payload_len++] = b;
+			if (dec->payload_size ? dec->payload_len == dec->payload_size : !(b & 0x80)) {
+				dec->in_packet = false;
+				itm_decoder_packet(dec);
+			} else if (dec->payload_len == sizeof(dec->payload)) {
+				/* runaway continuation, look for the next header */
+				dec->in_packet = false;
+				dec->errors++;
+			}
+			continue;
+		}
+
+		if (!b) {
+			dec->zeros++;
+			continue;
+		}
+		if (dec->zeros) {
+			bool sync = b == 0x80;
+			if (sync && dec->zeros >= 5)
+				dec->syncs++;
+			else if (sync)
+				dec->errors++;
+			dec->zeros = 0;
+			if (sync)
+				continue;
+		}
+		dec->in_packet = itm_decoder_header(dec, b);
+	}
+}
@@ -0,0 +1,106 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_ARMV7M_TRACE_DECODER_H
+#define OPENOCD_TARGET_ARMV7M_TRACE_DECODER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @file
+ * Incremental decoder of the ITM/DWT packet protocol (ARMv7-M ARM, appendix D4)
+ * as received from SWO with the TPIU formatter bypassed.
+ */
+
+#define ITM_DECODER_PORTS			256
+#define ITM_DECODER_EXCEPTIONS		512
+/* size of the PC sample histogram, must be a power of 2 */
+#define ITM_DECODER_PC_BUCKETS		4096
+/* exception events kept for the timeline, must be a power of 2 */
+#define ITM_DECODER_TIMELINE		256
+#define ITM_DECODER_LINE_MAX		128
+
+enum itm_decoder_exc_function {
+	ITM_DECODER_EXC_ENTER = 1,
+	ITM_DECODER_EXC_EXIT = 2,
+	ITM_DECODER_EXC_RETURN = 3,
+};
+
+/** Destination of the data written to a stimulus port */
+struct itm_decoder_sink {
+	/** file receiving the raw payload, or NULL */
+	FILE *file;
+	/** print complete lines to the log */
+	bool log;
+	unsigned int line_len;
+	char line[ITM_DECODER_LINE_MAX];
+};
+
+struct itm_decoder_pc_bucket {
+	uint32_t pc;
+	/** 0 for an unused bucket */
+	uint32_t count;
+};
+
+struct itm_decoder_exc_stats {
+	uint32_t entered;
+	uint32_t exited;
+	uint32_t returned;
+};
+
+struct itm_decoder_exc_event {
+	/** sum of the local timestamps received before the event */
+	uint64_t timestamp;
+	uint16_t number;
+	uint8_t function;
+};
+
+struct itm_decoder {
+	/* packet being assembled */
+	uint8_t header;
+	uint8_t payload[7];
+	unsigned int payload_len;
+	/** payload size of a source packet, 0 for packets ended by a clear continuation bit */
+	unsigned int payload_size;
+	bool in_packet;
+	/** consecutive zero bytes, a synchronization packet ends with 0x80 after at least 5 */
+	unsigned int zeros;
+	/** stimulus port page set by an extension packet */
+	unsigned int page;
+	uint64_t timestamp;
+
+	struct itm_decoder_sink sinks[ITM_DECODER_PORTS];
+
+	struct itm_decoder_pc_bucket pc_hist[ITM_DECODER_PC_BUCKETS];
+	struct itm_decoder_exc_stats exc[ITM_DECODER_EXCEPTIONS];
+	struct itm_decoder_exc_event timeline[ITM_DECODER_TIMELINE];
+
+	/* statistics */
+	uint64_t bytes;
+	uint64_t syncs;
+	uint64_t overflows;
+	uint64_t timestamps;
+	uint64_t errors;
+	uint64_t sw_packets;
+	uint64_t hw_packets;
+	uint64_t port_bytes[ITM_DECODER_PORTS];
+	uint64_t pc_samples;
+	/** PC samples taken while the core was sleeping */
+	uint64_t pc_sleep;
+	/** PC samples not counted because the histogram is full */
+	uint64_t pc_lost;
+	uint64_t exc_events;
+	uint64_t event_counters;
+	uint64_t data_trace;
+};
+
+void itm_decoder_init(struct itm_decoder *dec);
+/** Clears the statistics and the packet state, the sinks are kept */
+void itm_decoder_reset(struct itm_decoder *dec);
+void itm_decoder_feed(struct itm_decoder *dec, const uint8_t *data, size_t len);
+/** Flushes pending log lines and sink files */
+void itm_decoder_flush(struct itm_decoder *dec);
+
+#endif /* OPENOCD_TARGET_ARMV7M_TRACE_DECODER_H */
@@ -2253,6 +2253,48 @@ static int cortex_m_write_memory(struct target *target, target_addr_t address,
 	return mem_ap_write_buf(armv7m->debug_ap, buffer, size, count, address);
 }
 
+static int cortex_m_check_scatter_alignment(struct target *target,
+	const struct target_memory_scatter *list, unsigned int count)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+
+	if (armv7m->arm.arch != ARM_ARCH_V6M)
+		return ERROR_OK;
+
+	/* armv6m does not handle unaligned memory access */
+	for (unsigned int i = 0; i < count; i++) {
+		uint32_t size = list[i].size;
+		target_addr_t address = list[i].address;
+		if (((size == 4) && (address & 0x3u)) || ((size == 2) && (address & 0x1u)))
+			return ERROR_TARGET_UNALIGNED_ACCESS;
+	}
+	return ERROR_OK;
+}
+
+static int cortex_m_read_memory_scatter(struct target *target,
+	struct target_memory_scatter *list, unsigned int count)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+
+	int retval = cortex_m_check_scatter_alignment(target, list, count);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return mem_ap_read_buf_scatter(armv7m->debug_ap, list, count);
+}
+
+static int cortex_m_write_memory_scatter(struct target *target,
+	const struct target_memory_scatter *list, unsigned int count)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+
+	int retval = cortex_m_check_scatter_alignment(target, list, count);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return mem_ap_write_buf_scatter(armv7m->debug_ap, list, count);
+}
+
 static int cortex_m_init_target(struct command_context *cmd_ctx,
 	struct target *target)
 {
@@ -3184,6 +3226,8 @@ struct target_type cortexm_target = {
 
 	.read_memory = cortex_m_read_memory,
 	.write_memory = cortex_m_write_memory,
+	.read_memory_scatter = cortex_m_read_memory_scatter,
+	.write_memory_scatter = cortex_m_write_memory_scatter,
 	.checksum_memory = armv7m_checksum_memory,
 	.blank_check_memory = armv7m_blank_check_memory,
 
@@ -11,6 +11,9 @@
 
 #include <helper/log.h>
 #include <helper/binarybuffer.h>
+#include <helper/time_support.h>
+#include <target/breakpoints.h>
+#include <target/register.h>
 #include <target/smp.h>
 #include <target/target.h>
 #include "esp_riscv.h"
@@ -159,6 +162,7 @@ static int esp_common_flash_breakpoints_clear(struct target *target)
 	for (size_t slot = 0; slot < ESP_FLASH_BREAKPOINTS_MAX_NUM; slot++) {
 		struct esp_flash_breakpoint *flash_bp = &esp->flash_brps.brps[slot];
 		if (flash_bp->insn_sz > 0) {
+			esp->flash_brps_usage.stub_runs++;
 			int ret = esp->flash_brps.ops->breakpoint_remove(target, flash_bp, 1);
 			if (ret != ERROR_OK) {
 				LOG_TARGET_ERROR(target,
@@ -211,6 +215,237 @@ bool esp_common_flash_breakpoint_exists(struct esp_common *esp, struct breakpoin
 	return false;
 }
 
+static bool esp_common_flash_breakpoint_reuse_slot(struct esp_common *esp, struct breakpoint *breakpoint,
+	bool other_core)
+{
+	for (size_t slot = 0; slot < ESP_FLASH_BREAKPOINTS_MAX_NUM; slot++) {
+		struct esp_flash_breakpoint *flash_bp = &esp->flash_brps.brps[slot];
+		if (flash_bp->bp_address != breakpoint->address)
+			continue;
+		if (flash_bp->action == ESP_BP_ACT_REM && flash_bp->status == ESP_BP_STAT_PEND) {
+			/* the old breakpoint may be already freed */
+			flash_bp->oocd_bp = breakpoint;
+			flash_bp->action = ESP_BP_ACT_ADD;
+			flash_bp->status = ESP_BP_STAT_DONE;
+			breakpoint->is_set = true;
+			esp->flash_brps_usage.bps_reused++;
+			esp_common_dump_bp_slot("BP-ADD(reuse)", &esp->flash_brps, slot);
+			return true;
+		}
+		if (other_core && flash_bp->action == ESP_BP_ACT_ADD)
+			return true;
+	}
+	return false;
+}
+
+/* Called before a HW breakpoint is placed. A breakpoint re-inserted by GDB around a step or a stop
+ * is kept in flash while its removal is still pending, so it is not moved between HW comparators
+ * and flash on every stop. SMP cores share flash, so a breakpoint set there via another core is reused too. */
+bool esp_common_flash_breakpoint_reuse(struct target *target, struct breakpoint *breakpoint)
+{
+	if (breakpoint->type != BKPT_HARD)
+		return false;
+
+	if (!target->smp)
+		return esp_common_flash_breakpoint_reuse_slot(target_to_esp_common(target), breakpoint, false);
+
+	struct target_list *head;
+	foreach_smp_target(head, target->smp_targets) {
+		if (esp_common_flash_breakpoint_reuse_slot(target_to_esp_common(head->target), breakpoint,
+				head->target != target))
+			return true;
+	}
+	return false;
+}
+
+static struct esp_common *esp_common_flash_bp_hot_owner(struct target *target)
+{
+	/* hit counts of SMP cores are kept together, flash breakpoints hit any of them */
+	if (target->smp)
+		target = list_first_entry(target->smp_targets, struct target_list, lh)->target;
+	return target_to_esp_common(target);
+}
+
+static uint32_t esp_common_flash_breakpoint_hits(struct target *target, target_addr_t address)
+{
+	struct esp_flash_breakpoints_usage *usage = &esp_common_flash_bp_hot_owner(target)->flash_brps_usage;
+
+	for (size_t i = 0; i < ESP_FLASH_BREAKPOINTS_HOT_NUM; i++) {
+		if (usage->hot[i].hits && usage->hot[i].address == address)
+			return usage->hot[i].hits;
+	}
+	return 0;
+}
+
+/* Counts stops at HW breakpoints, flash ones included. The least hit address makes room for a new one. */
+static void esp_common_flash_breakpoint_hit(struct target *target)
+{
+	if (target->debug_reason != DBG_REASON_BREAKPOINT || !target->reg_cache)
+		return;
+
+	struct reg *pc = register_get_by_name(target->reg_cache, "pc", true);
+	if (!pc || (!pc->valid && pc->type->get(pc) != ERROR_OK))
+		return;
+	target_addr_t address = buf_get_u64(pc->value, 0, pc->size);
+	struct breakpoint *breakpoint = breakpoint_find(target, address);
+	if (!breakpoint || breakpoint->type != BKPT_HARD)
+		return;
+
+	struct esp_common *esp = esp_common_flash_bp_hot_owner(target);
+	if (!esp)
+		return;
+	struct esp_flash_breakpoints_usage *usage = &esp->flash_brps_usage;
+	size_t coldest = 0;
+	for (size_t i = 0; i < ESP_FLASH_BREAKPOINTS_HOT_NUM; i++) {
+		if (usage->hot[i].hits && usage->hot[i].address == address) {
+			if (usage->hot[i].hits < UINT32_MAX)
+				usage->hot[i].hits++;
+			return;
+		}
+		if (usage->hot[i].hits < usage->hot[coldest].hits)
+			coldest = i;
+	}
+	usage->hot[coldest].address = address;
+	usage->hot[coldest].hits = 1;
+}
+
+/* Places a HW breakpoint at the same address on all cores or on none of them */
+static int esp_common_hw_breakpoint_place(struct target *target, target_addr_t address)
+{
+	struct esp_common *esp = target_to_esp_common(target);
+
+	if (!target->smp) {
+		struct breakpoint *breakpoint = breakpoint_find(target, address);
+		if (!breakpoint || breakpoint->is_set)
+			return ERROR_FAIL;
+		return esp->hw_breakpoint_add(target, breakpoint);
+	}
+
+	struct target_list *head;
+	foreach_smp_target(head, target->smp_targets) {
+		if (head->target->state != TARGET_HALTED)
+			return ERROR_TARGET_NOT_HALTED;
+	}
+
+	int ret = ERROR_OK;
+	uint32_t placed = 0;
+	unsigned int core = 0;
+	foreach_smp_target(head, target->smp_targets) {
+		struct breakpoint *breakpoint = breakpoint_find(head->target, address);
+		if (core >= 32 || !breakpoint) {
+			ret = ERROR_FAIL;
+			break;
+		}
+		if (!breakpoint->is_set) {
+			ret = esp->hw_breakpoint_add(head->target, breakpoint);
+			if (ret != ERROR_OK)
+				break;
+			placed |= BIT(core);
+		}
+		core++;
+	}
+	if (ret == ERROR_OK)
+		return ERROR_OK;
+
+	core = 0;
+	foreach_smp_target(head, target->smp_targets) {
+		if (placed & BIT(core))
+			esp->hw_breakpoint_remove(head->target, breakpoint_find(head->target, address));
+		core++;
+	}
+	return ret;
+}
+
+/* Gives HW comparators which got free to the pending flash breakpoints, the most hit first,
+ * so that flash is written only for the breakpoints which do not fit there. */
+static void esp_common_flash_breakpoints_to_hw(struct target *target)
+{
+	struct esp_common *esp = target_to_esp_common(target);
+	struct esp_flash_breakpoint *flash_bps = esp->flash_brps.brps;
+	size_t slots[ESP_FLASH_BREAKPOINTS_MAX_NUM];
+	uint32_t hits[ESP_FLASH_BREAKPOINTS_MAX_NUM];
+	size_t num = 0;
+
+	if (!esp->hw_breakpoint_add || !esp->hw_breakpoint_remove)
+		return;
+
+	for (size_t slot = 0; slot < ESP_FLASH_BREAKPOINTS_MAX_NUM; slot++) {
+		if (flash_bps[slot].action != ESP_BP_ACT_ADD || flash_bps[slot].status != ESP_BP_STAT_PEND)
+			continue;
+		uint32_t slot_hits = esp_common_flash_breakpoint_hits(target, flash_bps[slot].bp_address);
+		size_t i = num++;
+		for (; i > 0 && hits[i - 1] < slot_hits; i--) {
+			slots[i] = slots[i - 1];
+			hits[i] = hits[i - 1];
+		}
+		slots[i] = slot;
+		hits[i] = slot_hits;
+	}
+
+	for (size_t i = 0; i < num; i++) {
+		struct esp_flash_breakpoint *flash_bp = &flash_bps[slots[i]];
+		if (esp_common_hw_breakpoint_place(target, flash_bp->bp_address) != ERROR_OK)
+			break;
+		LOG_TARGET_DEBUG(target, "Flash BP @ " TARGET_ADDR_FMT " (%" PRIu32 " hits) placed in HW",
+			flash_bp->bp_address, hits[i]);
+		memset(flash_bp, 0, sizeof(*flash_bp));
+		esp->flash_brps_usage.bps_to_hw++;
+	}
+}
+
+static bool esp_common_flash_breakpoint_before(const struct esp_flash_breakpoint *a,
+	const struct esp_flash_breakpoint *b)
+{
+	if (a->bank != b->bank)
+		return (uintptr_t)a->bank < (uintptr_t)b->bank;
+	return a->bp_flash_addr < b->bp_flash_addr;
+}
+
+/* Sets or clears all pending flash breakpoints with the given action in one stub run per flash bank.
+ * The stub gets them in flash order, so the ones sharing a sector are handled one after another. */
+static int esp_common_flash_breakpoints_flush(struct target *target, enum esp_flash_bp_action action)
+{
+	struct esp_common *esp = target_to_esp_common(target);
+	struct esp_flash_breakpoint *flash_bps = esp->flash_brps.brps;
+	struct esp_flash_breakpoint batch[ESP_FLASH_BREAKPOINTS_MAX_NUM];
+	size_t slots[ESP_FLASH_BREAKPOINTS_MAX_NUM];
+	size_t num = 0;
+
+	for (size_t slot = 0; slot < ESP_FLASH_BREAKPOINTS_MAX_NUM; slot++) {
+		if (flash_bps[slot].action != action || flash_bps[slot].status != ESP_BP_STAT_PEND)
+			continue;
+		size_t i = num++;
+		for (; i > 0 && esp_common_flash_breakpoint_before(&flash_bps[slot], &batch[i - 1]); i--) {
+			batch[i] = batch[i - 1];
+			slots[i] = slots[i - 1];
+		}
+		batch[i] = flash_bps[slot];
+		slots[i] = slot;
+	}
+
+	for (size_t first = 0, last; first < num; first = last) {
+		for (last = first + 1; last < num && batch[last].bank == batch[first].bank; last++)
+			;
+		int ret;
+		if (action == ESP_BP_ACT_ADD)
+			ret = esp->flash_brps.ops->breakpoint_add(target, &batch[first], last - first);
+		else
+			ret = esp->flash_brps.ops->breakpoint_remove(target, &batch[first], last - first);
+		esp->flash_brps_usage.stub_runs++;
+		if (ret != ERROR_OK) {
+			LOG_TARGET_ERROR(target, "Breakpoints couldn't be processed");
+			return ret;
+		}
+		if (action == ESP_BP_ACT_ADD)
+			esp->flash_brps_usage.bps_written += last - first;
+		else
+			esp->flash_brps_usage.bps_restored += last - first;
+		for (size_t i = first; i < last; i++)
+			flash_bps[slots[i]] = batch[i];
+	}
+	return ERROR_OK;
+}
+
 int esp_common_flash_breakpoint_add(struct target *target, struct esp_common *esp, struct breakpoint *breakpoint)
 {
 	size_t slot;
@@ -224,8 +459,10 @@ int esp_common_flash_breakpoint_add(struct target *target, struct esp_common *es
 		/* Do not check ocd_bp here since it could be freed before we complete the lazy process */
 		if (flash_bps->brps[slot].bp_address == breakpoint->address) {
 			if (flash_bps->brps[slot].action == ESP_BP_ACT_REM && flash_bps->brps[slot].status == ESP_BP_STAT_PEND) {
+				flash_bps->brps[slot].oocd_bp = breakpoint;
 				flash_bps->brps[slot].action = ESP_BP_ACT_ADD;
 				flash_bps->brps[slot].status = ESP_BP_STAT_DONE;
+				esp->flash_brps_usage.bps_reused++;
 				esp_common_dump_bp_slot("BP-ADD(fake)", flash_bps, slot);
 				return ERROR_OK;
 			}
@@ -253,7 +490,11 @@ int esp_common_flash_breakpoint_add(struct target *target, struct esp_common *es
 		return ERROR_OK;
 	}
 
-	return flash_bps->ops->breakpoint_add(target, &flash_bps->brps[slot], 1);
+	esp->flash_brps_usage.stub_runs++;
+	ret = flash_bps->ops->breakpoint_add(target, &flash_bps->brps[slot], 1);
+	if (ret == ERROR_OK)
+		esp->flash_brps_usage.bps_written++;
+	return ret;
 }
 
 int esp_common_flash_breakpoint_remove(struct target *target, struct esp_common *esp, struct breakpoint *breakpoint)
@@ -261,6 +502,16 @@ int esp_common_flash_breakpoint_remove(struct target *target, struct esp_common
 	struct esp_flash_breakpoint *flash_bps = esp->flash_brps.brps;
 	size_t slot;
 
+	/* Breakpoint removed before it has been written to flash, just forget it */
+	for (slot = 0; slot < ESP_FLASH_BREAKPOINTS_MAX_NUM; slot++) {
+		if (flash_bps[slot].action == ESP_BP_ACT_ADD && flash_bps[slot].status == ESP_BP_STAT_PEND &&
+			flash_bps[slot].bp_address == breakpoint->address) {
+			esp_common_dump_bp_slot("BP-REMOVE(pending)", &esp->flash_brps, slot);
+			memset(&flash_bps[slot], 0, sizeof(flash_bps[slot]));
+			return ERROR_OK;
+		}
+	}
+
 	for (slot = 0; slot < ESP_FLASH_BREAKPOINTS_MAX_NUM; slot++) {
 		if (flash_bps[slot].action == ESP_BP_ACT_ADD && flash_bps[slot].status == ESP_BP_STAT_DONE &&
 			flash_bps[slot].bp_address == breakpoint->address)
@@ -284,26 +535,28 @@ int esp_common_flash_breakpoint_remove(struct target *target, struct esp_common
 		return ERROR_OK;
 	}
 
-	return esp->flash_brps.ops->breakpoint_remove(target, &esp->flash_brps.brps[slot], 1);
+	esp->flash_brps_usage.stub_runs++;
+	int ret = esp->flash_brps.ops->breakpoint_remove(target, &esp->flash_brps.brps[slot], 1);
+	if (ret == ERROR_OK)
+		esp->flash_brps_usage.bps_restored++;
+	return ret;
 }
 
 int esp_common_process_lazy_flash_breakpoints(struct target *target)
 {
 	struct esp_common *esp = target_to_esp_common(target);
 	struct esp_flash_breakpoint *flash_bps = esp->flash_brps.brps;
-	int ret;
 
 	for (size_t i = 0; i < ESP_FLASH_BREAKPOINTS_MAX_NUM; ++i)
 		esp_common_dump_bp_slot("BP-PROCESS", &esp->flash_brps, i);
 
+	esp_common_flash_breakpoints_to_hw(target);
+
 	size_t add_num_bps = 0;
 	size_t remove_num_bps = 0;
-	size_t first_pending_off = ESP_FLASH_BREAKPOINTS_MAX_NUM;
 	for (size_t i = 0; i < ESP_FLASH_BREAKPOINTS_MAX_NUM; ++i) {
 		if (flash_bps[i].status != ESP_BP_STAT_PEND)
 			continue;
-		if (first_pending_off == ESP_FLASH_BREAKPOINTS_MAX_NUM)
-			first_pending_off = i;
 		flash_bps[i].action == ESP_BP_ACT_ADD ?  ++add_num_bps : ++remove_num_bps;
 	}
 
@@ -312,38 +565,14 @@ int esp_common_process_lazy_flash_breakpoints(struct target *target)
 		return ERROR_OK;
 	}
 
-	LOG_TARGET_DEBUG(target, "BP num in the cache: add(%zu) + rem(%zu) from off(%zu)",
-		add_num_bps, remove_num_bps, first_pending_off);
-
-	/* If both possible pending states in the cache, add them one by one in the order they were added */
-	if (add_num_bps && remove_num_bps) {
-		for (size_t slot = 0; slot < ESP_FLASH_BREAKPOINTS_MAX_NUM; ++slot) {
-			if (flash_bps[slot].status == ESP_BP_STAT_PEND) {
-				if (flash_bps[slot].action == ESP_BP_ACT_ADD)
-					ret = esp->flash_brps.ops->breakpoint_add(target, &flash_bps[slot], 1);
-				else
-					ret = esp->flash_brps.ops->breakpoint_remove(target, &flash_bps[slot], 1);
-				if (ret != ERROR_OK) {
-					LOG_TARGET_ERROR(target, "Breakpoints couldn't be processed at slot (%zu)", slot);
-					return ret;
-				}
-			}
-		}
-
-		return ERROR_OK;
-	}
-
-	/* If all bps have same add or remove pending state, add all in one shot from the first pending index */
-	flash_bps = &esp->flash_brps.brps[first_pending_off];
-	if (add_num_bps)
-		ret = esp->flash_brps.ops->breakpoint_add(target, flash_bps, add_num_bps);
-	else
-		ret = esp->flash_brps.ops->breakpoint_remove(target, flash_bps, remove_num_bps);
+	LOG_TARGET_DEBUG(target, "BP num in the cache: add(%zu) + rem(%zu)", add_num_bps, remove_num_bps);
 
+	/* Pending add and remove never refer to the same address, so their order does not matter */
+	int ret = esp_common_flash_breakpoints_flush(target, ESP_BP_ACT_REM);
 	if (ret != ERROR_OK)
-		LOG_TARGET_ERROR(target, "Breakpoints couldn't be processed");
+		return ret;
 
-	return ret;
+	return esp_common_flash_breakpoints_flush(target, ESP_BP_ACT_ADD);
 }
 
 int esp_common_halt_target(struct target *target, enum target_state *old_state)
@@ -563,13 +792,350 @@ int esp_common_disable_lazy_breakpoints_command(struct command_invocation *cmd)
 	return ret;
 }
 
+static int esp_common_profiling_prepare(struct target **cores, unsigned int num_cores,
+	const struct esp_profiling_ops *ops, bool start)
+{
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < num_cores; i++) {
+		int res = ops->prepare(cores[i], start);
+		if (res == ERROR_OK)
+			continue;
+		if (start) {
+			/* roll back the cores prepared so far */
+			while (i--)
+				ops->prepare(cores[i], false);
+			return res;
+		}
+		LOG_TARGET_ERROR(cores[i], "Failed to restore core after profiling!");
+		retval = res;
+	}
+	return retval;
+}
+
+/* Statistical profiler built on the chip specific PC sampler. Unlike target_profiling_default()
+ * it does not go through target_halt()/target_poll()/target_resume(), so no register cache
+ * refresh and no event processing happens per sample. */
+int esp_common_profiling(struct target *target, uint32_t *samples,
+	uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds,
+	const struct esp_profiling_ops *ops)
+{
+	struct esp_common *esp = target_to_esp_common(target);
+	struct target **cores;
+	unsigned int num_cores = 0;
+	struct target_list *head;
+
+	cores = calloc(target->smp ? list_count_nodes(target->smp_targets) : 1, sizeof(*cores));
+	if (!cores) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	/* Halt/resume cross-triggering is disabled on all cores, even if only one is sampled */
+	if (target->smp) {
+		foreach_smp_target(head, target->smp_targets) {
+			if (target_was_examined(head->target))
+				cores[num_cores++] = head->target;
+		}
+	} else {
+		cores[num_cores++] = target;
+	}
+
+	/* Make sure the target is running */
+	target_poll(target);
+	int retval = ERROR_OK;
+	if (target->state == TARGET_HALTED)
+		retval = target_resume(target, 1, 0, 0, 0);
+	if (retval != ERROR_OK) {
+		LOG_TARGET_ERROR(target, "Error while resuming target");
+		free(cores);
+		return retval;
+	}
+
+	retval = esp_common_profiling_prepare(cores, num_cores, ops, true);
+	if (retval != ERROR_OK) {
+		free(cores);
+		if (retval == ERROR_NOT_IMPLEMENTED) {
+			LOG_TARGET_INFO(target, "Fast PC sampling is not supported, fallback to stop-and-go");
+			return target_profiling_default(target, samples, max_num_samples, num_samples, seconds);
+		}
+		return retval;
+	}
+
+	unsigned int first = 0, num_sampled = num_cores;
+	if (!esp->profiling.all_cores) {
+		for (unsigned int i = 0; i < num_cores; i++) {
+			if (cores[i] == target)
+				first = i;
+		}
+		num_sampled = 1;
+	}
+
+	if (esp->profiling.rate_hz)
+		LOG_TARGET_INFO(target, "Starting PC sampling profiling at %" PRIu32 " Hz on %u core(s)...",
+			esp->profiling.rate_hz, num_sampled);
+	else
+		LOG_TARGET_INFO(target, "Starting PC sampling profiling on %u core(s). Sampling as fast as we can...",
+			num_sampled);
+
+	struct timeval timeout, now, next;
+	gettimeofday(&now, NULL);
+	timeout = now;
+	next = now;
+	timeval_add_time(&timeout, seconds, 0);
+
+	uint32_t sample_count = 0, missed = 0;
+	unsigned int idx = 0;
+	for (;;) {
+		struct target *curr = cores[first + idx];
+		uint32_t pc;
+		int res = ops->sample_pc(curr, &pc);
+		if (res == ERROR_OK) {
+			samples[sample_count++] = pc;
+		} else if (res == ERROR_WAIT) {
+			missed++;
+		} else if (res == ERROR_NOT_IMPLEMENTED && sample_count == 0) {
+			/* found out on the first access only */
+			retval = res;
+			break;
+		} else if (res == ERROR_TARGET_NOT_RUNNING) {
+			LOG_TARGET_INFO(curr, "Target stopped, profiling aborted");
+			break;
+		} else {
+			LOG_TARGET_ERROR(curr, "PC sampling failed (%d)!", res);
+			retval = res;
+			break;
+		}
+
+		gettimeofday(&now, NULL);
+		if (sample_count >= max_num_samples || timeval_compare(&now, &timeout) >= 0)
+			break;
+
+		idx = (idx + 1) % num_sampled;
+		if (idx != 0)
+			continue;
+
+		keep_alive();
+		if (esp->profiling.rate_hz) {
+			struct timeval wait;
+			timeval_add_time(&next, 0, 1000000 / esp->profiling.rate_hz);
+			/* timeval_subtract() returns 1 when the result is negative, i.e. we are late */
+			if (timeval_subtract(&wait, &next, &now) == 0)
+				usleep(wait.tv_sec * 1000000 + wait.tv_usec);
+			else
+				next = now;
+		}
+	}
+
+	int res = esp_common_profiling_prepare(cores, num_cores, ops, false);
+	if (retval == ERROR_OK)
+		retval = res;
+	free(cores);
+
+	if (retval == ERROR_NOT_IMPLEMENTED) {
+		LOG_TARGET_INFO(target, "Fast PC sampling is not supported, fallback to stop-and-go");
+		return target_profiling_default(target, samples, max_num_samples, num_samples, seconds);
+	}
+
+	LOG_TARGET_INFO(target, "Profiling completed. %" PRIu32 " samples, %" PRIu32 " missed.",
+		sample_count, missed);
+	*num_samples = sample_count;
+	return retval;
+}
+
+static void esp_common_profiling_config_set(struct target *target, const struct esp_profiling_config *config)
+{
+	if (target->smp) {
+		struct target_list *head;
+		foreach_smp_target(head, target->smp_targets)
+			target_to_esp_common(head->target)->profiling = *config;
+		return;
+	}
+	target_to_esp_common(target)->profiling = *config;
+}
+
+int esp_common_profile_rate_command(struct command_invocation *cmd)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	struct esp_profiling_config config = target_to_esp_common(target)->profiling;
+
+	if (CMD_ARGC == 1) {
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], config.rate_hz);
+		esp_common_profiling_config_set(target, &config);
+	}
+	command_print(CMD, "%" PRIu32, config.rate_hz);
+	return ERROR_OK;
+}
+
+int esp_common_profile_all_cores_command(struct command_invocation *cmd)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	struct esp_profiling_config config = target_to_esp_common(target)->profiling;
+
+	if (CMD_ARGC == 1) {
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], config.all_cores);
+		esp_common_profiling_config_set(target, &config);
+	}
+	command_print(CMD, "%s", config.all_cores ? "on" : "off");
+	return ERROR_OK;
+}
+
+/* polls are never chained for longer than this, to keep GDB and other clients responsive */
+#define ESP_SEMIHOST_FAST_POLL_MAX_MS	100
+
+void esp_common_semihosting_fast_poll(struct target *target)
+{
+	struct esp_semihost_fast_poll *fast = &target_to_esp_common(target)->semihost_fast_poll;
+
+	/* nested calls come from the polls below */
+	if (fast->window_us == 0 || fast->active || !target->semihosting)
+		return;
+
+	fast->active = true;
+	uint64_t requests = target->semihosting->requests;
+	struct duration total, window;
+	duration_start(&total);
+	duration_start(&window);
+	while (target->state == TARGET_RUNNING) {
+		if (target_poll(target) != ERROR_OK)
+			break;
+		fast->polls++;
+		/* a serviced call opens a new window, so bursts of calls are serviced at full speed */
+		if (target->semihosting->requests != requests) {
+			fast->calls += target->semihosting->requests - requests;
+			requests = target->semihosting->requests;
+			duration_start(&window);
+			continue;
+		}
+		duration_measure(&window);
+		duration_measure(&total);
+		if (duration_elapsed(&window) * 1000000 >= fast->window_us ||
+			duration_elapsed(&total) * 1000 >= ESP_SEMIHOST_FAST_POLL_MAX_MS)
+			break;
+	}
+	duration_measure(&total);
+	fast->busy_time += duration_elapsed(&total);
+	fast->active = false;
+}
+
+static void esp_common_semihost_fast_poll_set(struct target *target, uint32_t window_us)
+{
+	if (target->smp) {
+		struct target_list *head;
+		foreach_smp_target(head, target->smp_targets)
+			target_to_esp_common(head->target)->semihost_fast_poll.window_us = window_us;
+		return;
+	}
+	target_to_esp_common(target)->semihost_fast_poll.window_us = window_us;
+}
+
+int esp_common_semihost_fast_poll_command(struct command_invocation *cmd)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	struct esp_semihost_fast_poll *fast = &target_to_esp_common(target)->semihost_fast_poll;
+
+	if (CMD_ARGC == 1) {
+		if (!strcmp(CMD_ARGV[0], "stats")) {
+			command_print(CMD, "%" PRIu64 " calls serviced by fast polling, %" PRIu64 " polls, %.3f s",
+				fast->calls, fast->polls, fast->busy_time);
+			if (fast->busy_time > 0)
+				command_print(CMD, "%.0f calls/s while fast polling", fast->calls / fast->busy_time);
+			return ERROR_OK;
+		}
+		uint32_t window_us;
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], window_us);
+		esp_common_semihost_fast_poll_set(target, window_us);
+	}
+	command_print(CMD, "%" PRIu32, fast->window_us);
+	return ERROR_OK;
+}
+
+static void esp_common_flash_bp_stats_collect(struct target *target,
+	struct esp_flash_breakpoints_usage *total, bool reset)
+{
+	struct esp_flash_breakpoints_usage *usage = &target_to_esp_common(target)->flash_brps_usage;
+
+	if (reset) {
+		memset(usage, 0, sizeof(*usage));
+		return;
+	}
+	total->stub_runs += usage->stub_runs;
+	total->bps_written += usage->bps_written;
+	total->bps_restored += usage->bps_restored;
+	total->bps_reused += usage->bps_reused;
+	total->bps_to_hw += usage->bps_to_hw;
+}
+
+int esp_common_flash_bp_stats_command(struct command_invocation *cmd)
+{
+	if (CMD_ARGC > 1 || (CMD_ARGC == 1 && strcmp(CMD_ARGV[0], "reset")))
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	struct esp_flash_breakpoints_usage total = { 0 };
+	bool reset = CMD_ARGC == 1;
+
+	if (target->smp) {
+		struct target_list *head;
+		foreach_smp_target(head, target->smp_targets)
+			esp_common_flash_bp_stats_collect(head->target, &total, reset);
+	} else {
+		esp_common_flash_bp_stats_collect(target, &total, reset);
+	}
+	if (reset)
+		return ERROR_OK;
+
+	command_print(CMD, "%" PRIu64 " flash breakpoints set, %" PRIu64 " cleared in %" PRIu64 " stub runs",
+		total.bps_written, total.bps_restored, total.stub_runs);
+	command_print(CMD, "%" PRIu64 " re-inserted without flash write, %" PRIu64 " placed in HW comparators instead",
+		total.bps_reused, total.bps_to_hw);
+
+	const struct esp_flash_breakpoints_usage *usage = &esp_common_flash_bp_hot_owner(target)->flash_brps_usage;
+	for (size_t i = 0; i < ESP_FLASH_BREAKPOINTS_HOT_NUM; i++) {
+		if (usage->hot[i].hits)
+			command_print(CMD, TARGET_ADDR_FMT " hit %" PRIu32 " times",
+				usage->hot[i].address, usage->hot[i].hits);
+	}
+	return ERROR_OK;
+}
+
+/* Target code is going to run and can overwrite resident flasher stub */
+static void esp_common_algo_session_close(struct target *target)
+{
+	if (target->smp) {
+		struct target_list *head;
+		foreach_smp_target(head, target->smp_targets) {
+			struct target *curr = head->target;
+			esp_algorithm_session_close(curr, &target_to_esp_common(curr)->algo_session);
+		}
+		return;
+	}
+	esp_algorithm_session_close(target, &target_to_esp_common(target)->algo_session);
+}
+
 static int esp_callback_event_handler(struct target *target, enum target_event event, void *priv)
 {
+	int ret;
+
 	switch (event) {
 		case TARGET_EVENT_STEP_START:
 		case TARGET_EVENT_RESUME_START:
+			ret = esp_common_process_flash_breakpoints_handler(target);
+			esp_common_algo_session_close(target);
+			return ret;
 		case TARGET_EVENT_QXFER_THREAD_READ_END:
 			return esp_common_process_flash_breakpoints_handler(target);
+		case TARGET_EVENT_HALTED:
+			esp_common_flash_breakpoint_hit(target);
+			break;
 		case TARGET_EVENT_GDB_DETACH:
 			return esp_common_gdb_detach_handler(target);
 #if IS_ESPIDF
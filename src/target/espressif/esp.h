@@ -122,12 +122,73 @@ struct esp_flash_breakpoints {
 	struct esp_flash_breakpoint *brps;
 };
 
+#define ESP_FLASH_BREAKPOINTS_HOT_NUM	32
+
+/**
+ * Flash breakpoint usage. Hit counts decide which pending flash breakpoints are given
+ * HW comparators that got free, the rest tells how much flash rewriting was done or avoided.
+ */
+struct esp_flash_breakpoints_usage {
+	struct {
+		target_addr_t address;
+		uint32_t hits;
+	} hot[ESP_FLASH_BREAKPOINTS_HOT_NUM];
+	/** Flasher stub runs done to set or clear breakpoints */
+	uint64_t stub_runs;
+	uint64_t bps_written;
+	uint64_t bps_restored;
+	/** Re-inserted breakpoints still present in flash, which needed no flash write */
+	uint64_t bps_reused;
+	/** Pending flash breakpoints placed in HW comparators instead */
+	uint64_t bps_to_hw;
+};
+
+/**
+ * Fast PC sampling operations used by esp_common_profiling().
+ */
+struct esp_profiling_ops {
+	/** Prepares the core for sampling (start = true) or restores it afterwards */
+	int (*prepare)(struct target *target, bool start);
+	/** Samples PC of the running core. Returns ERROR_WAIT if no sample could be taken this time
+	 * and ERROR_TARGET_NOT_RUNNING if the core has stopped on its own. */
+	int (*sample_pc)(struct target *target, uint32_t *pc);
+};
+
+struct esp_profiling_config {
+	/** Samples per second per core, 0 - as fast as possible */
+	uint32_t rate_hz;
+	/** Sample all SMP cores in turn instead of the current one only */
+	bool all_cores;
+};
+
+/**
+ * Fast semihosting service. After the target is resumed from a semihosting call it is polled
+ * back-to-back for a short time instead of waiting for the next polling period, so that
+ * consecutive calls are serviced with low latency.
+ */
+struct esp_semihost_fast_poll {
+	/** Time to keep polling after the last serviced call, 0 disables fast polling */
+	uint32_t window_us;
+	bool active;
+	/* statistics */
+	uint64_t calls;
+	uint64_t polls;
+	float busy_time;
+};
+
 struct esp_common {
 	struct esp_flash_breakpoints flash_brps;
 	const struct esp_algorithm_hw *algo_hw;
 	struct esp_dbg_stubs dbg_stubs;
 	struct esp_panic_reason panic_reason;
 	bool breakpoint_lazy_process;
+	struct esp_algorithm_session algo_session;
+	struct esp_profiling_config profiling;
+	struct esp_semihost_fast_poll semihost_fast_poll;
+	struct esp_flash_breakpoints_usage flash_brps_usage;
+	/* arch specific HW breakpoint handling, optional */
+	int (*hw_breakpoint_add)(struct target *target, struct breakpoint *breakpoint);
+	int (*hw_breakpoint_remove)(struct target *target, struct breakpoint *breakpoint);
 };
 
 struct esp_ops {
@@ -149,10 +210,20 @@ int esp_common_flash_breakpoint_remove(struct target *target,
 	struct breakpoint *breakpoint);
 bool esp_common_flash_breakpoint_exists(struct esp_common *esp,
 	struct breakpoint *breakpoint);
+bool esp_common_flash_breakpoint_reuse(struct target *target,
+	struct breakpoint *breakpoint);
 int esp_common_handle_gdb_detach(struct target *target);
 int esp_common_process_flash_breakpoints_command(struct command_invocation *cmd);
 int esp_common_disable_lazy_breakpoints_command(struct command_invocation *cmd);
 int esp_dbgstubs_table_read(struct target *target, struct esp_dbg_stubs *dbg_stubs);
+int esp_common_profiling(struct target *target, uint32_t *samples,
+	uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds,
+	const struct esp_profiling_ops *ops);
+int esp_common_profile_rate_command(struct command_invocation *cmd);
+int esp_common_profile_all_cores_command(struct command_invocation *cmd);
+void esp_common_semihosting_fast_poll(struct target *target);
+int esp_common_semihost_fast_poll_command(struct command_invocation *cmd);
+int esp_common_flash_bp_stats_command(struct command_invocation *cmd);
 
 void esp_common_assist_debug_monitor_disable(struct target *target, uint32_t address, uint32_t *value);
 void esp_common_assist_debug_monitor_restore(struct target *target, uint32_t address, uint32_t value);
@@ -37,6 +37,7 @@
 #include "esp32_apptrace.h"
 #include "esp32_sysview.h"
 #include "segger_sysview.h"
+#include "esp_gcda.h"
 
 #define ESP32_APPTRACE_USER_BLOCK_CORE(_v_)     ((_v_) >> 15)
 #define ESP32_APPTRACE_USER_BLOCK_LEN(_v_)      ((_v_) & ~BIT(15))
@@ -59,6 +60,7 @@
 #define ESP_APPTRACE_FILE_CMD_FTELL             0x5
 #define ESP_APPTRACE_FILE_CMD_STOP              0x6	/* indicates that there is no files to transfer */
 #define ESP_APPTRACE_FILE_CMD_FEOF              0x7
+#define ESP_APPTRACE_FILE_CMD_BATCH             0x8	/* several commands in one block, see esp_gcov_process_data() */
 
 #define ESP_GCOV_FILES_MAX_NUM                  512
 
@@ -89,8 +91,27 @@ struct esp32_apptrace_block {
 	uint32_t data_len;
 };
 
+enum esp_gcov_mode {
+	ESP_GCOV_MODE_FILE,	/* every file operation is done on the host file */
+	ESP_GCOV_MODE_MEM,	/* files are kept in memory and written at the end */
+	ESP_GCOV_MODE_MERGE,	/* as MEM, but counters of existing files are merged on host */
+};
+
+struct esp_gcov_mem_file {
+	char *name;
+	uint8_t *data;
+	size_t size;
+	size_t alloc;
+	size_t pos;
+	bool eof;
+	bool open;
+	bool written;
+};
+
 struct esp32_gcov_cmd_data {
 	FILE * files[ESP_GCOV_FILES_MAX_NUM];
+	struct esp_gcov_mem_file *mem_files[ESP_GCOV_FILES_MAX_NUM];
+	enum esp_gcov_mode mode;
 	uint32_t files_num;
 	bool wait4halt;
 	int prefix_strip;
@@ -114,6 +135,7 @@ static int esp32_sysview_start(struct esp32_apptrace_cmd_ctx *ctx);
 static int esp32_sysview_stop(struct esp32_apptrace_cmd_ctx *ctx);
 
 static const bool s_time_stats_enable = true;
+static enum esp_gcov_mode s_gcov_mode = ESP_GCOV_MODE_MEM;
 
 /*********************************************************************
 *                       Trace destination API
@@ -1639,6 +1661,41 @@ COMMAND_HANDLER(esp32_cmd_sysview_mcore)
 	return esp32_cmd_apptrace_generic(CMD, ESP_APPTRACE_CMD_MODE_SYSVIEW_MCORE, CMD_ARGV, CMD_ARGC);
 }
 
+COMMAND_HANDLER(esp32_cmd_sysview_timeline)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		int res = esp32_sysview_timeline_set(strcmp(CMD_ARGV[0], "none") ? CMD_ARGV[0] : NULL);
+		if (res != ERROR_OK)
+			return res;
+	}
+	const char *path = esp32_sysview_timeline_get();
+	command_print(CMD, "%s", path ? path : "none");
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(esp32_cmd_sysview_stats)
+{
+	if (CMD_ARGC == 1 && !strcmp(CMD_ARGV[0], "reset")) {
+		esp32_sysview_stats_reset();
+		return ERROR_OK;
+	}
+	if (CMD_ARGC == 2 && !strcmp(CMD_ARGV[0], "window")) {
+		uint32_t window_ms;
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], window_ms);
+		if (!window_ms || window_ms > UINT32_MAX / 1000)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		esp32_sysview_window_set(window_ms);
+		return ERROR_OK;
+	}
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	return esp32_sysview_stats_print(CMD);
+}
+
 static int esp_gcov_cmd_init(struct esp32_apptrace_cmd_ctx *cmd_ctx,
 	struct command_invocation *cmd,
 	char *prefix,
@@ -1658,6 +1715,7 @@ static int esp_gcov_cmd_init(struct esp32_apptrace_cmd_ctx *cmd_ctx,
 
 	cmd_data->prefix = prefix;
 	cmd_data->prefix_strip = prefix_strip;
+	cmd_data->mode = s_gcov_mode;
 
 	cmd_ctx->stop_tmo = 3.0;
 	cmd_ctx->cmd_priv = cmd_data;
@@ -1667,17 +1725,113 @@ static int esp_gcov_cmd_init(struct esp32_apptrace_cmd_ctx *cmd_ctx,
 	return ERROR_OK;
 }
 
+/* Reads the whole host file, returns ERROR_OK with NULL data if it does not exist */
+static int esp_gcov_file_load(const char *fname, uint8_t **data, size_t *size)
+{
+	*data = NULL;
+	*size = 0;
+
+	FILE *f = fopen(fname, "rb");
+	if (!f) {
+		if (errno == ENOENT) {
+			errno = 0;
+			return ERROR_OK;
+		}
+		return ERROR_FAIL;
+	}
+	long fsize = -1;
+	if (fseek(f, 0, SEEK_END) == 0)
+		fsize = ftell(f);
+	if (fsize < 0 || fseek(f, 0, SEEK_SET)) {
+		fclose(f);
+		return ERROR_FAIL;
+	}
+	/* allocate at least one byte to tell an empty file from a missing one */
+	*data = malloc(fsize ? fsize : 1);
+	if (!*data || fread(*data, 1, fsize, f) != (size_t)fsize) {
+		free(*data);
+		*data = NULL;
+		fclose(f);
+		return ERROR_FAIL;
+	}
+	*size = fsize;
+	fclose(f);
+	return ERROR_OK;
+}
+
+static void esp_gcov_mem_file_free(struct esp_gcov_mem_file *file)
+{
+	if (!file)
+		return;
+	free(file->name);
+	free(file->data);
+	free(file);
+}
+
+static int esp_gcov_mem_file_write_out(struct esp32_gcov_cmd_data *cmd_data, struct esp_gcov_mem_file *file)
+{
+	uint8_t *data = file->data;
+	size_t size = file->size;
+	uint8_t *merged = NULL;
+
+	if (cmd_data->mode == ESP_GCOV_MODE_MERGE) {
+		uint8_t *old;
+		size_t old_size;
+		if (esp_gcov_file_load(file->name, &old, &old_size) != ERROR_OK) {
+			LOG_ERROR("Failed to read '%s' (%d)!", file->name, errno);
+			return ERROR_FAIL;
+		}
+		if (old && old_size) {
+			size_t merged_size;
+			if (esp_gcda_merge(data, size, old, old_size, &merged, &merged_size) == ERROR_OK) {
+				data = merged;
+				size = merged_size;
+			} else {
+				LOG_WARNING("Failed to merge '%s' with the existing file, overwriting it!", file->name);
+			}
+		}
+		free(old);
+	}
+
+	int res = ERROR_OK;
+	FILE *f = fopen(file->name, "wb");
+	if (!f || (size && fwrite(data, size, 1, f) != 1)) {
+		LOG_ERROR("Failed to write '%s' (%d)!", file->name, errno);
+		res = ERROR_FAIL;
+	}
+	if (f && fclose(f)) {
+		LOG_ERROR("Failed to close '%s' (%d)!", file->name, errno);
+		res = ERROR_FAIL;
+	}
+	free(merged);
+	return res;
+}
+
 static int esp_gcov_cmd_cleanup(struct esp32_apptrace_cmd_ctx *cmd_ctx)
 {
 	struct esp32_gcov_cmd_data *cmd_data = cmd_ctx->cmd_priv;
 	int res = ERROR_OK;
+	unsigned int written = 0;
+	size_t written_bytes = 0;
 
 	for (unsigned int i = 0; i < ESP_GCOV_FILES_MAX_NUM; i++) {
 		if (cmd_data->files[i] && fclose(cmd_data->files[i])) {
 			LOG_ERROR("Failed to close file 0x%p (%d)!", cmd_data->files[i], errno);
 			res = ERROR_FAIL;
 		}
+		struct esp_gcov_mem_file *file = cmd_data->mem_files[i];
+		if (file && file->written) {
+			if (esp_gcov_mem_file_write_out(cmd_data, file) != ERROR_OK) {
+				res = ERROR_FAIL;
+			} else {
+				written++;
+				written_bytes += file->size;
+			}
+		}
+		esp_gcov_mem_file_free(file);
 	}
+	if (written)
+		LOG_INFO("Wrote %u gcov files (%zu bytes)", written, written_bytes);
 	free(cmd_data->prefix);
 	free(cmd_data);
 	cmd_ctx->cmd_priv = NULL;
@@ -1760,6 +1914,52 @@ static char *esp_gcov_filename_alloc(struct esp32_gcov_cmd_data *cmd_data, const
 	return filename;
 }
 
+static bool esp_gcov_file_is_open(struct esp32_gcov_cmd_data *cmd_data, uint32_t fd)
+{
+	if (cmd_data->mode == ESP_GCOV_MODE_FILE)
+		return cmd_data->files[fd];
+	return cmd_data->mem_files[fd] && cmd_data->mem_files[fd]->open;
+}
+
+/* Opens in-memory file with stdio semantics of 'mode', sets errno on failure */
+static bool esp_gcov_mem_fopen(struct esp32_gcov_cmd_data *cmd_data, uint32_t fd, char *fname, const char *mode)
+{
+	struct esp_gcov_mem_file *file = calloc(1, sizeof(*file));
+	if (!file) {
+		errno = ENOMEM;
+		return false;
+	}
+
+	if (mode[0] == 'r' && cmd_data->mode == ESP_GCOV_MODE_MERGE) {
+		/* libgcov creates the file then and writes the counters of this run only,
+		 * which are merged with the existing file when it is written out */
+		free(file);
+		errno = ENOENT;
+		return false;
+	}
+	if (mode[0] != 'w') {
+		if (esp_gcov_file_load(fname, &file->data, &file->size) != ERROR_OK) {
+			free(file);
+			return false;
+		}
+		if (!file->data && mode[0] == 'r') {
+			free(file);
+			errno = ENOENT;
+			return false;
+		}
+		file->alloc = file->data ? MAX(file->size, 1) : 0;
+	}
+	if (mode[0] == 'a')
+		file->pos = file->size;
+	/* created or truncated file has to appear on host even if nothing is written */
+	file->written = mode[0] != 'r';
+	file->name = fname;
+	file->open = true;
+	esp_gcov_mem_file_free(cmd_data->mem_files[fd]);
+	cmd_data->mem_files[fd] = file;
+	return true;
+}
+
 static int esp_gcov_fopen(struct target *target,
 	struct esp32_gcov_cmd_data *cmd_data,
 	uint8_t *data,
@@ -1796,8 +1996,16 @@ static int esp_gcov_fopen(struct target *target,
 		return ERROR_FAIL;
 	}
 	LOG_INFO("Open file 0x%x '%s' mode '%s'", fd + 1, fname, mode);
-	cmd_data->files[fd] = fopen(fname, mode);
-	if (!cmd_data->files[fd]) {
+	bool opened;
+	if (cmd_data->mode == ESP_GCOV_MODE_FILE) {
+		cmd_data->files[fd] = fopen(fname, mode);
+		opened = cmd_data->files[fd];
+	} else {
+		opened = esp_gcov_mem_fopen(cmd_data, fd, fname, mode);
+		if (opened)
+			fname = NULL;	/* owned by the file now */
+	}
+	if (!opened) {
 		/* do not report error on reading non-existent file */
 		if (errno != ENOENT || !strchr(mode, 'r'))
 			LOG_ERROR("Failed to open file '%s', mode '%s' (%d)!", fname, mode, errno);
@@ -1810,8 +2018,13 @@ static int esp_gcov_fopen(struct target *target,
 	*resp = malloc(*resp_len);
 	if (!*resp) {
 		LOG_ERROR("Failed to alloc mem for resp!");
-		if (fd != 0)
-			fclose(cmd_data->files[fd - 1]);
+		if (fd != 0) {
+			if (cmd_data->files[fd - 1])
+				fclose(cmd_data->files[fd - 1]);
+			cmd_data->files[fd - 1] = NULL;
+			esp_gcov_mem_file_free(cmd_data->mem_files[fd - 1]);
+			cmd_data->mem_files[fd - 1] = NULL;
+		}
 		free(fname);
 		return ERROR_FAIL;
 	}
@@ -1844,16 +2057,22 @@ static int esp_gcov_fclose(struct target *target,
 		LOG_ERROR("Invalid file desc received 0x%x!", fd);
 		return ERROR_FAIL;
 	}
-	if (!cmd_data->files[fd]) {
+	if (!esp_gcov_file_is_open(cmd_data, fd)) {
 		LOG_ERROR("FCLOSE for not open file!");
 		return ERROR_FAIL;
 	}
 
-	int32_t fret = fclose(cmd_data->files[fd]);
-	if (fret)
-		LOG_ERROR("Failed to close file %d (%d)!", fd, errno);
-	else
-		cmd_data->files[fd] = NULL;
+	int32_t fret = 0;
+	if (cmd_data->mode == ESP_GCOV_MODE_FILE) {
+		fret = fclose(cmd_data->files[fd]);
+		if (fret)
+			LOG_ERROR("Failed to close file %d (%d)!", fd, errno);
+		else
+			cmd_data->files[fd] = NULL;
+	} else {
+		/* the contents are written out at the end */
+		cmd_data->mem_files[fd]->open = false;
+	}
 
 	*resp_len = sizeof(fret);
 	*resp = malloc(*resp_len);
@@ -1866,6 +2085,30 @@ static int esp_gcov_fclose(struct target *target,
 	return ERROR_OK;
 }
 
+/* Returns 1 on success like fwrite() with a single item */
+static uint32_t esp_gcov_mem_fwrite(struct esp_gcov_mem_file *file, const uint8_t *data, size_t size)
+{
+	if (file->pos + size > file->alloc) {
+		size_t alloc = MAX(file->alloc * 2, file->pos + size);
+		alloc = MAX(alloc, 4096);
+		uint8_t *buf = realloc(file->data, alloc);
+		if (!buf) {
+			errno = ENOMEM;
+			return 0;
+		}
+		file->data = buf;
+		file->alloc = alloc;
+	}
+	/* writing past the end leaves a hole of zeros, as on a file */
+	if (file->pos > file->size)
+		memset(file->data + file->size, 0, file->pos - file->size);
+	memcpy(file->data + file->pos, data, size);
+	file->pos += size;
+	file->size = MAX(file->size, file->pos);
+	file->written = true;
+	return 1;
+}
+
 static int esp_gcov_fwrite(struct target *target,
 	struct esp32_gcov_cmd_data *cmd_data,
 	uint8_t *data,
@@ -1884,12 +2127,16 @@ static int esp_gcov_fwrite(struct target *target,
 		LOG_ERROR("Invalid file desc received 0x%x!", fd);
 		return ERROR_FAIL;
 	}
-	if (!cmd_data->files[fd]) {
+	if (!esp_gcov_file_is_open(cmd_data, fd)) {
 		LOG_ERROR("FWRITE for not open file!");
 		return ERROR_FAIL;
 	}
 
-	uint32_t fret = fwrite(data + sizeof(fd), data_len - sizeof(fd), 1, cmd_data->files[fd]);
+	uint32_t fret;
+	if (cmd_data->mode == ESP_GCOV_MODE_FILE)
+		fret = fwrite(data + sizeof(fd), data_len - sizeof(fd), 1, cmd_data->files[fd]);
+	else
+		fret = esp_gcov_mem_fwrite(cmd_data->mem_files[fd], data + sizeof(fd), data_len - sizeof(fd));
 	if (fret != 1)
 		LOG_ERROR("Failed to write %ld byte (%d)!", (long)(data_len - sizeof(fd)), errno);
 
@@ -1924,18 +2171,22 @@ static int esp_gcov_fread(struct target *target,
 		LOG_ERROR("Invalid file desc received 0x%x!", fd);
 		return ERROR_FAIL;
 	}
-	if (!cmd_data->files[fd]) {
+	if (!esp_gcov_file_is_open(cmd_data, fd)) {
 		LOG_ERROR("FREAD for not open file!");
 		return ERROR_FAIL;
 	}
 
-	/* get the file size and leave the file in the original position */
-	long fpos = ftell(cmd_data->files[fd]);
-	fseek(cmd_data->files[fd], 0, SEEK_END);
-	long fsize = ftell(cmd_data->files[fd]);
-	fseek(cmd_data->files[fd], fpos, SEEK_SET);
-
 	uint32_t len = target_buffer_get_u32(target, data + sizeof(fd));
+	long fsize;
+	if (cmd_data->mode == ESP_GCOV_MODE_FILE) {
+		/* get the file size and leave the file in the original position */
+		long fpos = ftell(cmd_data->files[fd]);
+		fseek(cmd_data->files[fd], 0, SEEK_END);
+		fsize = ftell(cmd_data->files[fd]);
+		fseek(cmd_data->files[fd], fpos, SEEK_SET);
+	} else {
+		fsize = cmd_data->mem_files[fd]->size;
+	}
 
 	*resp_len = sizeof(fret) + len;
 	*resp = malloc(*resp_len);
@@ -1944,7 +2195,17 @@ static int esp_gcov_fread(struct target *target,
 		return ERROR_FAIL;
 	}
 
-	fret = fread(*resp + sizeof(fret), 1, len, cmd_data->files[fd]);
+	if (cmd_data->mode == ESP_GCOV_MODE_FILE) {
+		fret = fread(*resp + sizeof(fret), 1, len, cmd_data->files[fd]);
+	} else {
+		struct esp_gcov_mem_file *file = cmd_data->mem_files[fd];
+		fret = file->pos < file->size ? MIN(len, file->size - file->pos) : 0;
+		if (fret)
+			memcpy(*resp + sizeof(fret), file->data + file->pos, fret);
+		file->pos += fret;
+		if (fret < len)
+			file->eof = true;
+	}
 	/* GCC tries to read an empty file before writing to it. In that case don't show an error to the users */
 	if (fsize != 0 && fret == 0)
 		LOG_ERROR("Failed to read %d byte (%d) from fd 0x%x", len, errno, fd + 1);
@@ -1972,14 +2233,34 @@ static int esp_gcov_fseek(struct target *target,
 		LOG_ERROR("Invalid file desc received 0x%x!", fd);
 		return ERROR_FAIL;
 	}
-	if (!cmd_data->files[fd]) {
+	if (!esp_gcov_file_is_open(cmd_data, fd)) {
 		LOG_ERROR("FSEEK for not open file!");
 		return ERROR_FAIL;
 	}
 
 	int32_t off = target_buffer_get_u32(target, data + sizeof(fd));
 	int32_t whence = target_buffer_get_u32(target, data + sizeof(fd) + sizeof(off));
-	int32_t fret = fseek(cmd_data->files[fd], off, whence);
+	int32_t fret;
+	if (cmd_data->mode == ESP_GCOV_MODE_FILE) {
+		fret = fseek(cmd_data->files[fd], off, whence);
+	} else {
+		struct esp_gcov_mem_file *file = cmd_data->mem_files[fd];
+		int64_t pos = off;
+		if (whence == SEEK_CUR)
+			pos += file->pos;
+		else if (whence == SEEK_END)
+			pos += file->size;
+		else if (whence != SEEK_SET)
+			pos = -1;
+		if (pos < 0) {
+			errno = EINVAL;
+			fret = -1;
+		} else {
+			file->pos = pos;
+			file->eof = false;
+			fret = 0;
+		}
+	}
 	*resp_len = sizeof(fret);
 	*resp = malloc(*resp_len);
 	if (!*resp) {
@@ -2009,12 +2290,13 @@ static int esp_gcov_ftell(struct target *target,
 		LOG_ERROR("Invalid file desc received 0x%x!", fd);
 		return ERROR_FAIL;
 	}
-	if (!cmd_data->files[fd]) {
+	if (!esp_gcov_file_is_open(cmd_data, fd)) {
 		LOG_ERROR("FTELL for not open file!");
 		return ERROR_FAIL;
 	}
 
-	int32_t fret = ftell(cmd_data->files[fd]);
+	int32_t fret = cmd_data->mode == ESP_GCOV_MODE_FILE ? ftell(cmd_data->files[fd]) :
+		(int32_t)cmd_data->mem_files[fd]->pos;
 	*resp_len = sizeof(fret);
 	*resp = malloc(*resp_len);
 	if (!*resp) {
@@ -2044,12 +2326,13 @@ static int esp_gcov_feof(struct target *target,
 		LOG_ERROR("Invalid file desc received 0x%x!", fd);
 		return ERROR_FAIL;
 	}
-	if (!cmd_data->files[fd]) {
+	if (!esp_gcov_file_is_open(cmd_data, fd)) {
 		LOG_ERROR("FEOF for not open file!");
 		return ERROR_FAIL;
 	}
 
-	int32_t fret = feof(cmd_data->files[fd]);
+	int32_t fret = cmd_data->mode == ESP_GCOV_MODE_FILE ? feof(cmd_data->files[fd]) :
+		cmd_data->mem_files[fd]->eof;
 	*resp_len = sizeof(fret);
 	*resp = malloc(*resp_len);
 	if (!*resp) {
@@ -2061,55 +2344,145 @@ static int esp_gcov_feof(struct target *target,
 	return ERROR_OK;
 }
 
-/*TODO: support for multi-block data transfers */
-static int esp_gcov_process_data(struct esp32_apptrace_cmd_ctx *ctx,
+static int esp_gcov_exec_cmd(struct esp32_apptrace_cmd_ctx *ctx,
 	unsigned int core_id,
 	uint8_t *data,
-	uint32_t data_len)
+	uint32_t data_len,
+	uint8_t **resp,
+	uint32_t *resp_len);
+
+/* Executes the commands of a BATCH block: each one is preceded by its 16-bit length.
+ * Responses are concatenated in the same way, commands without response get a zero length. */
+static int esp_gcov_exec_batch(struct esp32_apptrace_cmd_ctx *ctx,
+	unsigned int core_id,
+	uint8_t *data,
+	uint32_t data_len,
+	uint8_t **resp,
+	uint32_t *resp_len)
 {
-	int ret = ERROR_OK;
-	struct esp32_gcov_cmd_data *cmd_data = ctx->cmd_priv;
-	uint8_t *resp;
-	uint32_t resp_len = 0;
+	struct target *target = ctx->cpus[core_id];
+	uint8_t *out = NULL;
+	uint32_t out_len = 0;
+	unsigned int cmds = 0;
+
+	while (data_len) {
+		if (data_len < sizeof(uint16_t)) {
+			LOG_ERROR("Truncated BATCH command header!");
+			free(out);
+			return ERROR_FAIL;
+		}
+		uint16_t len = target_buffer_get_u16(target, data);
+		data += sizeof(len);
+		data_len -= sizeof(len);
+		if (len == 0 || len > data_len) {
+			LOG_ERROR("Invalid BATCH command length %d!", len);
+			free(out);
+			return ERROR_FAIL;
+		}
+		uint8_t *cmd_resp = NULL;
+		uint32_t cmd_resp_len = 0;
+		int ret = esp_gcov_exec_cmd(ctx, core_id, data, len, &cmd_resp, &cmd_resp_len);
+		if (ret != ERROR_OK) {
+			free(out);
+			return ret;
+		}
+		if (cmd_resp_len > UINT16_MAX) {
+			/* does not fit the length field, the target would lose track of the responses */
+			LOG_ERROR("BATCH command response too long (%" PRIu32 " bytes)!", cmd_resp_len);
+			free(cmd_resp);
+			free(out);
+			return ERROR_FAIL;
+		}
+		uint8_t *new_out = realloc(out, out_len + sizeof(uint16_t) + cmd_resp_len);
+		if (!new_out) {
+			LOG_ERROR("Failed to alloc mem for resp!");
+			free(cmd_resp);
+			free(out);
+			return ERROR_FAIL;
+		}
+		out = new_out;
+		target_buffer_set_u16(target, out + out_len, cmd_resp_len);
+		if (cmd_resp_len)
+			memcpy(out + out_len + sizeof(uint16_t), cmd_resp, cmd_resp_len);
+		out_len += sizeof(uint16_t) + cmd_resp_len;
+		free(cmd_resp);
+		data += len;
+		data_len -= len;
+		cmds++;
+	}
+	LOG_DEBUG("Executed %u batched commands", cmds);
+	*resp = out;
+	*resp_len = out_len;
+	return ERROR_OK;
+}
 
-	LOG_DEBUG("Got block %d bytes [%x %x]", data_len, data[0], data[1]);
+static int esp_gcov_exec_cmd(struct esp32_apptrace_cmd_ctx *ctx,
+	unsigned int core_id,
+	uint8_t *data,
+	uint32_t data_len,
+	uint8_t **resp,
+	uint32_t *resp_len)
+{
+	struct esp32_gcov_cmd_data *cmd_data = ctx->cmd_priv;
+	int ret = ERROR_OK;
 
-	if (data_len < 1) {
-		LOG_ERROR("Too small data length %d!", data_len);
-		return ERROR_FAIL;
-	}
+	*resp = NULL;
+	*resp_len = 0;
 
 	LOG_DEBUG("Apptrace FCMD: 0x%x", *data);
 
 	switch (*data) {
 	case ESP_APPTRACE_FILE_CMD_FOPEN:
-		ret = esp_gcov_fopen(ctx->cpus[core_id], cmd_data, data + 1, data_len - 1, &resp, &resp_len);
+		ret = esp_gcov_fopen(ctx->cpus[core_id], cmd_data, data + 1, data_len - 1, resp, resp_len);
 		break;
 	case ESP_APPTRACE_FILE_CMD_FCLOSE:
-		ret = esp_gcov_fclose(ctx->cpus[core_id], cmd_data, data + 1, data_len - 1, &resp, &resp_len);
+		ret = esp_gcov_fclose(ctx->cpus[core_id], cmd_data, data + 1, data_len - 1, resp, resp_len);
 		break;
 	case ESP_APPTRACE_FILE_CMD_FWRITE:
-		ret = esp_gcov_fwrite(ctx->cpus[core_id], cmd_data, data + 1, data_len - 1, &resp, &resp_len);
+		ret = esp_gcov_fwrite(ctx->cpus[core_id], cmd_data, data + 1, data_len - 1, resp, resp_len);
 		break;
 	case ESP_APPTRACE_FILE_CMD_FREAD:
-		ret = esp_gcov_fread(ctx->cpus[core_id], cmd_data, data + 1, data_len - 1, &resp, &resp_len);
+		ret = esp_gcov_fread(ctx->cpus[core_id], cmd_data, data + 1, data_len - 1, resp, resp_len);
 		break;
 	case ESP_APPTRACE_FILE_CMD_FSEEK:
-		ret = esp_gcov_fseek(ctx->cpus[core_id], cmd_data, data + 1, data_len - 1, &resp, &resp_len);
+		ret = esp_gcov_fseek(ctx->cpus[core_id], cmd_data, data + 1, data_len - 1, resp, resp_len);
 		break;
 	case ESP_APPTRACE_FILE_CMD_FTELL:
-		ret = esp_gcov_ftell(ctx->cpus[core_id], cmd_data, data + 1, data_len - 1, &resp, &resp_len);
+		ret = esp_gcov_ftell(ctx->cpus[core_id], cmd_data, data + 1, data_len - 1, resp, resp_len);
 		break;
 	case ESP_APPTRACE_FILE_CMD_STOP:
 		ctx->running = 0;
 		break;
 	case ESP_APPTRACE_FILE_CMD_FEOF:
-		ret = esp_gcov_feof(ctx->cpus[core_id], cmd_data, data + 1, data_len - 1, &resp, &resp_len);
+		ret = esp_gcov_feof(ctx->cpus[core_id], cmd_data, data + 1, data_len - 1, resp, resp_len);
 		break;
 	default:
 		LOG_ERROR("Invalid FCMD 0x%x!", *data);
 		ret = ERROR_FAIL;
 	}
+	return ret;
+}
+
+static int esp_gcov_process_data(struct esp32_apptrace_cmd_ctx *ctx,
+	unsigned int core_id,
+	uint8_t *data,
+	uint32_t data_len)
+{
+	int ret;
+	uint8_t *resp;
+	uint32_t resp_len = 0;
+
+	if (data_len < 1) {
+		LOG_ERROR("Too small data length %d!", data_len);
+		return ERROR_FAIL;
+	}
+
+	LOG_DEBUG("Got block %d bytes [%x %x]", data_len, data[0], data_len > 1 ? data[1] : 0);
+
+	if (*data == ESP_APPTRACE_FILE_CMD_BATCH)
+		ret = esp_gcov_exec_batch(ctx, core_id, data + 1, data_len - 1, &resp, &resp_len);
+	else
+		ret = esp_gcov_exec_cmd(ctx, core_id, data, data_len, &resp, &resp_len);
 	if (ret != ERROR_OK)
 		return ret;
 
@@ -2342,6 +2715,31 @@ COMMAND_HANDLER(esp32_cmd_gcov)
 	return res;
 }
 
+COMMAND_HANDLER(esp32_cmd_gcov_mode)
+{
+	static const char * const mode_names[] = {
+		[ESP_GCOV_MODE_FILE] = "file",
+		[ESP_GCOV_MODE_MEM] = "mem",
+		[ESP_GCOV_MODE_MERGE] = "merge",
+	};
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int i;
+		for (i = 0; i < ARRAY_SIZE(mode_names); i++) {
+			if (!strcmp(CMD_ARGV[0], mode_names[i]))
+				break;
+		}
+		if (i == ARRAY_SIZE(mode_names))
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		s_gcov_mode = i;
+	}
+	command_print(CMD, "%s", mode_names[s_gcov_mode]);
+	return ERROR_OK;
+}
+
 const struct command_registration esp32_apptrace_command_handlers[] = {
 	{
 		.name = "apptrace",
@@ -2370,6 +2768,22 @@ const struct command_registration esp32_apptrace_command_handlers[] = {
 		.usage =
 			"(start file://<outfile> [poll_period [trace_size [stop_tmo [wait4halt [skip_size]]]]) | (stop) | (status)",
 	},
+	{
+		.name = "sysview_timeline",
+		.handler = esp32_cmd_sysview_timeline,
+		.mode = COMMAND_ANY,
+		.help = "App Tracing: set the file the task and ISR timeline of the next SystemView trace "
+			"is written to, as a Chrome JSON trace for the Perfetto UI.",
+		.usage = "[<file> | 'none']",
+	},
+	{
+		.name = "sysview_stats",
+		.handler = esp32_cmd_sysview_stats,
+		.mode = COMMAND_ANY,
+		.help = "App Tracing: show the CPU load, ISR and task statistics of the SystemView trace, "
+			"clear them or set the window the loads are computed on.",
+		.usage = "[reset | window <ms>]",
+	},
 	{
 		.name = "gcov",
 		.handler = esp32_cmd_gcov,
@@ -2377,5 +2791,14 @@ const struct command_registration esp32_apptrace_command_handlers[] = {
 		.help = "GCOV: Dumps gcov info collected on target.",
 		.usage = "[dump] [<prefix> [<prefix_strip>]]",
 	},
+	{
+		.name = "gcov_mode",
+		.handler = esp32_cmd_gcov_mode,
+		.mode = COMMAND_ANY,
+		.help = "GCOV: Set/get how gcov data files are handled on host. "
+			"'file' - every operation on host file, 'mem' - in memory, written at the end, "
+			"'merge' - as 'mem', counters are merged with existing files on host.",
+		.usage = "['file'|'mem'|'merge']",
+	},
 	COMMAND_REGISTRATION_DONE
 };
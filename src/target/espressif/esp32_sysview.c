@@ -12,6 +12,7 @@
 #include <helper/log.h>
 #include "esp32_apptrace.h"
 #include "esp32_sysview.h"
+#include "esp_sysview_decoder.h"
 #include "segger_sysview.h"
 
 /* in SystemView mode core ID is passed in event ID field */
@@ -26,7 +27,14 @@ struct esp_sysview_target2host_hdr {
 #define SYSVIEW_BLOCK_SIZE_OFFSET       0
 #define SYSVIEW_WR_SIZE_OFFSET          1
 
+/* kept after the tracing stopped, for the statistics */
+static struct esp_sysview_decoder s_sysview_decoder;
+static bool s_sysview_decoded;
+static char *s_sysview_timeline_path;
+static uint32_t s_sysview_window_ms = ESP_SYSVIEW_DECODER_WINDOW_US / 1000;
+
 static int esp_sysview_trace_header_write(struct esp32_apptrace_cmd_ctx *ctx, bool mcore_format);
+static void esp32_sysview_timeline_close(void);
 static int esp32_sysview_core_id_get(struct target *target, uint8_t *hdr_buf);
 static uint32_t esp32_sysview_usr_block_len_get(struct target *target, uint8_t *hdr_buf, uint32_t *wr_len);
 
@@ -92,6 +100,20 @@ int esp32_sysview_cmd_init(struct esp32_apptrace_cmd_ctx *cmd_ctx,
 		cmd_data->apptrace.wait4halt,
 		cmd_data->apptrace.skip_len);
 
+	FILE *timeline = NULL;
+	if (s_sysview_timeline_path) {
+		timeline = fopen(s_sysview_timeline_path, "w");
+		if (!timeline) {
+			command_print(cmd, "Failed to open timeline file '%s'!", s_sysview_timeline_path);
+			esp32_apptrace_dest_cleanup(cmd_data->data_dests, core_num);
+			free(cmd_data);
+			res = ERROR_FAIL;
+			goto on_error;
+		}
+	}
+	esp_sysview_decoder_init(&s_sysview_decoder, timeline, s_sysview_window_ms * 1000);
+	s_sysview_decoded = true;
+
 	cmd_ctx->trace_format.hdr_sz = ESP32_SYSVIEW_USER_BLOCK_HDR_SZ;
 	cmd_ctx->trace_format.core_id_get = esp32_sysview_core_id_get;
 	cmd_ctx->trace_format.usr_block_len_get = esp32_sysview_usr_block_len_get;
@@ -99,6 +121,7 @@ int esp32_sysview_cmd_init(struct esp32_apptrace_cmd_ctx *cmd_ctx,
 	res = esp_sysview_trace_header_write(cmd_ctx, mcore_format);
 	if (res != ERROR_OK) {
 		command_print(cmd, "Failed to write trace header (%d)!", res);
+		esp32_sysview_timeline_close();
 		esp32_apptrace_dest_cleanup(cmd_data->data_dests, core_num);
 		free(cmd_data);
 		return res;
@@ -114,6 +137,7 @@ int esp32_sysview_cmd_cleanup(struct esp32_apptrace_cmd_ctx *cmd_ctx)
 {
 	struct esp32_sysview_cmd_data *cmd_data = cmd_ctx->cmd_priv;
 
+	esp32_sysview_timeline_close();
 	esp32_apptrace_dest_cleanup(cmd_data->data_dests, cmd_ctx->cores_num);
 	free(cmd_data);
 	cmd_ctx->cmd_priv = NULL;
@@ -280,6 +304,8 @@ static uint16_t esp_sysview_parse_packet(uint8_t *pkt_buf,
 	unsigned int *pkt_core_id,
 	uint32_t *delta,
 	uint32_t *delta_len,
+	uint8_t **payload,
+	uint16_t *plen,
 	bool clear_core_bit)
 {
 	uint8_t *pkt = pkt_buf;
@@ -313,6 +339,8 @@ static uint16_t esp_sysview_parse_packet(uint8_t *pkt_buf,
 		else
 			payload_len = esp_sysview_decode_plen(&pkt);
 	}
+	*payload = pkt;
+	*plen = payload_len;
 	pkt += payload_len;
 	uint8_t *delta_start = pkt;
 	*delta = esp_sysview_decode_u32(&pkt);
@@ -504,11 +532,15 @@ int esp32_sysview_process_data(struct esp32_apptrace_cmd_ctx *ctx,
 		unsigned int pkt_core_id;
 		uint32_t delta_len = 0;
 		uint32_t pkt_len = 0, delta = 0;
+		uint8_t *payload;
+		uint16_t payload_len;
 		uint16_t event_id = esp_sysview_parse_packet(data + processed,
 			&pkt_len,
 			&pkt_core_id,
 			&delta,
 			&delta_len,
+			&payload,
+			&payload_len,
 			!cmd_data->mcore_format);
 		LOG_DEBUG("sysview: Process packet: core %d, %d id, %d bytes [%x %x %x %x]",
 			pkt_core_id,
@@ -518,6 +550,7 @@ int esp32_sysview_process_data(struct esp32_apptrace_cmd_ctx *ctx,
 			data[processed + 1],
 			data[processed + 2],
 			data[processed + 3]);
+		esp_sysview_decoder_event(&s_sysview_decoder, pkt_core_id, event_id, payload, payload_len, delta);
 		if (!cmd_data->mcore_format) {
 			res = esp32_sysview_process_packet(ctx,
 				pkt_core_id,
@@ -552,3 +585,109 @@ int esp32_sysview_process_data(struct esp32_apptrace_cmd_ctx *ctx,
 	}
 	return ERROR_OK;
 }
+
+static void esp32_sysview_timeline_close(void)
+{
+	esp_sysview_decoder_finish(&s_sysview_decoder);
+	if (s_sysview_decoder.timeline) {
+		fclose(s_sysview_decoder.timeline);
+		s_sysview_decoder.timeline = NULL;
+	}
+}
+
+int esp32_sysview_timeline_set(const char *path)
+{
+	free(s_sysview_timeline_path);
+	s_sysview_timeline_path = NULL;
+	if (path) {
+		s_sysview_timeline_path = strdup(path);
+		if (!s_sysview_timeline_path) {
+			LOG_ERROR("Failed to alloc memory!");
+			return ERROR_FAIL;
+		}
+	}
+	return ERROR_OK;
+}
+
+const char *esp32_sysview_timeline_get(void)
+{
+	return s_sysview_timeline_path;
+}
+
+void esp32_sysview_window_set(uint32_t window_ms)
+{
+	s_sysview_window_ms = window_ms;
+}
+
+void esp32_sysview_stats_reset(void)
+{
+	if (s_sysview_decoded)
+		esp_sysview_decoder_reset(&s_sysview_decoder);
+}
+
+static double esp32_sysview_percent(uint64_t part, uint64_t total)
+{
+	return total ? part * 100.0 / total : 0.0;
+}
+
+int esp32_sysview_stats_print(struct command_invocation *cmd)
+{
+	struct esp_sysview_decoder *dec = &s_sysview_decoder;
+
+	if (!s_sysview_decoded) {
+		command_print(cmd, "No SystemView trace decoded!");
+		return ERROR_FAIL;
+	}
+
+	command_print(cmd, "%" PRIu64 " events over %.6f s, timestamp %" PRIu32 " Hz%s",
+		dec->events,
+		esp_sysview_decoder_ticks_to_us(dec, dec->ts - dec->stats_ts) / 1000000.0,
+		dec->sys_freq ? dec->sys_freq : 1000000,
+		dec->sys_freq ? "" : " (assumed)");
+	command_print(cmd, "%" PRIu64 " overflows, %" PRIu64 " events lost, %" PRIu64 " untracked, %" PRIu64 " errors",
+		dec->overflows, dec->lost_events, dec->untracked, dec->errors);
+
+	for (unsigned int i = 0; i < ESP_SYSVIEW_DECODER_CORES; i++) {
+		const struct esp_sysview_decoder_core *core = &dec->cores[i];
+		if (!core->seen)
+			continue;
+		uint64_t total = core->busy_time + core->idle_time;
+		command_print(cmd, "core %u: load %.1f %% last %" PRIu32 " ms, %.1f %% overall, ISRs %.1f %%",
+			i,
+			dec->windows ? core->last_load / 10.0 : esp32_sysview_percent(core->window_busy,
+				dec->ts - dec->window_start),
+			dec->window_us / 1000,
+			esp32_sysview_percent(core->busy_time, total),
+			esp32_sysview_percent(core->isr_time, total));
+	}
+
+	command_print(cmd, "%-20s %4s %8s %8s %10s %28s", "task", "core", "last %", "total %", "runs",
+		"ready to run us min/avg/max");
+	for (unsigned int i = 0; i < dec->tasks_num; i++) {
+		const struct esp_sysview_decoder_task *task = &dec->tasks[i];
+		const struct esp_sysview_decoder_span *lat = &task->latency;
+		char core[12] = "-";
+		if (task->core >= 0)
+			snprintf(core, sizeof(core), "%d", task->core);
+		command_print(cmd, "%-20s %4s %8.1f %8.1f %10" PRIu32 " %8.1f/%8.1f/%8.1f",
+			task->name, core,
+			esp32_sysview_percent(task->last_window_time, dec->window_ticks),
+			esp32_sysview_percent(task->run_time, dec->ts - dec->stats_ts),
+			task->runs,
+			esp_sysview_decoder_ticks_to_us(dec, lat->min),
+			lat->count ? esp_sysview_decoder_ticks_to_us(dec, lat->sum) / lat->count : 0.0,
+			esp_sysview_decoder_ticks_to_us(dec, lat->max));
+	}
+
+	command_print(cmd, "%-20s %8s %10s %28s", "ISR", "number", "count", "duration us min/avg/max");
+	for (unsigned int i = 0; i < dec->isrs_num; i++) {
+		const struct esp_sysview_decoder_isr *isr = &dec->isrs[i];
+		const struct esp_sysview_decoder_span *dur = &isr->duration;
+		command_print(cmd, "%-20s %8" PRIu32 " %10" PRIu32 " %8.1f/%8.1f/%8.1f",
+			isr->name, isr->number, dur->count,
+			esp_sysview_decoder_ticks_to_us(dec, dur->min),
+			dur->count ? esp_sysview_decoder_ticks_to_us(dec, dur->sum) / dur->count : 0.0,
+			esp_sysview_decoder_ticks_to_us(dec, dur->max));
+	}
+	return ERROR_OK;
+}
@@ -34,5 +34,12 @@ int esp32_sysview_process_data(struct esp32_apptrace_cmd_ctx *ctx,
 	unsigned int core_id,
 	uint8_t *data,
 	uint32_t data_len);
+/** Sets the file the timeline of the next trace is written to, NULL for none */
+int esp32_sysview_timeline_set(const char *path);
+const char *esp32_sysview_timeline_get(void);
+/** Sets the length of the window the loads are computed on, applied at the next start */
+void esp32_sysview_window_set(uint32_t window_ms);
+void esp32_sysview_stats_reset(void);
+int esp32_sysview_stats_print(struct command_invocation *cmd);
 
 #endif	/* OPENOCD_TARGET_ESP32_SYSVIEW_H */
@@ -230,6 +230,7 @@ struct target_type esp32c2_target = {
 	.wait_algorithm = esp_riscv_wait_algorithm,
 
 	.commands = esp32c2_command_handlers,
+	.profiling = esp_riscv_profiling,
 
 	.address_bits = riscv_xlen_nonconst,
 };
@@ -246,6 +246,7 @@ struct target_type esp32c3_target = {
 	.wait_algorithm = esp_riscv_wait_algorithm,
 
 	.commands = esp32c3_command_handlers,
+	.profiling = esp_riscv_profiling,
 
 	.address_bits = riscv_xlen_nonconst,
 };
@@ -244,6 +244,7 @@ struct target_type esp32c61_target = {
 	.wait_algorithm = esp_riscv_wait_algorithm,
 
 	.commands = esp32c61_command_handlers,
+	.profiling = esp_riscv_profiling,
 
 	.address_bits = riscv_xlen_nonconst,
 };
@@ -252,6 +252,7 @@ struct target_type esp32h2_target = {
 	.wait_algorithm = esp_riscv_wait_algorithm,
 
 	.commands = esp32h2_command_handlers,
+	.profiling = esp_riscv_profiling,
 
 	.address_bits = riscv_xlen_nonconst,
 };
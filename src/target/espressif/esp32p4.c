@@ -365,6 +365,7 @@ struct target_type esp32p4_target = {
 	.wait_algorithm = esp_riscv_wait_algorithm,
 
 	.commands = esp32p4_command_handlers,
+	.profiling = esp_riscv_profiling,
 
 	.address_bits = riscv_xlen_nonconst,
 };
@@ -445,6 +445,7 @@ static int esp32s2_poll(struct target *target)
 						LOG_ERROR("Failed to resume target");
 						return ret;
 					}
+					esp_common_semihosting_fast_poll(target);
 				}
 				return ret;
 			} else if (retval == SEMIHOSTING_WAITING) {
@@ -675,4 +676,5 @@ struct target_type esp32s2_target = {
 	.deinit_target = esp_xtensa_target_deinit,
 
 	.commands = esp32s2_command_handlers,
+	.profiling = esp_xtensa_profiling,
 };
@@ -13,6 +13,7 @@
 #include <target/algorithm.h>
 #include <target/target.h>
 #include "esp_algorithm.h"
+#include "esp.h"
 #include "../../../contrib/loaders/flash/espressif/stub_flasher.h"
 
 /* 3 sec will be enough for the regular commands. Flash erase will take time but it has another timer value */
@@ -314,11 +315,16 @@ static int load_section_from_image(struct target *target,
 
 	while (sec_wr < section->size) {
 		uint32_t nb = section->size - sec_wr > sizeof(buf) ? sizeof(buf) : section->size - sec_wr;
-		size_t size_read = 0;
-		int retval = image_read_section(&run->image.image, section_num, sec_wr, nb, buf, &size_read);
+		size_t size_read = nb;
+		const uint8_t *data;
+		int retval = image_section_view(&run->image.image, section_num, sec_wr, nb, &data);
 		if (retval != ERROR_OK) {
-			LOG_ERROR("Failed to read stub section (%d)!", retval);
-			return retval;
+			retval = image_read_section(&run->image.image, section_num, sec_wr, nb, buf, &size_read);
+			if (retval != ERROR_OK) {
+				LOG_ERROR("Failed to read stub section (%d)!", retval);
+				return retval;
+			}
+			data = buf;
 		}
 
 		if (reverse) {
@@ -326,7 +332,7 @@ static int load_section_from_image(struct target *target,
 			uint8_t reversed_buf[aligned_len];
 
 			/* Send original size to allow padding */
-			reverse_binary(buf, reversed_buf, size_read);
+			reverse_binary(data, reversed_buf, size_read);
 
 			/*
 				The address range accessed via the instruction bus is in reverse order (word-wise) compared to access
@@ -349,7 +355,7 @@ static int load_section_from_image(struct target *target,
 				return retval;
 			}
 		} else {
-			retval = target_write_buffer(target, section->base_address + sec_wr, size_read, buf);
+			retval = target_write_buffer(target, section->base_address + sec_wr, size_read, data);
 			if (retval != ERROR_OK) {
 				LOG_ERROR("Failed to write stub section!");
 				return retval;
@@ -416,30 +422,16 @@ int esp_algorithm_check_preloaded_image(struct target *target, struct esp_algori
 	return ERROR_OK;
 }
 
-/*
- * Configuration:
- * ----------------------------
- * The linker scripts defines the memory layout for the stub code.
- * The OpenOCD script specifies the workarea address and it's size
- * Sections defined in the linker are organized to share the same addresses with the workarea.
- * Code and data sections are located in Internal SRAM1 and OpenOCD fills these sections using the data bus.
- */
-int esp_algorithm_load_func_image(struct target *target, struct esp_algorithm_run_data *run)
+/* [code + trampoline] + <padding> */
+static int esp_algorithm_load_code(struct target *target,
+	struct esp_algorithm_run_data *run,
+	struct esp_algorithm_stub *stub)
 {
 	int retval;
 	size_t tramp_sz = 0;
 	const uint8_t *tramp = NULL;
-	struct duration algo_time;
 	bool alloc_code_working_area = true;
 
-	if (!run || !run->hw)
-		return ERROR_FAIL;
-
-	if (duration_start(&algo_time) != 0) {
-		LOG_ERROR("Failed to start algo time measurement!");
-		return ERROR_FAIL;
-	}
-
 	if (run->hw->stub_tramp_get) {
 		tramp = run->hw->stub_tramp_get(target, &tramp_sz);
 		if (!tramp)
@@ -451,21 +443,20 @@ int esp_algorithm_load_func_image(struct target *target, struct esp_algorithm_ru
 		run->image.image.base_address_set ? (unsigned int)run->image.image.base_address : 0,
 		run->image.image.start_address,
 		run->image.image.num_sections);
-	run->stub.entry = run->image.image.start_address;
-
-	/* [code + trampoline] + <padding> + [data] */
+	stub->entry = run->image.image.start_address;
 
 	/* ESP32 has reversed memory region. It will use the last part of DRAM, the others will use the first part.
 	 * To avoid complexity for the backup/restore process, we will allocate a workarea for all IRAM region from
 	 * the beginning. In that case no need to have a padding area.
 	 */
 	if (run->image.reverse) {
-		if (target_alloc_working_area(target, run->image.iram_len, &run->stub.code) != ERROR_OK) {
+		if (target_alloc_working_area(target, run->image.iram_len, &stub->code) != ERROR_OK) {
 			LOG_ERROR("no working area available, can't alloc space for stub code!");
-			retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-			goto _on_error;
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 		}
 		alloc_code_working_area = false;
+		/* stub never modifies its code, only what we upload has to be restored */
+		target_working_area_declare_output(target, stub->code, 0, 0);
 	}
 
 	uint32_t code_size = 0;
@@ -482,29 +473,28 @@ int esp_algorithm_load_func_image(struct target *target, struct esp_algorithm_ru
 				section->base_address, section->size, section->flags);
 
 			if (alloc_code_working_area) {
-				retval = target_alloc_working_area(target, section->size, &run->stub.code);
+				retval = target_alloc_working_area(target, section->size, &stub->code);
 				if (retval != ERROR_OK) {
 					LOG_ERROR("no working area available, can't alloc space for stub code!");
-					retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-					goto _on_error;
+					return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 				}
+				target_working_area_declare_output(target, stub->code, 0, 0);
 			}
 
 			if (section->base_address == 0) {
-				section->base_address = run->stub.code->address;
+				section->base_address = stub->code->address;
 				/* sanity check, stub is compiled to be run from working area */
-			} else if (run->stub.code->address != section->base_address) {
+			} else if (stub->code->address != section->base_address) {
 				LOG_ERROR("working area " TARGET_ADDR_FMT " and stub code section " TARGET_ADDR_FMT
 					" address mismatch!",
 					section->base_address,
-					run->stub.code->address);
-				retval = ERROR_FAIL;
-				goto _on_error;
+					stub->code->address);
+				return ERROR_FAIL;
 			}
 
 			retval = load_section_from_image(target, run, i, run->image.reverse);
 			if (retval != ERROR_OK)
-				goto _on_error;
+				return retval;
 
 			code_size += ALIGN_UP(section->size, 4);
 			break; /* Stub has one executable text section */
@@ -513,15 +503,15 @@ int esp_algorithm_load_func_image(struct target *target, struct esp_algorithm_ru
 
 	/* If exists, load trampoline to the code area */
 	if (tramp) {
-		if (run->stub.tramp_addr == 0) {
+		if (stub->tramp_addr == 0) {
 			if (alloc_code_working_area) {
 				/* alloc trampoline in code working area */
-				if (target_alloc_working_area(target, tramp_sz, &run->stub.tramp) != ERROR_OK) {
+				if (target_alloc_working_area(target, tramp_sz, &stub->tramp) != ERROR_OK) {
 					LOG_ERROR("no working area available, can't alloc space for stub jumper!");
-					retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-					goto _on_error;
+					return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 				}
-				run->stub.tramp_addr = run->stub.tramp->address;
+				stub->tramp_addr = stub->tramp->address;
+				target_working_area_declare_output(target, stub->tramp, 0, 0);
 			}
 		}
 
@@ -533,22 +523,22 @@ int esp_algorithm_load_func_image(struct target *target, struct esp_algorithm_ru
 
 			/* Send original size to allow padding */
 			reverse_binary(tramp, reversed_tramp, tramp_sz);
-			run->stub.tramp_addr = reversed_tramp_addr - al_tramp_size;
-			LOG_DEBUG("Write reversed tramp to addr " TARGET_ADDR_FMT ", sz %zu", run->stub.tramp_addr, al_tramp_size);
-			retval = target_write_buffer(target, run->stub.tramp_addr, al_tramp_size, reversed_tramp);
+			stub->tramp_addr = reversed_tramp_addr - al_tramp_size;
+			LOG_DEBUG("Write reversed tramp to addr " TARGET_ADDR_FMT ", sz %zu", stub->tramp_addr, al_tramp_size);
+			retval = target_write_buffer(target, stub->tramp_addr, al_tramp_size, reversed_tramp);
 		} else {
-			LOG_DEBUG("Write tramp to addr " TARGET_ADDR_FMT ", sz %zu", run->stub.tramp_addr, tramp_sz);
-			retval = target_write_buffer(target, run->stub.tramp_addr, tramp_sz, tramp);
+			LOG_DEBUG("Write tramp to addr " TARGET_ADDR_FMT ", sz %zu", stub->tramp_addr, tramp_sz);
+			retval = target_write_buffer(target, stub->tramp_addr, tramp_sz, tramp);
 		}
 
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Failed to write stub jumper!");
-			goto _on_error;
+			return retval;
 		}
 
-		run->stub.tramp_mapped_addr = run->image.iram_org + code_size;
+		stub->tramp_mapped_addr = run->image.iram_org + code_size;
 		code_size += al_tramp_size;
-		LOG_DEBUG("Tramp mapped to addr " TARGET_ADDR_FMT, run->stub.tramp_mapped_addr);
+		LOG_DEBUG("Tramp mapped to addr " TARGET_ADDR_FMT, stub->tramp_mapped_addr);
 	}
 
 	/* allocate dummy space until the data address */
@@ -556,15 +546,22 @@ int esp_algorithm_load_func_image(struct target *target, struct esp_algorithm_ru
 		/* we dont need to restore padding area. */
 		uint32_t backup_working_area_prev = target->backup_working_area;
 		target->backup_working_area = 0;
-		if (target_alloc_working_area(target, run->image.iram_len - code_size, &run->stub.padding) != ERROR_OK) {
+		retval = target_alloc_working_area(target, run->image.iram_len - code_size, &stub->padding);
+		target->backup_working_area = backup_working_area_prev;
+		if (retval != ERROR_OK) {
 			LOG_ERROR("no working area available, can't alloc space for stub code!");
-			retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-			goto _on_error;
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 		}
-		target->backup_working_area = backup_working_area_prev;
 	}
 
-	/*  Load the data section */
+	return ERROR_OK;
+}
+
+/* [data + bss]. Working area is allocated only if stub does not have it yet. */
+static int esp_algorithm_load_data(struct target *target,
+	struct esp_algorithm_run_data *run,
+	struct esp_algorithm_stub *stub)
+{
 	for (unsigned int i = 0; i < run->image.image.num_sections; i++) {
 		struct imagesection *section = &run->image.image.sections[i];
 
@@ -574,56 +571,103 @@ int esp_algorithm_load_func_image(struct target *target, struct esp_algorithm_ru
 		if (!(section->flags & ESP_IMAGE_ELF_PHF_EXEC)) {
 			LOG_DEBUG("addr " TARGET_ADDR_FMT ", sz %d, flags %" PRIx64, section->base_address, section->size,
 				section->flags);
-			/* target_alloc_working_area() aligns the whole working area size to 4-byte boundary.
-			   We alloc one area for both DATA and BSS, so align each of them ourselves. */
-			uint32_t data_sec_sz = ALIGN_UP(section->size, 4);
-			LOG_DEBUG("DATA sec size %" PRIu32 " -> %" PRIu32, section->size, data_sec_sz);
-			uint32_t bss_sec_sz = ALIGN_UP(run->image.bss_size, 4);
-			LOG_DEBUG("BSS sec size %" PRIu32 " -> %" PRIu32, run->image.bss_size, bss_sec_sz);
-			if (target_alloc_working_area(target, data_sec_sz + bss_sec_sz, &run->stub.data) != ERROR_OK) {
-				LOG_ERROR("no working area available, can't alloc space for stub data!");
-				retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-				goto _on_error;
+			if (!stub->data) {
+				/* target_alloc_working_area() aligns the whole working area size to 4-byte boundary.
+				   We alloc one area for both DATA and BSS, so align each of them ourselves. */
+				uint32_t data_sec_sz = ALIGN_UP(section->size, 4);
+				LOG_DEBUG("DATA sec size %" PRIu32 " -> %" PRIu32, section->size, data_sec_sz);
+				uint32_t bss_sec_sz = ALIGN_UP(run->image.bss_size, 4);
+				LOG_DEBUG("BSS sec size %" PRIu32 " -> %" PRIu32, run->image.bss_size, bss_sec_sz);
+				if (target_alloc_working_area(target, data_sec_sz + bss_sec_sz, &stub->data) != ERROR_OK) {
+					LOG_ERROR("no working area available, can't alloc space for stub data!");
+					return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+				}
+				/* data and BSS are modified by the stub */
+				int retval = target_working_area_declare_output(target, stub->data, 0, stub->data->size);
+				if (retval != ERROR_OK)
+					return retval;
 			}
 			if (section->base_address == 0) {
-				section->base_address = run->stub.data->address;
+				section->base_address = stub->data->address;
 				/* sanity check, stub is compiled to be run from working area */
-			} else if (run->stub.data->address != section->base_address) {
+			} else if (stub->data->address != section->base_address) {
 				LOG_ERROR("working area " TARGET_ADDR_FMT
 					" and stub data section " TARGET_ADDR_FMT
 					" address mismatch!",
 					section->base_address,
-					run->stub.data->address);
-				retval = ERROR_FAIL;
-				goto _on_error;
+					stub->data->address);
+				return ERROR_FAIL;
 			}
 
-			retval = load_section_from_image(target, run, i, false);
+			int retval = load_section_from_image(target, run, i, false);
 			if (retval != ERROR_OK)
-				goto _on_error;
+				return retval;
 		}
 	}
 
-	/* stack */
-	if (run->stub.stack_addr == 0 && run->stack_size > 0) {
-		/* allocate stack in data working area */
-		if (target_alloc_working_area(target, run->stack_size, &run->stub.stack) != ERROR_OK) {
-			LOG_ERROR("no working area available, can't alloc stub stack!");
-			retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-			goto _on_error;
-		}
-		run->stub.stack_addr = run->stub.stack->address + run->stack_size;
+	return ERROR_OK;
+}
+
+static int esp_algorithm_alloc_stack(struct target *target, struct esp_algorithm_run_data *run)
+{
+	if (run->stub.stack_addr != 0 || run->stack_size == 0)
+		return ERROR_OK;
+
+	/* allocate stack in data working area */
+	if (target_alloc_working_area(target, run->stack_size, &run->stub.stack) != ERROR_OK) {
+		LOG_ERROR("no working area available, can't alloc stub stack!");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+	run->stub.stack_addr = run->stub.stack->address + run->stack_size;
+	int retval = target_working_area_declare_output(target, run->stub.stack, 0, run->stub.stack->size);
+	if (retval != ERROR_OK)
+		return retval;
 
 #ifdef ESP_STACK_HIGH_WATER_MARK
-		/* For development purpose only */
-		uint8_t buff[run->stack_size];
-		memset(buff, 0xA5, sizeof(buff));
-		retval = target_write_memory(target, run->stub.stack->address, 1, run->stack_size, buff);
-		if (retval != ERROR_OK)
-			return retval;
+	/* For development purpose only */
+	uint8_t buff[run->stack_size];
+	memset(buff, 0xA5, sizeof(buff));
+	retval = target_write_memory(target, run->stub.stack->address, 1, run->stack_size, buff);
+	if (retval != ERROR_OK)
+		return retval;
 #endif
+	return ERROR_OK;
+}
+
+/*
+ * Configuration:
+ * ----------------------------
+ * The linker scripts defines the memory layout for the stub code.
+ * The OpenOCD script specifies the workarea address and it's size
+ * Sections defined in the linker are organized to share the same addresses with the workarea.
+ * Code and data sections are located in Internal SRAM1 and OpenOCD fills these sections using the data bus.
+ */
+int esp_algorithm_load_func_image(struct target *target, struct esp_algorithm_run_data *run)
+{
+	int retval;
+	struct duration algo_time;
+
+	if (!run || !run->hw)
+		return ERROR_FAIL;
+
+	if (duration_start(&algo_time) != 0) {
+		LOG_ERROR("Failed to start algo time measurement!");
+		return ERROR_FAIL;
 	}
 
+	/* [code + trampoline] + <padding> + [data] */
+	retval = esp_algorithm_load_code(target, run, &run->stub);
+	if (retval != ERROR_OK)
+		goto _on_error;
+
+	retval = esp_algorithm_load_data(target, run, &run->stub);
+	if (retval != ERROR_OK)
+		goto _on_error;
+
+	retval = esp_algorithm_alloc_stack(target, run);
+	if (retval != ERROR_OK)
+		goto _on_error;
+
 	if (duration_measure(&algo_time) != 0) {
 		LOG_ERROR("Failed to stop algo run measurement!");
 		retval = ERROR_FAIL;
@@ -637,12 +681,169 @@ _on_error:
 	return retval;
 }
 
+/* Frees the working areas allocated for the run, the ones of other users are left alone */
+static void esp_algorithm_free_run_areas(struct target *target, struct esp_algorithm_run_data *run)
+{
+	/* in reverse order of allocation */
+	target_free_working_area(target, run->stub.stack);
+	target_free_working_area(target, run->stub.data);
+	target_free_working_area(target, run->stub.padding);
+	target_free_working_area(target, run->stub.tramp);
+	target_free_working_area(target, run->stub.code);
+}
+
 int esp_algorithm_unload_func_image(struct target *target, struct esp_algorithm_run_data *run)
 {
 	if (!run)
 		return ERROR_FAIL;
 
-	target_free_all_working_areas(target);
+	esp_algorithm_free_run_areas(target, run);
+
+	run->stub.tramp = NULL;
+	run->stub.stack = NULL;
+	run->stub.code = NULL;
+	run->stub.data = NULL;
+	run->stub.padding = NULL;
+
+	return ERROR_OK;
+}
+
+static int esp_algorithm_image_code_crc(struct esp_algorithm_run_data *run, uint32_t *crc, uint32_t *size)
+{
+	for (unsigned int i = 0; i < run->image.image.num_sections; i++) {
+		struct imagesection *section = &run->image.image.sections[i];
+
+		if (section->size == 0 || !(section->flags & ESP_IMAGE_ELF_PHF_EXEC))
+			continue;
+
+		const uint8_t *data;
+		uint8_t *copy;
+		size_t size_read = 0;
+		int retval = image_section_get(&run->image.image, i, 0, section->size, &data, &copy, &size_read);
+		if (retval == ERROR_OK) {
+			retval = image_calculate_checksum(data, size_read, crc);
+			free(copy);
+		}
+		*size = size_read;
+		return retval;
+	}
+
+	LOG_ERROR("Stub image has no code section!");
+	return ERROR_FAIL;
+}
+
+void esp_algorithm_session_close(struct target *target, struct esp_algorithm_session *session)
+{
+	if (session->stub.code)
+		LOG_TARGET_DEBUG(target, "Close stub session");
+
+	/* areas are freed in reverse order of allocation, every free clears the session pointer */
+	if (session->stub.data)
+		target_free_working_area(target, session->stub.data);
+	if (session->stub.padding)
+		target_free_working_area(target, session->stub.padding);
+	if (session->stub.tramp)
+		target_free_working_area(target, session->stub.tramp);
+	if (session->stub.code)
+		target_free_working_area(target, session->stub.code);
+
+	memset(&session->stub, 0, sizeof(session->stub));
+	session->code_crc = 0;
+	session->code_size = 0;
+}
+
+/*
+ * Loads stub keeping its code and data areas allocated after the run.
+ * If the same stub is already loaded on target only its data section is re-uploaded.
+ */
+int esp_algorithm_session_load_func_image(struct target *target, struct esp_algorithm_run_data *run)
+{
+	uint32_t code_crc = 0, code_size = 0;
+	struct duration algo_time;
+
+	if (!run || !run->hw)
+		return ERROR_FAIL;
+
+	struct esp_common *esp = target_to_esp_common(target);
+	if (!esp)
+		return ERROR_FAIL;
+	struct esp_algorithm_session *session = &esp->algo_session;
+
+	if (duration_start(&algo_time) != 0) {
+		LOG_ERROR("Failed to start algo time measurement!");
+		return ERROR_FAIL;
+	}
+
+	int retval = esp_algorithm_image_code_crc(run, &code_crc, &code_size);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* Working areas could be freed behind our back (e.g. on reset). In that case the first freed one
+	 * clears its session pointer and the whole session is considered as broken. */
+	bool loaded = session->stub.code && session->stub.data &&
+		(session->stub.padding || run->image.reverse) &&
+		(session->stub.tramp || run->image.reverse || !run->hw->stub_tramp_get);
+	bool reuse = loaded && session->code_crc == code_crc && session->code_size == code_size &&
+		session->stub.entry == run->image.image.start_address;
+
+	if (!reuse) {
+		esp_algorithm_session_close(target, session);
+		retval = esp_algorithm_load_code(target, run, &session->stub);
+		if (retval != ERROR_OK)
+			goto _on_error;
+		session->code_crc = code_crc;
+		session->code_size = code_size;
+		session->loads++;
+	} else {
+		/* code section is not uploaded, so set its address as load_code() would do */
+		for (unsigned int i = 0; i < run->image.image.num_sections; i++) {
+			struct imagesection *section = &run->image.image.sections[i];
+			if (section->size && (section->flags & ESP_IMAGE_ELF_PHF_EXEC) && section->base_address == 0)
+				section->base_address = session->stub.code->address;
+		}
+		session->reuses++;
+	}
+
+	/* stub can modify its data, so reload it for every run. BSS is cleared by stub itself. */
+	retval = esp_algorithm_load_data(target, run, &session->stub);
+	if (retval != ERROR_OK)
+		goto _on_error;
+
+	run->stub.entry = session->stub.entry;
+	run->stub.code = session->stub.code;
+	run->stub.tramp = session->stub.tramp;
+	run->stub.padding = session->stub.padding;
+	run->stub.data = session->stub.data;
+	run->stub.tramp_addr = session->stub.tramp_addr;
+	run->stub.tramp_mapped_addr = session->stub.tramp_mapped_addr;
+
+	retval = esp_algorithm_alloc_stack(target, run);
+	if (retval != ERROR_OK)
+		goto _on_error;
+
+	if (duration_measure(&algo_time) != 0) {
+		LOG_ERROR("Failed to stop algo run measurement!");
+		retval = ERROR_FAIL;
+		goto _on_error;
+	}
+	LOG_DEBUG("Stub %s in %g ms", reuse ? "reused" : "loaded", duration_elapsed(&algo_time) * 1000);
+	return ERROR_OK;
+
+_on_error:
+	esp_algorithm_session_unload_func_image(target, run);
+	esp_algorithm_session_close(target, session);
+	return retval;
+}
+
+/* Frees the working areas allocated for the run, the resident stub ones are kept */
+int esp_algorithm_session_unload_func_image(struct target *target, struct esp_algorithm_run_data *run)
+{
+	if (!run)
+		return ERROR_FAIL;
+
+	/* The other areas of the run are copies of the session ones, which may have been freed
+	 * behind our back meanwhile. Only the stack is allocated for every run. */
+	target_free_working_area(target, run->stub.stack);
 
 	run->stub.tramp = NULL;
 	run->stub.stack = NULL;
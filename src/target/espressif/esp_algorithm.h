@@ -170,6 +170,25 @@ struct esp_algorithm_stub {
 	void *ainfo;
 };
 
+/**
+ * Flasher stub kept resident on target between algorithm runs.
+ * Code, trampoline and data working areas stay allocated until the session is closed,
+ * which happens when target resumes or any of the areas is freed by someone else (e.g. on reset).
+ * Data section is re-uploaded and stack is allocated for every run.
+ */
+struct esp_algorithm_session {
+	/** Resident stub areas and addresses. Code area is NULL if no stub is loaded. */
+	struct esp_algorithm_stub stub;
+	/** CRC of the loaded stub code section. */
+	uint32_t code_crc;
+	/** Size of the loaded stub code section. */
+	uint32_t code_size;
+	/** Number of stub uploads. */
+	uint32_t loads;
+	/** Number of runs which reused already loaded stub. */
+	uint32_t reuses;
+};
+
 /**
  * Algorithm stub in-memory arguments.
  */
@@ -302,11 +321,16 @@ struct esp_algorithm_run_data {
 	bool check_preloaded_binary;
 	/** True if stub binary is loaded to the target reserved memory */
 	bool run_preloaded_binary;
+	/** Keep stub loaded after the run and reuse it if the next run uses the same stub image */
+	bool use_session;
 };
 
 int esp_algorithm_check_preloaded_image(struct target *target, struct esp_algorithm_run_data *run);
 int esp_algorithm_load_func_image(struct target *target, struct esp_algorithm_run_data *run);
 int esp_algorithm_unload_func_image(struct target *target, struct esp_algorithm_run_data *run);
+int esp_algorithm_session_load_func_image(struct target *target, struct esp_algorithm_run_data *run);
+int esp_algorithm_session_unload_func_image(struct target *target, struct esp_algorithm_run_data *run);
+void esp_algorithm_session_close(struct target *target, struct esp_algorithm_session *session);
 
 int esp_algorithm_exec_func_image_va(struct target *target,
 	struct esp_algorithm_run_data *run,
@@ -330,6 +354,15 @@ static inline int esp_algorithm_run_func_image_va(struct target *target,
 {
 	int ret = ERROR_FAIL;
 
+	if (run->use_session) {
+		ret = esp_algorithm_session_load_func_image(target, run);
+		if (ret != ERROR_OK)
+			return ret;
+		ret = esp_algorithm_exec_func_image_va(target, run, num_args, ap);
+		int rc = esp_algorithm_session_unload_func_image(target, run);
+		return ret != ERROR_OK ? ret : rc;
+	}
+
 	if (run->check_preloaded_binary)
 		ret = esp_algorithm_check_preloaded_image(target, run);
 	if (ret != ERROR_OK) {
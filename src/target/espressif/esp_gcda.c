@@ -0,0 +1,239 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/***************************************************************************
+ *   gcov data file (.gcda) merging                                        *
+ *   Copyright (C) 2025 Espressif Systems Ltd.                             *
+ ***************************************************************************/
+
+/**
+ * @file
+ * Does on the host what libgcov does on the target before writing a .gcda file:
+ * adds the counters of the file written by previous runs to the new ones.
+ * Only files written by the same program (equal header) with the GCC 9+
+ * object summary are supported, as well as the counters merged by plain
+ * addition or bitwise OR. Anything else is rejected and left to the caller.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <helper/log.h>
+#include <helper/types.h>
+#include "esp_gcda.h"
+
+#define GCDA_MAGIC				0x67636461	/* "gcda" */
+#define GCDA_TAG_FUNCTION		0x01000000
+#define GCDA_TAG_COUNTER_BASE	0x01a10000
+#define GCDA_TAG_COUNTER(n)		(GCDA_TAG_COUNTER_BASE + ((uint32_t)(n) << 17))
+#define GCDA_TAG_COUNTERS_NUM	9
+#define GCDA_TAG_OBJECT_SUMMARY	0xa1000000
+
+/* counter kinds whose index is the same in all supported GCC versions */
+#define GCDA_COUNTER_ARCS		0
+#define GCDA_COUNTER_INTERVAL	1
+#define GCDA_COUNTER_POW2		2
+#define GCDA_COUNTER_AVERAGE	5
+#define GCDA_COUNTER_IOR		6
+
+struct gcda_image {
+	const uint8_t *data;
+	size_t size;
+	size_t pos;
+	/* GCC 12+ stores record lengths in bytes instead of words */
+	bool len_in_bytes;
+};
+
+struct gcda_record {
+	uint32_t tag;
+	const uint8_t *payload;
+	/* payload size in bytes */
+	size_t size;
+	/* counters record with all counters zero, stored without payload */
+	bool zero;
+};
+
+static bool gcda_is_tag(uint32_t tag)
+{
+	if (tag == GCDA_TAG_FUNCTION || tag == GCDA_TAG_OBJECT_SUMMARY)
+		return true;
+	for (unsigned int i = 0; i < GCDA_TAG_COUNTERS_NUM; i++) {
+		if (tag == GCDA_TAG_COUNTER(i))
+			return true;
+	}
+	return false;
+}
+
+static uint32_t gcda_word(const struct gcda_image *img, size_t pos)
+{
+	return le_to_h_u32(img->data + pos);
+}
+
+/* Returns header size in bytes, 0 if the image is not supported */
+static size_t gcda_header_parse(struct gcda_image *img)
+{
+	if (img->size < 12 || img->size % 4 || gcda_word(img, 0) != GCDA_MAGIC)
+		return 0;
+
+	/* GCC 12+ appends a checksum word to magic, version and stamp */
+	size_t hdr;
+	if (img->size == 12 || gcda_is_tag(gcda_word(img, 12)))
+		hdr = 12;
+	else if (img->size == 16 || (img->size > 16 && gcda_is_tag(gcda_word(img, 16))))
+		hdr = 16;
+	else
+		return 0;
+
+	/* the object summary comes first and has a fixed size: runs and sum_max */
+	if (img->size > hdr) {
+		if (img->size < hdr + 8 || gcda_word(img, hdr) != GCDA_TAG_OBJECT_SUMMARY)
+			return 0;
+		uint32_t len = gcda_word(img, hdr + 4);
+		if (len == 2)
+			img->len_in_bytes = false;
+		else if (len == 8)
+			img->len_in_bytes = true;
+		else
+			return 0;
+	}
+	img->pos = hdr;
+	return hdr;
+}
+
+/* Returns 1 when a record has been read, 0 at the end of data, -1 on error */
+static int gcda_record_next(struct gcda_image *img, struct gcda_record *rec)
+{
+	if (img->pos == img->size)
+		return 0;
+	if (img->size - img->pos < 8)
+		/* a single zero word terminates data written by some GCC versions */
+		return img->size - img->pos == 4 && gcda_word(img, img->pos) == 0 ? 0 : -1;
+
+	rec->tag = gcda_word(img, img->pos);
+	int32_t len = (int32_t)gcda_word(img, img->pos + 4);
+	img->pos += 8;
+	rec->zero = false;
+	if (len < 0) {
+		if (!img->len_in_bytes || rec->tag == GCDA_TAG_FUNCTION || rec->tag == GCDA_TAG_OBJECT_SUMMARY)
+			return -1;
+		rec->zero = true;
+		rec->payload = NULL;
+		rec->size = -(int64_t)len;
+		return 1;
+	}
+	rec->size = img->len_in_bytes ? (size_t)len : (size_t)len * 4;
+	if (rec->size % 4 || rec->size > img->size - img->pos)
+		return -1;
+	rec->payload = img->data + img->pos;
+	img->pos += rec->size;
+	return 1;
+}
+
+static uint64_t gcda_counter(const struct gcda_record *rec, size_t i)
+{
+	if (rec->zero)
+		return 0;
+	/* low word first */
+	return le_to_h_u32(rec->payload + i * 8) | (uint64_t)le_to_h_u32(rec->payload + i * 8 + 4) << 32;
+}
+
+static uint8_t *gcda_put_word(uint8_t *p, uint32_t val)
+{
+	h_u32_to_le(p, val);
+	return p + 4;
+}
+
+/**
+ * Merges two .gcda images written by the same program.
+ * @param cur data of the current run
+ * @param old data of previous runs, as found on the host
+ * @param out newly allocated merged image, to be freed by the caller
+ * @returns ERROR_OK, or ERROR_FAIL when the images can not be merged
+ */
+int esp_gcda_merge(const uint8_t *cur, size_t cur_size,
+	const uint8_t *old, size_t old_size,
+	uint8_t **out, size_t *out_size)
+{
+	struct gcda_image a = { .data = cur, .size = cur_size };
+	struct gcda_image b = { .data = old, .size = old_size };
+
+	size_t hdr = gcda_header_parse(&a);
+	if (!hdr || gcda_header_parse(&b) != hdr || memcmp(cur, old, hdr) ||
+		(a.size > hdr && b.size > hdr && a.len_in_bytes != b.len_in_bytes)) {
+		LOG_DEBUG("gcda: unsupported format or data of another build");
+		return ERROR_FAIL;
+	}
+
+	/* zero counter records may be expanded, but never beyond the size of the old one */
+	uint8_t *buf = malloc(cur_size + old_size);
+	if (!buf)
+		return ERROR_FAIL;
+	memcpy(buf, cur, hdr);
+	uint8_t *p = buf + hdr;
+
+	while (true) {
+		struct gcda_record ra, rb;
+		int ret_a = gcda_record_next(&a, &ra);
+		int ret_b = gcda_record_next(&b, &rb);
+		if (ret_a < 0 || ret_b < 0 || ret_a != ret_b || (ret_a && ra.tag != rb.tag))
+			goto mismatch;
+		if (!ret_a)
+			break;
+
+		if (ra.tag == GCDA_TAG_FUNCTION) {
+			/* ident and checksums */
+			if (ra.size != rb.size || memcmp(ra.payload, rb.payload, ra.size))
+				goto mismatch;
+			p = gcda_put_word(p, ra.tag);
+			p = gcda_put_word(p, a.len_in_bytes ? ra.size : ra.size / 4);
+			memcpy(p, ra.payload, ra.size);
+			p += ra.size;
+		} else if (ra.tag == GCDA_TAG_OBJECT_SUMMARY) {
+			if (ra.size != 8 || rb.size != 8)
+				goto mismatch;
+			p = gcda_put_word(p, ra.tag);
+			p = gcda_put_word(p, a.len_in_bytes ? 8 : 2);
+			/* runs, sum_max */
+			p = gcda_put_word(p, le_to_h_u32(ra.payload) + le_to_h_u32(rb.payload));
+			p = gcda_put_word(p, le_to_h_u32(ra.payload + 4) + le_to_h_u32(rb.payload + 4));
+		} else {
+			unsigned int kind = (ra.tag - GCDA_TAG_COUNTER_BASE) >> 17;
+			bool ior = kind == GCDA_COUNTER_IOR;
+			if (kind != GCDA_COUNTER_ARCS && kind != GCDA_COUNTER_INTERVAL && kind != GCDA_COUNTER_POW2 &&
+				kind != GCDA_COUNTER_AVERAGE && !ior) {
+				LOG_DEBUG("gcda: can not merge counters 0x%08" PRIx32, ra.tag);
+				goto mismatch;
+			}
+			if (ra.size != rb.size || ra.size % 8)
+				goto mismatch;
+			if (ra.zero && rb.zero) {
+				p = gcda_put_word(p, ra.tag);
+				p = gcda_put_word(p, (uint32_t)-(int32_t)ra.size);
+				continue;
+			}
+			size_t num = ra.size / 8;
+			p = gcda_put_word(p, ra.tag);
+			p = gcda_put_word(p, a.len_in_bytes ? ra.size : ra.size / 4);
+			for (size_t i = 0; i < num; i++) {
+				uint64_t val = ior ? gcda_counter(&ra, i) | gcda_counter(&rb, i) :
+					gcda_counter(&ra, i) + gcda_counter(&rb, i);
+				p = gcda_put_word(p, (uint32_t)val);
+				p = gcda_put_word(p, (uint32_t)(val >> 32));
+			}
+		}
+	}
+	/* keep the terminating word when the current run wrote one */
+	if (a.pos != a.size)
+		p = gcda_put_word(p, 0);
+
+	*out = buf;
+	*out_size = p - buf;
+	return ERROR_OK;
+
+mismatch:
+	LOG_DEBUG("gcda: records do not match");
+	free(buf);
+	return ERROR_FAIL;
+}
@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/***************************************************************************
+ *   gcov data file (.gcda) merging                                        *
+ *   Copyright (C) 2025 Espressif Systems Ltd.                             *
+ ***************************************************************************/
+
+#ifndef OPENOCD_TARGET_ESP_GCDA_H
+#define OPENOCD_TARGET_ESP_GCDA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+int esp_gcda_merge(const uint8_t *cur, size_t cur_size,
+	const uint8_t *old, size_t old_size,
+	uint8_t **out, size_t *out_size);
+
+#endif	/* OPENOCD_TARGET_ESP_GCDA_H */
@@ -301,7 +301,11 @@ int esp_riscv_poll(struct target *target)
 		esp_riscv->was_reset = false;
 	}
 
-	return riscv_openocd_poll(target);
+	uint64_t semihost_requests = target->semihosting ? target->semihosting->requests : 0;
+	res = riscv_openocd_poll(target);
+	if (res == ERROR_OK && target->semihosting && target->semihosting->requests != semihost_requests)
+		esp_common_semihosting_fast_poll(target);
+	return res;
 }
 
 int esp_riscv_alloc_trigger_addr(struct target *target)
@@ -487,6 +491,9 @@ int esp_riscv_breakpoint_add(struct target *target, struct breakpoint *breakpoin
 {
 	struct esp_riscv_common *esp_riscv;
 
+	if (esp_common_flash_breakpoint_reuse(target, breakpoint))
+		return ERROR_OK;
+
 	int res = riscv_add_breakpoint(target, breakpoint);
 	if (res == ERROR_TARGET_RESOURCE_NOT_AVAILABLE && breakpoint->type == BKPT_HARD) {
 		/* For SMP target return OK if SW flash breakpoint is already set using another
@@ -954,9 +961,42 @@ int esp_riscv_core_resume(struct target *target)
 	return ERROR_FAIL;
 }
 
+static int esp_riscv_profiling_prepare(struct target *target, bool start)
+{
+	RISCV_INFO(r);
+
+	if (!r->sample_pc_prep || !r->sample_pc)
+		return ERROR_NOT_IMPLEMENTED;
+	return r->sample_pc_prep(target, start);
+}
+
+static int esp_riscv_profiling_sample_pc(struct target *target, uint32_t *pc)
+{
+	RISCV_INFO(r);
+	riscv_reg_t value;
+
+	int res = r->sample_pc(target, &value);
+	if (res == ERROR_OK)
+		*pc = value;
+	return res;
+}
+
+static const struct esp_profiling_ops esp_riscv_profiling_ops = {
+	.prepare = esp_riscv_profiling_prepare,
+	.sample_pc = esp_riscv_profiling_sample_pc,
+};
+
+int esp_riscv_profiling(struct target *target, uint32_t *samples,
+	uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
+{
+	return esp_common_profiling(target, samples, max_num_samples, num_samples, seconds,
+		&esp_riscv_profiling_ops);
+}
+
 void esp_riscv_deinit_target(struct target *target)
 {
 	struct esp_riscv_common *esp_riscv = target_to_esp_riscv(target);
+	esp_algorithm_session_close(target, &esp_riscv->esp.algo_session);
 	if (esp_riscv->semi_ops->post_reset)
 		esp_riscv->semi_ops->post_reset(target);
 
@@ -995,6 +1035,35 @@ const struct command_registration esp_riscv_command_handlers[] = {
 		.help = "Process flash breakpoints on time",
 		.usage = "",
 	},
+	{
+		.name = "profile_rate",
+		.handler = esp_common_profile_rate_command,
+		.mode = COMMAND_ANY,
+		.help = "Set/get PC sampling rate used by 'profile' in Hz per core, 0 - as fast as possible",
+		.usage = "[rate_hz]",
+	},
+	{
+		.name = "profile_all_cores",
+		.handler = esp_common_profile_all_cores_command,
+		.mode = COMMAND_ANY,
+		.help = "Set/get whether 'profile' samples all cores in turn",
+		.usage = "['on'|'off']",
+	},
+	{
+		.name = "semihost_fast_poll",
+		.handler = esp_common_semihost_fast_poll_command,
+		.mode = COMMAND_ANY,
+		.help = "Set/get time in us to keep re-polling the target after a serviced semihosting call, "
+			"0 - disabled. 'stats' shows fast polling statistics",
+		.usage = "[window_us|'stats']",
+	},
+	{
+		.name = "flash_bp_stats",
+		.handler = esp_common_flash_bp_stats_command,
+		.mode = COMMAND_ANY,
+		.help = "Show flash breakpoint statistics and the most hit HW breakpoints",
+		.usage = "['reset']",
+	},
 	{
 		.name = "halted_event_handler",
 		.handler = esp_riscv_halted_command,
@@ -65,6 +65,8 @@ static inline int esp_riscv_init_arch_info(struct target *target,
 	int ret = esp_common_init(target, &esp_riscv->esp, flash_brps_ops, &riscv_algo_hw);
 	if (ret != ERROR_OK)
 		return ret;
+	esp_riscv->esp.hw_breakpoint_add = riscv_add_breakpoint;
+	esp_riscv->esp.hw_breakpoint_remove = riscv_remove_breakpoint;
 
 	esp_riscv->apptrace.hw = &esp_riscv_apptrace_hw;
 	esp_riscv->semi_ops = (struct esp_semihost_ops *)semi_ops;
@@ -104,6 +106,8 @@ int esp_riscv_write_memory(struct target *target, target_addr_t address,
 int esp_riscv_core_halt(struct target *target);
 int esp_riscv_core_resume(struct target *target);
 int esp_riscv_core_ebreaks_enable(struct target *target);
+int esp_riscv_profiling(struct target *target, uint32_t *samples,
+	uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds);
 void esp_riscv_deinit_target(struct target *target);
 
 extern const struct command_registration esp_riscv_command_handlers[];
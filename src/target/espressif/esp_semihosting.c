@@ -210,7 +210,7 @@ static int esp_semihosting_sys_seek(struct target *target, uint64_t fd, uint32_t
 {
 	struct semihosting *semihosting = target->semihosting;
 
-	semihosting->result = lseek(fd, pos, whence);
+	semihosting->result = semihosting_io_seek(semihosting_get_io(target), fd, pos, whence);
 	semihosting->sys_errno = errno;
 	LOG_TARGET_DEBUG(target, "lseek(%" PRIx64 ", %" PRIu32 " %" PRId64 ")=%d", fd, pos, semihosting->result, errno);
 	return ERROR_OK;
@@ -673,6 +673,7 @@ int esp_semihosting_common(struct target *target)
 		retval = semihosting_read_fields(target, 1, fields);
 		if (retval == ERROR_OK) {
 			int fd = semihosting_get_field(target, 0, fields);
+			semihosting_io_sync(semihosting_get_io(target), fd);
 			semihosting->result = fsync(fd);
 			semihosting->sys_errno = errno;
 			LOG_DEBUG("fsync('%d')=%" PRId64, fd, semihosting->result);
@@ -0,0 +1,528 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ * Decodes the SystemView events as they are received, so the timeline and the
+ * statistics are up to date while tracing. Slices are written to the timeline
+ * as "complete" events when they end, with the names known at that time: the
+ * task names sent after a task started running are still used. Tasks and ISRs
+ * are kept in fixed size tables, nothing is allocated while decoding.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <helper/log.h>
+#include <helper/replacements.h>
+#include "esp_sysview_decoder.h"
+#include "segger_sysview.h"
+
+/* process ID of all the timeline events, the cores are its threads */
+#define ESP_SYSVIEW_TIMELINE_PID	1
+
+static uint32_t esp_sysview_decoder_u32(const uint8_t **ptr, const uint8_t *end)
+{
+	uint32_t val = 0;
+
+	for (unsigned int shift = 0; *ptr < end && shift < 35; shift += 7) {
+		uint8_t b = *(*ptr)++;
+		val |= (uint32_t)(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			break;
+	}
+	return val;
+}
+
+/* Copies a string prefixed by its length, truncating it to the size of @a dst */
+static void esp_sysview_decoder_str(const uint8_t **ptr, const uint8_t *end, char *dst, size_t size)
+{
+	size_t len = 0;
+
+	if (*ptr < end) {
+		len = *(*ptr)++;
+		if (len > (size_t)(end - *ptr))
+			len = end - *ptr;
+	}
+	size_t n = MIN(len, size - 1);
+	memcpy(dst, *ptr, n);
+	dst[n] = '\0';
+	*ptr += len;
+}
+
+double esp_sysview_decoder_ticks_to_us(const struct esp_sysview_decoder *dec, uint64_t ticks)
+{
+	if (!dec->sys_freq)
+		return ticks;
+	return ticks * 1000000.0 / dec->sys_freq;
+}
+
+static void esp_sysview_span_add(struct esp_sysview_decoder_span *span, uint64_t val)
+{
+	if (!span->count || val < span->min)
+		span->min = val;
+	if (val > span->max)
+		span->max = val;
+	span->sum += val;
+	span->count++;
+}
+
+/*********************************************************************
+*                       Timeline (Chrome JSON)
+**********************************************************************/
+
+static void esp_sysview_timeline_write(struct esp_sysview_decoder *dec, const char *fmt, ...)
+{
+	if (!dec->timeline)
+		return;
+
+	/* JSON array format, the closing bracket is optional so the file can be opened while tracing */
+	int res = fputs(dec->timeline_started ? ",\n" : "[\n", dec->timeline);
+	dec->timeline_started = true;
+	if (res >= 0) {
+		va_list ap;
+		va_start(ap, fmt);
+		res = vfprintf(dec->timeline, fmt, ap);
+		va_end(ap);
+	}
+	if (res < 0) {
+		LOG_ERROR("sysview: error writing the timeline, closing it");
+		fclose(dec->timeline);
+		dec->timeline = NULL;
+	}
+}
+
+static void esp_sysview_json_escape(char *dst, size_t size, const char *src)
+{
+	size_t n = 0;
+
+	for (; *src && n + 7 < size; src++) {
+		unsigned char c = *src;
+		if (c == '"' || c == '\\') {
+			dst[n++] = '\\';
+			dst[n++] = c;
+		} else if (c < 0x20 || c >= 0x7f) {
+			n += snprintf(dst + n, size - n, "\\u%04x", c);
+		} else {
+			dst[n++] = c;
+		}
+	}
+	dst[n] = '\0';
+}
+
+static void esp_sysview_timeline_slice(struct esp_sysview_decoder *dec, unsigned int core,
+	const char *cat, const char *name, uint64_t start, uint64_t end)
+{
+	char escaped[ESP_SYSVIEW_DECODER_NAME_MAX * 6 + 1];
+
+	if (!dec->timeline)
+		return;
+	esp_sysview_json_escape(escaped, sizeof(escaped), name);
+	esp_sysview_timeline_write(dec,
+		"{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u}",
+		escaped, cat,
+		esp_sysview_decoder_ticks_to_us(dec, start),
+		esp_sysview_decoder_ticks_to_us(dec, end - start),
+		ESP_SYSVIEW_TIMELINE_PID, core);
+}
+
+static void esp_sysview_timeline_instant(struct esp_sysview_decoder *dec, unsigned int core,
+	const char *name, uint32_t arg)
+{
+	esp_sysview_timeline_write(dec,
+		"{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u,\"args\":{\"value\":%" PRIu32 "}}",
+		name, esp_sysview_decoder_ticks_to_us(dec, dec->ts), ESP_SYSVIEW_TIMELINE_PID, core, arg);
+}
+
+/*********************************************************************
+*                       Tasks and ISRs
+**********************************************************************/
+
+static int esp_sysview_task_get(struct esp_sysview_decoder *dec, uint32_t id)
+{
+	for (unsigned int i = 0; i < dec->tasks_num; i++) {
+		if (dec->tasks[i].id == id)
+			return i;
+	}
+	if (dec->tasks_num == ESP_SYSVIEW_DECODER_TASKS) {
+		dec->untracked++;
+		return -1;
+	}
+	struct esp_sysview_decoder_task *task = &dec->tasks[dec->tasks_num];
+	memset(task, 0, sizeof(*task));
+	task->id = id;
+	task->core = -1;
+	snprintf(task->name, sizeof(task->name), "task 0x%" PRIx32, id);
+	return dec->tasks_num++;
+}
+
+static int esp_sysview_isr_get(struct esp_sysview_decoder *dec, uint32_t number)
+{
+	for (unsigned int i = 0; i < dec->isrs_num; i++) {
+		if (dec->isrs[i].number == number)
+			return i;
+	}
+	if (dec->isrs_num == ESP_SYSVIEW_DECODER_ISRS) {
+		dec->untracked++;
+		return -1;
+	}
+	struct esp_sysview_decoder_isr *isr = &dec->isrs[dec->isrs_num];
+	memset(isr, 0, sizeof(*isr));
+	isr->number = number;
+	snprintf(isr->name, sizeof(isr->name), "ISR %" PRIu32, number);
+	return dec->isrs_num++;
+}
+
+static void esp_sysview_task_name(struct esp_sysview_decoder *dec, uint32_t id, char *name, size_t size)
+{
+	int idx = esp_sysview_task_get(dec, id);
+	if (idx < 0)
+		snprintf(name, size, "task 0x%" PRIx32, id);
+	else
+		snprintf(name, size, "%s", dec->tasks[idx].name);
+}
+
+/* Takes the ISR names from the "I#<number>=<name>" entries of a system description */
+static void esp_sysview_sysdesc_parse(struct esp_sysview_decoder *dec, const char *desc)
+{
+	while (*desc) {
+		const char *next = strchr(desc, ',');
+		size_t len = next ? (size_t)(next - desc) : strlen(desc);
+
+		if (!strncmp(desc, "I#", 2)) {
+			char *eq;
+			unsigned long number = strtoul(desc + 2, &eq, 0);
+			if (*eq == '=' && eq < desc + len) {
+				int idx = esp_sysview_isr_get(dec, number);
+				if (idx >= 0) {
+					size_t n = MIN((size_t)(desc + len - eq - 1), ESP_SYSVIEW_DECODER_NAME_MAX - 1);
+					memcpy(dec->isrs[idx].name, eq + 1, n);
+					dec->isrs[idx].name[n] = '\0';
+				}
+			}
+		}
+		desc += len;
+		if (*desc == ',')
+			desc++;
+	}
+}
+
+/*********************************************************************
+*                       Cores
+**********************************************************************/
+
+/* Adds the time since the last event to the context the core is in */
+static void esp_sysview_core_account(struct esp_sysview_decoder *dec, struct esp_sysview_decoder_core *core,
+	uint64_t until)
+{
+	uint64_t elapsed = until - core->ts;
+
+	core->ts = until;
+	if (!core->seen || !elapsed)
+		return;
+	if (core->isr_depth) {
+		core->isr_time += elapsed;
+	} else if (core->ctx == ESP_SYSVIEW_DECODER_IDLE) {
+		core->idle_time += elapsed;
+		return;
+	} else if (core->ctx == ESP_SYSVIEW_DECODER_TASK && core->task >= 0) {
+		dec->tasks[core->task].run_time += elapsed;
+		dec->tasks[core->task].window_time += elapsed;
+	}
+	core->busy_time += elapsed;
+	core->window_busy += elapsed;
+}
+
+static void esp_sysview_window_close(struct esp_sysview_decoder *dec)
+{
+	for (unsigned int i = 0; i < ESP_SYSVIEW_DECODER_CORES; i++) {
+		struct esp_sysview_decoder_core *core = &dec->cores[i];
+		core->last_load = core->window_busy * 1000 / dec->window_ticks;
+		core->window_busy = 0;
+	}
+	for (unsigned int i = 0; i < dec->tasks_num; i++) {
+		dec->tasks[i].last_window_time = dec->tasks[i].window_time;
+		dec->tasks[i].window_time = 0;
+	}
+}
+
+/* Accounts the time up to @a now to all the cores, closing the windows that ended before */
+static void esp_sysview_advance(struct esp_sysview_decoder *dec, uint64_t now)
+{
+	uint64_t windows = (now - dec->window_start) / dec->window_ticks;
+
+	if (windows > 1) {
+		/* after a long gap only the last of the windows without events is kept */
+		uint64_t skip_end = dec->window_start + (windows - 1) * dec->window_ticks;
+		for (unsigned int i = 0; i < ESP_SYSVIEW_DECODER_CORES; i++)
+			esp_sysview_core_account(dec, &dec->cores[i], skip_end);
+		esp_sysview_window_close(dec);
+		dec->window_start = skip_end;
+		dec->windows += windows - 1;
+		windows = 1;
+	}
+	if (windows) {
+		uint64_t end = dec->window_start + dec->window_ticks;
+		for (unsigned int i = 0; i < ESP_SYSVIEW_DECODER_CORES; i++)
+			esp_sysview_core_account(dec, &dec->cores[i], end);
+		esp_sysview_window_close(dec);
+		dec->window_start = end;
+		dec->windows++;
+	}
+	for (unsigned int i = 0; i < ESP_SYSVIEW_DECODER_CORES; i++)
+		esp_sysview_core_account(dec, &dec->cores[i], now);
+}
+
+static void esp_sysview_window_set(struct esp_sysview_decoder *dec)
+{
+	uint64_t freq = dec->sys_freq ? dec->sys_freq : 1000000;
+
+	dec->window_ticks = MAX(1, (uint64_t)dec->window_us * freq / 1000000);
+	dec->window_start = dec->ts;
+	for (unsigned int i = 0; i < ESP_SYSVIEW_DECODER_CORES; i++)
+		dec->cores[i].window_busy = 0;
+	for (unsigned int i = 0; i < dec->tasks_num; i++)
+		dec->tasks[i].window_time = 0;
+}
+
+/* Ends the task or idle slice of a core */
+static void esp_sysview_core_ctx_end(struct esp_sysview_decoder *dec, unsigned int core_id)
+{
+	struct esp_sysview_decoder_core *core = &dec->cores[core_id];
+	char name[ESP_SYSVIEW_DECODER_NAME_MAX];
+
+	if (core->ctx == ESP_SYSVIEW_DECODER_TASK) {
+		if (core->task >= 0)
+			dec->tasks[core->task].core = -1;
+		esp_sysview_task_name(dec, core->task_id, name, sizeof(name));
+		esp_sysview_timeline_slice(dec, core_id, "task", name, core->ctx_start_ts, dec->ts);
+	} else if (core->ctx == ESP_SYSVIEW_DECODER_IDLE) {
+		esp_sysview_timeline_slice(dec, core_id, "idle", "idle", core->ctx_start_ts, dec->ts);
+	}
+	core->ctx = ESP_SYSVIEW_DECODER_SCHED;
+	core->ctx_start_ts = dec->ts;
+}
+
+static void esp_sysview_task_start(struct esp_sysview_decoder *dec, unsigned int core_id, uint32_t id)
+{
+	struct esp_sysview_decoder_core *core = &dec->cores[core_id];
+	int idx = esp_sysview_task_get(dec, id);
+
+	esp_sysview_core_ctx_end(dec, core_id);
+	if (idx >= 0) {
+		struct esp_sysview_decoder_task *task = &dec->tasks[idx];
+		/* a stop on the other core has been lost */
+		if (task->core >= 0 && task->core != (int)core_id)
+			esp_sysview_core_ctx_end(dec, task->core);
+		task->core = core_id;
+		task->runs++;
+		if (task->ready) {
+			esp_sysview_span_add(&task->latency, dec->ts - task->ready_ts);
+			task->ready = false;
+		}
+	}
+	core->ctx = ESP_SYSVIEW_DECODER_TASK;
+	core->task = idx;
+	core->task_id = id;
+}
+
+static void esp_sysview_task_ready(struct esp_sysview_decoder *dec, uint32_t id, bool ready)
+{
+	int idx = esp_sysview_task_get(dec, id);
+
+	if (idx < 0)
+		return;
+	struct esp_sysview_decoder_task *task = &dec->tasks[idx];
+	if (ready && !task->ready && task->core < 0) {
+		task->ready = true;
+		task->ready_ts = dec->ts;
+	} else if (!ready) {
+		task->ready = false;
+	}
+}
+
+static void esp_sysview_isr_enter(struct esp_sysview_decoder *dec, unsigned int core_id, uint32_t number)
+{
+	struct esp_sysview_decoder_core *core = &dec->cores[core_id];
+
+	if (core->isr_depth == ESP_SYSVIEW_DECODER_ISR_DEPTH) {
+		dec->errors++;
+		return;
+	}
+	core->isr[core->isr_depth] = number;
+	core->isr_enter_ts[core->isr_depth] = dec->ts;
+	core->isr_depth++;
+}
+
+static void esp_sysview_isr_exit(struct esp_sysview_decoder *dec, unsigned int core_id)
+{
+	struct esp_sysview_decoder_core *core = &dec->cores[core_id];
+
+	/* the trace may have started in the ISR */
+	if (!core->isr_depth)
+		return;
+	core->isr_depth--;
+	uint32_t number = core->isr[core->isr_depth];
+	uint64_t enter_ts = core->isr_enter_ts[core->isr_depth];
+	int idx = esp_sysview_isr_get(dec, number);
+	char name[ESP_SYSVIEW_DECODER_NAME_MAX];
+
+	if (idx >= 0) {
+		esp_sysview_span_add(&dec->isrs[idx].duration, dec->ts - enter_ts);
+		snprintf(name, sizeof(name), "%s", dec->isrs[idx].name);
+	} else {
+		snprintf(name, sizeof(name), "ISR %" PRIu32, number);
+	}
+	esp_sysview_timeline_slice(dec, core_id, "isr", name, enter_ts, dec->ts);
+}
+
+/*********************************************************************
+*                       Decoder API
+**********************************************************************/
+
+void esp_sysview_decoder_init(struct esp_sysview_decoder *dec, FILE *timeline, uint32_t window_us)
+{
+	memset(dec, 0, sizeof(*dec));
+	dec->timeline = timeline;
+	dec->window_us = window_us ? window_us : ESP_SYSVIEW_DECODER_WINDOW_US;
+	for (unsigned int i = 0; i < ESP_SYSVIEW_DECODER_CORES; i++)
+		dec->cores[i].task = -1;
+	esp_sysview_window_set(dec);
+	esp_sysview_timeline_write(dec,
+		"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"SystemView\"}}",
+		ESP_SYSVIEW_TIMELINE_PID);
+}
+
+void esp_sysview_decoder_reset(struct esp_sysview_decoder *dec)
+{
+	for (unsigned int i = 0; i < ESP_SYSVIEW_DECODER_CORES; i++) {
+		struct esp_sysview_decoder_core *core = &dec->cores[i];
+		core->busy_time = 0;
+		core->idle_time = 0;
+		core->isr_time = 0;
+		core->last_load = 0;
+	}
+	for (unsigned int i = 0; i < dec->tasks_num; i++) {
+		struct esp_sysview_decoder_task *task = &dec->tasks[i];
+		task->runs = 0;
+		task->run_time = 0;
+		task->last_window_time = 0;
+		memset(&task->latency, 0, sizeof(task->latency));
+	}
+	for (unsigned int i = 0; i < dec->isrs_num; i++)
+		memset(&dec->isrs[i].duration, 0, sizeof(dec->isrs[i].duration));
+	dec->windows = 0;
+	dec->events = 0;
+	dec->overflows = 0;
+	dec->lost_events = 0;
+	dec->untracked = 0;
+	dec->errors = 0;
+	dec->stats_ts = dec->ts;
+	esp_sysview_window_set(dec);
+}
+
+void esp_sysview_decoder_event(struct esp_sysview_decoder *dec, unsigned int core_id, uint16_t event_id,
+	const uint8_t *payload, uint32_t payload_len, uint32_t delta)
+{
+	const uint8_t *end = payload + payload_len;
+	char str[256];
+
+	dec->events++;
+	dec->ts += delta;
+	if (core_id >= ESP_SYSVIEW_DECODER_CORES) {
+		dec->errors++;
+		return;
+	}
+	esp_sysview_advance(dec, dec->ts);
+
+	struct esp_sysview_decoder_core *core = &dec->cores[core_id];
+	if (!core->seen) {
+		core->seen = true;
+		core->ctx_start_ts = dec->ts;
+		esp_sysview_timeline_write(dec,
+			"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"core %u\"}}",
+			ESP_SYSVIEW_TIMELINE_PID, core_id, core_id);
+	}
+
+	switch (event_id) {
+	case SYSVIEW_EVTID_ISR_ENTER:
+		esp_sysview_isr_enter(dec, core_id, esp_sysview_decoder_u32(&payload, end));
+		break;
+	case SYSVIEW_EVTID_ISR_EXIT:
+	case SYSVIEW_EVTID_ISR_TO_SCHEDULER:
+		/* the task switch, if any, is sent as a separate event */
+		esp_sysview_isr_exit(dec, core_id);
+		break;
+	case SYSVIEW_EVTID_TASK_START_EXEC:
+		esp_sysview_task_start(dec, core_id, esp_sysview_decoder_u32(&payload, end));
+		break;
+	case SYSVIEW_EVTID_TASK_STOP_EXEC:
+		esp_sysview_core_ctx_end(dec, core_id);
+		break;
+	case SYSVIEW_EVTID_IDLE:
+		esp_sysview_core_ctx_end(dec, core_id);
+		core->ctx = ESP_SYSVIEW_DECODER_IDLE;
+		break;
+	case SYSVIEW_EVTID_TASK_START_READY:
+		esp_sysview_task_ready(dec, esp_sysview_decoder_u32(&payload, end), true);
+		break;
+	case SYSVIEW_EVTID_TASK_STOP_READY:
+	case SYSVIEW_EVTID_TASK_TERMINATE:
+		esp_sysview_task_ready(dec, esp_sysview_decoder_u32(&payload, end), false);
+		break;
+	case SYSVIEW_EVTID_TASK_CREATE:
+		esp_sysview_task_get(dec, esp_sysview_decoder_u32(&payload, end));
+		break;
+	case SYSVIEW_EVTID_TASK_INFO: {
+		uint32_t id = esp_sysview_decoder_u32(&payload, end);
+		esp_sysview_decoder_u32(&payload, end);	/* priority */
+		int idx = esp_sysview_task_get(dec, id);
+		if (idx >= 0)
+			esp_sysview_decoder_str(&payload, end, dec->tasks[idx].name, sizeof(dec->tasks[idx].name));
+		break;
+	}
+	case SYSVIEW_EVTID_SYSDESC:
+		esp_sysview_decoder_str(&payload, end, str, sizeof(str));
+		esp_sysview_sysdesc_parse(dec, str);
+		break;
+	case SYSVIEW_EVTID_INIT:
+		dec->sys_freq = esp_sysview_decoder_u32(&payload, end);
+		esp_sysview_window_set(dec);
+		break;
+	case SYSVIEW_EVTID_OVERFLOW: {
+		uint32_t lost = esp_sysview_decoder_u32(&payload, end);
+		dec->overflows++;
+		dec->lost_events += lost;
+		esp_sysview_timeline_instant(dec, core_id, "overflow", lost);
+		break;
+	}
+	case SYSVIEW_EVTID_TRACE_START:
+		esp_sysview_timeline_instant(dec, core_id, "trace start", 0);
+		break;
+	case SYSVIEW_EVTID_TRACE_STOP:
+		esp_sysview_timeline_instant(dec, core_id, "trace stop", 0);
+		break;
+	default:
+		break;
+	}
+}
+
+void esp_sysview_decoder_finish(struct esp_sysview_decoder *dec)
+{
+	for (unsigned int i = 0; i < ESP_SYSVIEW_DECODER_CORES; i++) {
+		struct esp_sysview_decoder_core *core = &dec->cores[i];
+		if (!core->seen)
+			continue;
+		while (core->isr_depth)
+			esp_sysview_isr_exit(dec, i);
+		esp_sysview_core_ctx_end(dec, i);
+	}
+	if (dec->timeline && dec->timeline_started)
+		fputs("\n]\n", dec->timeline);
+	if (dec->timeline)
+		fflush(dec->timeline);
+}
@@ -0,0 +1,130 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_ESP_SYSVIEW_DECODER_H
+#define OPENOCD_TARGET_ESP_SYSVIEW_DECODER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @file
+ * Host side decoder of the SEGGER SystemView events sent by the ESP-IDF
+ * tracing library. It follows the task and ISR running on every core, writes
+ * the resulting timeline as a Chrome JSON trace (opened by the Perfetto UI)
+ * and keeps CPU load, ISR duration and task wake-up latency statistics.
+ */
+
+#define ESP_SYSVIEW_DECODER_CORES		2
+#define ESP_SYSVIEW_DECODER_TASKS		64
+#define ESP_SYSVIEW_DECODER_ISRS		64
+/* nested interrupts followed per core */
+#define ESP_SYSVIEW_DECODER_ISR_DEPTH	8
+#define ESP_SYSVIEW_DECODER_NAME_MAX	32
+/* default length of the window the loads are computed on, in microseconds */
+#define ESP_SYSVIEW_DECODER_WINDOW_US	1000000
+
+/** Minimum, maximum and sum of durations, in timestamp ticks */
+struct esp_sysview_decoder_span {
+	uint32_t count;
+	uint64_t min;
+	uint64_t max;
+	uint64_t sum;
+};
+
+struct esp_sysview_decoder_task {
+	/** ID as sent by the target, shrunk by the RAM base and ID shift */
+	uint32_t id;
+	char name[ESP_SYSVIEW_DECODER_NAME_MAX];
+	/** core the task is running on, -1 when it is not running */
+	int core;
+	bool ready;
+	uint64_t ready_ts;
+	uint32_t runs;
+	uint64_t run_time;
+	uint64_t window_time;
+	/** run time during the last complete window */
+	uint64_t last_window_time;
+	/** from ready to running */
+	struct esp_sysview_decoder_span latency;
+};
+
+struct esp_sysview_decoder_isr {
+	uint32_t number;
+	char name[ESP_SYSVIEW_DECODER_NAME_MAX];
+	/** from enter to exit, nested interrupts included */
+	struct esp_sysview_decoder_span duration;
+};
+
+enum esp_sysview_decoder_ctx {
+	/** between a task stop and the next task start */
+	ESP_SYSVIEW_DECODER_SCHED,
+	ESP_SYSVIEW_DECODER_TASK,
+	ESP_SYSVIEW_DECODER_IDLE,
+};
+
+struct esp_sysview_decoder_core {
+	bool seen;
+	enum esp_sysview_decoder_ctx ctx;
+	uint64_t ctx_start_ts;
+	/** ID of the running task, valid in ESP_SYSVIEW_DECODER_TASK */
+	uint32_t task_id;
+	/** index of the running task, -1 when the task table is full */
+	int task;
+	unsigned int isr_depth;
+	uint32_t isr[ESP_SYSVIEW_DECODER_ISR_DEPTH];
+	uint64_t isr_enter_ts[ESP_SYSVIEW_DECODER_ISR_DEPTH];
+	/** time accounted up to */
+	uint64_t ts;
+	uint64_t busy_time;
+	uint64_t idle_time;
+	uint64_t isr_time;
+	uint64_t window_busy;
+	/** load during the last complete window, in 1/1000 */
+	unsigned int last_load;
+};
+
+struct esp_sysview_decoder {
+	/** Chrome JSON trace being written, or NULL */
+	FILE *timeline;
+	bool timeline_started;
+	/** timestamp frequency from the init event, 0 until it is received */
+	uint32_t sys_freq;
+	/** sum of the event time deltas */
+	uint64_t ts;
+	/** timestamp the statistics were cleared at */
+	uint64_t stats_ts;
+	uint32_t window_us;
+	uint64_t window_start;
+	uint64_t window_ticks;
+	uint32_t windows;
+
+	struct esp_sysview_decoder_core cores[ESP_SYSVIEW_DECODER_CORES];
+	unsigned int tasks_num;
+	struct esp_sysview_decoder_task tasks[ESP_SYSVIEW_DECODER_TASKS];
+	unsigned int isrs_num;
+	struct esp_sysview_decoder_isr isrs[ESP_SYSVIEW_DECODER_ISRS];
+
+	/* statistics */
+	uint64_t events;
+	uint64_t overflows;
+	/** events dropped by the target, as reported by overflow events */
+	uint64_t lost_events;
+	/** tasks or ISRs not followed because their table is full */
+	uint64_t untracked;
+	uint64_t errors;
+};
+
+/** Starts decoding a new trace, the timeline is written to @a timeline when not NULL */
+void esp_sysview_decoder_init(struct esp_sysview_decoder *dec, FILE *timeline, uint32_t window_us);
+/** Clears the statistics, the state of the cores and the known names are kept */
+void esp_sysview_decoder_reset(struct esp_sysview_decoder *dec);
+/** Handles one event, @a delta is its timestamp delta from the previous event of any core */
+void esp_sysview_decoder_event(struct esp_sysview_decoder *dec, unsigned int core, uint16_t event_id,
+	const uint8_t *payload, uint32_t payload_len, uint32_t delta);
+/** Closes the slices still open and completes the timeline, the file is not closed */
+void esp_sysview_decoder_finish(struct esp_sysview_decoder *dec);
+/** Converts timestamp ticks to microseconds, ticks are taken as microseconds until the frequency is known */
+double esp_sysview_decoder_ticks_to_us(const struct esp_sysview_decoder *dec, uint64_t ticks);
+
+#endif /* OPENOCD_TARGET_ESP_SYSVIEW_DECODER_H */
@@ -171,6 +171,8 @@ int esp_xtensa_init_arch_info(struct target *target,
 	ret = esp_common_init(target, &esp_xtensa->esp, esp_ops->flash_brps_ops, &xtensa_algo_hw);
 	if (ret != ERROR_OK)
 		return ret;
+	esp_xtensa->esp.hw_breakpoint_add = xtensa_breakpoint_add;
+	esp_xtensa->esp.hw_breakpoint_remove = xtensa_breakpoint_remove;
 
 	INIT_LIST_HEAD(&esp_xtensa->semihost.dir_map_list);
 	esp_xtensa->semihost.ops = (struct esp_semihost_ops *)esp_ops->semihost_ops;
@@ -193,6 +195,8 @@ void esp_xtensa_target_deinit(struct target *target)
 {
 	LOG_DEBUG("start");
 
+	esp_algorithm_session_close(target, &target_to_esp_xtensa(target)->esp.algo_session);
+
 	if (target_was_examined(target)) {
 		int ret = esp_xtensa_dbgstubs_restore(target);
 		if (ret != ERROR_OK)
@@ -350,6 +354,9 @@ int esp_xtensa_breakpoint_add(struct target *target, struct breakpoint *breakpoi
 {
 	struct esp_xtensa_common *esp_xtensa;
 
+	if (esp_common_flash_breakpoint_reuse(target, breakpoint))
+		return ERROR_OK;
+
 	int res = xtensa_breakpoint_add(target, breakpoint);
 	if (res == ERROR_TARGET_RESOURCE_NOT_AVAILABLE && breakpoint->type == BKPT_HARD) {
 		/* For SMP target return OK if SW flash breakpoint is already set using another core;
@@ -384,6 +391,21 @@ int esp_xtensa_breakpoint_remove(struct target *target, struct breakpoint *break
 	return res;
 }
 
+static int esp_xtensa_profiling_prepare(struct target *target, bool start)
+{
+	struct xtensa *xtensa = target_to_xtensa(target);
+
+	if (start && xtensa->core_config->core_type != XT_LX)
+		return ERROR_NOT_IMPLEMENTED;
+	/* Do not let the short debug interrupt halt the other cores */
+	return xtensa_smpbreak_write(xtensa, start ? 0 : xtensa->smp_break);
+}
+
+static const struct esp_profiling_ops esp_xtensa_profiling_ops = {
+	.prepare = esp_xtensa_profiling_prepare,
+	.sample_pc = xtensa_sample_pc,
+};
+
 int esp_xtensa_profiling(struct target *target, uint32_t *samples,
 	uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
 {
@@ -405,11 +427,13 @@ int esp_xtensa_profiling(struct target *target, uint32_t *samples,
 	xtensa_queue_dbg_reg_read(xtensa, XDMREG_DEBUGPC, buf);
 	res = xtensa_dm_queue_execute(&xtensa->dbg_mod);
 	if (res != ERROR_OK) {
-		LOG_TARGET_INFO(target, "Failed to read DEBUGPC, fallback to stop-and-go");
-		return target_profiling_default(target, samples, max_num_samples, num_samples, seconds);
+		LOG_TARGET_INFO(target, "Failed to read DEBUGPC, fallback to PC sampling");
+		return esp_common_profiling(target, samples, max_num_samples, num_samples, seconds,
+			&esp_xtensa_profiling_ops);
 	} else if (buf[0] == 0 && buf[1] == 0 && buf[2] == 0 && buf[3] == 0) {
-		LOG_TARGET_INFO(target, "NULL DEBUGPC, fallback to stop-and-go");
-		return target_profiling_default(target, samples, max_num_samples, num_samples, seconds);
+		LOG_TARGET_INFO(target, "NULL DEBUGPC, fallback to PC sampling");
+		return esp_common_profiling(target, samples, max_num_samples, num_samples, seconds,
+			&esp_xtensa_profiling_ops);
 	}
 
 	LOG_TARGET_INFO(target, "Starting XTENSA DEBUGPC profiling. Sampling as fast as we can...");
@@ -471,5 +495,34 @@ const struct command_registration esp_command_handlers[] = {
 		.help = "Process flash breakpoints on time",
 		.usage = "",
 	},
+	{
+		.name = "profile_rate",
+		.handler = esp_common_profile_rate_command,
+		.mode = COMMAND_ANY,
+		.help = "Set/get PC sampling rate used by 'profile' in Hz per core, 0 - as fast as possible",
+		.usage = "[rate_hz]",
+	},
+	{
+		.name = "profile_all_cores",
+		.handler = esp_common_profile_all_cores_command,
+		.mode = COMMAND_ANY,
+		.help = "Set/get whether 'profile' samples all cores in turn",
+		.usage = "['on'|'off']",
+	},
+	{
+		.name = "semihost_fast_poll",
+		.handler = esp_common_semihost_fast_poll_command,
+		.mode = COMMAND_ANY,
+		.help = "Set/get time in us to keep re-polling the target after a serviced semihosting call, "
+			"0 - disabled. 'stats' shows fast polling statistics",
+		.usage = "[window_us|'stats']",
+	},
+	{
+		.name = "flash_bp_stats",
+		.handler = esp_common_flash_bp_stats_command,
+		.mode = COMMAND_ANY,
+		.help = "Show flash breakpoint statistics and the most hit HW breakpoints",
+		.usage = "['reset']",
+	},
 	COMMAND_REGISTRATION_DONE
 };
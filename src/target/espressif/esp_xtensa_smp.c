@@ -257,6 +257,7 @@ int esp_xtensa_smp_poll(struct target *target)
 						LOG_ERROR("Failed to resume target");
 						return ret;
 					}
+					esp_common_semihosting_fast_poll(target);
 				}
 				return ret;
 			} else if (retval == SEMIHOSTING_WAITING) {
@@ -284,6 +285,36 @@ int esp_xtensa_smp_poll(struct target *target)
 	return ERROR_OK;
 }
 
+/* Reads DSR of the other cores in one queue execution, so that only the stopped ones need a full poll.
+ * Returns NULL if that is not possible, e.g. when the cores are accessed via DAP. */
+static uint8_t *esp_xtensa_smp_core_status_prefetch(struct target *target)
+{
+	struct target_list *head;
+	unsigned int core = 0;
+
+	foreach_smp_target(head, target->smp_targets) {
+		if (target_to_xtensa(head->target)->dbg_mod.dap)
+			return NULL;
+	}
+
+	uint8_t *dsr_bufs = calloc(list_count_nodes(target->smp_targets), sizeof(uint32_t));
+	if (!dsr_bufs)
+		return NULL;
+	foreach_smp_target(head, target->smp_targets) {
+		struct target *curr = head->target;
+		if (curr != target && target_was_examined(curr) && curr->state != TARGET_HALTED)
+			xtensa_dm_queue_core_status_read(&target_to_xtensa(curr)->dbg_mod, &dsr_bufs[core * sizeof(uint32_t)]);
+		else
+			buf_set_u32(&dsr_bufs[core * sizeof(uint32_t)], 0, 32, OCDDSR_STOPPED);
+		core++;
+	}
+	if (xtensa_dm_queue_execute(&target_to_xtensa(target)->dbg_mod) != ERROR_OK) {
+		free(dsr_bufs);
+		return NULL;
+	}
+	return dsr_bufs;
+}
+
 static int esp_xtensa_smp_update_halt_gdb(struct target *target, bool *need_resume)
 {
 	struct esp_xtensa_smp_common *esp_xtensa_smp;
@@ -306,9 +337,13 @@ static int esp_xtensa_smp_update_halt_gdb(struct target *target, bool *need_resu
 	if (target->gdb_service)
 		gdb_target = target->gdb_service->target;
 
+	uint8_t *dsr_bufs = esp_xtensa_smp_core_status_prefetch(target);
+	unsigned int core = 0;
+
 	/* due to smpbreak config other cores can also go to HALTED state */
 	foreach_smp_target(head, target->smp_targets) {
 		curr = head->target;
+		bool stopped = !dsr_bufs || (buf_get_u32(&dsr_bufs[core++ * sizeof(uint32_t)], 0, 32) & OCDDSR_STOPPED);
 		LOG_DEBUG("Check target '%s'", target_name(curr));
 		/* skip calling context */
 		if (curr == target)
@@ -323,6 +358,9 @@ static int esp_xtensa_smp_update_halt_gdb(struct target *target, bool *need_resu
 		/* Skip gdb_target; it alerts GDB so has to be polled as last one */
 		if (curr == gdb_target)
 			continue;
+		/* still running, its regular poll will do */
+		if (!stopped)
+			continue;
 		LOG_DEBUG("Poll target '%s'", target_name(curr));
 
 		esp_xtensa_smp = target_to_esp_xtensa_smp(curr);
@@ -335,8 +373,10 @@ static int esp_xtensa_smp_update_halt_gdb(struct target *target, bool *need_resu
 		else
 			ret = esp_xtensa_smp_poll(curr);
 		curr->smp = 1;
-		if (ret != ERROR_OK)
+		if (ret != ERROR_OK) {
+			free(dsr_bufs);
 			return ret;
+		}
 		esp_xtensa_smp->other_core_does_resume = false;
 		struct esp_xtensa_common *curr_esp_xtensa = target_to_esp_xtensa(curr);
 		if (curr_esp_xtensa->semihost.need_resume) {
@@ -345,6 +385,8 @@ static int esp_xtensa_smp_update_halt_gdb(struct target *target, bool *need_resu
 		}
 	}
 
+	free(dsr_bufs);
+
 	/* after all targets were updated, poll the gdb serving target */
 	if (gdb_target && gdb_target != target) {
 		esp_xtensa_smp = target_to_esp_xtensa_smp(gdb_target);
@@ -372,28 +414,105 @@ static inline int esp_xtensa_smp_smpbreak_restore(struct target *target, uint32_
 	return xtensa_smpbreak_set(target, smp_break);
 }
 
+/* Collects the target and the other SMP cores which have to be resumed together with it */
+static int esp_xtensa_smp_resume_cores_get(struct target *target, struct target ***cores, unsigned int *num_cores)
+{
+	struct target_list *head;
+
+	*cores = calloc(list_count_nodes(target->smp_targets) + 1, sizeof(**cores));
+	if (!*cores) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	(*cores)[0] = target;
+	*num_cores = 1;
+	foreach_smp_target(head, target->smp_targets) {
+		struct target *curr = head->target;
+		/* in single-core mode disabled core cannot be examined, but need to be resumed too*/
+		if ((curr != target) && (curr->state != TARGET_RUNNING) && target_was_examined(curr))
+			(*cores)[(*num_cores)++] = curr;
+	}
+	return ERROR_OK;
+}
+
+static int esp_xtensa_smp_prepare_resume_core(struct target *target,
+	int current,
+	target_addr_t address,
+	int handle_breakpoints,
+	int debug_execution)
+{
+	uint32_t smp_break;
+
+	/* xtensa_prepare_resume() can step over breakpoint/watchpoint and generate signals on BreakInOut circuit for
+	 * other cores. So disconnect this core from BreakInOut circuit and do xtensa_prepare_resume(). */
+	int res = esp_xtensa_smp_smpbreak_disable(target, &smp_break);
+	if (res != ERROR_OK)
+		return res;
+	res = xtensa_prepare_resume(target, current, address, handle_breakpoints, debug_execution);
+	/* restore configured BreakInOut signals config */
+	int ret = esp_xtensa_smp_smpbreak_restore(target, smp_break);
+	if (ret != ERROR_OK)
+		return ret;
+	if (res != ERROR_OK)
+		LOG_TARGET_ERROR(target, "Failed to prepare for resume!");
+	return res;
+}
+
+/* Restores registers of all cores one by one, then lets them leave debug mode in one queue execution,
+ * so that the cores start at the same time and the resume costs a single round trip to the adapter. */
 static int esp_xtensa_smp_resume_cores(struct target *target,
+	int current,
+	target_addr_t address,
 	int handle_breakpoints,
 	int debug_execution)
 {
-	struct target_list *head;
-	struct target *curr;
+	struct target **cores;
+	unsigned int num_cores;
 
 	LOG_TARGET_DEBUG(target, "begin");
 
-	foreach_smp_target(head, target->smp_targets) {
-		curr = head->target;
-		/* in single-core mode disabled core cannot be examined, but need to be resumed too*/
-		if ((curr != target) && (curr->state != TARGET_RUNNING) && target_was_examined(curr)) {
-			/*  resume current address, not in SMP mode */
-			curr->smp = 0;
-			int res = esp_xtensa_smp_resume(curr, 1, 0, handle_breakpoints, debug_execution);
-			curr->smp = 1;
-			if (res != ERROR_OK)
-				return res;
-		}
+	int res = esp_xtensa_smp_resume_cores_get(target, &cores, &num_cores);
+	if (res != ERROR_OK)
+		return res;
+
+	/* the target comes first and is the only one which may not resume at the current address */
+	for (unsigned int i = 0; i < num_cores; i++) {
+		bool other = cores[i] != target;
+		res = esp_xtensa_smp_prepare_resume_core(cores[i], other ? 1 : current, other ? 0 : address,
+			handle_breakpoints, debug_execution);
+		if (res != ERROR_OK)
+			goto out;
 	}
-	return ERROR_OK;
+
+	struct xtensa_debug_module *dm = &target_to_xtensa(target)->dbg_mod;
+	for (unsigned int i = 0; i < num_cores; i++)
+		xtensa_queue_resume(cores[i]);
+	res = xtensa_dm_queue_execute(dm);
+	/* JTAG queue is common for all cores, DAP transactions are not */
+	for (unsigned int i = 0; i < num_cores && res == ERROR_OK; i++) {
+		struct xtensa_debug_module *core_dm = &target_to_xtensa(cores[i])->dbg_mod;
+		if (core_dm->dap && core_dm->dap != dm->dap)
+			res = xtensa_dm_queue_execute(core_dm);
+	}
+	if (res != ERROR_OK) {
+		LOG_TARGET_ERROR(target, "Failed to resume cores (%d)!", res);
+		goto out;
+	}
+
+	for (unsigned int i = 0; i < num_cores; i++) {
+		struct target *curr = cores[i];
+		xtensa_core_status_check(curr);
+		curr->debug_reason = DBG_REASON_NOTHALTED;
+		if (!debug_execution)
+			curr->state = TARGET_RUNNING;
+		else
+			curr->state = TARGET_DEBUG_RUNNING;
+		target_call_event_callbacks(curr, TARGET_EVENT_RESUMED);
+	}
+
+out:
+	free(cores);
+	return res;
 }
 
 int esp_xtensa_smp_resume(struct target *target,
@@ -419,29 +538,16 @@ int esp_xtensa_smp_resume(struct target *target,
 		return ERROR_OK;
 	}
 
-	/* xtensa_prepare_resume() can step over breakpoint/watchpoint and generate signals on BreakInOut circuit for
-	 * other cores. So disconnect this core from BreakInOut circuit and do xtensa_prepare_resume(). */
-	res = esp_xtensa_smp_smpbreak_disable(target, &smp_break);
-	if (res != ERROR_OK)
-		return res;
-	res = xtensa_prepare_resume(target, current, address, handle_breakpoints, debug_execution);
-	/* restore configured BreakInOut signals config */
-	int ret = esp_xtensa_smp_smpbreak_restore(target, smp_break);
-	if (ret != ERROR_OK)
-		return ret;
-	if (res != ERROR_OK) {
-		LOG_TARGET_ERROR(target, "Failed to prepare for resume!");
-		return res;
-	}
-
 	if (target->smp) {
 		if (target->gdb_service)
 			target->gdb_service->core[0] = -1;
-		res = esp_xtensa_smp_resume_cores(target, handle_breakpoints, debug_execution);
-		if (res != ERROR_OK)
-			return res;
+		return esp_xtensa_smp_resume_cores(target, current, address, handle_breakpoints, debug_execution);
 	}
 
+	res = esp_xtensa_smp_prepare_resume_core(target, current, address, handle_breakpoints, debug_execution);
+	if (res != ERROR_OK)
+		return res;
+
 	res = xtensa_do_resume(target);
 	if (res != ERROR_OK) {
 		LOG_TARGET_ERROR(target, "Failed to resume!");
@@ -890,6 +996,30 @@ COMMAND_HANDLER(esp_xtensa_smp_cmd_perfmon_dump)
 		target_to_xtensa(target));
 }
 
+COMMAND_HANDLER(esp_xtensa_smp_cmd_perfmon_sample)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	if (target->smp) {
+		/* all cores are sampled at the same tick and written to the same file */
+		unsigned int num_cores = 0;
+		struct target_list *head;
+		foreach_smp_target(head, target->smp_targets)
+			num_cores++;
+		struct target **cores = calloc(num_cores, sizeof(*cores));
+		if (!cores) {
+			LOG_ERROR("Failed to alloc memory for cores list!");
+			return ERROR_FAIL;
+		}
+		num_cores = 0;
+		foreach_smp_target(head, target->smp_targets)
+			cores[num_cores++] = head->target;
+		int ret = CALL_COMMAND_HANDLER(xtensa_cmd_perfmon_sample_do, cores, num_cores);
+		free(cores);
+		return ret;
+	}
+	return CALL_COMMAND_HANDLER(xtensa_cmd_perfmon_sample_do, &target, 1);
+}
+
 COMMAND_HANDLER(esp_xtensa_smp_cmd_tracestart)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -960,6 +1090,13 @@ COMMAND_HANDLER(esp_xtensa_smp_cmd_tracedump)
 		target_to_xtensa(target), CMD_ARGV[0]);
 }
 
+COMMAND_HANDLER(esp_xtensa_smp_cmd_tracedecode)
+{
+	/* every core has its own trace unit, decode the current one */
+	return CALL_COMMAND_HANDLER(xtensa_cmd_tracedecode_do,
+		target_to_xtensa(get_current_target(CMD_CTX)));
+}
+
 const struct command_registration esp_xtensa_smp_xtensa_command_handlers[] = {
 	{
 		.name = "xtdef",
@@ -1054,6 +1191,14 @@ const struct command_registration esp_xtensa_smp_xtensa_command_handlers[] = {
 			"Dump performance counter value. If no argument specified, dumps all counters.",
 		.usage = "[counter_id]",
 	},
+	{
+		.name = "perfmon_sample",
+		.handler = esp_xtensa_smp_cmd_perfmon_sample,
+		.mode = COMMAND_EXEC,
+		.help = "Periodically sample the enabled performance counters of all cores while "
+			"the target runs and write the deltas to a file. Without arguments shows the sampling state.",
+		.usage = "[start <outfile> [period_ms] ['csv'|'binary'] | stop]",
+	},
 	{
 		.name = "tracestart",
 		.handler = esp_xtensa_smp_cmd_tracestart,
@@ -1076,6 +1221,14 @@ const struct command_registration esp_xtensa_smp_xtensa_command_handlers[] = {
 		.help = "Tracing: Dump trace memory to a files. One file per core.",
 		.usage = "<outfile1> <outfile2>",
 	},
+	{
+		.name = "tracedecode",
+		.handler = esp_xtensa_smp_cmd_tracedecode,
+		.mode = COMMAND_EXEC,
+		.help = "Tracing: Decode trace memory of the current core (or a file written by tracedump) "
+			"into gmon histogram or binary call trace",
+		.usage = "('gmon'|'calltrace') <outfile> [rawfile]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -1094,6 +1247,20 @@ const struct command_registration esp_xtensa_smp_esp_command_handlers[] = {
 		.help = "Process flash breakpoints on time",
 		.usage = "",
 	},
+	{
+		.name = "profile_rate",
+		.handler = esp_common_profile_rate_command,
+		.mode = COMMAND_ANY,
+		.help = "Set/get PC sampling rate used by 'profile' in Hz per core, 0 - as fast as possible",
+		.usage = "[rate_hz]",
+	},
+	{
+		.name = "profile_all_cores",
+		.handler = esp_common_profile_all_cores_command,
+		.mode = COMMAND_ANY,
+		.help = "Set/get whether 'profile' samples all cores in turn",
+		.usage = "['on'|'off']",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
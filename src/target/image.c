@@ -23,6 +23,7 @@
 
 #include "image.h"
 #include "target.h"
+#include <helper/list.h>
 #include <helper/log.h>
 #include <server/server.h>
 
@@ -39,6 +40,35 @@
 	((elf->endianness == ELFDATA2LSB) ? \
 	le_to_h_u64((uint8_t *)&field) : be_to_h_u64((uint8_t *)&field))
 
+/* Parsed IHEX and S19 images are kept after they are closed, so the next
+ * commands using the same file, e.g. flashing then verifying it, do not parse
+ * it again while its size, modification time and inode are unchanged. */
+#define IMAGE_PARSED_CACHE_SIZE		4
+
+/* what tells the content of a file has changed */
+struct image_parsed_key {
+	size_t file_size;
+	struct fileio_identity id;
+};
+
+struct image_parsed {
+	struct list_head lh;
+	char *url;
+	enum image_type type;
+	struct image_parsed_key key;
+	/* number of open images using the entry */
+	unsigned int users;
+	uint8_t *buffer;
+	unsigned int num_sections;
+	/* before relocation */
+	struct imagesection *sections;
+	bool start_address_set;
+	uint32_t start_address;
+};
+
+/* most recently used first */
+static LIST_HEAD(image_parsed_cache);
+
 static int autodetect_image_type(struct image *image, const char *url)
 {
 	int retval;
@@ -954,6 +984,167 @@ static int image_mot_buffer_complete(struct image *image)
 	return retval;
 }
 
+static void image_parsed_free(struct image_parsed *parsed)
+{
+	list_del(&parsed->lh);
+	free(parsed->url);
+	free(parsed->buffer);
+	free(parsed->sections);
+	free(parsed);
+}
+
+/* Drops the least recently used entries beyond the cache size, unless they are in use */
+static void image_parsed_trim(void)
+{
+	struct image_parsed *parsed, *tmp;
+	unsigned int count = 0;
+
+	list_for_each_entry_safe(parsed, tmp, &image_parsed_cache, lh) {
+		if (++count > IMAGE_PARSED_CACHE_SIZE && !parsed->users)
+			image_parsed_free(parsed);
+	}
+}
+
+/* Fails for files whose content could change unnoticed, these are not cached */
+static int image_parsed_key_get(struct fileio *fileio, struct image_parsed_key *key)
+{
+	int retval = fileio_size(fileio, &key->file_size);
+	if (retval != ERROR_OK)
+		return retval;
+	retval = fileio_identity(fileio, &key->id);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* with a 1 second resolution, a rewrite within the same second goes unseen */
+	if (key->id.mtime_nsec < 0 && difftime(time(NULL), key->id.mtime) < 2)
+		return ERROR_FAIL;
+	return ERROR_OK;
+}
+
+static bool image_parsed_key_equal(const struct image_parsed_key *a, const struct image_parsed_key *b)
+{
+	return a->file_size == b->file_size && a->id.mtime == b->id.mtime &&
+		a->id.mtime_nsec == b->id.mtime_nsec && a->id.dev == b->id.dev && a->id.ino == b->id.ino;
+}
+
+/* Sets the sections of the image from a cached parse of the same file, if any.
+ * @a key is set for image_parsed_add(), NULL if the file can not be cached. */
+static struct image_parsed *image_parsed_get(struct image *image, const char *url, struct fileio *fileio,
+	struct image_parsed_key **key)
+{
+	struct image_parsed *parsed, *tmp;
+
+	if (image_parsed_key_get(fileio, *key) != ERROR_OK) {
+		*key = NULL;
+		return NULL;
+	}
+
+	list_for_each_entry_safe(parsed, tmp, &image_parsed_cache, lh) {
+		if (parsed->type != image->type || strcmp(parsed->url, url))
+			continue;
+
+		if (!image_parsed_key_equal(&parsed->key, *key)) {
+			/* the file has changed */
+			if (!parsed->users)
+				image_parsed_free(parsed);
+			continue;
+		}
+
+		image->sections = malloc(parsed->num_sections * sizeof(struct imagesection));
+		if (!image->sections)
+			return NULL;
+		memcpy(image->sections, parsed->sections, parsed->num_sections * sizeof(struct imagesection));
+		image->num_sections = parsed->num_sections;
+		if (parsed->start_address_set) {
+			image->start_address_set = true;
+			image->start_address = parsed->start_address;
+		}
+
+		parsed->users++;
+		list_move(&parsed->lh, &image_parsed_cache);
+		LOG_DEBUG("using the cached parse of %s", url);
+		return parsed;
+	}
+
+	return NULL;
+}
+
+/* Hands the buffer of a freshly parsed image over to the cache, returns NULL if it is not cached */
+static struct image_parsed *image_parsed_add(struct image *image, const char *url,
+	const struct image_parsed_key *key, uint8_t *buffer)
+{
+	/* the key is taken before parsing, a change during the parse is seen by the next open */
+	if (!key)
+		return NULL;
+
+	struct image_parsed *parsed = calloc(1, sizeof(*parsed));
+	if (!parsed)
+		return NULL;
+
+	parsed->url = strdup(url);
+	parsed->sections = malloc(image->num_sections * sizeof(struct imagesection));
+	if (!parsed->url || !parsed->sections) {
+		free(parsed->url);
+		free(parsed->sections);
+		free(parsed);
+		return NULL;
+	}
+	memcpy(parsed->sections, image->sections, image->num_sections * sizeof(struct imagesection));
+	parsed->num_sections = image->num_sections;
+	parsed->type = image->type;
+	parsed->key = *key;
+	parsed->start_address_set = image->start_address_set;
+	parsed->start_address = image->start_address;
+	parsed->buffer = buffer;
+	parsed->users = 1;
+
+	list_add(&parsed->lh, &image_parsed_cache);
+	image_parsed_trim();
+	return parsed;
+}
+
+static void image_parsed_release(struct image_parsed *parsed)
+{
+	parsed->users--;
+	image_parsed_trim();
+}
+
+void image_cache_cleanup(void)
+{
+	struct image_parsed *parsed, *tmp;
+
+	list_for_each_entry_safe(parsed, tmp, &image_parsed_cache, lh)
+		image_parsed_free(parsed);
+}
+
+static uint64_t image_elf_section_offset(struct image_elf *elf, struct imagesection *section)
+{
+	if (elf->is_64_bit)
+		return field64(elf, ((Elf64_Phdr *)section->private)->p_offset);
+	return field32(elf, ((Elf32_Phdr *)section->private)->p_offset);
+}
+
+/* Maps the file if all the loadable segments are inside it, their content is then accessed in place */
+static void image_elf_map(struct image *image)
+{
+	struct image_elf *elf = image->type_private;
+	const uint8_t *data;
+	size_t filesize;
+
+	if (fileio_map(elf->fileio, &data) != ERROR_OK || fileio_size(elf->fileio, &filesize) != ERROR_OK)
+		return;
+
+	for (unsigned int i = 0; i < image->num_sections; i++) {
+		uint64_t offset = image_elf_section_offset(elf, &image->sections[i]);
+		if (offset > filesize || image->sections[i].size > filesize - offset) {
+			LOG_DEBUG("ELF segment %u outside of the file, not mapped", i);
+			return;
+		}
+	}
+
+	elf->data = data;
+}
+
 int image_open(struct image *image, const char *url, const char *type_string)
 {
 	int retval = ERROR_OK;
@@ -971,6 +1162,10 @@ int image_open(struct image *image, const char *url, const char *type_string)
 		if (retval != ERROR_OK)
 			goto free_mem_on_error;
 
+		/* read through the file where it cannot be mapped */
+		image_binary->data = NULL;
+		fileio_map(image_binary->fileio, &image_binary->data);
+
 		size_t filesize;
 		retval = fileio_size(image_binary->fileio, &filesize);
 		if (retval != ERROR_OK) {
@@ -992,12 +1187,21 @@ int image_open(struct image *image, const char *url, const char *type_string)
 		if (retval != ERROR_OK)
 			goto free_mem_on_error;
 
-		retval = image_ihex_buffer_complete(image);
-		if (retval != ERROR_OK) {
-			LOG_ERROR(
-				"failed buffering IHEX image, check server output for additional information");
-			fileio_close(image_ihex->fileio);
-			goto free_mem_on_error;
+		struct image_parsed_key key_buf, *key = &key_buf;
+		image_ihex->parsed = image_parsed_get(image, url, image_ihex->fileio, &key);
+		if (image_ihex->parsed) {
+			image_ihex->buffer = image_ihex->parsed->buffer;
+		} else {
+			image_ihex->buffer = NULL;
+			retval = image_ihex_buffer_complete(image);
+			if (retval != ERROR_OK) {
+				LOG_ERROR(
+					"failed buffering IHEX image, check server output for additional information");
+				free(image_ihex->buffer);
+				fileio_close(image_ihex->fileio);
+				goto free_mem_on_error;
+			}
+			image_ihex->parsed = image_parsed_add(image, url, key, image_ihex->buffer);
 		}
 	} else if (image->type == IMAGE_ELF) {
 		struct image_elf *image_elf;
@@ -1013,6 +1217,9 @@ int image_open(struct image *image, const char *url, const char *type_string)
 			fileio_close(image_elf->fileio);
 			goto free_mem_on_error;
 		}
+
+		image_elf->data = NULL;
+		image_elf_map(image);
 	} else if (image->type == IMAGE_MEMORY) {
 		struct target *target = get_target(url);
 
@@ -1043,12 +1250,21 @@ int image_open(struct image *image, const char *url, const char *type_string)
 		if (retval != ERROR_OK)
 			goto free_mem_on_error;
 
-		retval = image_mot_buffer_complete(image);
-		if (retval != ERROR_OK) {
-			LOG_ERROR(
-				"failed buffering S19 image, check server output for additional information");
-			fileio_close(image_mot->fileio);
-			goto free_mem_on_error;
+		struct image_parsed_key key_buf, *key = &key_buf;
+		image_mot->parsed = image_parsed_get(image, url, image_mot->fileio, &key);
+		if (image_mot->parsed) {
+			image_mot->buffer = image_mot->parsed->buffer;
+		} else {
+			image_mot->buffer = NULL;
+			retval = image_mot_buffer_complete(image);
+			if (retval != ERROR_OK) {
+				LOG_ERROR(
+					"failed buffering S19 image, check server output for additional information");
+				free(image_mot->buffer);
+				fileio_close(image_mot->fileio);
+				goto free_mem_on_error;
+			}
+			image_mot->parsed = image_parsed_add(image, url, key, image_mot->buffer);
 		}
 	} else if (image->type == IMAGE_BUILDER) {
 		image->num_sections = 0;
@@ -1095,6 +1311,13 @@ int image_read_section(struct image *image,
 		return ERROR_COMMAND_SYNTAX_ERROR;
 	}
 
+	const uint8_t *data;
+	if (image_section_view(image, section, offset, size, &data) == ERROR_OK) {
+		memcpy(buffer, data, size);
+		*size_read = size;
+		return ERROR_OK;
+	}
+
 	if (image->type == IMAGE_BINARY) {
 		struct image_binary *image_binary = image->type_private;
 
@@ -1111,11 +1334,6 @@ int image_read_section(struct image *image,
 		retval = fileio_read(image_binary->fileio, size, buffer, size_read);
 		if (retval != ERROR_OK)
 			return retval;
-	} else if (image->type == IMAGE_IHEX) {
-		memcpy(buffer, (uint8_t *)image->sections[section].private + offset, size);
-		*size_read = size;
-
-		return ERROR_OK;
 	} else if (image->type == IMAGE_ELF) {
 		return image_elf_read_section(image, section, offset, size, buffer, size_read);
 	} else if (image->type == IMAGE_MEMORY) {
@@ -1156,18 +1374,82 @@ int image_read_section(struct image *image,
 			*size_read += (size_in_cache > size) ? size : size_in_cache;
 			address += (size_in_cache > size) ? size : size_in_cache;
 		}
-	} else if (image->type == IMAGE_SRECORD) {
-		memcpy(buffer, (uint8_t *)image->sections[section].private + offset, size);
-		*size_read = size;
+	}
 
-		return ERROR_OK;
-	} else if (image->type == IMAGE_BUILDER) {
-		memcpy(buffer, (uint8_t *)image->sections[section].private + offset, size);
-		*size_read = size;
+	return ERROR_OK;
+}
 
+/**
+ * Gives direct access to @a size bytes of a section, without copying them:
+ * the parsed content of IHEX, S19 and built images, the mapped file of binary
+ * and ELF images. The data is valid until the image is closed.
+ * Fails with ERROR_NOT_IMPLEMENTED for target memory images and for files
+ * that cannot be mapped, image_read_section() is then to be used.
+ */
+int image_section_view(struct image *image,
+	int section,
+	target_addr_t offset,
+	uint32_t size,
+	const uint8_t **data)
+{
+	if (offset + size > image->sections[section].size)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (image->type == IMAGE_BINARY) {
+		struct image_binary *image_binary = image->type_private;
+
+		if (section != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		if (!image_binary->data)
+			return ERROR_NOT_IMPLEMENTED;
+		*data = image_binary->data + offset;
+	} else if (image->type == IMAGE_ELF) {
+		struct image_elf *image_elf = image->type_private;
+
+		if (!image_elf->data)
+			return ERROR_NOT_IMPLEMENTED;
+		*data = image_elf->data + image_elf_section_offset(image_elf, &image->sections[section]) + offset;
+	} else if (image->type == IMAGE_IHEX || image->type == IMAGE_SRECORD || image->type == IMAGE_BUILDER) {
+		*data = (const uint8_t *)image->sections[section].private + offset;
+	} else {
+		return ERROR_NOT_IMPLEMENTED;
+	}
+
+	return ERROR_OK;
+}
+
+/**
+ * Gets @a size bytes of a section, as a view when image_section_view() can
+ * provide one, otherwise read into a buffer returned in @a copy that the
+ * caller frees. @a copy is NULL for a view.
+ */
+int image_section_get(struct image *image,
+	int section,
+	target_addr_t offset,
+	uint32_t size,
+	const uint8_t **data,
+	uint8_t **copy,
+	size_t *size_read)
+{
+	*copy = NULL;
+	if (image_section_view(image, section, offset, size, data) == ERROR_OK) {
+		*size_read = size;
 		return ERROR_OK;
 	}
 
+	*copy = malloc(MAX(size, 1));
+	if (!*copy) {
+		LOG_ERROR("error allocating buffer for section (%" PRIu32 " bytes)", size);
+		return ERROR_FAIL;
+	}
+
+	int retval = image_read_section(image, section, offset, size, *copy, size_read);
+	if (retval != ERROR_OK) {
+		free(*copy);
+		*copy = NULL;
+		return retval;
+	}
+	*data = *copy;
 	return ERROR_OK;
 }
 
@@ -1219,7 +1501,10 @@ void image_close(struct image *image)
 
 		fileio_close(image_ihex->fileio);
 
-		free(image_ihex->buffer);
+		if (image_ihex->parsed)
+			image_parsed_release(image_ihex->parsed);
+		else
+			free(image_ihex->buffer);
 		image_ihex->buffer = NULL;
 	} else if (image->type == IMAGE_ELF) {
 		struct image_elf *image_elf = image->type_private;
@@ -1249,7 +1534,10 @@ void image_close(struct image *image)
 
 		fileio_close(image_mot->fileio);
 
-		free(image_mot->buffer);
+		if (image_mot->parsed)
+			image_parsed_release(image_mot->parsed);
+		else
+			free(image_mot->buffer);
 		image_mot->buffer = NULL;
 	} else if (image->type == IMAGE_BUILDER) {
 		for (unsigned int i = 0; i < image->num_sections; i++) {
@@ -58,11 +58,17 @@ struct image {
 
 struct image_binary {
 	struct fileio *fileio;
+	/* read-only mapping of the file, or NULL */
+	const uint8_t *data;
 };
 
+struct image_parsed;
+
 struct image_ihex {
 	struct fileio *fileio;
 	uint8_t *buffer;
+	/* cache entry owning the buffer, or NULL */
+	struct image_parsed *parsed;
 };
 
 struct image_memory {
@@ -84,17 +90,26 @@ struct image_elf {
 	};
 	uint32_t segment_count;
 	uint8_t endianness;
+	/* read-only mapping of the file, or NULL */
+	const uint8_t *data;
 };
 
 struct image_mot {
 	struct fileio *fileio;
 	uint8_t *buffer;
+	/* cache entry owning the buffer, or NULL */
+	struct image_parsed *parsed;
 };
 
 int image_open(struct image *image, const char *url, const char *type_string);
 int image_read_section(struct image *image, int section, target_addr_t offset,
 		uint32_t size, uint8_t *buffer, size_t *size_read);
+int image_section_view(struct image *image, int section, target_addr_t offset,
+		uint32_t size, const uint8_t **data);
+int image_section_get(struct image *image, int section, target_addr_t offset,
+		uint32_t size, const uint8_t **data, uint8_t **copy, size_t *size_read);
 void image_close(struct image *image);
+void image_cache_cleanup(void);
 
 int image_add_section(struct image *image, target_addr_t base, uint32_t size,
 		uint64_t flags, uint8_t const *data);
@@ -262,6 +262,26 @@ static int mem_ap_write_memory(struct target *target, target_addr_t address,
 	return mem_ap_write_buf(mem_ap->ap, buffer, size, count, address);
 }
 
+static int mem_ap_read_memory_scatter(struct target *target,
+		struct target_memory_scatter *list, unsigned int count)
+{
+	struct mem_ap *mem_ap = target->arch_info;
+
+	LOG_DEBUG("Reading %u scattered memory blocks", count);
+
+	return mem_ap_read_buf_scatter(mem_ap->ap, list, count);
+}
+
+static int mem_ap_write_memory_scatter(struct target *target,
+		const struct target_memory_scatter *list, unsigned int count)
+{
+	struct mem_ap *mem_ap = target->arch_info;
+
+	LOG_DEBUG("Writing %u scattered memory blocks", count);
+
+	return mem_ap_write_buf_scatter(mem_ap->ap, list, count);
+}
+
 struct target_type mem_ap_target = {
 	.name = "mem_ap",
 
@@ -286,4 +306,6 @@ struct target_type mem_ap_target = {
 
 	.read_memory = mem_ap_read_memory,
 	.write_memory = mem_ap_write_memory,
+	.read_memory_scatter = mem_ap_read_memory_scatter,
+	.write_memory_scatter = mem_ap_write_memory_scatter,
 };
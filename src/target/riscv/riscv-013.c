@@ -47,6 +47,8 @@ static int riscv013_halt_go(struct target *target);
 static int riscv013_resume_go(struct target *target);
 static int riscv013_step_current_hart(struct target *target);
 static int riscv013_on_halt(struct target *target); /* ESPRESSIF */
+static int riscv013_sample_pc_prep(struct target *target, bool start); /* ESPRESSIF */
+static int riscv013_sample_pc(struct target *target, riscv_reg_t *pc); /* ESPRESSIF */
 static int riscv013_on_step(struct target *target);
 static int riscv013_resume_prep(struct target *target);
 static enum riscv_halt_reason riscv013_halt_reason(struct target *target);
@@ -2793,6 +2795,8 @@ static int init_target(struct command_context *cmd_ctx,
 	generic_info->resume_go = &riscv013_resume_go;
 	generic_info->step_current_hart = &riscv013_step_current_hart;
 	generic_info->on_halt = &riscv013_on_halt; /* ESPRESSIF */
+	generic_info->sample_pc_prep = &riscv013_sample_pc_prep; /* ESPRESSIF */
+	generic_info->sample_pc = &riscv013_sample_pc; /* ESPRESSIF */
 	generic_info->resume_prep = &riscv013_resume_prep;
 	generic_info->halt_prep = &riscv013_halt_prep;
 	generic_info->halt_go = &riscv013_halt_go;
@@ -5117,6 +5121,144 @@ static int riscv013_on_halt(struct target *target)
 	return ERROR_OK;
 }
 
+/* ESPRESSIF */
+static int riscv013_sample_pc_prep(struct target *target, bool start)
+{
+	RISCV013_INFO(info);
+
+	if (start) {
+		if (!info->abstract_read_csr_supported || riscv_xlen(target) != 32)
+			return ERROR_NOT_IMPLEMENTED;
+	}
+	if (!info->haltgroup_supported)
+		return ERROR_OK;
+
+	/* Keep the other harts running while this one is briefly halted for sampling */
+	if (dm013_select_hart(target, info->index) != ERROR_OK)
+		return ERROR_FAIL;
+	bool supported;
+	unsigned int group = start ? 0 : target->smp;
+	if (set_group(target, &supported, group, HALT_GROUP) != ERROR_OK)
+		return ERROR_FAIL;
+	if (!supported)
+		LOG_TARGET_ERROR(target, "Couldn't place hart in halt group %u. "
+			"Some harts may be unexpectedly halted.", group);
+	return ERROR_OK;
+}
+
+/* ESPRESSIF */
+/* Recovers from a failed PC sample: makes sure that the halt request is released,
+ * no abstract command error is pending and the hart is running again. */
+static int riscv013_sample_pc_recover(struct target *target, uint32_t dmcontrol)
+{
+	if (dm_write(target, DM_DMCONTROL, dmcontrol) != ERROR_OK)
+		return ERROR_FAIL;
+
+	uint32_t abstractcs;
+	if (wait_for_idle(target, &abstractcs) != ERROR_OK)
+		return ERROR_FAIL;
+	if (get_field(abstractcs, DM_ABSTRACTCS_CMDERR) != CMDERR_NONE &&
+			dm_write(target, DM_ABSTRACTCS, DM_ABSTRACTCS_CMDERR) != ERROR_OK)
+		return ERROR_FAIL;
+
+	uint32_t dmstatus;
+	if (dmstatus_read(target, &dmstatus, true) != ERROR_OK)
+		return ERROR_FAIL;
+	if (get_field(dmstatus, DM_DMSTATUS_ALLHALTED) &&
+			dm_write(target, DM_DMCONTROL, dmcontrol | DM_DMCONTROL_RESUMEREQ) != ERROR_OK)
+		return ERROR_FAIL;
+	return ERROR_OK;
+}
+
+/* ESPRESSIF */
+/* Samples DPC of the running hart: halt request, abstract DPC read and resume
+ * request go out in a single DMI batch. Neither target->state nor the register
+ * cache are touched, so this must only be used while the hart is running.
+ * Returns ERROR_WAIT when no sample could be taken, but the hart is running again, and
+ * ERROR_TARGET_NOT_RUNNING when the hart had already stopped on its own. */
+static int riscv013_sample_pc(struct target *target, riscv_reg_t *pc)
+{
+	RISCV013_INFO(info);
+	dm013_info_t *dm = get_dm(target);
+	if (!dm)
+		return ERROR_FAIL;
+
+	uint32_t dmcontrol = set_dmcontrol_hartsel(DM_DMCONTROL_DMACTIVE, info->index);
+	struct riscv_batch *batch = riscv_batch_alloc(target, 10,
+		info->dmi_busy_delay + info->ac_busy_delay);
+	if (!batch)
+		return ERROR_FAIL;
+
+	/* DMSTATUS before the halt request tells whether the hart has stopped on its own */
+	riscv_batch_add_dm_write(batch, DM_DMCONTROL, dmcontrol, false);
+	size_t dmstatus_key = riscv_batch_add_dm_read(batch, DM_DMSTATUS);
+	riscv_batch_add_dm_write(batch, DM_DMCONTROL, dmcontrol | DM_DMCONTROL_HALTREQ, false);
+	riscv_batch_add_dm_write(batch, DM_DMCONTROL, dmcontrol, false);
+	riscv_batch_add_dm_write(batch, DM_COMMAND,
+		access_register_command(target, GDB_REGNO_DPC, 32, AC_ACCESS_REGISTER_TRANSFER), false);
+	size_t abstractcs_key = riscv_batch_add_dm_read(batch, DM_ABSTRACTCS);
+	size_t data0_key = riscv_batch_add_dm_read(batch, DM_DATA0);
+	/* read_back makes the result of the DATA0 read available */
+	riscv_batch_add_dm_write(batch, DM_DMCONTROL, dmcontrol | DM_DMCONTROL_RESUMEREQ, true);
+	dm->current_hartid = info->index;
+
+	int result = batch_run(target, batch);
+	if (result != ERROR_OK) {
+		riscv_batch_free(batch);
+		return result;
+	}
+
+	if (riscv_batch_get_dmi_read_op(batch, dmstatus_key) == DTM_DMI_OP_BUSY ||
+			riscv_batch_get_dmi_read_op(batch, abstractcs_key) == DTM_DMI_OP_BUSY ||
+			riscv_batch_get_dmi_read_op(batch, data0_key) == DTM_DMI_OP_BUSY ||
+			riscv_batch_dmi_busy_encountered(batch)) {
+		riscv_batch_free(batch);
+		increase_dmi_busy_delay(target);
+		if (riscv013_sample_pc_recover(target, dmcontrol) != ERROR_OK)
+			return ERROR_FAIL;
+		return ERROR_WAIT;
+	}
+
+	uint32_t dmstatus = riscv_batch_get_dmi_read_data(batch, dmstatus_key);
+	uint32_t abstractcs = riscv_batch_get_dmi_read_data(batch, abstractcs_key);
+	uint32_t data0 = riscv_batch_get_dmi_read_data(batch, data0_key);
+	riscv_batch_free(batch);
+
+	if (get_field(dmstatus, DM_DMSTATUS_ALLHALTED)) {
+		/* The resume request makes it stop again on the same ebreak or trigger */
+		LOG_TARGET_DEBUG(target, "hart was halted before PC sampling");
+		if (riscv013_sample_pc_recover(target, dmcontrol) != ERROR_OK)
+			return ERROR_FAIL;
+		return ERROR_TARGET_NOT_RUNNING;
+	}
+
+	if (get_field(abstractcs, DM_ABSTRACTCS_BUSY)) {
+		increase_ac_busy_delay(target);
+		if (riscv013_sample_pc_recover(target, dmcontrol) != ERROR_OK)
+			return ERROR_FAIL;
+		return ERROR_WAIT;
+	}
+
+	uint32_t cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
+	if (cmderr != CMDERR_NONE) {
+		LOG_TARGET_DEBUG(target, "DPC sample failed, cmderr=%" PRIu32, cmderr);
+		if (riscv013_sample_pc_recover(target, dmcontrol) != ERROR_OK)
+			return ERROR_FAIL;
+		if (cmderr == CMDERR_NOT_SUPPORTED) {
+			info->abstract_read_csr_supported = false;
+			LOG_TARGET_INFO(target, "Disabling abstract command reads from CSRs.");
+			return ERROR_NOT_IMPLEMENTED;
+		}
+		/* CMDERR_HALT_RESUME: the hart did not halt in time */
+		if (cmderr == CMDERR_BUSY)
+			increase_ac_busy_delay(target);
+		return ERROR_WAIT;
+	}
+
+	*pc = data0;
+	return ERROR_OK;
+}
+
 static enum riscv_halt_reason riscv013_halt_reason(struct target *target)
 {
 	riscv_reg_t dcsr;
@@ -224,6 +224,10 @@ struct riscv_info {
 	int (*on_halt)(struct target *target);
 	/* Indicates that target was reset.*/
 	int (*on_reset)(struct target *target);
+	/* Prepares the hart for (start=true) or restores it after PC sampling. */
+	int (*sample_pc_prep)(struct target *target, bool start);
+	/* Reads the PC of the running hart with a short halt, leaving target state alone. */
+	int (*sample_pc)(struct target *target, riscv_reg_t *pc);
 	/****************/
 	/* Get this target as ready as possible to resume, without actually
 	 * resuming. */
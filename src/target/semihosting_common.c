@@ -135,6 +135,7 @@ int semihosting_common_init(struct target *target, void *setup,
 	semihosting->sys_errno = -1;
 	semihosting->cmdline = NULL;
 	semihosting->basedir = NULL;
+	semihosting_io_init(&semihosting->io);
 
 	/* If possible, update it in setup(). */
 	semihosting->setup_time = clock();
@@ -151,6 +152,21 @@ int semihosting_common_init(struct target *target, void *setup,
 	return ERROR_OK;
 }
 
+/**
+ * Returns the host file buffering state of the target. The cores of an SMP
+ * group share the host descriptors and tasks migrate between them, so the
+ * state of the whole group is kept by its first target.
+ */
+struct semihosting_io *semihosting_get_io(struct target *target)
+{
+	if (target->smp) {
+		struct target_list *head = list_first_entry(target->smp_targets, struct target_list, lh);
+		if (head->target->semihosting)
+			return &head->target->semihosting->io;
+	}
+	return &target->semihosting->io;
+}
+
 struct semihosting_tcp_service {
 	struct semihosting *semihosting;
 	char *name;
@@ -215,13 +231,15 @@ static ssize_t semihosting_redirect_write(struct semihosting *semihosting, void
 	return retval;
 }
 
-static ssize_t semihosting_write(struct semihosting *semihosting, int fd, void *buf, int size)
+static ssize_t semihosting_write(struct target *target, int fd, void *buf, int size)
 {
+	struct semihosting *semihosting = target->semihosting;
+
 	if (semihosting_is_redirected(semihosting, fd))
 		return semihosting_redirect_write(semihosting, buf, size);
 
 	/* default write */
-	int result = write(fd, buf, size);
+	int result = semihosting_io_write(semihosting_get_io(target), fd, buf, size);
 	if (result == -1)
 		semihosting->sys_errno = errno;
 	return result;
@@ -262,13 +280,15 @@ static inline int semihosting_putchar(struct semihosting *semihosting, int fd, i
 	return putchar(c);
 }
 
-static inline ssize_t semihosting_read(struct semihosting *semihosting, int fd, void *buf, int size)
+static inline ssize_t semihosting_read(struct target *target, int fd, void *buf, int size)
 {
+	struct semihosting *semihosting = target->semihosting;
+
 	if (semihosting_is_redirected(semihosting, fd))
 		return semihosting_redirect_read(semihosting, buf, size);
 
 	/* default read */
-	ssize_t result = read(fd, buf, size);
+	ssize_t result = semihosting_io_read(semihosting_get_io(target), fd, buf, size);
 	if (result == -1)
 		semihosting->sys_errno = errno;
 
@@ -371,6 +391,8 @@ int semihosting_common(struct target *target)
 
 	struct gdb_fileio_info *fileio_info = target->fileio_info;
 
+	semihosting->requests++;
+
 	/*
 	 * By default return an error.
 	 * The actual result must be set by each function
@@ -460,7 +482,7 @@ int semihosting_common(struct target *target)
 					fileio_info->identifier = "close";
 					fileio_info->param_1 = fd;
 				} else {
-					semihosting->result = close(fd);
+					semihosting->result = semihosting_io_close(semihosting_get_io(target), fd);
 					if (semihosting->result == -1)
 						semihosting->sys_errno = errno;
 					LOG_DEBUG("close(%d)=%" PRId64, fd, semihosting->result);
@@ -541,6 +563,8 @@ int semihosting_common(struct target *target)
 			 * were on entry to the operation, or as subsequently modified
 			 * by the debugger.
 			 */
+			/* buffered file data must not be lost when OpenOCD exits below */
+			semihosting_io_free(semihosting_get_io(target));
 			if (semihosting->word_size_bytes == 8) {
 				retval = semihosting_read_fields(target, 2, fields);
 				if (retval != ERROR_OK)
@@ -633,6 +657,7 @@ int semihosting_common(struct target *target)
 			 * the mandatory SYS_EXIT (0x18) call. If this extension is
 			 * supported, then both calls must be implemented.
 			 */
+			semihosting_io_free(semihosting_get_io(target));
 			retval = semihosting_read_fields(target, 2, fields);
 			if (retval != ERROR_OK)
 				return retval;
@@ -685,6 +710,7 @@ int semihosting_common(struct target *target)
 			else {
 				int fd = semihosting_get_field(target, 0, fields);
 				struct stat buf;
+				semihosting_io_sync(semihosting_get_io(target), fd);
 				semihosting->result = fstat(fd, &buf);
 				if (semihosting->result == -1) {
 					semihosting->sys_errno = errno;
@@ -974,6 +1000,8 @@ int semihosting_common(struct target *target)
 							semihosting->result = open(fn, flags, 0644);
 							if (semihosting->result == -1)
 								semihosting->sys_errno = errno;
+							else
+								semihosting_io_opened(semihosting_get_io(target), semihosting->result, flags);
 							LOG_DEBUG("open('%s')=%" PRId64, fn, semihosting->result);
 						}
 					}
@@ -1036,7 +1064,7 @@ int semihosting_common(struct target *target)
 						semihosting->result = -1;
 						semihosting->sys_errno = ENOMEM;
 					} else {
-						semihosting->result = semihosting_read(semihosting, fd, buf, len);
+						semihosting->result = semihosting_read(target, fd, buf, len);
 						LOG_DEBUG("read(%d, 0x%" PRIx64 ", %zu)=%" PRId64,
 							fd,
 							addr,
@@ -1225,7 +1253,7 @@ int semihosting_common(struct target *target)
 					fileio_info->param_2 = pos;
 					fileio_info->param_3 = SEEK_SET;
 				} else {
-					semihosting->result = lseek(fd, pos, SEEK_SET);
+					semihosting->result = semihosting_io_seek(semihosting_get_io(target), fd, pos, SEEK_SET);
 					if (semihosting->result == -1)
 						semihosting->sys_errno = errno;
 					LOG_DEBUG("lseek(%d, %d)=%" PRId64, fd, (int)pos, semihosting->result);
@@ -1364,7 +1392,7 @@ int semihosting_common(struct target *target)
 							free(buf);
 							return retval;
 						}
-						semihosting->result = semihosting_write(semihosting, fd, buf, len);
+						semihosting->result = semihosting_write(target, fd, buf, len);
 						LOG_DEBUG("write(%d, 0x%" PRIx64 ", %zu)=%" PRId64,
 							fd,
 							addr,
@@ -2120,6 +2148,70 @@ COMMAND_HANDLER(handle_common_semihosting_basedir_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_common_semihosting_buffer_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!target) {
+		LOG_ERROR("No target selected");
+		return ERROR_FAIL;
+	}
+
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting) {
+		command_print(CMD, "semihosting not supported for current target");
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC > 0) {
+		uint32_t size;
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], size);
+		if (size > SEMIHOSTING_IO_BUF_SIZE_MAX) {
+			command_print(CMD, "buffer size is limited to %d bytes", SEMIHOSTING_IO_BUF_SIZE_MAX);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		semihosting_get_io(target)->buf_size = size;
+	}
+
+	struct semihosting_io *io = semihosting_get_io(target);
+	command_print(CMD, "semihosting file buffer size: %zu", io->buf_size);
+	command_print(CMD, "%" PRIu64 " bytes read with %" PRIu64 " host reads, "
+		"%" PRIu64 " bytes written with %" PRIu64 " host writes",
+		io->bytes_read, io->host_reads, io->bytes_written, io->host_writes);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_common_semihosting_mmap_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!target) {
+		LOG_ERROR("No target selected");
+		return ERROR_FAIL;
+	}
+
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting) {
+		command_print(CMD, "semihosting not supported for current target");
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC > 0)
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], semihosting_get_io(target)->use_mmap);
+
+	command_print(CMD, "semihosting mmap of read-only files is %s",
+		semihosting_get_io(target)->use_mmap ? "enabled" : "disabled");
+
+	return ERROR_OK;
+}
+
 const struct command_registration semihosting_common_handlers[] = {
 	{
 		.name = "semihosting",
@@ -2170,5 +2262,19 @@ const struct command_registration semihosting_common_handlers[] = {
 		.usage = "[dir]",
 		.help = "set the base directory for semihosting I/O operations",
 	},
+	{
+		.name = "semihosting_buffer",
+		.handler = handle_common_semihosting_buffer_command,
+		.mode = COMMAND_ANY,
+		.usage = "[size]",
+		.help = "set/get the host side buffer size of files opened by semihosting, 0 disables buffering",
+	},
+	{
+		.name = "semihosting_mmap",
+		.handler = handle_common_semihosting_mmap_command,
+		.mode = COMMAND_ANY,
+		.usage = "['enable'|'disable']",
+		.help = "map read-only files opened by buffered semihosting instead of reading them",
+	},
 	COMMAND_REGISTRATION_DONE
 };
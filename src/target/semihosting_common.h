@@ -17,6 +17,7 @@
 #include "helper/replacements.h"
 #include <server/server.h>
 #include <dirent.h>
+#include "semihosting_io.h"
 
 /*
  * According to:
@@ -169,6 +170,9 @@ struct semihosting {
 	/** The value to be returned by semihosting SYS_ERRNO request. */
 	int sys_errno;
 
+	/** Number of requests processed so far, lets targets tell if one has been serviced. */
+	uint64_t requests;
+
 	/** The semihosting command line to be passed to the target. */
 	char *cmdline;
 
@@ -178,6 +182,9 @@ struct semihosting {
 	/** Base directory for semihosting I/O operations. */
 	char *basedir;
 
+	/** Host side buffering of files opened by the target. */
+	struct semihosting_io io;
+
 	/**
 	 * Target's extension of semihosting user commands.
 	 * @returns ERROR_NOT_IMPLEMENTED when user command is not handled, otherwise
@@ -199,6 +206,7 @@ const char *semihosting_opcode_to_str(uint64_t opcode);
 int semihosting_common_init(struct target *target, void *setup,
 	void *post_result);
 int semihosting_common(struct target *target);
+struct semihosting_io *semihosting_get_io(struct target *target);
 
 /* utility functions which may also be used by semihosting extensions (custom vendor-defined syscalls) */
 int semihosting_read_fields(struct target *target, size_t number, uint8_t *fields);
@@ -0,0 +1,346 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/***************************************************************************
+ *   Buffered host I/O for files opened by semihosting                     *
+ ***************************************************************************/
+
+/**
+ * @file
+ * Every SYS_READ/SYS_WRITE is a full halt/transfer/resume cycle of the target,
+ * so programs reading test vectors in small chunks spend most of the time in
+ * host syscalls. Regular files opened by the target can be given a buffer here:
+ * sequential reads are served from data read ahead in large chunks and
+ * sequential writes are coalesced until the buffer is full, the file is
+ * repositioned or closed. Files opened read-only can be mapped as a whole instead.
+ *
+ * The file position seen by the target is kept here and the host descriptor
+ * is repositioned lazily. Descriptors without a buffer are passed through.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+#include <helper/log.h>
+#include <helper/replacements.h>
+#include "semihosting_io.h"
+
+struct semihosting_io_file {
+	struct list_head lh;
+	int fd;
+	/* file position seen by the target */
+	off_t pos;
+	/* position of the host descriptor */
+	off_t host_pos;
+	/* file data [buf_pos, buf_pos + buf_len), not yet written when dirty */
+	uint8_t *buf;
+	size_t buf_size;
+	off_t buf_pos;
+	size_t buf_len;
+	bool dirty;
+	/* read-only file mapped as a whole */
+	uint8_t *map;
+	size_t map_size;
+};
+
+void semihosting_io_init(struct semihosting_io *io)
+{
+	memset(io, 0, sizeof(*io));
+	INIT_LIST_HEAD(&io->files);
+}
+
+static struct semihosting_io_file *semihosting_io_find(struct semihosting_io *io, int fd)
+{
+	struct semihosting_io_file *file;
+	list_for_each_entry(file, &io->files, lh) {
+		if (file->fd == fd)
+			return file;
+	}
+	return NULL;
+}
+
+static bool semihosting_io_map(struct semihosting_io_file *file)
+{
+#ifndef _WIN32
+	struct stat st;
+	if (fstat(file->fd, &st) != 0 || st.st_size <= 0 || (uint64_t)st.st_size > SIZE_MAX)
+		return false;
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, file->fd, 0);
+	if (map == MAP_FAILED)
+		return false;
+	file->map = map;
+	file->map_size = st.st_size;
+	return true;
+#else
+	return false;
+#endif
+}
+
+/* Gives a buffer to a descriptor returned by open(). Only regular files opened
+ * without O_APPEND qualify, anything else keeps unbuffered access. */
+void semihosting_io_opened(struct semihosting_io *io, int fd, int flags)
+{
+	if (io->buf_size == 0 || fd < 0 || (flags & O_APPEND))
+		return;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+		return;
+
+	struct semihosting_io_file *file = calloc(1, sizeof(*file));
+	if (!file)
+		return;
+	file->fd = fd;
+
+	if (!(io->use_mmap && (flags & O_ACCMODE) == O_RDONLY && semihosting_io_map(file))) {
+		file->buf = malloc(io->buf_size);
+		if (!file->buf) {
+			LOG_WARNING("semihosting: no memory for the buffer of fd %d, using unbuffered access", fd);
+			free(file);
+			return;
+		}
+		file->buf_size = io->buf_size;
+	}
+	list_add_tail(&file->lh, &io->files);
+	LOG_DEBUG("semihosting: fd %d %s", fd, file->map ? "mapped" : "buffered");
+}
+
+static int semihosting_io_host_seek(struct semihosting_io_file *file, off_t pos)
+{
+	if (file->host_pos == pos)
+		return 0;
+	if (lseek(file->fd, pos, SEEK_SET) == -1)
+		return -1;
+	file->host_pos = pos;
+	return 0;
+}
+
+/* Writes out pending data and drops the buffer contents */
+static int semihosting_io_flush(struct semihosting_io *io, struct semihosting_io_file *file)
+{
+	if (!file->dirty) {
+		file->buf_len = 0;
+		return 0;
+	}
+
+	int retval = semihosting_io_host_seek(file, file->buf_pos);
+	size_t done = 0;
+	while (retval == 0 && done < file->buf_len) {
+		ssize_t n = write(file->fd, file->buf + done, file->buf_len - done);
+		if (n <= 0) {
+			if (n == 0)
+				errno = EIO;
+			retval = -1;
+			break;
+		}
+		io->host_writes++;
+		done += n;
+		file->host_pos += n;
+	}
+	/* data that could not be written is dropped, like with a failing fflush() */
+	file->dirty = false;
+	file->buf_len = 0;
+	return retval;
+}
+
+static ssize_t semihosting_io_host_read(struct semihosting_io *io, struct semihosting_io_file *file,
+	void *buf, size_t size)
+{
+	if (semihosting_io_host_seek(file, file->pos) != 0)
+		return -1;
+	ssize_t n = read(file->fd, buf, size);
+	if (n > 0) {
+		io->host_reads++;
+		file->host_pos += n;
+	}
+	return n;
+}
+
+ssize_t semihosting_io_read(struct semihosting_io *io, int fd, void *buf, size_t size)
+{
+	struct semihosting_io_file *file = semihosting_io_find(io, fd);
+	if (!file)
+		return read(fd, buf, size);
+
+	size_t done = 0;
+	if (file->map) {
+		if (file->pos < (off_t)file->map_size) {
+			done = MIN(size, file->map_size - file->pos);
+			memcpy(buf, file->map + file->pos, done);
+			file->pos += done;
+		}
+		io->bytes_read += done;
+		return done;
+	}
+
+	if (file->dirty && semihosting_io_flush(io, file) != 0)
+		return -1;
+
+	if (file->buf_len && file->pos >= file->buf_pos && file->pos < file->buf_pos + (off_t)file->buf_len) {
+		done = MIN(size, file->buf_pos + file->buf_len - file->pos);
+		memcpy(buf, file->buf + (file->pos - file->buf_pos), done);
+		file->pos += done;
+	}
+
+	/* partial reads are fine for semihosting, the data is valid up to here */
+	while (done < size) {
+		ssize_t n;
+		size_t left = size - done;
+		if (left >= file->buf_size) {
+			/* large reads bypass the buffer */
+			n = semihosting_io_host_read(io, file, (uint8_t *)buf + done, left);
+		} else {
+			file->buf_pos = file->pos;
+			file->buf_len = 0;
+			n = semihosting_io_host_read(io, file, file->buf, file->buf_size);
+			if (n > 0) {
+				file->buf_len = n;
+				n = MIN((size_t)n, left);
+				memcpy((uint8_t *)buf + done, file->buf, n);
+			}
+		}
+		if (n < 0)
+			return done ? (ssize_t)done : -1;
+		if (n == 0)
+			break;
+		done += n;
+		file->pos += n;
+	}
+	io->bytes_read += done;
+	return done;
+}
+
+ssize_t semihosting_io_write(struct semihosting_io *io, int fd, const void *buf, size_t size)
+{
+	struct semihosting_io_file *file = semihosting_io_find(io, fd);
+	if (!file || file->map)
+		return write(fd, buf, size);
+
+	/* only a write continuing the pending data can be merged with it */
+	if (!file->dirty || file->pos != file->buf_pos + (off_t)file->buf_len ||
+		file->buf_len + size > file->buf_size) {
+		if (semihosting_io_flush(io, file) != 0)
+			return -1;
+	}
+
+	if (size >= file->buf_size) {
+		if (semihosting_io_host_seek(file, file->pos) != 0)
+			return -1;
+		ssize_t n = write(fd, buf, size);
+		if (n < 0)
+			return -1;
+		io->host_writes++;
+		io->bytes_written += n;
+		file->host_pos += n;
+		file->pos += n;
+		return n;
+	}
+
+	if (!file->dirty) {
+		file->buf_pos = file->pos;
+		file->dirty = true;
+	}
+	memcpy(file->buf + file->buf_len, buf, size);
+	file->buf_len += size;
+	file->pos += size;
+	io->bytes_written += size;
+	return size;
+}
+
+off_t semihosting_io_seek(struct semihosting_io *io, int fd, off_t offset, int whence)
+{
+	struct semihosting_io_file *file = semihosting_io_find(io, fd);
+	if (!file)
+		return lseek(fd, offset, whence);
+
+	off_t pos;
+	switch (whence) {
+	case SEEK_SET:
+		pos = offset;
+		break;
+	case SEEK_CUR:
+		pos = file->pos + offset;
+		break;
+	default:
+		/* the end of file is only known once pending data is written */
+		if (semihosting_io_flush(io, file) != 0)
+			return -1;
+		pos = lseek(fd, offset, whence);
+		if (pos == -1)
+			return -1;
+		file->host_pos = pos;
+		file->pos = pos;
+		return pos;
+	}
+	if (pos < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	/* buffered data stays valid: read ahead data may still be hit and
+	 * pending writes carry their own position */
+	file->pos = pos;
+	return pos;
+}
+
+/* Brings the host descriptor in line with what the target sees,
+ * for operations done on the descriptor directly (fstat, fsync, ...). */
+int semihosting_io_sync(struct semihosting_io *io, int fd)
+{
+	struct semihosting_io_file *file = semihosting_io_find(io, fd);
+	if (!file)
+		return 0;
+
+	int retval = semihosting_io_flush(io, file);
+	if (semihosting_io_host_seek(file, file->pos) != 0)
+		return -1;
+	return retval;
+}
+
+static void semihosting_io_release(struct semihosting_io_file *file)
+{
+	list_del(&file->lh);
+#ifndef _WIN32
+	if (file->map)
+		munmap(file->map, file->map_size);
+#endif
+	free(file->buf);
+	free(file);
+}
+
+int semihosting_io_close(struct semihosting_io *io, int fd)
+{
+	struct semihosting_io_file *file = semihosting_io_find(io, fd);
+	int retval = 0;
+	int flush_errno = 0;
+
+	if (file) {
+		retval = semihosting_io_flush(io, file);
+		flush_errno = errno;
+		semihosting_io_release(file);
+	}
+	if (close(fd) != 0)
+		return -1;
+	if (retval != 0)
+		errno = flush_errno;
+	return retval;
+}
+
+/* Writes out pending data of all files and drops the buffers, the descriptors stay open */
+void semihosting_io_free(struct semihosting_io *io)
+{
+	struct semihosting_io_file *file, *tmp;
+	list_for_each_entry_safe(file, tmp, &io->files, lh) {
+		if (semihosting_io_flush(io, file) != 0)
+			LOG_ERROR("semihosting: failed to write buffered data of fd %d: %s", file->fd, strerror(errno));
+		semihosting_io_host_seek(file, file->pos);
+		semihosting_io_release(file);
+	}
+}
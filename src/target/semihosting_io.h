@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/***************************************************************************
+ *   Buffered host I/O for files opened by semihosting                     *
+ ***************************************************************************/
+
+#ifndef OPENOCD_TARGET_SEMIHOSTING_IO_H
+#define OPENOCD_TARGET_SEMIHOSTING_IO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <helper/list.h>
+
+/* buffers larger than this are not worth the host memory */
+#define SEMIHOSTING_IO_BUF_SIZE_MAX		(64 * 1024 * 1024)
+
+struct semihosting_io {
+	/** Buffer size of newly opened files, 0 disables buffering */
+	size_t buf_size;
+	/** Map read-only files instead of reading them into a buffer */
+	bool use_mmap;
+	/** Buffered files, struct semihosting_io_file */
+	struct list_head files;
+	/* statistics */
+	uint64_t host_reads;
+	uint64_t host_writes;
+	uint64_t bytes_read;
+	uint64_t bytes_written;
+};
+
+void semihosting_io_init(struct semihosting_io *io);
+void semihosting_io_opened(struct semihosting_io *io, int fd, int flags);
+ssize_t semihosting_io_read(struct semihosting_io *io, int fd, void *buf, size_t size);
+ssize_t semihosting_io_write(struct semihosting_io *io, int fd, const void *buf, size_t size);
+off_t semihosting_io_seek(struct semihosting_io *io, int fd, off_t offset, int whence);
+int semihosting_io_sync(struct semihosting_io *io, int fd);
+int semihosting_io_close(struct semihosting_io *io, int fd);
+void semihosting_io_free(struct semihosting_io *io);
+
+#endif	/* OPENOCD_TARGET_SEMIHOSTING_IO_H */
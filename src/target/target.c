@@ -31,6 +31,7 @@
 #endif
 
 #include <helper/align.h>
+#include <helper/bits.h>
 #include <helper/nvp.h>
 #include <helper/time_support.h>
 #include <jtag/jtag.h>
@@ -52,6 +53,10 @@
 /* default halt wait timeout (ms) */
 #define DEFAULT_HALT_TIMEOUT 5000
 
+/* default geometry of the memory read cache */
+#define TARGET_MEMCACHE_DEFAULT_LINE_SIZE	64
+#define TARGET_MEMCACHE_DEFAULT_NUM_LINES	256
+
 static int target_read_buffer_default(struct target *target, target_addr_t address,
 		uint32_t count, uint8_t *buffer);
 static int target_write_buffer_default(struct target *target, target_addr_t address,
@@ -61,6 +66,13 @@ static int target_get_gdb_fileio_info_default(struct target *target,
 		struct gdb_fileio_info *fileio_info);
 static int target_gdb_fileio_end_default(struct target *target, int retcode,
 		int fileio_errno, bool ctrl_c);
+static int target_backup_working_areas_for_write(struct target *target,
+		target_addr_t address, uint32_t size, bool phys);
+static int target_backup_working_areas_for_algorithm(struct target *target);
+static bool target_memcache_eligible(struct target *target, target_addr_t address,
+		uint32_t access_size, uint32_t size);
+static int target_memcache_read(struct target *target, target_addr_t address,
+		uint32_t size, uint8_t *buffer);
 
 static struct target_type *target_types[] = {
 	&arm7tdmi_target,
@@ -114,6 +126,15 @@ static struct target_type *target_types[] = {
 struct target *all_targets;
 static struct target_event_callback *target_event_callbacks;
 static struct target_timer_callback *target_timer_callbacks;
+/* min-heap of queued timer callbacks ordered by 'when', entries are owned by the list above */
+static struct target_timer_callback **target_timer_heap;
+static unsigned int target_timer_heap_count;
+static unsigned int target_timer_heap_size;
+/* callbacks which are due in the current target_call_timer_callbacks_check_time() pass */
+static struct target_timer_callback **target_timer_due;
+static unsigned int target_timer_due_size;
+/* number of removed callbacks still linked in target_timer_callbacks */
+static unsigned int target_timer_removed_count;
 static int64_t target_timer_next_event_value;
 static LIST_HEAD(target_reset_callback_list);
 static LIST_HEAD(target_trace_callback_list);
@@ -575,6 +596,8 @@ int target_resume(struct target *target, int current, target_addr_t address,
 
 	target_call_event_callbacks(target, TARGET_EVENT_RESUME_START);
 
+	target_memcache_invalidate();
+
 	/* note that resume *must* be asynchronous. The CPU can halt before
 	 * we poll. The CPU can even halt at the current PC as a result of
 	 * a software breakpoint being inserted by (a bug?) the application.
@@ -614,6 +637,8 @@ static int target_process_reset(struct command_invocation *cmd, enum target_rese
 	for (target = all_targets; target; target = target->next)
 		target_call_reset_callbacks(target, reset_mode);
 
+	target_memcache_invalidate();
+
 	/* disable polling during reset to make reset event scripts
 	 * more predictable, i.e. dr/irscan & pathmove in events will
 	 * not have JTAG operations injected into the middle of a sequence.
@@ -797,6 +822,12 @@ int target_run_algorithm(struct target *target,
 		goto done;
 	}
 
+	retval = target_backup_working_areas_for_algorithm(target);
+	if (retval != ERROR_OK)
+		goto done;
+
+	target_memcache_invalidate();
+
 	target->running_alg = true;
 	retval = target->type->run_algorithm(target,
 			num_mem_params, mem_params,
@@ -842,6 +873,12 @@ int target_start_algorithm(struct target *target,
 		goto done;
 	}
 
+	retval = target_backup_working_areas_for_algorithm(target);
+	if (retval != ERROR_OK)
+		goto done;
+
+	target_memcache_invalidate();
+
 	target->running_alg = true;
 	retval = target->type->start_algorithm(target,
 			num_mem_params, mem_params,
@@ -886,6 +923,7 @@ int target_wait_algorithm(struct target *target,
 			num_mem_params, mem_params,
 			num_reg_params, reg_params,
 			exit_point, timeout_ms, arch_info);
+	target_memcache_invalidate();
 	if (retval != ERROR_TARGET_TIMEOUT)
 		target->running_alg = false;
 
@@ -1254,6 +1292,8 @@ int target_read_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support read_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	if (target_memcache_eligible(target, address, size, size * count))
+		return target_memcache_read(target, address, size * count, buffer);
 	return target->type->read_memory(target, address, size, count, buffer);
 }
 
@@ -1282,6 +1322,10 @@ int target_write_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	int retval = target_backup_working_areas_for_write(target, address, size * count, false);
+	if (retval != ERROR_OK)
+		return retval;
+	target_memcache_invalidate();
 	return target->type->write_memory(target, address, size, count, buffer);
 }
 
@@ -1296,9 +1340,67 @@ int target_write_phys_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_phys_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	int retval = target_backup_working_areas_for_write(target, address, size * count, true);
+	if (retval != ERROR_OK)
+		return retval;
+	target_memcache_invalidate();
 	return target->type->write_phys_memory(target, address, size, count, buffer);
 }
 
+int target_read_memory_scatter(struct target *target,
+		struct target_memory_scatter *list, unsigned int count)
+{
+	if (!target_was_examined(target)) {
+		LOG_ERROR("Target not examined yet");
+		return ERROR_FAIL;
+	}
+
+	/* cached data would be read again by the target */
+	bool cached = false;
+	for (unsigned int i = 0; i < count && !cached; i++)
+		cached = target_memcache_eligible(target, list[i].address, list[i].size,
+				list[i].size * list[i].count);
+
+	if (target->type->read_memory_scatter && !cached)
+		return target->type->read_memory_scatter(target, list, count);
+
+	for (unsigned int i = 0; i < count; i++) {
+		int retval = target_read_memory(target, list[i].address, list[i].size,
+				list[i].count, list[i].buffer);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	return ERROR_OK;
+}
+
+int target_write_memory_scatter(struct target *target,
+		const struct target_memory_scatter *list, unsigned int count)
+{
+	if (!target_was_examined(target)) {
+		LOG_ERROR("Target not examined yet");
+		return ERROR_FAIL;
+	}
+
+	if (!target->type->write_memory_scatter) {
+		for (unsigned int i = 0; i < count; i++) {
+			int retval = target_write_memory(target, list[i].address, list[i].size,
+					list[i].count, list[i].buffer);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+		return ERROR_OK;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		int retval = target_backup_working_areas_for_write(target, list[i].address,
+				list[i].size * list[i].count, false);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	target_memcache_invalidate();
+	return target->type->write_memory_scatter(target, list, count);
+}
+
 int target_add_breakpoint(struct target *target,
 		struct breakpoint *breakpoint)
 {
@@ -1423,6 +1525,8 @@ int target_step(struct target *target,
 
 	target_call_event_callbacks(target, TARGET_EVENT_STEP_START);
 
+	target_memcache_invalidate();
+
 	retval = target->type->step(target, current, address, handle_breakpoints);
 	if (retval != ERROR_OK)
 		return retval;
@@ -1664,31 +1768,112 @@ int target_register_trace_callback(int (*callback)(struct target *target,
 	return ERROR_OK;
 }
 
+static void target_timer_heap_set(unsigned int i, struct target_timer_callback *cb)
+{
+	target_timer_heap[i] = cb;
+	cb->heap_index = i;
+}
+
+static void target_timer_heap_sift_up(unsigned int i)
+{
+	struct target_timer_callback *cb = target_timer_heap[i];
+
+	while (i > 0) {
+		unsigned int parent = (i - 1) / 2;
+		if (target_timer_heap[parent]->when <= cb->when)
+			break;
+		target_timer_heap_set(i, target_timer_heap[parent]);
+		i = parent;
+	}
+	target_timer_heap_set(i, cb);
+}
+
+static void target_timer_heap_sift_down(unsigned int i)
+{
+	struct target_timer_callback *cb = target_timer_heap[i];
+
+	while (true) {
+		unsigned int child = 2 * i + 1;
+		if (child >= target_timer_heap_count)
+			break;
+		if (child + 1 < target_timer_heap_count &&
+				target_timer_heap[child + 1]->when < target_timer_heap[child]->when)
+			child++;
+		if (cb->when <= target_timer_heap[child]->when)
+			break;
+		target_timer_heap_set(i, target_timer_heap[child]);
+		i = child;
+	}
+	target_timer_heap_set(i, cb);
+}
+
+static int target_timer_heap_push(struct target_timer_callback *cb)
+{
+	if (target_timer_heap_count == target_timer_heap_size) {
+		unsigned int new_size = target_timer_heap_size ? 2 * target_timer_heap_size : 16;
+		struct target_timer_callback **heap = realloc(target_timer_heap, new_size * sizeof(*heap));
+		if (!heap) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		target_timer_heap = heap;
+		target_timer_heap_size = new_size;
+	}
+
+	target_timer_heap_set(target_timer_heap_count, cb);
+	target_timer_heap_sift_up(target_timer_heap_count++);
+	return ERROR_OK;
+}
+
+static void target_timer_heap_remove(struct target_timer_callback *cb)
+{
+	if (cb->heap_index < 0)
+		return;
+
+	unsigned int i = cb->heap_index;
+	struct target_timer_callback *last = target_timer_heap[--target_timer_heap_count];
+
+	cb->heap_index = -1;
+	if (i == target_timer_heap_count)
+		return;
+
+	target_timer_heap_set(i, last);
+	target_timer_heap_sift_up(i);
+	target_timer_heap_sift_down(last->heap_index);
+}
+
 int target_register_timer_callback(int (*callback)(void *priv),
 		unsigned int time_ms, enum target_timer_type type, void *priv)
 {
 	struct target_timer_callback **callbacks_p = &target_timer_callbacks;
+	struct target_timer_callback *cb;
 
 	if (!callback)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	if (*callbacks_p) {
-		while ((*callbacks_p)->next)
-			callbacks_p = &((*callbacks_p)->next);
-		callbacks_p = &((*callbacks_p)->next);
+	cb = malloc(sizeof(struct target_timer_callback));
+	if (!cb) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
 	}
+	cb->callback = callback;
+	cb->type = type;
+	cb->time_ms = time_ms;
+	cb->removed = false;
+	cb->heap_index = -1;
+	cb->priv = priv;
+	cb->next = NULL;
+
+	cb->when = timeval_ms() + time_ms;
+	if (target_timer_heap_push(cb) != ERROR_OK) {
+		free(cb);
+		return ERROR_FAIL;
+	}
+	target_timer_next_event_value = MIN(target_timer_next_event_value, cb->when);
 
-	(*callbacks_p) = malloc(sizeof(struct target_timer_callback));
-	(*callbacks_p)->callback = callback;
-	(*callbacks_p)->type = type;
-	(*callbacks_p)->time_ms = time_ms;
-	(*callbacks_p)->removed = false;
-
-	(*callbacks_p)->when = timeval_ms() + time_ms;
-	target_timer_next_event_value = MIN(target_timer_next_event_value, (*callbacks_p)->when);
-
-	(*callbacks_p)->priv = priv;
-	(*callbacks_p)->next = NULL;
+	while (*callbacks_p)
+		callbacks_p = &((*callbacks_p)->next);
+	*callbacks_p = cb;
 
 	return ERROR_OK;
 }
@@ -1762,7 +1947,11 @@ int target_unregister_timer_callback(int (*callback)(void *priv), void *priv)
 	for (struct target_timer_callback *c = target_timer_callbacks;
 	     c; c = c->next) {
 		if ((c->callback == callback) && (c->priv == priv)) {
-			c->removed = true;
+			if (!c->removed) {
+				c->removed = true;
+				target_timer_removed_count++;
+				target_timer_heap_remove(c);
+			}
 			return ERROR_OK;
 		}
 	}
@@ -1784,6 +1973,22 @@ int target_call_event_callbacks(struct target *target, enum target_event event)
 			target_event_name(event),
 			target_name(target));
 
+	switch (event) {
+	case TARGET_EVENT_HALTED:
+	case TARGET_EVENT_RESUMED:
+	case TARGET_EVENT_DEBUG_HALTED:
+	case TARGET_EVENT_DEBUG_RESUMED:
+	case TARGET_EVENT_RESET_ASSERT:
+	case TARGET_EVENT_RESET_DEASSERT_POST:
+	case TARGET_EVENT_GDB_FLASH_ERASE_END:
+	case TARGET_EVENT_GDB_FLASH_WRITE_END:
+		/* target memory may have changed behind our back */
+		target_memcache_invalidate();
+		break;
+	default:
+		break;
+	}
+
 	target_handle_event(target, event);
 
 	while (callback) {
@@ -1833,7 +2038,27 @@ static int target_call_timer_callback(struct target_timer_callback *cb,
 	if (cb->type == TARGET_TIMER_TYPE_PERIODIC)
 		return target_timer_callback_periodic_restart(cb, now);
 
-	return target_unregister_timer_callback(cb->callback, cb->priv);
+	if (!cb->removed) {
+		cb->removed = true;
+		target_timer_removed_count++;
+	}
+	return ERROR_OK;
+}
+
+static void target_timer_free_removed(void)
+{
+	struct target_timer_callback **callback = &target_timer_callbacks;
+
+	while (*callback) {
+		if ((*callback)->removed) {
+			struct target_timer_callback *p = *callback;
+			*callback = (*callback)->next;
+			free(p);
+			continue;
+		}
+		callback = &(*callback)->next;
+	}
+	target_timer_removed_count = 0;
 }
 
 static int target_call_timer_callbacks_check_time(int checktime)
@@ -1844,42 +2069,65 @@ static int target_call_timer_callbacks_check_time(int checktime)
 	if (callback_processing)
 		return ERROR_OK;
 
+	/* every due callback comes from the heap */
+	if (target_timer_due_size < target_timer_heap_size) {
+		struct target_timer_callback **due = realloc(target_timer_due,
+				target_timer_heap_size * sizeof(*due));
+		if (!due) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		target_timer_due = due;
+		target_timer_due_size = target_timer_heap_size;
+	}
+
 	callback_processing = true;
 
 	keep_alive();
 
 	int64_t now = timeval_ms();
 
-	/* Initialize to a default value that's a ways into the future.
-	 * The loop below will make it closer to now if there are
-	 * callbacks that want to be called sooner. */
-	target_timer_next_event_value = now + 1000;
-
-	/* Store an address of the place containing a pointer to the
-	 * next item; initially, that's a standalone "root of the
-	 * list" variable. */
-	struct target_timer_callback **callback = &target_timer_callbacks;
-	while (callback && *callback) {
-		if ((*callback)->removed) {
-			struct target_timer_callback *p = *callback;
-			*callback = (*callback)->next;
-			free(p);
-			continue;
+	/* Collect the due callbacks before calling any of them, so a periodic
+	 * callback re-armed with a short period is called once per pass. */
+	unsigned int num_due = 0;
+	if (!checktime) {
+		for (struct target_timer_callback *c = target_timer_callbacks; c; c = c->next) {
+			if (c->heap_index >= 0 && c->type == TARGET_TIMER_TYPE_PERIODIC) {
+				target_timer_heap_remove(c);
+				target_timer_due[num_due++] = c;
+			}
 		}
+	}
+	while (target_timer_heap_count && target_timer_heap[0]->when <= now) {
+		struct target_timer_callback *c = target_timer_heap[0];
+		target_timer_heap_remove(c);
+		target_timer_due[num_due++] = c;
+	}
 
-		bool call_it = (*callback)->callback &&
-			((!checktime && (*callback)->type == TARGET_TIMER_TYPE_PERIODIC) ||
-			 now >= (*callback)->when);
+	for (unsigned int i = 0; i < num_due; i++) {
+		struct target_timer_callback *c = target_timer_due[i];
 
-		if (call_it)
-			target_call_timer_callback(*callback, &now);
+		/* unregistered by one of the previous callbacks */
+		if (c->removed)
+			continue;
 
-		if (!(*callback)->removed && (*callback)->when < target_timer_next_event_value)
-			target_timer_next_event_value = (*callback)->when;
+		target_call_timer_callback(c, &now);
 
-		callback = &(*callback)->next;
+		if (!c->removed && target_timer_heap_push(c) != ERROR_OK) {
+			c->removed = true;
+			target_timer_removed_count++;
+		}
 	}
 
+	if (target_timer_removed_count)
+		target_timer_free_removed();
+
+	/* Default to a value that's a ways into the future, closer if there are
+	 * callbacks that want to be called sooner. */
+	target_timer_next_event_value = now + 1000;
+	if (target_timer_heap_count && target_timer_heap[0]->when < target_timer_next_event_value)
+		target_timer_next_event_value = target_timer_heap[0]->when;
+
 	callback_processing = false;
 	return ERROR_OK;
 }
@@ -1929,7 +2177,10 @@ static void target_split_working_area(struct working_area *area, uint32_t size)
 		new_wa->next = area->next;
 		new_wa->size = area->size - size;
 		new_wa->address = area->address + size;
+		new_wa->phys_address = area->phys_address + size;
 		new_wa->backup = NULL;
+		new_wa->backup_map = NULL;
+		new_wa->outputs_declared = false;
 		new_wa->user = NULL;
 		new_wa->free = true;
 
@@ -2007,13 +2258,25 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 			}
 		}
 
+		/* The working area is contiguous in physical memory as well */
+		target_addr_t phys_address = target->working_area;
+		if (enabled) {
+			if (target->working_area_phys_spec)
+				phys_address = target->working_area_phys;
+			else if (target->type->virt2phys(target, target->working_area, &phys_address) != ERROR_OK)
+				phys_address = target->working_area;
+		}
+
 		/* Set up initial working area on first call */
 		struct working_area *new_wa = malloc(sizeof(*new_wa));
 		if (new_wa) {
 			new_wa->next = NULL;
 			new_wa->size = ALIGN_DOWN(target->working_area_size, 4); /* 4-byte align */
 			new_wa->address = target->working_area;
+			new_wa->phys_address = phys_address;
 			new_wa->backup = NULL;
+			new_wa->backup_map = NULL;
+			new_wa->outputs_declared = false;
 			new_wa->user = NULL;
 			new_wa->free = true;
 		}
@@ -2049,9 +2312,17 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 				return ERROR_FAIL;
 		}
 
-		int retval = target_read_memory(target, c->address, 4, c->size / 4, c->backup);
-		if (retval != ERROR_OK)
-			return retval;
+		if (target->backup_working_area_dirty) {
+			/* nothing is read now, see target_backup_working_area_range() */
+			c->backup_map = calloc(DIV_ROUND_UP(c->size / 4, 32), sizeof(uint32_t));
+			if (!c->backup_map)
+				return ERROR_FAIL;
+			c->outputs_declared = false;
+		} else {
+			int retval = target_read_memory(target, c->address, 4, c->size / 4, c->backup);
+			if (retval != ERROR_OK)
+				return retval;
+		}
 	}
 
 	/* mark as used, and return the new (reused) area */
@@ -2077,11 +2348,136 @@ int target_alloc_working_area(struct target *target, uint32_t size, struct worki
 
 }
 
+static inline bool target_working_area_word_saved(const struct working_area *area, uint32_t word)
+{
+	return area->backup_map[word / 32] & BIT(word % 32);
+}
+
+/* Dirty backup mode: save the words of [offset, offset + size) which have not
+ * been saved yet, reading runs of consecutive words at once. */
+static int target_backup_working_area_range(struct target *target, struct working_area *area,
+		uint32_t offset, uint32_t size)
+{
+	uint32_t word = offset / 4;
+	const uint32_t end = DIV_ROUND_UP(offset + size, 4);
+
+	while (word < end) {
+		if (target_working_area_word_saved(area, word)) {
+			word++;
+			continue;
+		}
+
+		uint32_t run_end = word + 1;
+		while (run_end < end && !target_working_area_word_saved(area, run_end))
+			run_end++;
+
+		int retval = target_read_memory(target, area->address + word * 4, 4, run_end - word,
+				&area->backup[word * 4]);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("failed to back up working area at address " TARGET_ADDR_FMT,
+					area->address + word * 4);
+			return retval;
+		}
+
+		for (; word < run_end; word++)
+			area->backup_map[word / 32] |= BIT(word % 32);
+	}
+
+	return ERROR_OK;
+}
+
+/* Dirty backup mode: save the parts of allocated working areas the host is
+ * about to overwrite */
+static int target_backup_working_areas_for_write(struct target *target,
+		target_addr_t address, uint32_t size, bool phys)
+{
+	if (!target->backup_working_area_dirty)
+		return ERROR_OK;
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (c->free || !c->backup_map)
+			continue;
+		target_addr_t base = phys ? c->phys_address : c->address;
+		if (address >= base + c->size || address + size <= base)
+			continue;
+
+		target_addr_t start = MAX(address, base);
+		target_addr_t end = MIN(address + size, base + c->size);
+		int retval = target_backup_working_area_range(target, c, start - base, end - start);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return ERROR_OK;
+}
+
+/* Dirty backup mode: algorithms may write anywhere in areas whose owner did
+ * not declare otherwise, so save those completely before running one */
+static int target_backup_working_areas_for_algorithm(struct target *target)
+{
+	if (!target->backup_working_area_dirty)
+		return ERROR_OK;
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (c->free || !c->backup_map || c->outputs_declared)
+			continue;
+
+		int retval = target_backup_working_area_range(target, c, 0, c->size);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return ERROR_OK;
+}
+
+int target_working_area_declare_output(struct target *target, struct working_area *area,
+		uint32_t offset, uint32_t size)
+{
+	if (!area || area->free || offset > area->size || size > area->size - offset)
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+
+	if (!area->backup_map)
+		return ERROR_OK;
+
+	area->outputs_declared = true;
+	if (size == 0)
+		return ERROR_OK;
+
+	return target_backup_working_area_range(target, area, offset, size);
+}
+
 static int target_restore_working_area(struct target *target, struct working_area *area)
 {
 	int retval = ERROR_OK;
 
-	if (target->backup_working_area && area->backup) {
+	if (target->backup_working_area && area->backup && area->backup_map) {
+		uint32_t restored = 0;
+		uint32_t word = 0;
+		const uint32_t end = area->size / 4;
+
+		/* write back runs of saved words only */
+		while (word < end && retval == ERROR_OK) {
+			if (!target_working_area_word_saved(area, word)) {
+				word++;
+				continue;
+			}
+
+			uint32_t run_end = word + 1;
+			while (run_end < end && target_working_area_word_saved(area, run_end))
+				run_end++;
+
+			retval = target_write_memory(target, area->address + word * 4, 4, run_end - word,
+					&area->backup[word * 4]);
+			restored += (run_end - word) * 4;
+			word = run_end;
+		}
+		if (retval != ERROR_OK)
+			LOG_ERROR("failed to restore working area at address " TARGET_ADDR_FMT,
+					area->address);
+		else
+			LOG_DEBUG("restored %" PRIu32 " of %" PRIu32 " bytes of working area at address " TARGET_ADDR_FMT,
+					restored, area->size, area->address);
+	} else if (target->backup_working_area && area->backup) {
 		retval = target_write_memory(target, area->address, 4, area->size / 4, area->backup);
 		if (retval != ERROR_OK)
 			LOG_ERROR("failed to restore %" PRIu32 " bytes of working area at address " TARGET_ADDR_FMT,
@@ -2106,6 +2502,8 @@ static int target_free_working_area_restore(struct target *target, struct workin
 	}
 
 	area->free = true;
+	free(area->backup_map);
+	area->backup_map = NULL;
 
 	LOG_DEBUG("freed %" PRIu32 " bytes of working area at address " TARGET_ADDR_FMT,
 			area->size, area->address);
@@ -2144,6 +2542,8 @@ static void target_free_all_working_areas_restore(struct target *target, int res
 			if (restore)
 				target_restore_working_area(target, c);
 			c->free = true;
+			free(c->backup_map);
+			c->backup_map = NULL;
 			*c->user = NULL; /* Same as above */
 			c->user = NULL;
 		}
@@ -2196,8 +2596,10 @@ static void target_destroy(struct target *target)
 	if (target->type->deinit_target)
 		target->type->deinit_target(target);
 
-	if (target->semihosting)
+	if (target->semihosting) {
+		semihosting_io_free(&target->semihosting->io);
 		free(target->semihosting->basedir);
+	}
 	free(target->semihosting);
 
 	jtag_unregister_event_callback(jtag_enable_callback, target);
@@ -2212,6 +2614,12 @@ static void target_destroy(struct target *target)
 
 	target_free_all_working_areas(target);
 
+	free(target->memcache.lines);
+	free(target->memcache.data);
+	free(target->memcache.regions);
+
+	free(target->gdb_tdesc_cache);
+
     //TODO-UPS -- create a patch
 	rtos_destroy(target);
 
@@ -2255,6 +2663,15 @@ void target_quit(void)
 	}
 	target_timer_callbacks = NULL;
 
+	free(target_timer_heap);
+	target_timer_heap = NULL;
+	target_timer_heap_count = 0;
+	target_timer_heap_size = 0;
+	free(target_timer_due);
+	target_timer_due = NULL;
+	target_timer_due_size = 0;
+	target_timer_removed_count = 0;
+
 	for (struct target *target = all_targets; target;) {
 		struct target *tmp;
 
@@ -2370,6 +2787,10 @@ int target_write_buffer(struct target *target, target_addr_t address, uint32_t s
 		return ERROR_FAIL;
 	}
 
+	int retval = target_backup_working_areas_for_write(target, address, size, false);
+	if (retval != ERROR_OK)
+		return retval;
+	target_memcache_invalidate();
 	return target->type->write_buffer(target, address, size, buffer);
 }
 
@@ -2435,6 +2856,8 @@ int target_read_buffer(struct target *target, target_addr_t address, uint32_t si
 		return ERROR_FAIL;
 	}
 
+	if (target_memcache_eligible(target, address, 0, size))
+		return target_memcache_read(target, address, size, buffer);
 	return target->type->read_buffer(target, address, size, buffer);
 }
 
@@ -2474,6 +2897,171 @@ static int target_read_buffer_default(struct target *target, target_addr_t addre
 	return ERROR_OK;
 }
 
+/* Generation of the memory read caches. Memory is often shared between the
+ * cores of a chip, so instead of tracking which target may have modified what,
+ * any event which can change memory bumps this counter and thereby invalidates
+ * the lines of all targets at once. */
+static uint64_t target_memcache_generation = 1;
+
+/* access size of the line fills */
+#define TARGET_MEMCACHE_ACCESS_SIZE	4
+
+void target_memcache_invalidate(void)
+{
+	target_memcache_generation++;
+}
+
+static void target_memcache_free_lines(struct target_memcache *cache)
+{
+	free(cache->lines);
+	cache->lines = NULL;
+	free(cache->data);
+	cache->data = NULL;
+}
+
+static int target_memcache_alloc_lines(struct target_memcache *cache)
+{
+	if (cache->lines)
+		return ERROR_OK;
+
+	if (!cache->line_size)
+		cache->line_size = TARGET_MEMCACHE_DEFAULT_LINE_SIZE;
+	if (!cache->num_lines)
+		cache->num_lines = TARGET_MEMCACHE_DEFAULT_NUM_LINES;
+
+	cache->lines = calloc(cache->num_lines, sizeof(*cache->lines));
+	cache->data = malloc((size_t)cache->num_lines * cache->line_size);
+	if (!cache->lines || !cache->data) {
+		LOG_ERROR("Out of memory");
+		target_memcache_free_lines(cache);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+/* @a access_size is the access width requested by the caller, 0 if it does not matter */
+static bool target_memcache_eligible(struct target *target, target_addr_t address,
+	uint32_t access_size, uint32_t size)
+{
+	struct target_memcache *cache = &target->memcache;
+
+	if (!cache->enabled || !cache->lines || size == 0)
+		return false;
+
+	/* an explicit access width other than the one of the line fills
+	 * has to reach the target as it is */
+	if (access_size && access_size != TARGET_MEMCACHE_ACCESS_SIZE)
+		return false;
+
+	/* the content is only stable while the target is halted */
+	if (target->state != TARGET_HALTED)
+		return false;
+
+	/* bulk transfers (dumps, verify) would only thrash the cache */
+	if (size > cache->num_lines / 2 * cache->line_size)
+		return false;
+
+	/* line fills must not touch anything outside of the cacheable regions */
+	target_addr_t first = ALIGN_DOWN(address, cache->line_size);
+	target_addr_t last = ALIGN_DOWN(address + size - 1, cache->line_size) + cache->line_size - 1;
+	if (last < first)
+		return false;
+
+	for (unsigned int i = 0; i < cache->num_regions; i++) {
+		const struct target_memcache_region *region = &cache->regions[i];
+		if (first >= region->address && last - region->address < region->size)
+			return true;
+	}
+
+	return false;
+}
+
+static inline unsigned int target_memcache_index(const struct target_memcache *cache,
+	target_addr_t address)
+{
+	return (address / cache->line_size) % cache->num_lines;
+}
+
+static bool target_memcache_hit(const struct target_memcache *cache, target_addr_t address)
+{
+	const struct target_memcache_line *line = &cache->lines[target_memcache_index(cache, address)];
+
+	return line->generation == target_memcache_generation && line->address == address;
+}
+
+/* Read @a count consecutive lines starting at @a address from the target */
+static int target_memcache_fill(struct target *target, target_addr_t address, unsigned int count)
+{
+	struct target_memcache *cache = &target->memcache;
+	const uint32_t line_size = cache->line_size;
+
+	uint8_t *buf = malloc((size_t)count * line_size);
+	if (!buf) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int retval = target->type->read_memory(target, address, TARGET_MEMCACHE_ACCESS_SIZE,
+			count * line_size / TARGET_MEMCACHE_ACCESS_SIZE, buf);
+	if (retval == ERROR_OK) {
+		for (unsigned int i = 0; i < count; i++) {
+			target_addr_t line_addr = address + i * line_size;
+			unsigned int idx = target_memcache_index(cache, line_addr);
+			cache->lines[idx].address = line_addr;
+			cache->lines[idx].generation = target_memcache_generation;
+			memcpy(&cache->data[(size_t)idx * line_size], &buf[(size_t)i * line_size], line_size);
+		}
+		cache->fills++;
+		cache->misses += count;
+	}
+
+	free(buf);
+	return retval;
+}
+
+static int target_memcache_read(struct target *target, target_addr_t address, uint32_t size, uint8_t *buffer)
+{
+	struct target_memcache *cache = &target->memcache;
+	const uint32_t line_size = cache->line_size;
+	const target_addr_t first = ALIGN_DOWN(address, line_size);
+	const unsigned int num_lines = (ALIGN_DOWN(address + size - 1, line_size) - first) / line_size + 1;
+
+	/* Fill missing lines first, merging runs of consecutive misses into
+	 * single reads. A request spans at most half of the cache (see
+	 * target_memcache_eligible()), so the fills can not evict each other. */
+	for (unsigned int i = 0; i < num_lines; ) {
+		if (target_memcache_hit(cache, first + i * line_size)) {
+			cache->hits++;
+			i++;
+			continue;
+		}
+
+		unsigned int run = 1;
+		while (i + run < num_lines && !target_memcache_hit(cache, first + (i + run) * line_size))
+			run++;
+
+		int retval = target_memcache_fill(target, first + i * line_size, run);
+		if (retval != ERROR_OK)
+			return retval;
+		i += run;
+	}
+
+	while (size > 0) {
+		target_addr_t line_addr = ALIGN_DOWN(address, line_size);
+		uint32_t offset = address - line_addr;
+		uint32_t len = MIN(size, line_size - offset);
+		unsigned int idx = target_memcache_index(cache, line_addr);
+
+		memcpy(buffer, &cache->data[(size_t)idx * line_size + offset], len);
+		address += len;
+		buffer += len;
+		size -= len;
+	}
+
+	return ERROR_OK;
+}
+
 int target_checksum_memory(struct target *target, target_addr_t address, uint32_t size, uint32_t *crc)
 {
 	uint8_t *buffer;
@@ -3621,7 +4209,8 @@ static COMMAND_HELPER(parse_load_image_command, struct image *image,
 
 COMMAND_HANDLER(handle_load_image_command)
 {
-	uint8_t *buffer;
+	const uint8_t *data;
+	uint8_t *copy;
 	size_t buf_cnt;
 	uint32_t image_size;
 	target_addr_t min_address = 0;
@@ -3644,20 +4233,9 @@ COMMAND_HANDLER(handle_load_image_command)
 	image_size = 0x0;
 	retval = ERROR_OK;
 	for (unsigned int i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (!buffer) {
-			command_print(CMD,
-						  "error allocating buffer for section (%d bytes)",
-						  (int)(image.sections[i].size));
-			retval = ERROR_FAIL;
-			break;
-		}
-
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
+		retval = image_section_get(&image, i, 0x0, image.sections[i].size, &data, &copy, &buf_cnt);
+		if (retval != ERROR_OK)
 			break;
-		}
 
 		uint32_t offset = 0;
 		uint32_t length = buf_cnt;
@@ -3677,9 +4255,9 @@ COMMAND_HANDLER(handle_load_image_command)
 				length -= (image.sections[i].base_address + buf_cnt)-max_address;
 
 			retval = target_write_buffer(target,
-					image.sections[i].base_address + offset, length, buffer + offset);
+					image.sections[i].base_address + offset, length, data + offset);
 			if (retval != ERROR_OK) {
-				free(buffer);
+				free(copy);
 				break;
 			}
 			image_size += length;
@@ -3688,7 +4266,7 @@ COMMAND_HANDLER(handle_load_image_command)
 					image.sections[i].base_address + offset);
 		}
 
-		free(buffer);
+		free(copy);
 	}
 
 	if ((retval == ERROR_OK) && (duration_measure(&bench) == ERROR_OK)) {
@@ -3771,14 +4349,91 @@ enum verify_mode {
 	IMAGE_CHECKSUM_ONLY = 2
 };
 
+/* Sections are verified in chunks of this size. It bounds the host memory used
+ * and the amount of data read back from the target when a chunk does not match. */
+#define VERIFY_IMAGE_CHUNK_SIZE		(256 * 1024)
+
+struct verify_image_state {
+	/* target computes checksums, cleared when it can not */
+	bool use_checksum;
+	/* buffer for data read back from target */
+	uint8_t *readback;
+	unsigned int diffs;
+	unsigned int chunks;
+	unsigned int chunks_read;
+};
+
+static COMMAND_HELPER(verify_image_chunk, enum verify_mode verify, struct verify_image_state *state,
+	target_addr_t address, const uint8_t *data, uint32_t size)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	int retval;
+
+	state->chunks++;
+	if (state->use_checksum) {
+		uint32_t checksum, mem_checksum;
+		retval = image_calculate_checksum(data, size, &checksum);
+		if (retval != ERROR_OK)
+			return retval;
+
+		if (target->type->checksum_memory)
+			retval = target->type->checksum_memory(target, address, size, &mem_checksum);
+		else
+			retval = ERROR_FAIL;
+
+		if (retval == ERROR_OK && checksum == mem_checksum)
+			return ERROR_OK;
+
+		if (retval != ERROR_OK) {
+			/* reading the data back is needed anyway, compare it directly from now on */
+			LOG_DEBUG("no on-target checksum, comparing data read back");
+			state->use_checksum = false;
+		} else if (verify == IMAGE_CHECKSUM_ONLY) {
+			LOG_ERROR("checksum mismatch at address " TARGET_ADDR_FMT " length 0x%08" PRIx32,
+				address, size);
+			return ERROR_FAIL;
+		} else {
+			if (state->diffs == 0)
+				LOG_ERROR("checksum mismatch - attempting binary compare");
+			LOG_INFO("checksum mismatch at address " TARGET_ADDR_FMT " length 0x%08" PRIx32,
+				address, size);
+		}
+	}
+
+	state->chunks_read++;
+	retval = target_read_buffer(target, address, size, state->readback);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (!memcmp(state->readback, data, size))
+		return ERROR_OK;
+
+	if (verify == IMAGE_CHECKSUM_ONLY) {
+		LOG_ERROR("checksum mismatch at address " TARGET_ADDR_FMT " length 0x%08" PRIx32,
+			address, size);
+		return ERROR_FAIL;
+	}
+
+	for (uint32_t t = 0; t < size; t++) {
+		if (state->readback[t] == data[t])
+			continue;
+		command_print(CMD, "diff %u address 0x%08x. Was 0x%02x instead of 0x%02x",
+			state->diffs, (unsigned int)(t + address), state->readback[t], data[t]);
+		if (state->diffs++ >= 127) {
+			command_print(CMD, "More than 128 errors, the rest are not printed.");
+			return ERROR_FAIL;
+		}
+	}
+	return ERROR_OK;
+}
+
 static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode verify)
 {
-	uint8_t *buffer;
+	uint8_t *buffer = NULL;
 	size_t buf_cnt;
 	uint32_t image_size;
 	int retval;
-	uint32_t checksum = 0;
-	uint32_t mem_checksum = 0;
+	struct verify_image_state state = { .use_checksum = true };
 
 	struct image image;
 
@@ -3792,6 +4447,11 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 		return ERROR_FAIL;
 	}
 
+	if (verify >= IMAGE_VERIFY && !target_was_examined(target)) {
+		LOG_ERROR("Target not examined yet");
+		return ERROR_FAIL;
+	}
+
 	struct duration bench;
 	duration_start(&bench);
 
@@ -3811,100 +4471,79 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 	if (retval != ERROR_OK)
 		return retval;
 
+	uint32_t max_section_size = 0;
+	for (unsigned int i = 0; i < image.num_sections; i++)
+		max_section_size = MAX(max_section_size, image.sections[i].size);
+	uint32_t chunk_size = MIN(max_section_size, VERIFY_IMAGE_CHUNK_SIZE);
+
+	buffer = malloc(MAX(chunk_size, 1));
+	if (verify >= IMAGE_VERIFY)
+		state.readback = malloc(MAX(chunk_size, 1));
+	if (!buffer || (verify >= IMAGE_VERIFY && !state.readback)) {
+		command_print(CMD, "error allocating buffer for section (%" PRIu32 " bytes)", chunk_size);
+		retval = ERROR_FAIL;
+		goto done;
+	}
+
 	image_size = 0x0;
-	int diffs = 0;
 	retval = ERROR_OK;
 	for (unsigned int i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (!buffer) {
-			command_print(CMD,
-					"error allocating buffer for section (%" PRIu32 " bytes)",
-					image.sections[i].size);
-			break;
-		}
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
-			break;
-		}
-
-		if (verify >= IMAGE_VERIFY) {
-			/* calculate checksum of image */
-			retval = image_calculate_checksum(buffer, buf_cnt, &checksum);
-			if (retval != ERROR_OK) {
-				free(buffer);
-				break;
+		struct imagesection *section = &image.sections[i];
+		size_t section_cnt = 0;
+
+		/* only the chunks that do not match are read back from the target */
+		for (uint32_t offset = 0; offset < section->size; offset += buf_cnt) {
+			uint32_t size = MIN(section->size - offset, chunk_size);
+			/* the image is accessed in place when possible */
+			const uint8_t *data;
+			if (image_section_view(&image, i, offset, size, &data) == ERROR_OK) {
+				buf_cnt = size;
+			} else {
+				retval = image_read_section(&image, i, offset, size, buffer, &buf_cnt);
+				if (retval != ERROR_OK)
+					goto done;
+				data = buffer;
 			}
-
-			retval = target_checksum_memory(target, image.sections[i].base_address, buf_cnt, &mem_checksum);
-			if (retval != ERROR_OK) {
-				free(buffer);
+			if (buf_cnt == 0)
 				break;
+
+			if (verify >= IMAGE_VERIFY) {
+				retval = CALL_COMMAND_HANDLER(verify_image_chunk, verify, &state,
+					section->base_address + offset, data, buf_cnt);
+				if (retval != ERROR_OK)
+					goto done;
 			}
-			if ((checksum != mem_checksum) && (verify == IMAGE_CHECKSUM_ONLY)) {
-				LOG_ERROR("checksum mismatch");
-				free(buffer);
-				retval = ERROR_FAIL;
+			section_cnt += buf_cnt;
+
+			keep_alive();
+			if (openocd_is_shutdown_pending()) {
+				retval = ERROR_SERVER_INTERRUPTED;
 				goto done;
 			}
-			if (checksum != mem_checksum) {
-				/* failed crc checksum, fall back to a binary compare */
-				uint8_t *data;
-
-				if (diffs == 0)
-					LOG_ERROR("checksum mismatch - attempting binary compare");
-
-				data = malloc(buf_cnt);
-
-				retval = target_read_buffer(target, image.sections[i].base_address, buf_cnt, data);
-				if (retval == ERROR_OK) {
-					uint32_t t;
-					for (t = 0; t < buf_cnt; t++) {
-						if (data[t] != buffer[t]) {
-							command_print(CMD,
-										  "diff %d address 0x%08x. Was 0x%02x instead of 0x%02x",
-										  diffs,
-										  (unsigned)(t + image.sections[i].base_address),
-										  data[t],
-										  buffer[t]);
-							if (diffs++ >= 127) {
-								command_print(CMD, "More than 128 errors, the rest are not printed.");
-								free(data);
-								free(buffer);
-								goto done;
-							}
-						}
-						keep_alive();
-						if (openocd_is_shutdown_pending()) {
-							retval = ERROR_SERVER_INTERRUPTED;
-							free(data);
-							free(buffer);
-							goto done;
-						}
-					}
-				}
-				free(data);
-			}
-		} else {
-			command_print(CMD, "address " TARGET_ADDR_FMT " length 0x%08zx",
-						  image.sections[i].base_address,
-						  buf_cnt);
 		}
 
-		free(buffer);
-		image_size += buf_cnt;
+		if (verify == IMAGE_TEST)
+			command_print(CMD, "address " TARGET_ADDR_FMT " length 0x%08zx",
+						  section->base_address,
+						  section_cnt);
+
+		image_size += section_cnt;
 	}
-	if (diffs > 0)
+	if (state.diffs > 0)
 		command_print(CMD, "No more differences found.");
 done:
-	if (diffs > 0)
+	if (state.diffs > 0)
 		retval = ERROR_FAIL;
 	if ((retval == ERROR_OK) && (duration_measure(&bench) == ERROR_OK)) {
 		command_print(CMD, "verified %" PRIu32 " bytes "
 				"in %fs (%0.3f KiB/s)", image_size,
 				duration_elapsed(&bench), duration_kbps(&bench, image_size));
+		if (verify >= IMAGE_VERIFY)
+			LOG_DEBUG("%u chunks verified, %u of them read back", state.chunks, state.chunks_read);
 	}
 
+	free(state.readback);
+	free(buffer);
 	image_close(&image);
 
 	return retval;
@@ -4216,8 +4855,18 @@ static void write_string(FILE *f, char *s)
 typedef unsigned char UNIT[2];  /* unit of profiling */
 
 /* Dump a gmon.out histogram file. */
-static void write_gmon(uint32_t *samples, uint32_t sample_num, const char *filename, bool with_range,
+void target_write_gmon(uint32_t *samples, uint32_t sample_num, const char *filename, bool with_range,
 			uint32_t start_address, uint32_t end_address, struct target *target, uint32_t duration_ms)
+{
+	target_write_gmon_weighted(samples, NULL, sample_num, filename, with_range,
+		start_address, end_address, target, duration_ms);
+}
+
+/* Dump a gmon.out histogram file, every sample address counts @a weights[i] times (once if NULL).
+ * The histogram is scaled down when weighted buckets do not fit the 16-bit gmon counters. */
+void target_write_gmon_weighted(const uint32_t *samples, const uint32_t *weights, uint32_t sample_num,
+			const char *filename, bool with_range, uint32_t start_address, uint32_t end_address,
+			struct target *target, uint32_t duration_ms)
 {
 	uint32_t i;
 	FILE *f = fopen(filename, "wb");
@@ -4270,15 +4919,18 @@ static void write_gmon(uint32_t *samples, uint32_t sample_num, const char *filen
 	uint32_t num_buckets = address_space / sizeof(UNIT);
 	if (num_buckets > max_buckets)
 		num_buckets = max_buckets;
-	int *buckets = malloc(sizeof(int) * num_buckets);
+	uint64_t *buckets = calloc(num_buckets, sizeof(*buckets));
 	if (!buckets) {
 		fclose(f);
 		return;
 	}
-	memset(buckets, 0, sizeof(int) * num_buckets);
+	uint64_t total = 0;
+	uint64_t max_bucket = 0;
 	for (i = 0; i < sample_num; i++) {
 		uint32_t address = samples[i];
+		uint32_t weight = weights ? weights[i] : 1;
 
+		total += weight;
 		if ((address < min) || (max <= address))
 			continue;
 
@@ -4286,14 +4938,20 @@ static void write_gmon(uint32_t *samples, uint32_t sample_num, const char *filen
 		long long b = num_buckets;
 		long long c = address_space;
 		int index_t = (a * b) / c; /* danger!!!! int32 overflows */
-		buckets[index_t]++;
+		buckets[index_t] += weight;
+		max_bucket = MAX(max_bucket, buckets[index_t]);
+	}
+	if (weights && max_bucket > 65535) {
+		for (i = 0; i < num_buckets; i++)
+			buckets[i] = buckets[i] * 65535 / max_bucket;
+		total = total * 65535 / max_bucket;
 	}
 
 	/* append binary memory gmon.out &profile_hist_hdr ((char*)&profile_hist_hdr + sizeof(struct gmon_hist_hdr)) */
 	write_long(f, min, target);			/* low_pc */
 	write_long(f, max, target);			/* high_pc */
 	write_long(f, num_buckets, target);	/* # of buckets */
-	float sample_rate = sample_num / (duration_ms / 1000.0);
+	float sample_rate = total / (duration_ms / 1000.0);
 	write_long(f, sample_rate, target);
 	write_string(f, "seconds");
 	for (i = 0; i < (15-strlen("seconds")); i++)
@@ -4305,7 +4963,7 @@ static void write_gmon(uint32_t *samples, uint32_t sample_num, const char *filen
 	char *data = malloc(2 * num_buckets);
 	if (data) {
 		for (i = 0; i < num_buckets; i++) {
-			int val;
+			uint64_t val;
 			val = buckets[i];
 			if (val > 65535)
 				val = 65535;
@@ -4403,7 +5061,7 @@ COMMAND_HANDLER(handle_profile_command)
 		return retval;
 	}
 
-	write_gmon(samples, num_of_samples, CMD_ARGV[1],
+	target_write_gmon(samples, num_of_samples, CMD_ARGV[1],
 		   with_range, start_address, end_address, target, duration_ms);
 	command_print(CMD, "Wrote %s", CMD_ARGV[1]);
 
@@ -5100,13 +5758,19 @@ no_params:
 				e = jim_getopt_wide(goi, &w);
 				if (e != JIM_OK)
 					return e;
-				/* make this boolean */
+				/* 0: off, 1: whole areas, 2: modified ranges only */
+				if (w < 0 || w > 2) {
+					Jim_SetResultString(goi->interp, "-work-area-backup must be 0, 1 or 2", -1);
+					return JIM_ERR;
+				}
 				target->backup_working_area = (w != 0);
+				target->backup_working_area_dirty = (w == 2);
 			} else {
 				if (goi->argc != 0)
 					goto no_params;
 			}
-			Jim_SetResult(goi->interp, Jim_NewIntObj(goi->interp, target->backup_working_area ? 1 : 0));
+			Jim_SetResult(goi->interp, Jim_NewIntObj(goi->interp,
+				!target->backup_working_area ? 0 : target->backup_working_area_dirty ? 2 : 1));
 			/* loop for more e*/
 			break;
 
@@ -5386,6 +6050,7 @@ COMMAND_HANDLER(handle_target_reset)
 	target->reset_halt = (a != 0);
 	/* When this happens - all workareas are invalid. */
 	target_free_all_working_areas_restore(target, 0);
+	target_memcache_invalidate();
 
 	/* do the assert */
 	if (n->value == NVP_ASSERT) {
@@ -5521,6 +6186,210 @@ static int jim_target_invoke_event(Jim_Interp *interp, int argc, Jim_Obj *const
 	return JIM_OK;
 }
 
+COMMAND_HANDLER(handle_target_memcache_enable)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	struct target_memcache *cache = &target->memcache;
+
+	int retval = target_memcache_alloc_lines(cache);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (!cache->num_regions)
+		command_print(CMD, "warning: no cacheable region configured, see '%s memcache region'",
+			target_name(target));
+
+	/* lines allocated before may hold data of an earlier halt */
+	target_memcache_invalidate();
+	cache->enabled = true;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_target_memcache_disable)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+
+	target->memcache.enabled = false;
+	target_memcache_free_lines(&target->memcache);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_target_memcache_config)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct target_memcache *cache = &target->memcache;
+
+	if (CMD_ARGC == 0) {
+		command_print(CMD, "line size %" PRIu32 " bytes, %u lines",
+			cache->line_size ? cache->line_size : TARGET_MEMCACHE_DEFAULT_LINE_SIZE,
+			cache->num_lines ? cache->num_lines : TARGET_MEMCACHE_DEFAULT_NUM_LINES);
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	uint32_t line_size;
+	unsigned int num_lines;
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], line_size);
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], num_lines);
+
+	if (line_size < 4 || !IS_PWR_OF_2(line_size)) {
+		command_print(CMD, "line size must be a power of 2, at least 4 bytes");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	if (num_lines < 2) {
+		command_print(CMD, "at least 2 lines are required");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	target_memcache_free_lines(cache);
+	cache->line_size = line_size;
+	cache->num_lines = num_lines;
+
+	if (cache->enabled)
+		return target_memcache_alloc_lines(cache);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_target_memcache_region)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct target_memcache *cache = &target->memcache;
+
+	if (CMD_ARGC == 0) {
+		for (unsigned int i = 0; i < cache->num_regions; i++)
+			command_print(CMD, TARGET_ADDR_FMT " size 0x%08" PRIx32,
+				cache->regions[i].address, cache->regions[i].size);
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC == 1 && !strcmp(CMD_ARGV[0], "clear")) {
+		free(cache->regions);
+		cache->regions = NULL;
+		cache->num_regions = 0;
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	target_addr_t address;
+	uint32_t size;
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], size);
+
+	if (size == 0 || address + size - 1 < address) {
+		command_print(CMD, "invalid region");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct target_memcache_region *regions = realloc(cache->regions,
+		(cache->num_regions + 1) * sizeof(*regions));
+	if (!regions) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	regions[cache->num_regions].address = address;
+	regions[cache->num_regions].size = size;
+	cache->regions = regions;
+	cache->num_regions++;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_target_memcache_flush)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	target_memcache_invalidate();
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_target_memcache_stats)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct target_memcache *cache = &target->memcache;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		cache->hits = 0;
+		cache->misses = 0;
+		cache->fills = 0;
+		return ERROR_OK;
+	}
+
+	uint64_t total = cache->hits + cache->misses;
+	command_print(CMD, "%s: hits %" PRIu64 ", misses %" PRIu64 " (%.1f%% hit rate), fills %" PRIu64,
+		cache->enabled ? "enabled" : "disabled",
+		cache->hits, cache->misses,
+		total ? 100.0 * cache->hits / total : 0.0,
+		cache->fills);
+
+	return ERROR_OK;
+}
+
+static const struct command_registration target_memcache_command_handlers[] = {
+	{
+		.name = "enable",
+		.mode = COMMAND_ANY,
+		.handler = handle_target_memcache_enable,
+		.help = "enable the memory read cache",
+		.usage = "",
+	},
+	{
+		.name = "disable",
+		.mode = COMMAND_ANY,
+		.handler = handle_target_memcache_disable,
+		.help = "disable the memory read cache and release its memory",
+		.usage = "",
+	},
+	{
+		.name = "config",
+		.mode = COMMAND_ANY,
+		.handler = handle_target_memcache_config,
+		.help = "display or set the cache geometry",
+		.usage = "[line_size num_lines]",
+	},
+	{
+		.name = "region",
+		.mode = COMMAND_ANY,
+		.handler = handle_target_memcache_region,
+		.help = "display, add or clear cacheable memory regions",
+		.usage = "[address size | 'clear']",
+	},
+	{
+		.name = "flush",
+		.mode = COMMAND_ANY,
+		.handler = handle_target_memcache_flush,
+		.help = "invalidate the memory read cache",
+		.usage = "",
+	},
+	{
+		.name = "stats",
+		.mode = COMMAND_ANY,
+		.handler = handle_target_memcache_stats,
+		.help = "display or reset the cache hit/miss counters",
+		.usage = "['reset']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 static const struct command_registration target_instance_command_handlers[] = {
 	{
 		.name = "configure",
@@ -5704,6 +6573,13 @@ static const struct command_registration target_instance_command_handlers[] = {
 		.help = "invoke handler for specified event",
 		.usage = "event_name",
 	},
+	{
+		.name = "memcache",
+		.mode = COMMAND_ANY,
+		.help = "memory read cache commands",
+		.usage = "",
+		.chain = target_memcache_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -6144,7 +7020,8 @@ static void free_fastload(void)
 
 COMMAND_HANDLER(handle_fast_load_image_command)
 {
-	uint8_t *buffer;
+	const uint8_t *data;
+	uint8_t *copy;
 	size_t buf_cnt;
 	uint32_t image_size;
 	target_addr_t min_address = 0;
@@ -6175,19 +7052,9 @@ COMMAND_HANDLER(handle_fast_load_image_command)
 	}
 	memset(fastload, 0, sizeof(struct fast_load)*image.num_sections);
 	for (unsigned int i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (!buffer) {
-			command_print(CMD, "error allocating buffer for section (%d bytes)",
-						  (int)(image.sections[i].size));
-			retval = ERROR_FAIL;
-			break;
-		}
-
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
+		retval = image_section_get(&image, i, 0x0, image.sections[i].size, &data, &copy, &buf_cnt);
+		if (retval != ERROR_OK)
 			break;
-		}
 
 		uint32_t offset = 0;
 		uint32_t length = buf_cnt;
@@ -6208,13 +7075,13 @@ COMMAND_HANDLER(handle_fast_load_image_command)
 			fastload[i].address = image.sections[i].base_address + offset;
 			fastload[i].data = malloc(length);
 			if (!fastload[i].data) {
-				free(buffer);
+				free(copy);
 				command_print(CMD, "error allocating buffer for section (%" PRIu32 " bytes)",
 							  length);
 				retval = ERROR_FAIL;
 				break;
 			}
-			memcpy(fastload[i].data, buffer + offset, length);
+			memcpy(fastload[i].data, data + offset, length);
 			fastload[i].length = length;
 
 			image_size += length;
@@ -6223,7 +7090,7 @@ COMMAND_HANDLER(handle_fast_load_image_command)
 						  ((unsigned int)(image.sections[i].base_address + offset)));
 		}
 
-		free(buffer);
+		free(copy);
 	}
 
 	if ((retval == ERROR_OK) && (duration_measure(&bench) == ERROR_OK)) {
@@ -88,9 +88,12 @@ enum target_endianness {
 
 struct working_area {
 	target_addr_t address;
+	target_addr_t phys_address;	/* same as address unless the MMU is enabled */
 	uint32_t size;
 	bool free;
 	uint8_t *backup;
+	uint32_t *backup_map;		/* dirty backup mode: bitmap of the 32-bit words saved in backup */
+	bool outputs_declared;		/* dirty backup mode: owner declared what algorithms may modify */
 	struct working_area **user;
 	struct working_area *next;
 };
@@ -110,6 +113,33 @@ struct backoff_timer {
 	int count;
 };
 
+/* range of target memory which may be served from the memory read cache */
+struct target_memcache_region {
+	target_addr_t address;
+	uint32_t size;
+};
+
+/* one line of the direct-mapped memory read cache */
+struct target_memcache_line {
+	target_addr_t address;
+	uint64_t generation;			/* line is valid only if it matches the global generation */
+};
+
+/* Opt-in read cache for target memory. Contents are only valid while the
+ * target stays halted, see target_memcache_invalidate(). */
+struct target_memcache {
+	bool enabled;
+	uint32_t line_size;				/* bytes per line, power of 2 */
+	unsigned int num_lines;
+	struct target_memcache_line *lines;
+	uint8_t *data;					/* num_lines * line_size bytes */
+	struct target_memcache_region *regions;
+	unsigned int num_regions;
+	uint64_t hits;					/* lines served from the cache */
+	uint64_t misses;				/* lines read from the target */
+	uint64_t fills;					/* read transactions issued to fill lines */
+};
+
 /* split target registers into multiple class */
 enum target_register_class {
 	REG_CLASS_ALL,
@@ -154,6 +184,7 @@ struct target {
 	target_addr_t working_area_phys;			/* physical address */
 	uint32_t working_area_size;			/* size in bytes */
 	bool backup_working_area;			/* whether the content of the working area has to be preserved */
+	bool backup_working_area_dirty;		/* back up only the ranges which are actually modified */
 	struct working_area *working_areas;/* list of allocated working areas */
 	enum target_debug_reason debug_reason;/* reason why the target entered debug state */
 	enum target_endianness endianness;	/* target endianness */
@@ -209,8 +240,16 @@ struct target {
 
 	int gdb_max_connections;			/* max number of simultaneous gdb connections */
 
+	/* last generated gdb target description and the hash of the register
+	 * list it was generated from, see gdb_server.c */
+	char *gdb_tdesc_cache;
+	uint32_t gdb_tdesc_cache_hash;
+
 	/* The semihosting information, extracted from the target. */
 	struct semihosting *semihosting;
+
+	/* memory read cache, valid between halts */
+	struct target_memcache memcache;
 };
 
 struct target_list {
@@ -339,6 +378,7 @@ struct target_timer_callback {
 	enum target_timer_type type;
 	bool removed;
 	int64_t when;	/* output of timeval_ms() */
+	int heap_index;	/* position in the pending timers heap, -1 if not queued */
 	void *priv;
 	struct target_timer_callback *next;
 };
@@ -349,6 +389,16 @@ struct target_memory_check_block {
 	uint32_t result;
 };
 
+/** One request of a scattered memory access */
+struct target_memory_scatter {
+	target_addr_t address;
+	/** access size in bytes, 1, 2 or 4 */
+	uint32_t size;
+	uint32_t count;
+	/** data read, or to be written, in target memory order */
+	uint8_t *buffer;
+};
+
 int target_register_commands(struct command_context *cmd_ctx);
 int target_examine(void);
 
@@ -632,6 +682,19 @@ int target_write_memory(struct target *target,
 int target_write_phys_memory(struct target *target,
 		target_addr_t address, uint32_t size, uint32_t count, const uint8_t *buffer);
 
+/**
+ * Read or write all the requests of a scatter list. Targets implementing
+ * target->type->read_memory_scatter or write_memory_scatter may reorder
+ * and merge the accesses to complete them in fewer transactions, others
+ * do them one by one with target_read_memory() or target_write_memory().
+ * The requests are not meant for locations with access side effects,
+ * writes to overlapping locations are done in the order of the list.
+ */
+int target_read_memory_scatter(struct target *target,
+		struct target_memory_scatter *list, unsigned int count);
+int target_write_memory_scatter(struct target *target,
+		const struct target_memory_scatter *list, unsigned int count);
+
 /*
  * Write to target memory using the virtual address.
  *
@@ -658,6 +721,15 @@ int target_write_phys_memory(struct target *target,
  */
 int target_write_buffer(struct target *target,
 		target_addr_t address, uint32_t size, const uint8_t *buffer);
+
+/**
+ * Invalidate the memory read cache of all targets.
+ *
+ * Must be called whenever target memory may have changed behind the back of
+ * target_write_memory()/target_write_buffer(), e.g. when a target driver
+ * resumes a core or writes memory through its own low level routines.
+ */
+void target_memcache_invalidate(void);
 int target_read_buffer(struct target *target,
 		target_addr_t address, uint32_t size, uint8_t *buffer);
 int target_checksum_memory(struct target *target,
@@ -739,6 +811,19 @@ int target_alloc_working_area_try(struct target *target,
  */
 int target_free_working_area(struct target *target, struct working_area *area);
 void target_free_all_working_areas(struct target *target);
+
+/**
+ * Declare which part of an allocated working area an algorithm may modify.
+ *
+ * Only has an effect with "-work-area-backup 2". By default the whole area is
+ * backed up before an algorithm runs, because OpenOCD can not know what the
+ * algorithm writes. After this call only the declared ranges and the ranges
+ * written by the host are backed up and restored. May be called several times
+ * to declare several ranges, a @a size of 0 declares that algorithms do not
+ * modify the area at all.
+ */
+int target_working_area_declare_output(struct target *target, struct working_area *area,
+		uint32_t offset, uint32_t size);
 uint32_t target_get_working_area_avail(struct target *target);
 
 /**
@@ -789,6 +874,11 @@ void target_handle_md_output(struct command_invocation *cmd,
 
 int target_profiling_default(struct target *target, uint32_t *samples, uint32_t
 		max_num_samples, uint32_t *num_samples, uint32_t seconds);
+void target_write_gmon(uint32_t *samples, uint32_t sample_num, const char *filename, bool with_range,
+		uint32_t start_address, uint32_t end_address, struct target *target, uint32_t duration_ms);
+void target_write_gmon_weighted(const uint32_t *samples, const uint32_t *weights, uint32_t sample_num,
+		const char *filename, bool with_range, uint32_t start_address, uint32_t end_address,
+		struct target *target, uint32_t duration_ms);
 
 #define ERROR_TARGET_INVALID	(-300)
 #define ERROR_TARGET_INIT_FAILED (-301)
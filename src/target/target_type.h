@@ -124,6 +124,16 @@ struct target_type {
 	int (*write_memory)(struct target *target, target_addr_t address,
 			uint32_t size, uint32_t count, const uint8_t *buffer);
 
+	/**
+	 * Optional scatter list memory access callbacks. Do @b not call these
+	 * functions directly, use target_read_memory_scatter() and
+	 * target_write_memory_scatter() instead.
+	 */
+	int (*read_memory_scatter)(struct target *target,
+			struct target_memory_scatter *list, unsigned int count);
+	int (*write_memory_scatter)(struct target *target,
+			const struct target_memory_scatter *list, unsigned int count);
+
 	/* Default implementation will do some fancy alignment to improve performance, target can override */
 	int (*read_buffer)(struct target *target, target_addr_t address,
 			uint32_t size, uint8_t *buffer);
@@ -19,6 +19,7 @@
 #include <target/algorithm.h>
 
 #include "xtensa.h"
+#include "xtensa_trax.h"
 /* Swap 4-bit Xtensa opcodes and fields */
 #define XT_NIBSWAP8(V)									\
 	((((V) & 0x0F) << 4)								\
@@ -1567,6 +1568,73 @@ int xtensa_halt(struct target *target)
 	return res;
 }
 
+/* Samples the PC of a running core for the profiler: the core is stopped with a debug
+ * interrupt, EPC[DEBUGLEVEL] is read through DDR with A3 swapped out and restored by
+ * XSR, then the core is resumed with RFDO. The register cache and target->state
+ * are left alone.
+ * Returns ERROR_WAIT when the core did not stop in time (no sample taken) and
+ * ERROR_TARGET_NOT_RUNNING when the core was already stopped for another reason. */
+int xtensa_sample_pc(struct target *target, uint32_t *pc)
+{
+	struct xtensa *xtensa = target_to_xtensa(target);
+	uint8_t dsr_buf[3][sizeof(uint32_t)];
+	uint8_t pc_buf[sizeof(uint32_t)];
+
+	if (xtensa->core_config->core_type != XT_LX)
+		return ERROR_NOT_IMPLEMENTED;
+
+	/* The DSR reads before and after the debug interrupt tell whether the core
+	 * was stopped by us. Instructions are only executed once this is known. */
+	xtensa_queue_dbg_reg_read(xtensa, XDMREG_DSR, dsr_buf[0]);
+	xtensa_queue_dbg_reg_write(xtensa, XDMREG_DCRSET, OCDDCR_ENABLEOCD | OCDDCR_DEBUGINTERRUPT);
+	xtensa_queue_dbg_reg_read(xtensa, XDMREG_DSR, dsr_buf[1]);
+	xtensa_queue_dbg_reg_read(xtensa, XDMREG_DSR, dsr_buf[2]);
+	xtensa_dm_queue_tdi_idle(&xtensa->dbg_mod);
+	int res = xtensa_dm_queue_execute(&xtensa->dbg_mod);
+	if (res != ERROR_OK)
+		return res;
+
+	if (buf_get_u32(dsr_buf[0], 0, 32) & OCDDSR_STOPPED) {
+		/* Stopped on its own (breakpoint, other core); do not leave a pending interrupt */
+		xtensa_queue_dbg_reg_write(xtensa, XDMREG_DCRCLR, OCDDCR_DEBUGINTERRUPT);
+		xtensa_dm_queue_tdi_idle(&xtensa->dbg_mod);
+		res = xtensa_dm_queue_execute(&xtensa->dbg_mod);
+		return res != ERROR_OK ? res : ERROR_TARGET_NOT_RUNNING;
+	}
+	if (!((buf_get_u32(dsr_buf[1], 0, 32) | buf_get_u32(dsr_buf[2], 0, 32)) & OCDDSR_STOPPED)) {
+		xtensa_queue_dbg_reg_write(xtensa, XDMREG_DCRCLR, OCDDCR_DEBUGINTERRUPT);
+		xtensa_queue_dbg_reg_read(xtensa, XDMREG_DSR, dsr_buf[0]);
+		xtensa_dm_queue_tdi_idle(&xtensa->dbg_mod);
+		res = xtensa_dm_queue_execute(&xtensa->dbg_mod);
+		if (res != ERROR_OK)
+			return res;
+		/* The interrupt may have been taken just before it was cleared */
+		if (!(buf_get_u32(dsr_buf[0], 0, 32) & OCDDSR_STOPPED))
+			return ERROR_WAIT;
+	}
+
+	xtensa_queue_exec_ins(xtensa, XT_INS_XSR(xtensa, XT_SR_DDR, XT_REG_A3));
+	xtensa_queue_exec_ins(xtensa, XT_INS_RSR(xtensa,
+			XT_EPC_REG_NUM_BASE + xtensa->core_config->debug.irq_level, XT_REG_A3));
+	xtensa_queue_exec_ins(xtensa, XT_INS_XSR(xtensa, XT_SR_DDR, XT_REG_A3));
+	xtensa_queue_dbg_reg_read(xtensa, XDMREG_DDR, pc_buf);
+	xtensa_queue_dbg_reg_read(xtensa, XDMREG_DSR, dsr_buf[0]);
+	xtensa_queue_exec_ins(xtensa, XT_INS_RFDO(xtensa));
+	xtensa_dm_queue_tdi_idle(&xtensa->dbg_mod);
+	res = xtensa_dm_queue_execute(&xtensa->dbg_mod);
+	if (res != ERROR_OK)
+		return res;
+
+	xtensa_dsr_t dsr = buf_get_u32(dsr_buf[0], 0, 32);
+	if (dsr & (OCDDSR_EXECEXCEPTION | OCDDSR_EXECOVERRUN)) {
+		LOG_TARGET_ERROR(target, "DSR (%08" PRIX32 ") indicates PC sampling failure", dsr);
+		xtensa_dm_core_status_clear(&xtensa->dbg_mod, OCDDSR_EXECEXCEPTION | OCDDSR_EXECOVERRUN);
+		return ERROR_FAIL;
+	}
+	*pc = buf_get_u32(pc_buf, 0, 32);
+	return ERROR_OK;
+}
+
 int xtensa_prepare_resume(struct target *target,
 	int current,
 	target_addr_t address,
@@ -1630,14 +1698,22 @@ int xtensa_prepare_resume(struct target *target,
 	return res;
 }
 
+/* Queues leaving debug mode, so several cores can be resumed by one queue execution */
+void xtensa_queue_resume(struct target *target)
+{
+	struct xtensa *xtensa = target_to_xtensa(target);
+
+	xtensa_cause_reset(target);
+	xtensa_queue_exec_ins(xtensa, XT_INS_RFDO(xtensa));
+}
+
 int xtensa_do_resume(struct target *target)
 {
 	struct xtensa *xtensa = target_to_xtensa(target);
 
 	LOG_TARGET_DEBUG(target, "start");
 
-	xtensa_cause_reset(target);
-	xtensa_queue_exec_ins(xtensa, XT_INS_RFDO(xtensa));
+	xtensa_queue_resume(target);
 	int res = xtensa_dm_queue_execute(&xtensa->dbg_mod);
 	if (res != ERROR_OK) {
 		LOG_TARGET_ERROR(target, "Failed to exec RFDO %d!", res);
@@ -3489,6 +3565,24 @@ static void xtensa_free_reg_cache(struct target *target)
 	xtensa->optregs = NULL;
 }
 
+static void xtensa_perfmon_sampler_free(struct xtensa_perfmon_sampler *sampler)
+{
+	for (unsigned int i = 0; i < sampler->num_cores; i++)
+		target_to_xtensa(sampler->cores[i].target)->perfmon_sampler = NULL;
+	if (sampler->out)
+		fclose(sampler->out);
+	free(sampler->cores);
+	free(sampler);
+}
+
+static int xtensa_perfmon_sampler_timer_callback(void *priv);
+
+static void xtensa_perfmon_sampler_stop(struct xtensa_perfmon_sampler *sampler)
+{
+	target_unregister_timer_callback(xtensa_perfmon_sampler_timer_callback, sampler);
+	xtensa_perfmon_sampler_free(sampler);
+}
+
 void xtensa_target_deinit(struct target *target)
 {
 	struct xtensa *xtensa = target_to_xtensa(target);
@@ -3509,6 +3603,8 @@ void xtensa_target_deinit(struct target *target)
 		}
 		xtensa_dm_deinit(&xtensa->dbg_mod);
 	}
+	if (xtensa->perfmon_sampler)
+		xtensa_perfmon_sampler_stop(xtensa->perfmon_sampler);
 	xtensa_free_reg_cache(target);
 	free(xtensa->hw_brps);
 	free(xtensa->hw_wps);
@@ -4132,7 +4228,10 @@ COMMAND_HELPER(xtensa_cmd_perfmon_enable_do, struct xtensa *xtensa)
 	if (config.tracelevel == -1)
 		config.tracelevel = xtensa->core_config->debug.irq_level;
 
-	return xtensa_dm_perfmon_enable(&xtensa->dbg_mod, counter_id, &config);
+	int res = xtensa_dm_perfmon_enable(&xtensa->dbg_mod, counter_id, &config);
+	if (res == ERROR_OK)
+		xtensa->perfmon_counters |= BIT(counter_id);
+	return res;
 }
 
 COMMAND_HANDLER(xtensa_cmd_perfmon_enable)
@@ -4181,6 +4280,216 @@ COMMAND_HANDLER(xtensa_cmd_perfmon_dump)
 		target_to_xtensa(get_current_target(CMD_CTX)));
 }
 
+#define XTENSA_PERFMON_SAMPLE_PERIOD_DEFAULT	10	/* ms */
+#define XTENSA_PERFMON_SAMPLE_MAGIC				"XPMS"
+#define XTENSA_PERFMON_SAMPLE_VERSION			1
+
+/* Reads all counters of the core and writes the deltas against the previous sample. 32-bit
+ * counter wraparound is handled by unsigned arithmetic. The PMSTAT overflow bit is cleared on
+ * every sample, so an overflow flag means the counter wrapped at least once since the previous
+ * sample and the delta may be short by a multiple of 2^32; how many times it wrapped is unknown.
+ * The first sample after (re)start only sets the baseline and produces no output. */
+static int xtensa_perfmon_sampler_core_sample(struct xtensa_perfmon_sampler *sampler,
+	struct xtensa_perfmon_sampler_core *core, uint32_t time_ms)
+{
+	struct xtensa *xtensa = target_to_xtensa(core->target);
+	struct xtensa_perfmon_result results[XTENSA_MAX_PERF_COUNTERS] = { 0 };
+	uint32_t deltas[XTENSA_MAX_PERF_COUNTERS] = { 0 };
+	uint32_t overflow_mask = 0;
+
+	int res = xtensa_dm_perfmon_sample(&xtensa->dbg_mod, core->counters_mask, results);
+	if (res != ERROR_OK)
+		return res;
+
+	for (unsigned int i = 0; i < XTENSA_MAX_PERF_COUNTERS; i++) {
+		if (!(core->counters_mask & BIT(i)))
+			continue;
+		deltas[i] = (uint32_t)results[i].value - core->prev[i];
+		core->prev[i] = (uint32_t)results[i].value;
+		if (results[i].overflow)
+			overflow_mask |= BIT(i);
+	}
+	if (!core->prev_valid) {
+		core->prev_valid = true;
+		return ERROR_OK;
+	}
+
+	if (sampler->binary) {
+		uint8_t rec[4 * (4 + XTENSA_MAX_PERF_COUNTERS)];
+		h_u32_to_le(&rec[0], time_ms);
+		h_u32_to_le(&rec[4], core->target->coreid);
+		h_u32_to_le(&rec[8], core->counters_mask);
+		h_u32_to_le(&rec[12], overflow_mask);
+		for (unsigned int i = 0; i < XTENSA_MAX_PERF_COUNTERS; i++)
+			h_u32_to_le(&rec[16 + 4 * i], deltas[i]);
+		if (fwrite(rec, sizeof(rec), 1, sampler->out) != 1)
+			return ERROR_FAIL;
+	} else {
+		fprintf(sampler->out, "%" PRIu32 ",%d", time_ms, core->target->coreid);
+		for (unsigned int i = 0; i < XTENSA_MAX_PERF_COUNTERS; i++) {
+			if (core->counters_mask & BIT(i))
+				fprintf(sampler->out, ",%" PRIu32 ",%d", deltas[i], (overflow_mask & BIT(i)) ? 1 : 0);
+			else
+				fprintf(sampler->out, ",,");
+		}
+		if (fprintf(sampler->out, "\n") < 0)
+			return ERROR_FAIL;
+	}
+	return ERROR_OK;
+}
+
+static int xtensa_perfmon_sampler_timer_callback(void *priv)
+{
+	struct xtensa_perfmon_sampler *sampler = priv;
+	uint32_t time_ms = (uint32_t)(timeval_ms() - sampler->start_ms);
+
+	for (unsigned int i = 0; i < sampler->num_cores; i++) {
+		struct xtensa_perfmon_sampler_core *core = &sampler->cores[i];
+		/* core can be powered off or be in reset, start over when it is back */
+		if (!target_was_examined(core->target) || target_to_xtensa(core->target)->reset_asserted) {
+			core->prev_valid = false;
+			continue;
+		}
+		int res = xtensa_perfmon_sampler_core_sample(sampler, core, time_ms);
+		if (res != ERROR_OK) {
+			LOG_TARGET_ERROR(core->target, "Failed to sample perfmon counters (%d), sampling stopped!", res);
+			xtensa_perfmon_sampler_stop(sampler);
+			return ERROR_OK;
+		}
+	}
+	/* keep the output usable by tools following the file while the target runs */
+	fflush(sampler->out);
+	return ERROR_OK;
+}
+
+static int xtensa_perfmon_sampler_write_header(struct xtensa_perfmon_sampler *sampler)
+{
+	if (sampler->binary) {
+		uint8_t hdr[12];
+		memcpy(hdr, XTENSA_PERFMON_SAMPLE_MAGIC, 4);
+		h_u32_to_le(&hdr[4], XTENSA_PERFMON_SAMPLE_VERSION);
+		h_u32_to_le(&hdr[8], XTENSA_MAX_PERF_COUNTERS);
+		return fwrite(hdr, sizeof(hdr), 1, sampler->out) == 1 ? ERROR_OK : ERROR_FAIL;
+	}
+	fprintf(sampler->out, "time_ms,core");
+	for (unsigned int i = 0; i < XTENSA_MAX_PERF_COUNTERS; i++)
+		fprintf(sampler->out, ",pm%u,ovf%u", i, i);
+	return fprintf(sampler->out, "\n") < 0 ? ERROR_FAIL : ERROR_OK;
+}
+
+/* perfmon_sample [start <outfile> [period_ms] ['csv'|'binary'] | stop] */
+COMMAND_HELPER(xtensa_cmd_perfmon_sample_do, struct target **targets, unsigned int num_targets)
+{
+	struct xtensa_perfmon_sampler *sampler = target_to_xtensa(targets[0])->perfmon_sampler;
+
+	if (CMD_ARGC == 0) {
+		if (!sampler)
+			command_print(CMD, "perfmon sampling is stopped");
+		else
+			command_print(CMD, "perfmon sampling is running, period %u ms, %u core(s)",
+				sampler->period_ms, sampler->num_cores);
+		return ERROR_OK;
+	}
+
+	if (!strcasecmp(CMD_ARGV[0], "stop")) {
+		if (CMD_ARGC != 1)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		if (sampler)
+			xtensa_perfmon_sampler_stop(sampler);
+		return ERROR_OK;
+	}
+
+	if (strcasecmp(CMD_ARGV[0], "start") || CMD_ARGC < 2 || CMD_ARGC > 4)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (sampler) {
+		command_print(CMD, "perfmon sampling is already running");
+		return ERROR_FAIL;
+	}
+
+	unsigned int period_ms = XTENSA_PERFMON_SAMPLE_PERIOD_DEFAULT;
+	if (CMD_ARGC >= 3) {
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[2], period_ms);
+		if (period_ms == 0) {
+			command_print(CMD, "period should be > 0");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+	bool binary = false;
+	if (CMD_ARGC >= 4) {
+		if (!strcasecmp(CMD_ARGV[3], "binary"))
+			binary = true;
+		else if (strcasecmp(CMD_ARGV[3], "csv"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	sampler = calloc(1, sizeof(*sampler));
+	if (sampler)
+		sampler->cores = calloc(num_targets, sizeof(*sampler->cores));
+	if (!sampler || !sampler->cores) {
+		free(sampler);
+		LOG_ERROR("Failed to alloc memory for perfmon sampler!");
+		return ERROR_FAIL;
+	}
+	sampler->binary = binary;
+	sampler->period_ms = period_ms;
+	for (unsigned int i = 0; i < num_targets; i++) {
+		struct xtensa *xtensa = target_to_xtensa(targets[i]);
+		if (!xtensa->perfmon_counters)
+			continue;
+		struct xtensa_perfmon_sampler_core *core = &sampler->cores[sampler->num_cores++];
+		core->target = targets[i];
+		core->counters_mask = xtensa->perfmon_counters;
+		xtensa->perfmon_sampler = sampler;
+	}
+	if (sampler->num_cores == 0) {
+		command_print(CMD, "No perfmon counters configured, use 'perfmon_enable' first");
+		xtensa_perfmon_sampler_free(sampler);
+		return ERROR_FAIL;
+	}
+
+	sampler->out = fopen(CMD_ARGV[1], binary ? "wb" : "w");
+	if (!sampler->out) {
+		command_print(CMD, "Failed to open '%s'!", CMD_ARGV[1]);
+		xtensa_perfmon_sampler_free(sampler);
+		return ERROR_FAIL;
+	}
+	int res = xtensa_perfmon_sampler_write_header(sampler);
+	if (res != ERROR_OK) {
+		command_print(CMD, "Failed to write to '%s'!", CMD_ARGV[1]);
+		xtensa_perfmon_sampler_free(sampler);
+		return res;
+	}
+
+	/* take the baseline now to report access problems to the user right away */
+	sampler->start_ms = timeval_ms();
+	for (unsigned int i = 0; i < sampler->num_cores; i++) {
+		struct xtensa_perfmon_sampler_core *core = &sampler->cores[i];
+		if (!target_was_examined(core->target))
+			continue;
+		res = xtensa_perfmon_sampler_core_sample(sampler, core, 0);
+		if (res != ERROR_OK) {
+			command_print(CMD, "Failed to read perfmon counters of %s!", target_name(core->target));
+			xtensa_perfmon_sampler_free(sampler);
+			return res;
+		}
+	}
+
+	res = target_register_timer_callback(xtensa_perfmon_sampler_timer_callback, period_ms,
+		TARGET_TIMER_TYPE_PERIODIC, sampler);
+	if (res != ERROR_OK) {
+		xtensa_perfmon_sampler_free(sampler);
+		return res;
+	}
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(xtensa_cmd_perfmon_sample)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	return CALL_COMMAND_HANDLER(xtensa_cmd_perfmon_sample_do, &target, 1);
+}
+
 COMMAND_HELPER(xtensa_cmd_mask_interrupts_do, struct xtensa *xtensa)
 {
 	int state = -1;
@@ -4394,7 +4703,8 @@ COMMAND_HANDLER(xtensa_cmd_tracestop)
 		target_to_xtensa(get_current_target(CMD_CTX)));
 }
 
-COMMAND_HELPER(xtensa_cmd_tracedump_do, struct xtensa *xtensa, const char *fname)
+/* Checks that tracing is stopped and returns the size of the recorded trace in bytes */
+static int xtensa_trace_data_size(struct command_invocation *cmd, struct xtensa *xtensa, uint32_t *size)
 {
 	struct xtensa_trace_config trace_config;
 	struct xtensa_trace_status trace_status;
@@ -4436,13 +4746,24 @@ COMMAND_HELPER(xtensa_cmd_tracedump_do, struct xtensa *xtensa, const char *fname
 			command_print(CMD, "Real trace is %d words, but the start has been truncated.", trc_sz);
 		}
 	}
+	*size = memsz * 4;
+	return ERROR_OK;
+}
 
-	uint8_t *tracemem = malloc(memsz * 4);
+COMMAND_HELPER(xtensa_cmd_tracedump_do, struct xtensa *xtensa, const char *fname)
+{
+	uint32_t size;
+
+	int res = xtensa_trace_data_size(CMD, xtensa, &size);
+	if (res != ERROR_OK)
+		return res;
+
+	uint8_t *tracemem = malloc(size);
 	if (!tracemem) {
 		command_print(CMD, "Failed to alloc memory for trace data!");
 		return ERROR_FAIL;
 	}
-	res = xtensa_dm_trace_data_read(&xtensa->dbg_mod, tracemem, memsz * 4);
+	res = xtensa_dm_trace_data_read(&xtensa->dbg_mod, tracemem, size);
 	if (res != ERROR_OK) {
 		free(tracemem);
 		return res;
@@ -4454,14 +4775,14 @@ COMMAND_HELPER(xtensa_cmd_tracedump_do, struct xtensa *xtensa, const char *fname
 		command_print(CMD, "Unable to open file %s", fname);
 		return ERROR_FAIL;
 	}
-	if (write(f, tracemem, memsz * 4) != (int)memsz * 4)
+	if (write(f, tracemem, size) != (int)size)
 		command_print(CMD, "Unable to write to file %s", fname);
 	else
-		command_print(CMD, "Written %d bytes of trace data to %s", memsz * 4, fname);
+		command_print(CMD, "Written %d bytes of trace data to %s", size, fname);
 	close(f);
 
 	bool is_all_zeroes = true;
-	for (unsigned int i = 0; i < memsz * 4; i++) {
+	for (unsigned int i = 0; i < size; i++) {
 		if (tracemem[i] != 0) {
 			is_all_zeroes = false;
 			break;
@@ -4487,6 +4808,247 @@ COMMAND_HANDLER(xtensa_cmd_tracedump)
 		target_to_xtensa(get_current_target(CMD_CTX)), CMD_ARGV[0]);
 }
 
+#define XTENSA_TRACE_CALLTRACE_MAGIC		"XTRC"
+#define XTENSA_TRACE_CALLTRACE_VERSION		1
+#define XTENSA_TRACE_CALLTRACE_REC_SIZE		12
+#define XTENSA_TRACE_CALLTRACE_ADDR_VALID	BIT(0)
+/* distinct run start addresses kept in the histogram */
+#define XTENSA_TRACE_GMON_MAX_ADDRS		(1024 * 1024)
+
+struct xtensa_trace_gmon_bucket {
+	uint32_t addr;
+	/* executed instructions, 0 for an empty bucket */
+	uint32_t count;
+};
+
+struct xtensa_trace_decode_ctx {
+	struct xtensa_trax_decoder dec;
+	/* call trace output */
+	FILE *out;
+	/* gmon output */
+	bool gmon;
+	/* open addressing hash table of address -> instructions, the size is a power of 2 */
+	struct xtensa_trace_gmon_bucket *hist;
+	uint32_t hist_size;
+	uint32_t hist_used;
+	/* instructions of the addresses not fitting the histogram */
+	uint64_t dropped;
+};
+
+static struct xtensa_trace_gmon_bucket *xtensa_trace_gmon_find(struct xtensa_trace_gmon_bucket *hist,
+	uint32_t size, uint32_t addr)
+{
+	/* Fibonacci hashing, instruction addresses are at least 2-byte aligned */
+	uint32_t idx = ((addr >> 1) * 2654435761u) & (size - 1);
+	while (hist[idx].count && hist[idx].addr != addr)
+		idx = (idx + 1) & (size - 1);
+	return &hist[idx];
+}
+
+/* Doubles the histogram size, keeps its load factor below 1/2 */
+static int xtensa_trace_gmon_grow(struct xtensa_trace_decode_ctx *ctx)
+{
+	uint32_t size = ctx->hist_size ? ctx->hist_size * 2 : 4096;
+	struct xtensa_trace_gmon_bucket *hist = calloc(size, sizeof(*hist));
+	if (!hist) {
+		LOG_ERROR("Failed to alloc memory for histogram!");
+		return ERROR_FAIL;
+	}
+	for (uint32_t i = 0; i < ctx->hist_size; i++) {
+		if (ctx->hist[i].count)
+			*xtensa_trace_gmon_find(hist, size, ctx->hist[i].addr) = ctx->hist[i];
+	}
+	free(ctx->hist);
+	ctx->hist = hist;
+	ctx->hist_size = size;
+	return ERROR_OK;
+}
+
+static int xtensa_trace_decode_gmon_msg(struct xtensa_trace_decode_ctx *ctx, const struct xtensa_trax_msg *msg)
+{
+	/* Executed instructions are accounted to the address their run has started at */
+	if (!msg->prev_addr_valid || msg->icnt == 0)
+		return ERROR_OK;
+
+	if (ctx->hist_used >= ctx->hist_size / 2) {
+		if (ctx->hist_used >= XTENSA_TRACE_GMON_MAX_ADDRS) {
+			struct xtensa_trace_gmon_bucket *b = xtensa_trace_gmon_find(ctx->hist, ctx->hist_size, msg->prev_addr);
+			if (b->count)
+				b->count = MIN((uint64_t)b->count + msg->icnt, UINT32_MAX);
+			else
+				ctx->dropped += msg->icnt;
+			return ERROR_OK;
+		}
+		int res = xtensa_trace_gmon_grow(ctx);
+		if (res != ERROR_OK)
+			return res;
+	}
+
+	struct xtensa_trace_gmon_bucket *b = xtensa_trace_gmon_find(ctx->hist, ctx->hist_size, msg->prev_addr);
+	if (!b->count) {
+		b->addr = msg->prev_addr;
+		ctx->hist_used++;
+	}
+	b->count = MIN((uint64_t)b->count + msg->icnt, UINT32_MAX);
+	return ERROR_OK;
+}
+
+/* Writes the histogram as gmon samples weighted by their instruction count */
+static int xtensa_trace_gmon_write(struct xtensa_trace_decode_ctx *ctx, struct target *target, const char *fname)
+{
+	uint32_t *addrs = malloc(ctx->hist_used * sizeof(*addrs));
+	uint32_t *counts = malloc(ctx->hist_used * sizeof(*counts));
+	if (!addrs || !counts) {
+		LOG_ERROR("Failed to alloc memory for samples!");
+		free(addrs);
+		free(counts);
+		return ERROR_FAIL;
+	}
+	uint32_t n = 0;
+	for (uint32_t i = 0; i < ctx->hist_size; i++) {
+		if (ctx->hist[i].count) {
+			addrs[n] = ctx->hist[i].addr;
+			counts[n++] = ctx->hist[i].count;
+		}
+	}
+	/* one sample per instruction, there is no time base in the trace */
+	target_write_gmon_weighted(addrs, counts, n, fname, false, 0, 0, target, 1000);
+	free(addrs);
+	free(counts);
+	return ERROR_OK;
+}
+
+static int xtensa_trace_decode_msg(void *priv, const struct xtensa_trax_msg *msg)
+{
+	struct xtensa_trace_decode_ctx *ctx = priv;
+
+	if (ctx->gmon)
+		return xtensa_trace_decode_gmon_msg(ctx, msg);
+
+	uint8_t rec[XTENSA_TRACE_CALLTRACE_REC_SIZE];
+	h_u32_to_le(&rec[0], msg->addr_valid ? msg->addr : 0);
+	h_u32_to_le(&rec[4], msg->icnt);
+	rec[8] = msg->tcode;
+	rec[9] = msg->aux;
+	rec[10] = msg->addr_valid ? XTENSA_TRACE_CALLTRACE_ADDR_VALID : 0;
+	rec[11] = 0;
+	if (fwrite(rec, sizeof(rec), 1, ctx->out) != 1) {
+		LOG_ERROR("Failed to write call trace record!");
+		return ERROR_FAIL;
+	}
+	return ERROR_OK;
+}
+
+static int xtensa_trace_decode_data(void *priv, const uint8_t *data, uint32_t size)
+{
+	struct xtensa_trace_decode_ctx *ctx = priv;
+	return xtensa_trax_decode(&ctx->dec, data, size);
+}
+
+static int xtensa_trace_decode_file(struct xtensa_trace_decode_ctx *ctx, const char *fname)
+{
+	uint8_t buf[XTENSA_TRACE_READ_CHUNK_SIZE];
+	FILE *f = fopen(fname, "rb");
+	if (!f) {
+		LOG_ERROR("Unable to open file %s", fname);
+		return ERROR_FAIL;
+	}
+	int res = ERROR_OK;
+	size_t len;
+	while (res == ERROR_OK && (len = fread(buf, 1, sizeof(buf), f)) > 0)
+		res = xtensa_trace_decode_data(ctx, buf, len);
+	if (res == ERROR_OK && ferror(f)) {
+		LOG_ERROR("Unable to read file %s", fname);
+		res = ERROR_FAIL;
+	}
+	fclose(f);
+	return res;
+}
+
+/* tracedecode (gmon|calltrace) <outfile> [rawfile] */
+COMMAND_HELPER(xtensa_cmd_tracedecode_do, struct xtensa *xtensa)
+{
+	struct xtensa_trace_decode_ctx ctx = { 0 };
+	struct duration bench;
+	int res;
+
+	if (CMD_ARGC < 2 || CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!strcasecmp(CMD_ARGV[0], "gmon")) {
+		ctx.gmon = true;
+	} else if (strcasecmp(CMD_ARGV[0], "calltrace")) {
+		command_print(CMD, "Unknown output format '%s'", CMD_ARGV[0]);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	if (!ctx.gmon) {
+		ctx.out = fopen(CMD_ARGV[1], "wb");
+		if (!ctx.out) {
+			command_print(CMD, "Unable to open file %s", CMD_ARGV[1]);
+			return ERROR_FAIL;
+		}
+		uint8_t hdr[8];
+		memcpy(hdr, XTENSA_TRACE_CALLTRACE_MAGIC, 4);
+		h_u32_to_le(&hdr[4], XTENSA_TRACE_CALLTRACE_VERSION);
+		if (fwrite(hdr, sizeof(hdr), 1, ctx.out) != 1) {
+			command_print(CMD, "Unable to write to file %s", CMD_ARGV[1]);
+			fclose(ctx.out);
+			return ERROR_FAIL;
+		}
+	}
+
+	xtensa_trax_decoder_init(&ctx.dec, xtensa_trace_decode_msg, &ctx);
+	duration_start(&bench);
+	if (CMD_ARGC == 3) {
+		res = xtensa_trace_decode_file(&ctx, CMD_ARGV[2]);
+	} else {
+		uint32_t size;
+		res = xtensa_trace_data_size(CMD, xtensa, &size);
+		if (res == ERROR_OK)
+			res = xtensa_dm_trace_data_read_stream(&xtensa->dbg_mod, size, XTENSA_TRACE_READ_CHUNK_SIZE,
+				xtensa_trace_decode_data, &ctx);
+	}
+	duration_measure(&bench);
+
+	if (ctx.out && fclose(ctx.out) != 0 && res == ERROR_OK) {
+		command_print(CMD, "Unable to write to file %s", CMD_ARGV[1]);
+		res = ERROR_FAIL;
+	}
+	if (res != ERROR_OK) {
+		free(ctx.hist);
+		return res;
+	}
+
+	command_print(CMD, "Decoded %" PRIu32 " messages (%" PRIu64 " instructions) in %.3f ms, "
+		"%" PRIu32 " unknown messages, %" PRIu32 " bytes skipped",
+		ctx.dec.stats.messages, ctx.dec.stats.instructions, duration_elapsed(&bench) * 1000,
+		ctx.dec.stats.unknown, ctx.dec.stats.dropped_bytes);
+
+	if (ctx.gmon) {
+		if (ctx.hist_used == 0) {
+			command_print(CMD, "No instructions with known address in the trace, nothing to write");
+			free(ctx.hist);
+			return ERROR_FAIL;
+		}
+		if (ctx.dropped)
+			command_print(CMD, "Histogram is limited to %d addresses, %" PRIu64 " instructions are not counted",
+				XTENSA_TRACE_GMON_MAX_ADDRS, ctx.dropped);
+		res = xtensa_trace_gmon_write(&ctx, xtensa->target, CMD_ARGV[1]);
+		free(ctx.hist);
+		if (res != ERROR_OK)
+			return res;
+	}
+	command_print(CMD, "Wrote %s", CMD_ARGV[1]);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(xtensa_cmd_tracedecode)
+{
+	return CALL_COMMAND_HANDLER(xtensa_cmd_tracedecode_do,
+		target_to_xtensa(get_current_target(CMD_CTX)));
+}
+
 static const struct command_registration xtensa_any_command_handlers[] = {
 	{
 		.name = "xtdef",
@@ -4586,6 +5148,14 @@ static const struct command_registration xtensa_any_command_handlers[] = {
 		.help = "Dump performance counter value. If no argument specified, dumps all counters.",
 		.usage = "[counter_id]",
 	},
+	{
+		.name = "perfmon_sample",
+		.handler = xtensa_cmd_perfmon_sample,
+		.mode = COMMAND_EXEC,
+		.help = "Periodically sample the enabled performance counters while the target runs "
+			"and write the deltas to a file. Without arguments shows the sampling state.",
+		.usage = "[start <outfile> [period_ms] ['csv'|'binary'] | stop]",
+	},
 	{
 		.name = "tracestart",
 		.handler = xtensa_cmd_tracestart,
@@ -4608,6 +5178,14 @@ static const struct command_registration xtensa_any_command_handlers[] = {
 		.help = "Tracing: Dump trace memory to a files. One file per core.",
 		.usage = "<outfile>",
 	},
+	{
+		.name = "tracedecode",
+		.handler = xtensa_cmd_tracedecode,
+		.mode = COMMAND_EXEC,
+		.help = "Tracing: Decode trace memory (or a file written by tracedump) "
+			"into gmon histogram or binary call trace",
+		.usage = "('gmon'|'calltrace') <outfile> [rawfile]",
+	},
 	{
 		.name = "exe",
 		.handler = xtensa_cmd_exe,
@@ -267,6 +267,9 @@ struct xtensa {
 	struct watchpoint **hw_wps;
 	struct xtensa_sw_breakpoint *sw_brps;
 	bool trace_active;
+	/* bitmask of the perfmon counters configured with 'perfmon_enable' */
+	uint32_t perfmon_counters;
+	struct xtensa_perfmon_sampler *perfmon_sampler;
 	bool permissive_mode;	/* bypass memory checks */
 	bool suppress_dsr_errors;
 	uint32_t smp_break;
@@ -287,6 +290,26 @@ struct xtensa {
 	bool regs_fetched;	/* true after first register fetch completed successfully */
 };
 
+struct xtensa_perfmon_sampler_core {
+	struct target *target;
+	/* counters enabled on the core at the time the sampler was started */
+	uint32_t counters_mask;
+	bool prev_valid;
+	uint32_t prev[XTENSA_MAX_PERF_COUNTERS];
+};
+
+/**
+ * Background perfmon sampler. Shared by all cores it samples, see 'xtensa perfmon_sample'.
+ */
+struct xtensa_perfmon_sampler {
+	FILE *out;
+	bool binary;
+	unsigned int period_ms;
+	int64_t start_ms;
+	unsigned int num_cores;
+	struct xtensa_perfmon_sampler_core *cores;
+};
+
 static inline struct xtensa *target_to_xtensa(struct target *target)
 {
 	assert(target);
@@ -376,6 +399,7 @@ void xtensa_cause_reset(struct target *target);
 int xtensa_poll(struct target *target);
 void xtensa_on_poll(struct target *target);
 int xtensa_halt(struct target *target);
+int xtensa_sample_pc(struct target *target, uint32_t *pc);
 int xtensa_resume(struct target *target,
 	int current,
 	target_addr_t address,
@@ -386,6 +410,7 @@ int xtensa_prepare_resume(struct target *target,
 	target_addr_t address,
 	int handle_breakpoints,
 	int debug_execution);
+void xtensa_queue_resume(struct target *target);
 int xtensa_do_resume(struct target *target);
 int xtensa_step(struct target *target, int current, target_addr_t address, int handle_breakpoints);
 int xtensa_do_step(struct target *target, int current, target_addr_t address, int handle_breakpoints);
@@ -438,9 +463,11 @@ COMMAND_HELPER(xtensa_cmd_mask_interrupts_do, struct xtensa *xtensa);
 COMMAND_HELPER(xtensa_cmd_smpbreak_do, struct target *target);
 COMMAND_HELPER(xtensa_cmd_perfmon_dump_do, struct xtensa *xtensa);
 COMMAND_HELPER(xtensa_cmd_perfmon_enable_do, struct xtensa *xtensa);
+COMMAND_HELPER(xtensa_cmd_perfmon_sample_do, struct target **targets, unsigned int num_targets);
 COMMAND_HELPER(xtensa_cmd_tracestart_do, struct xtensa *xtensa);
 COMMAND_HELPER(xtensa_cmd_tracestop_do, struct xtensa *xtensa);
 COMMAND_HELPER(xtensa_cmd_tracedump_do, struct xtensa *xtensa, const char *fname);
+COMMAND_HELPER(xtensa_cmd_tracedecode_do, struct xtensa *xtensa);
 
 extern const struct command_registration xtensa_command_handlers[];
 
@@ -274,13 +274,18 @@ int xtensa_dm_power_status_read(struct xtensa_debug_module *dm, uint32_t clear)
 	return res;
 }
 
-int xtensa_dm_core_status_read(struct xtensa_debug_module *dm)
+void xtensa_dm_queue_core_status_read(struct xtensa_debug_module *dm, uint8_t *dsr_buf)
 {
-	uint8_t dsr_buf[sizeof(uint32_t)];
-
 	xtensa_dm_queue_enable(dm);
 	dm->dbg_ops->queue_reg_read(dm, XDMREG_DSR, dsr_buf);
 	xtensa_dm_queue_tdi_idle(dm);
+}
+
+int xtensa_dm_core_status_read(struct xtensa_debug_module *dm)
+{
+	uint8_t dsr_buf[sizeof(uint32_t)];
+
+	xtensa_dm_queue_core_status_read(dm, dsr_buf);
 	int res = xtensa_dm_queue_execute(dm);
 	if (res != ERROR_OK)
 		return res;
@@ -422,15 +427,55 @@ int xtensa_dm_trace_config_read(struct xtensa_debug_module *dm, struct xtensa_tr
 	return res;
 }
 
+static int xtensa_dm_trace_data_copy(void *priv, const uint8_t *data, uint32_t size)
+{
+	uint8_t **dest = priv;
+
+	memcpy(*dest, data, size);
+	*dest += size;
+	return ERROR_OK;
+}
+
 int xtensa_dm_trace_data_read(struct xtensa_debug_module *dm, uint8_t *dest, uint32_t size)
 {
 	if (!dest)
 		return ERROR_FAIL;
 
-	for (unsigned int i = 0; i < size / 4; i++)
-		dm->dbg_ops->queue_reg_read(dm, XDMREG_TRAXDATA, &dest[i * 4]);
-	xtensa_dm_queue_tdi_idle(dm);
-	return xtensa_dm_queue_execute(dm);
+	return xtensa_dm_trace_data_read_stream(dm, size, XTENSA_TRACE_READ_CHUNK_SIZE,
+		xtensa_dm_trace_data_copy, &dest);
+}
+
+/* Reads trace RAM in chunks instead of queueing reads of the whole memory at once,
+ * so the queue stays small and every chunk can be processed as soon as it arrives. */
+int xtensa_dm_trace_data_read_stream(struct xtensa_debug_module *dm, uint32_t size, uint32_t chunk_size,
+	xtensa_dm_trace_data_cb_t cb, void *priv)
+{
+	chunk_size = ALIGN_DOWN(chunk_size, 4);
+	if (!cb || chunk_size == 0)
+		return ERROR_FAIL;
+
+	uint8_t *buf = malloc(chunk_size);
+	if (!buf) {
+		LOG_ERROR("Failed to alloc memory for trace data!");
+		return ERROR_FAIL;
+	}
+
+	int res = ERROR_OK;
+	for (uint32_t offset = 0; offset < size / 4 * 4; ) {
+		uint32_t len = MIN(size / 4 * 4 - offset, chunk_size);
+		for (unsigned int i = 0; i < len / 4; i++)
+			dm->dbg_ops->queue_reg_read(dm, XDMREG_TRAXDATA, &buf[i * 4]);
+		xtensa_dm_queue_tdi_idle(dm);
+		res = xtensa_dm_queue_execute(dm);
+		if (res != ERROR_OK)
+			break;
+		res = cb(priv, buf, len);
+		if (res != ERROR_OK)
+			break;
+		offset += len;
+	}
+	free(buf);
+	return res;
 }
 
 int xtensa_dm_perfmon_enable(struct xtensa_debug_module *dm, int counter_id,
@@ -479,3 +524,35 @@ int xtensa_dm_perfmon_dump(struct xtensa_debug_module *dm, int counter_id,
 
 	return res;
 }
+
+/* Reads the counters selected by 'counters_mask' together with their PMSTAT in a single queue
+ * execution, so that the values of all counters are taken at about the same time.
+ * The sticky PMSTAT overflow bit is cleared (write 1 to clear) right after it is read, so
+ * 'overflow' reports only wraps that happened since the previous sample.
+ * 'out_results' is indexed by counter id, entries of unselected counters are left untouched. */
+int xtensa_dm_perfmon_sample(struct xtensa_debug_module *dm, uint32_t counters_mask,
+	struct xtensa_perfmon_result *out_results)
+{
+	uint8_t pmstat_buf[XTENSA_MAX_PERF_COUNTERS][4];
+	uint8_t pmcount_buf[XTENSA_MAX_PERF_COUNTERS][4];
+
+	for (unsigned int i = 0; i < XTENSA_MAX_PERF_COUNTERS; i++) {
+		if (!(counters_mask & BIT(i)))
+			continue;
+		dm->dbg_ops->queue_reg_read(dm, XDMREG_PMSTAT0 + i, pmstat_buf[i]);
+		dm->dbg_ops->queue_reg_write(dm, XDMREG_PMSTAT0 + i, XDM_PMSTAT_OVFL);
+		dm->dbg_ops->queue_reg_read(dm, XDMREG_PM0 + i, pmcount_buf[i]);
+	}
+	xtensa_dm_queue_tdi_idle(dm);
+	int res = xtensa_dm_queue_execute(dm);
+	if (res != ERROR_OK)
+		return res;
+
+	for (unsigned int i = 0; i < XTENSA_MAX_PERF_COUNTERS; i++) {
+		if (!(counters_mask & BIT(i)))
+			continue;
+		out_results[i].overflow = (buf_get_u32(pmstat_buf[i], 0, 32) & XDM_PMSTAT_OVFL) != 0;
+		out_results[i].value = buf_get_u32(pmcount_buf[i], 0, 32);
+	}
+	return ERROR_OK;
+}
@@ -312,6 +312,8 @@ struct xtensa_dm_reg_offsets {
 #define OCDDSR_BREAKINITI           BIT(26)
 #define OCDDSR_DBGMODPOWERON        BIT(31)
 
+#define XDM_PMSTAT_OVFL             BIT(0)	/* Sticky, write 1 to clear */
+
 /* NX stop cause */
 #define OCDDSR_STOPCAUSE_DI         (0)		/* Debug Interrupt */
 #define OCDDSR_STOPCAUSE_SS         (1)		/* Single-step completed */
@@ -390,6 +392,8 @@ struct xtensa_dm_reg_offsets {
 #define XTENSA_MAX_PERF_MASK        0xffff
 
 #define XTENSA_STOPMASK_DISABLED    UINT32_MAX
+/* Trace RAM is read in chunks of this size (bytes) */
+#define XTENSA_TRACE_READ_CHUNK_SIZE	4096
 
 struct xtensa_debug_module;
 
@@ -446,6 +450,9 @@ struct xtensa_trace_status {
 	xtensa_traxstat_t stat;
 };
 
+/** Called for every chunk read by xtensa_dm_trace_data_read_stream() */
+typedef int (*xtensa_dm_trace_data_cb_t)(void *priv, const uint8_t *data, uint32_t size);
+
 struct xtensa_trace_start_config {
 	uint32_t stoppc;
 	bool after_is_words;
@@ -545,6 +552,7 @@ static inline xtensa_pwrstat_t xtensa_dm_power_status_get(struct xtensa_debug_mo
 	return dm->power_status.stat;
 }
 
+void xtensa_dm_queue_core_status_read(struct xtensa_debug_module *dm, uint8_t *dsr_buf);
 int xtensa_dm_core_status_read(struct xtensa_debug_module *dm);
 int xtensa_dm_core_status_clear(struct xtensa_debug_module *dm, xtensa_dsr_t bits);
 int xtensa_dm_core_status_check(struct xtensa_debug_module *dm);
@@ -567,6 +575,8 @@ int xtensa_dm_trace_stop(struct xtensa_debug_module *dm, bool pto_enable);
 int xtensa_dm_trace_config_read(struct xtensa_debug_module *dm, struct xtensa_trace_config *config);
 int xtensa_dm_trace_status_read(struct xtensa_debug_module *dm, struct xtensa_trace_status *status);
 int xtensa_dm_trace_data_read(struct xtensa_debug_module *dm, uint8_t *dest, uint32_t size);
+int xtensa_dm_trace_data_read_stream(struct xtensa_debug_module *dm, uint32_t size, uint32_t chunk_size,
+	xtensa_dm_trace_data_cb_t cb, void *priv);
 
 static inline bool xtensa_dm_is_online(struct xtensa_debug_module *dm)
 {
@@ -602,5 +612,7 @@ int xtensa_dm_perfmon_enable(struct xtensa_debug_module *dm, int counter_id,
 	const struct xtensa_perfmon_config *config);
 int xtensa_dm_perfmon_dump(struct xtensa_debug_module *dm, int counter_id,
 	struct xtensa_perfmon_result *out_result);
+int xtensa_dm_perfmon_sample(struct xtensa_debug_module *dm, uint32_t counters_mask,
+	struct xtensa_perfmon_result *out_results);
 
 #endif	/* OPENOCD_TARGET_XTENSA_DEBUG_MODULE_H */
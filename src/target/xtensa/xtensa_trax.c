@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/***************************************************************************
+ *   Xtensa TRAX trace message decoder for OpenOCD                         *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <helper/log.h>
+#include "xtensa_trax.h"
+
+void xtensa_trax_decoder_init(struct xtensa_trax_decoder *dec, xtensa_trax_msg_cb_t cb, void *priv)
+{
+	memset(dec, 0, sizeof(*dec));
+	dec->cb = cb;
+	dec->priv = priv;
+}
+
+static void xtensa_trax_msg_reset(struct xtensa_trax_decoder *dec)
+{
+	dec->num_fields = 0;
+	dec->msg_bytes = 0;
+	dec->field[0] = 0;
+	dec->field_bits[0] = 0;
+}
+
+/* Takes 'bits' bits from the start of the first field */
+static uint64_t xtensa_trax_take_bits(uint64_t *field, unsigned int *field_bits, unsigned int bits)
+{
+	uint64_t val = *field & ((1ULL << bits) - 1);
+	*field >>= bits;
+	*field_bits = *field_bits > bits ? *field_bits - bits : 0;
+	return val;
+}
+
+static int xtensa_trax_msg_process(struct xtensa_trax_decoder *dec)
+{
+	struct xtensa_trax_msg msg = { 0 };
+	uint64_t f0 = dec->field[0];
+	unsigned int f0_bits = dec->field_bits[0];
+	bool has_faddr = false, has_uaddr = false;
+
+	if (f0_bits < XTENSA_TRAX_MDO_BITS)
+		return ERROR_OK;
+
+	/* TCODE and fixed size fields share the first field with the first variable one */
+	msg.tcode = xtensa_trax_take_bits(&f0, &f0_bits, 6);
+	switch (msg.tcode) {
+	case XTENSA_TRAX_TCODE_DBRANCH:
+		break;
+	case XTENSA_TRAX_TCODE_IBRANCH:
+		msg.aux = xtensa_trax_take_bits(&f0, &f0_bits, 2);
+		has_uaddr = true;
+		break;
+	case XTENSA_TRAX_TCODE_SYNC:
+	case XTENSA_TRAX_TCODE_DBRANCH_SYNC:
+		msg.aux = xtensa_trax_take_bits(&f0, &f0_bits, 4);
+		has_faddr = true;
+		break;
+	case XTENSA_TRAX_TCODE_IBRANCH_SYNC:
+		msg.aux = xtensa_trax_take_bits(&f0, &f0_bits, 2);
+		has_faddr = true;
+		break;
+	case XTENSA_TRAX_TCODE_CORRELATION:
+		msg.aux = xtensa_trax_take_bits(&f0, &f0_bits, 4);
+		/* CDF */
+		xtensa_trax_take_bits(&f0, &f0_bits, 2);
+		break;
+	default:
+		dec->stats.unknown++;
+		return ERROR_OK;
+	}
+	msg.icnt = f0 > UINT32_MAX ? UINT32_MAX : (uint32_t)f0;
+
+	if (has_faddr || has_uaddr) {
+		if (dec->num_fields < 2) {
+			dec->stats.unknown++;
+			return ERROR_OK;
+		}
+		uint32_t addr = (uint32_t)dec->field[1];
+		if (has_faddr) {
+			dec->last_addr = addr;
+			dec->last_addr_valid = true;
+		} else {
+			/* U-ADDR holds the bits that differ from the previously sent address */
+			dec->last_addr ^= addr;
+		}
+		msg.addr = dec->last_addr;
+		msg.addr_valid = dec->last_addr_valid;
+	}
+
+	msg.prev_addr = dec->run_addr;
+	msg.prev_addr_valid = dec->run_addr_valid;
+	if (msg.addr_valid) {
+		dec->run_addr = msg.addr;
+		dec->run_addr_valid = true;
+	} else if (msg.tcode == XTENSA_TRAX_TCODE_DBRANCH) {
+		/* target of a direct branch is not traced */
+		dec->run_addr_valid = false;
+	}
+
+	dec->stats.messages++;
+	dec->stats.instructions += msg.icnt;
+	return dec->cb ? dec->cb(dec->priv, &msg) : ERROR_OK;
+}
+
+/* Decodes a chunk of the trace stream. Can be called repeatedly for consecutive chunks.
+ * Bytes up to the first end of message are skipped, because trace memory usually
+ * starts in the middle of a message after it has wrapped around. */
+int xtensa_trax_decode(struct xtensa_trax_decoder *dec, const uint8_t *data, size_t size)
+{
+	for (size_t i = 0; i < size; i++) {
+		uint8_t mseo = data[i] & XTENSA_TRAX_MSEO_MASK;
+		uint64_t mdo = data[i] >> XTENSA_TRAX_MDO_SHIFT;
+
+		if (!dec->synced) {
+			dec->stats.dropped_bytes++;
+			if (mseo == XTENSA_TRAX_MSEO_END_MSG) {
+				dec->synced = true;
+				xtensa_trax_msg_reset(dec);
+			}
+			continue;
+		}
+
+		if (++dec->msg_bytes > XTENSA_TRAX_MSG_BYTES_MAX) {
+			dec->stats.dropped_bytes += dec->msg_bytes;
+			dec->synced = false;
+			continue;
+		}
+
+		if (dec->num_fields < XTENSA_TRAX_MSG_FIELDS_MAX) {
+			unsigned int n = dec->num_fields;
+			/* bits above 64 can not be meaningful for 32-bit addresses and counters */
+			if (dec->field_bits[n] < 64)
+				dec->field[n] |= mdo << dec->field_bits[n];
+			dec->field_bits[n] += XTENSA_TRAX_MDO_BITS;
+			if (mseo == XTENSA_TRAX_MSEO_END_FIELD || mseo == XTENSA_TRAX_MSEO_END_MSG) {
+				dec->num_fields++;
+				if (dec->num_fields < XTENSA_TRAX_MSG_FIELDS_MAX) {
+					dec->field[dec->num_fields] = 0;
+					dec->field_bits[dec->num_fields] = 0;
+				}
+			}
+		}
+
+		if (mseo == XTENSA_TRAX_MSEO_END_MSG) {
+			int res = xtensa_trax_msg_process(dec);
+			xtensa_trax_msg_reset(dec);
+			if (res != ERROR_OK)
+				return res;
+		}
+	}
+	return ERROR_OK;
+}
@@ -0,0 +1,83 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/***************************************************************************
+ *   Xtensa TRAX trace message decoder for OpenOCD                         *
+ ***************************************************************************/
+
+#ifndef OPENOCD_TARGET_XTENSA_TRAX_H
+#define OPENOCD_TARGET_XTENSA_TRAX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* TRAX messages follow Nexus (IEEE-ISTO 5001) framing: every trace byte carries
+ * 6 bits of message data (MDO) and 2 bits of MSEO which mark the end of a
+ * variable length field or of the whole message. */
+#define XTENSA_TRAX_MSEO_MASK			0x3
+#define XTENSA_TRAX_MSEO_END_FIELD		0x1
+#define XTENSA_TRAX_MSEO_END_MSG		0x3
+#define XTENSA_TRAX_MDO_SHIFT			2
+#define XTENSA_TRAX_MDO_BITS			6
+
+/* Message codes emitted by TRAX */
+#define XTENSA_TRAX_TCODE_DBRANCH		4	/* direct branch: I-CNT */
+#define XTENSA_TRAX_TCODE_IBRANCH		5	/* indirect branch: B-TYPE, I-CNT, U-ADDR */
+#define XTENSA_TRAX_TCODE_ERROR			8	/* error: E-TYPE, ... */
+#define XTENSA_TRAX_TCODE_SYNC			9	/* program trace sync: SYNC, I-CNT, F-ADDR */
+#define XTENSA_TRAX_TCODE_DBRANCH_SYNC	11	/* direct branch with sync: SYNC, I-CNT, F-ADDR */
+#define XTENSA_TRAX_TCODE_IBRANCH_SYNC	12	/* indirect branch with sync: B-TYPE, I-CNT, F-ADDR */
+#define XTENSA_TRAX_TCODE_CORRELATION	33	/* program correlation: EVCODE, CDF, I-CNT */
+
+#define XTENSA_TRAX_MSG_FIELDS_MAX		4
+/* longer messages are garbage, e.g. unwritten trace memory */
+#define XTENSA_TRAX_MSG_BYTES_MAX		24
+
+struct xtensa_trax_msg {
+	/** Nexus message code */
+	uint8_t tcode;
+	/** B-TYPE of branch messages, EVCODE of correlation messages, SYNC of sync messages */
+	uint8_t aux;
+	/** Instructions executed since the previous message */
+	uint32_t icnt;
+	/** Address carried by the message (absolute) */
+	uint32_t addr;
+	/** Set when the message carries an address, which could be reconstructed */
+	bool addr_valid;
+	/** Absolute address of the previous message, i.e. start of the instructions counted by icnt */
+	uint32_t prev_addr;
+	bool prev_addr_valid;
+};
+
+/** Called for every decoded message. Non-ERROR_OK return value stops decoding. */
+typedef int (*xtensa_trax_msg_cb_t)(void *priv, const struct xtensa_trax_msg *msg);
+
+struct xtensa_trax_stats {
+	uint32_t messages;
+	uint32_t unknown;
+	uint32_t dropped_bytes;
+	uint64_t instructions;
+};
+
+struct xtensa_trax_decoder {
+	xtensa_trax_msg_cb_t cb;
+	void *priv;
+	/* message boundary has been seen, see xtensa_trax_decode() */
+	bool synced;
+	uint64_t field[XTENSA_TRAX_MSG_FIELDS_MAX];
+	unsigned int field_bits[XTENSA_TRAX_MSG_FIELDS_MAX];
+	unsigned int num_fields;
+	unsigned int msg_bytes;
+	/* last address sent by the trace unit, base for U-ADDR */
+	bool last_addr_valid;
+	uint32_t last_addr;
+	/* where the currently counted run of instructions has started */
+	bool run_addr_valid;
+	uint32_t run_addr;
+	struct xtensa_trax_stats stats;
+};
+
+void xtensa_trax_decoder_init(struct xtensa_trax_decoder *dec, xtensa_trax_msg_cb_t cb, void *priv);
+int xtensa_trax_decode(struct xtensa_trax_decoder *dec, const uint8_t *data, size_t size);
+
+#endif	/* OPENOCD_TARGET_XTENSA_TRAX_H */
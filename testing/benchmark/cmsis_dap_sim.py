@@ -0,0 +1,316 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+"""
+Software CMSIS-DAP adapter for the TCP backend of the cmsis-dap driver.
+
+Receives the command packets framed as described in
+src/jtag/drivers/cmsis_dap_tcp.c and answers them in order. DAP_Transfer and
+DAP_TransferBlock go to an SW-DP in front of the MEM-AP and RAM of
+jtag_dp_sim.py, DAP_JTAG_Sequence is clocked into its JTAG-DP, so bench.cfg
+works with both the swd and the jtag transport.
+Each response is held back --delay-ms after its command arrived, without
+delaying the commands behind it, to emulate the latency of an USB probe:
+the throughput then depends on how many commands the host keeps in flight,
+up to the --packet-count reported in DAP_Info.
+"""
+
+import argparse
+import collections
+import select
+import socket
+import struct
+import sys
+import time
+
+from jtag_dp_sim import JtagDp, MemAp, IDCODE, DP_DPIDR, DP_CTRL_STAT, DP_SELECT, DP_RDBUFF
+
+SIGNATURE = 0x00504144
+HDR = struct.Struct('<IHBB')
+TYPE_REQUEST = 1
+TYPE_RESPONSE = 2
+
+PACKET_SIZE = 1024
+SWD_DPIDR = 0x2BA01477
+CAPS = 0x03             # SWD and JTAG
+FW_VERSION = b'2.1.0\0'
+
+CMD_INFO = 0x00
+CMD_LED = 0x01
+CMD_CONNECT = 0x02
+CMD_DISCONNECT = 0x03
+CMD_TFER_CONFIGURE = 0x04
+CMD_TFER = 0x05
+CMD_TFER_BLOCK = 0x06
+CMD_TFER_ABORT = 0x07
+CMD_WRITE_ABORT = 0x08
+CMD_DELAY = 0x09
+CMD_RESET_TARGET = 0x0A
+CMD_SWJ_PINS = 0x10
+CMD_SWJ_CLOCK = 0x11
+CMD_SWJ_SEQ = 0x12
+CMD_SWD_CONFIGURE = 0x13
+CMD_JTAG_SEQ = 0x14
+CMD_JTAG_CONFIGURE = 0x15
+CMD_JTAG_IDCODE = 0x16
+CMD_SWD_SEQUENCE = 0x1D
+DAP_OK = 0x00
+DAP_ERROR = 0xFF
+
+ACK_OK = 0x01
+ACK_MISMATCH = 0x10
+
+TFER_APNDP = 0x01
+TFER_RNW = 0x02
+TFER_MATCH_VALUE = 0x10
+TFER_MATCH_MASK = 0x20
+
+
+class SwDp:
+    """SW-DP answering DAP_Transfer requests, AP reads are not posted as the probe hides it"""
+
+    def __init__(self, mem):
+        self.ap = MemAp(mem)
+        self.ctrl_stat = 0
+        self.select = 0
+        self.rdbuff = 0
+        self.match_mask = 0xFFFFFFFF
+
+    def read(self, apndp, addr):
+        if apndp:
+            reg = (self.select & 0xF0) | addr
+            self.rdbuff = self.ap.read(reg) if self.select >> 24 == 0 else 0
+            return self.rdbuff
+        if addr == DP_DPIDR:
+            return SWD_DPIDR
+        if addr == DP_CTRL_STAT:
+            # power-up requests are acknowledged immediately
+            return self.ctrl_stat | (self.ctrl_stat & ((1 << 30) | (1 << 28))) << 1
+        if addr == DP_RDBUFF:
+            return self.rdbuff
+        return 0
+
+    def write(self, apndp, addr, value):
+        if apndp:
+            if self.select >> 24 == 0:
+                self.ap.write((self.select & 0xF0) | addr, value)
+        elif addr == DP_CTRL_STAT:
+            self.ctrl_stat = value & 0x50000F00
+        elif addr == DP_SELECT:
+            self.select = value
+        # writes to ABORT are accepted and ignored
+
+
+class Probe:
+    def __init__(self, packet_count):
+        self.packet_count = packet_count
+        self.jtag = JtagDp()
+        self.swd = SwDp(self.jtag.mem)
+        self.pins = 0
+
+    def info(self, req):
+        ident = req[1]
+        if ident == 0x04:
+            return bytes([CMD_INFO, len(FW_VERSION)]) + FW_VERSION
+        if ident == 0xF0:
+            return bytes([CMD_INFO, 1, CAPS])
+        if ident == 0xFD:
+            return bytes([CMD_INFO, 4]) + struct.pack('<I', 0)
+        if ident == 0xFE:
+            return bytes([CMD_INFO, 1, self.packet_count])
+        if ident == 0xFF:
+            return bytes([CMD_INFO, 2]) + struct.pack('<H', PACKET_SIZE)
+        return bytes([CMD_INFO, 0])
+
+    def transfer(self, req):
+        count = req[2]
+        pos = 3
+        data = bytearray()
+        done = 0
+        ack = ACK_OK
+        for _ in range(count):
+            request = req[pos]
+            pos += 1
+            apndp = request & TFER_APNDP
+            addr = request & 0x0C
+            if request & TFER_RNW:
+                value = self.swd.read(apndp, addr)
+                if request & TFER_MATCH_VALUE:
+                    match = struct.unpack_from('<I', req, pos)[0]
+                    pos += 4
+                    if (value & self.swd.match_mask) != match:
+                        ack |= ACK_MISMATCH
+                        break
+                else:
+                    data += struct.pack('<I', value)
+            else:
+                value = struct.unpack_from('<I', req, pos)[0]
+                pos += 4
+                if request & TFER_MATCH_MASK:
+                    self.swd.match_mask = value
+                else:
+                    self.swd.write(apndp, addr, value)
+            done += 1
+        return bytes([CMD_TFER, done, ack]) + data
+
+    def transfer_block(self, req):
+        count, request = struct.unpack_from('<HB', req, 2)
+        apndp = request & TFER_APNDP
+        addr = request & 0x0C
+        data = bytearray()
+        if request & TFER_RNW:
+            for _ in range(count):
+                data += struct.pack('<I', self.swd.read(apndp, addr))
+        else:
+            for value in struct.unpack_from('<%dI' % count, req, 5):
+                self.swd.write(apndp, addr, value)
+        return struct.pack('<BHB', CMD_TFER_BLOCK, count, ACK_OK) + data
+
+    def jtag_sequence(self, req):
+        count = req[1]
+        pos = 2
+        out = bytearray([CMD_JTAG_SEQ, DAP_OK])
+        for _ in range(count):
+            info = req[pos]
+            bits = info & 0x3F or 64
+            tms = 1 if info & 0x40 else 0
+            nbytes = (bits + 7) // 8
+            tdi = int.from_bytes(req[pos + 1:pos + 1 + nbytes], 'little')
+            pos += 1 + nbytes
+            tdo = 0
+            for i in range(bits):
+                tdo |= self.jtag.tdo << i
+                self.jtag.clock(tms, (tdi >> i) & 1)
+            if info & 0x80:
+                out += tdo.to_bytes(nbytes, 'little')
+        return bytes(out)
+
+    def swd_sequence(self, req):
+        count = req[1]
+        pos = 2
+        out = bytearray([CMD_SWD_SEQUENCE, DAP_OK])
+        for _ in range(count):
+            info = req[pos]
+            nbytes = ((info & 0x3F or 64) + 7) // 8
+            pos += 1
+            if info & 0x80:
+                out += bytes(nbytes)
+            else:
+                pos += nbytes
+        return bytes(out)
+
+    def process(self, req):
+        cmd = req[0]
+        if cmd == CMD_INFO:
+            return self.info(req)
+        if cmd == CMD_TFER:
+            return self.transfer(req)
+        if cmd == CMD_TFER_BLOCK:
+            return self.transfer_block(req)
+        if cmd == CMD_JTAG_SEQ:
+            return self.jtag_sequence(req)
+        if cmd == CMD_SWD_SEQUENCE:
+            return self.swd_sequence(req)
+        if cmd == CMD_CONNECT:
+            port = req[1] or 1
+            if port == 2:
+                self.jtag.reset()
+            return bytes([CMD_CONNECT, port])
+        if cmd == CMD_SWJ_PINS:
+            mask = req[2]
+            self.pins = (self.pins & ~mask) | (req[1] & mask)
+            return bytes([CMD_SWJ_PINS, self.pins])
+        if cmd == CMD_JTAG_IDCODE:
+            return bytes([CMD_JTAG_IDCODE, DAP_OK]) + struct.pack('<I', IDCODE)
+        if cmd == CMD_RESET_TARGET:
+            return bytes([CMD_RESET_TARGET, DAP_OK, 0])
+        if cmd == CMD_TFER_ABORT:
+            return None
+        if cmd in (CMD_LED, CMD_DISCONNECT, CMD_TFER_CONFIGURE, CMD_WRITE_ABORT, CMD_DELAY,
+                   CMD_SWJ_CLOCK, CMD_SWJ_SEQ, CMD_SWD_CONFIGURE, CMD_JTAG_CONFIGURE):
+            return bytes([cmd, DAP_OK])
+        # SWO and vendor commands are not implemented
+        return bytes([DAP_ERROR])
+
+
+class Connection:
+    def __init__(self, conn, probe, delay):
+        self.conn = conn
+        self.probe = probe
+        self.delay = delay
+        self.buf = b''
+        # responses with the time they may be sent
+        self.queue = collections.deque()
+        self.commands = 0
+
+    def _parse(self):
+        while len(self.buf) >= HDR.size:
+            signature, length, ptype, _ = HDR.unpack_from(self.buf)
+            if signature != SIGNATURE or ptype != TYPE_REQUEST:
+                raise ValueError('invalid packet header')
+            if len(self.buf) < HDR.size + length:
+                break
+            req = self.buf[HDR.size:HDR.size + length]
+            self.buf = self.buf[HDR.size + length:]
+            self.commands += 1
+            resp = self.probe.process(req)
+            if resp is not None:
+                self.queue.append((time.monotonic() + self.delay,
+                                   HDR.pack(SIGNATURE, len(resp), TYPE_RESPONSE, 0) + resp))
+
+    def run(self):
+        while True:
+            timeout = None
+            if self.queue:
+                timeout = max(0.0, self.queue[0][0] - time.monotonic())
+            readable, _, _ = select.select([self.conn], [], [], timeout)
+            if readable:
+                data = self.conn.recv(65536)
+                if not data:
+                    return
+                self.buf += data
+                self._parse()
+            out = bytearray()
+            now = time.monotonic()
+            while self.queue and self.queue[0][0] <= now:
+                out += self.queue.popleft()[1]
+            if out:
+                self.conn.sendall(out)
+
+
+def serve(port, once, packet_count, delay):
+    srv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    srv.bind(('127.0.0.1', port))
+    srv.listen(1)
+    print('cmsis_dap_sim: listening on port %d' % srv.getsockname()[1], flush=True)
+    while True:
+        conn, _ = srv.accept()
+        conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        c = Connection(conn, Probe(packet_count), delay)
+        try:
+            c.run()
+        except (ConnectionError, ValueError) as e:
+            print('cmsis_dap_sim: %s' % e, file=sys.stderr)
+        conn.close()
+        print('cmsis_dap_sim: %d commands' % c.commands, file=sys.stderr)
+        if once:
+            break
+    srv.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--port', type=int, default=9901, help='TCP port to listen on')
+    parser.add_argument('--once', action='store_true', help='exit after the first connection is closed')
+    parser.add_argument('--packet-count', type=int, default=32, choices=range(1, 256), metavar='1..255',
+                        help='packet count reported in DAP_Info')
+    parser.add_argument('--delay-ms', type=float, default=0.0,
+                        help='latency of every response, emulates the round trip of an USB probe')
+    args = parser.parse_args()
+    serve(args.port, args.once, args.packet_count, args.delay_ms / 1000.0)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
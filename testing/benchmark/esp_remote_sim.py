@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+"""
+Loopback server for the jtag_esp_remote adapter driver.
+
+Speaks protocol v1 (one command per message) and v2 (batches of commands with
+one bulk TDO response), see src/jtag/drivers/jtag_esp_remote.c. The commands are
+clocked into the simulated JTAG-DP of jtag_dp_sim.py, so bench.cfg works with it
+as well. It is meant for comparing the protocol versions on the host, with
+--delay-ms emulating the round trip of a remote bridge.
+"""
+
+import argparse
+import socket
+import struct
+import sys
+import time
+
+from jtag_dp_sim import JtagDp
+
+VER_1 = 1
+VER_2 = 2
+
+CMD_RESET = 1
+CMD_SCAN = 2
+CMD_TMS_SEQ = 3
+CMD_SET_CLK = 4
+CMD_BATCH = 5
+
+V2_FLAG_READ = 0x01
+V2_FLAG_FLIP_TMS = 0x02
+V2_FLAG_TRST = 0x08
+
+
+class Connection:
+    def __init__(self, conn, delay):
+        self.conn = conn
+        self.delay = delay
+        self.buf = b''
+        self.dp = JtagDp()
+        self.last_tms = 0
+
+    def receive(self, length):
+        while len(self.buf) < length:
+            chunk = self.conn.recv(max(65536, length - len(self.buf)))
+            if not chunk:
+                raise EOFError
+            self.buf += chunk
+        data, self.buf = self.buf[:length], self.buf[length:]
+        return data
+
+    def send(self, data):
+        if self.delay:
+            time.sleep(self.delay)
+        self.conn.sendall(data)
+
+    def clock(self, n_bits, tms_bits, tdi_bits, flip_tms):
+        """Clocks n_bits, returns TDO packed LSB first. TMS of None keeps the last value."""
+        dp = self.dp
+        tdo = bytearray((n_bits + 7) // 8)
+        for i in range(n_bits):
+            if tms_bits is None:
+                tms = self.last_tms ^ (1 if flip_tms and i == n_bits - 1 else 0)
+            else:
+                tms = (tms_bits[i // 8] >> (i % 8)) & 1
+            tdi = (tdi_bits[i // 8] >> (i % 8)) & 1 if tdi_bits is not None else 1
+            if dp.tdo:
+                tdo[i // 8] |= 1 << (i % 8)
+            dp.clock(tms, tdi)
+            self.last_tms = tms
+        return bytes(tdo)
+
+    def execute(self, func, flags, n_bits, data):
+        """Executes one command, returns its TDO data or None"""
+        if func == CMD_SCAN:
+            tdo = self.clock(n_bits, None, data, flags & V2_FLAG_FLIP_TMS)
+            return tdo if flags & V2_FLAG_READ else None
+        if func == CMD_TMS_SEQ:
+            self.clock(n_bits, data, None, False)
+        elif func == CMD_RESET:
+            if flags & V2_FLAG_TRST:
+                self.dp.reset()
+        return None
+
+    def handle_v1(self, func, param):
+        if func == CMD_SCAN:
+            n_bits = param & 0xfff
+            flags = (V2_FLAG_READ if param & (1 << 12) else 0) | \
+                (V2_FLAG_FLIP_TMS if param & (1 << 13) else 0)
+        elif func == CMD_TMS_SEQ:
+            n_bits = param & 0xfff
+            flags = 0
+        elif func == CMD_SET_CLK:
+            n_bits = 32
+            flags = 0
+        else:
+            # v1 reset: srst:1, trst:1
+            n_bits = 0
+            flags = V2_FLAG_TRST if param & 2 else 0
+        data = self.receive((n_bits + 7) // 8)
+        tdo = self.execute(func, flags, n_bits, data)
+        if tdo:
+            self.send(tdo)
+
+    def handle_v2(self):
+        (length,) = struct.unpack('<I', self.receive(4))
+        payload = self.receive(length)
+        out = bytearray()
+        pos = 0
+        while pos < length:
+            func, flags, _, n_bits = struct.unpack_from('<BBHI', payload, pos)
+            pos += 8
+            n_bytes = (n_bits + 7) // 8
+            tdo = self.execute(func, flags, n_bits, payload[pos:pos + n_bytes])
+            pos += n_bytes
+            if tdo:
+                out += tdo
+        if out:
+            self.send(bytes(out))
+
+    def run(self):
+        try:
+            while True:
+                rsv_ver, func, param = struct.unpack('<BBH', self.receive(4))
+                ver = rsv_ver >> 4
+                if ver == VER_2 and func == CMD_BATCH:
+                    self.handle_v2()
+                elif ver == VER_1:
+                    self.handle_v1(func, param)
+                else:
+                    print('esp_remote_sim: unsupported command ver %d func %d' % (ver, func),
+                          file=sys.stderr)
+                    return
+        except EOFError:
+            pass
+
+
+def serve(port, once, delay):
+    srv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    srv.bind(('127.0.0.1', port))
+    srv.listen(1)
+    print('esp_remote_sim: listening on port %d' % srv.getsockname()[1], flush=True)
+    while True:
+        conn, _ = srv.accept()
+        conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        Connection(conn, delay).run()
+        conn.close()
+        if once:
+            break
+    srv.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--port', type=int, default=5555, help='TCP port to listen on')
+    parser.add_argument('--once', action='store_true', help='exit after the first connection is closed')
+    parser.add_argument('--delay-ms', type=float, default=0.0,
+                        help='delay added before every response, emulates a remote link')
+    args = parser.parse_args()
+    serve(args.port, args.once, args.delay_ms / 1000.0)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
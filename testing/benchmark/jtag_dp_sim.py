@@ -0,0 +1,318 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+"""
+Simulated ARM JTAG-DP with a single AHB MEM-AP in front of a sparse RAM.
+
+Speaks the remote_bitbang protocol (see src/jtag/drivers/remote_bitbang.c),
+so OpenOCD can talk to it with 'adapter driver remote_bitbang' and a
+'mem_ap' target. The vector extension of the protocol is supported too.
+It is meant as a local responder for host-side benchmarks,
+not as a faithful model of any real chip: transfers never fail or WAIT,
+packed transfers are not supported and only AP #0 exists.
+"""
+
+import argparse
+import socket
+import sys
+
+# TAP controller states
+(TLR, RTI, SELDR, CAPDR, SHDR, EX1DR, PADR, EX2DR, UPDR,
+ SELIR, CAPIR, SHIR, EX1IR, PAIR, EX2IR, UPIR) = range(16)
+
+# next state for TMS = 0 / TMS = 1
+NEXT_STATE = {
+    TLR: (RTI, TLR), RTI: (RTI, SELDR),
+    SELDR: (CAPDR, SELIR), CAPDR: (SHDR, EX1DR), SHDR: (SHDR, EX1DR),
+    EX1DR: (PADR, UPDR), PADR: (PADR, EX2DR), EX2DR: (SHDR, UPDR), UPDR: (RTI, SELDR),
+    SELIR: (CAPIR, TLR), CAPIR: (SHIR, EX1IR), SHIR: (SHIR, EX1IR),
+    EX1IR: (PAIR, UPIR), PAIR: (PAIR, EX2IR), EX2IR: (SHIR, UPIR), UPIR: (RTI, SELDR),
+}
+
+IR_LEN = 4
+IR_ABORT = 0x8
+IR_DPACC = 0xA
+IR_APACC = 0xB
+IR_IDCODE = 0xE
+
+IDCODE = 0x4BA00477
+DPIDR = 0x4BA00477
+AP_IDR = 0x24770011     # AHB-AP
+ACK_OK_FAULT = 0x2
+
+DP_DPIDR = 0x0
+DP_CTRL_STAT = 0x4
+DP_SELECT = 0x8
+DP_RDBUFF = 0xC
+
+AP_CSW = 0x00
+AP_TAR = 0x04
+AP_DRW = 0x0C
+AP_BD0 = 0x10
+AP_CFG = 0xF4
+AP_BASE = 0xF8
+AP_IDR_REG = 0xFC
+
+CSW_SIZE_MASK = 0x7
+CSW_ADDRINC_SHIFT = 4
+CSW_ADDRINC_MASK = 0x3 << CSW_ADDRINC_SHIFT
+CSW_DEVICE_EN = 1 << 6
+
+PAGE_SIZE = 4096
+
+
+class SparseMemory:
+    def __init__(self):
+        self.pages = {}
+
+    def read(self, addr, size):
+        out = bytearray()
+        while size:
+            page = self.pages.get(addr // PAGE_SIZE)
+            off = addr % PAGE_SIZE
+            n = min(size, PAGE_SIZE - off)
+            out += page[off:off + n] if page else bytes(n)
+            addr += n
+            size -= n
+        return bytes(out)
+
+    def write(self, addr, data):
+        pos = 0
+        while pos < len(data):
+            page = self.pages.setdefault(addr // PAGE_SIZE, bytearray(PAGE_SIZE))
+            off = addr % PAGE_SIZE
+            n = min(len(data) - pos, PAGE_SIZE - off)
+            page[off:off + n] = data[pos:pos + n]
+            addr += n
+            pos += n
+
+
+class MemAp:
+    def __init__(self, mem):
+        self.mem = mem
+        self.csw = 0x2      # 32-bit, no increment
+        self.tar = 0
+
+    def _size(self):
+        return 1 << min(self.csw & CSW_SIZE_MASK, 2)
+
+    def _increment(self):
+        if self.csw & CSW_ADDRINC_MASK:
+            self.tar = (self.tar + self._size()) & 0xFFFFFFFF
+
+    def _read_lane(self, addr):
+        size = self._size()
+        lane = addr & 3 & ~(size - 1)
+        data = self.mem.read(addr & ~(size - 1), size)
+        return int.from_bytes(data, 'little') << (8 * lane)
+
+    def _write_lane(self, addr, value):
+        size = self._size()
+        lane = addr & 3 & ~(size - 1)
+        data = ((value >> (8 * lane)) & ((1 << (8 * size)) - 1)).to_bytes(size, 'little')
+        self.mem.write(addr & ~(size - 1), data)
+
+    def read(self, reg):
+        if reg == AP_CSW:
+            return self.csw | CSW_DEVICE_EN
+        if reg == AP_TAR:
+            return self.tar
+        if reg == AP_DRW:
+            value = self._read_lane(self.tar)
+            self._increment()
+            return value
+        if AP_BD0 <= reg < AP_BD0 + 0x10:
+            return int.from_bytes(self.mem.read((self.tar & ~0xF) | (reg & 0xC), 4), 'little')
+        if reg == AP_IDR_REG:
+            return AP_IDR
+        return 0
+
+    def write(self, reg, value):
+        if reg == AP_CSW:
+            # packed transfers are not supported, report single increment instead
+            if (value & CSW_ADDRINC_MASK) == (2 << CSW_ADDRINC_SHIFT):
+                value = (value & ~CSW_ADDRINC_MASK) | (1 << CSW_ADDRINC_SHIFT)
+            self.csw = value & ~CSW_DEVICE_EN
+        elif reg == AP_TAR:
+            self.tar = value
+        elif reg == AP_DRW:
+            self._write_lane(self.tar, value)
+            self._increment()
+        elif AP_BD0 <= reg < AP_BD0 + 0x10:
+            self.mem.write((self.tar & ~0xF) | (reg & 0xC), value.to_bytes(4, 'little'))
+
+
+class JtagDp:
+    def __init__(self, vector=True):
+        self.vector_ext = vector
+        self.pending = b''
+        self.mem = SparseMemory()
+        self.ap = MemAp(self.mem)
+        self.state = TLR
+        self.ir = IR_IDCODE
+        self.shift = 0
+        self.shift_len = 0
+        self.tdo = 0
+        self.tck = 0
+        self.ctrl_stat = 0
+        self.select = 0
+        self.rdbuff = 0
+        self.result = 0
+
+    def _dr_capture(self):
+        if self.ir == IR_IDCODE:
+            return IDCODE, 32
+        if self.ir in (IR_DPACC, IR_APACC, IR_ABORT):
+            return (self.result << 3) | ACK_OK_FAULT, 35
+        return 0, 1     # BYPASS
+
+    def _dp_access(self, rnw, addr, value):
+        if self.ir == IR_APACC:
+            apsel = self.select >> 24
+            reg = (self.select & 0xF0) | addr
+            if rnw:
+                self.rdbuff = self.ap.read(reg) if apsel == 0 else 0
+                self.result = self.rdbuff
+            elif apsel == 0:
+                self.ap.write(reg, value)
+            return
+        if rnw:
+            if addr == DP_DPIDR:
+                self.result = DPIDR
+            elif addr == DP_CTRL_STAT:
+                # power-up requests are acknowledged immediately
+                acks = (self.ctrl_stat & ((1 << 30) | (1 << 28))) << 1
+                self.result = self.ctrl_stat | acks
+            elif addr == DP_SELECT:
+                self.result = self.select
+            else:
+                self.result = self.rdbuff
+        elif addr == DP_CTRL_STAT:
+            self.ctrl_stat = value & 0x50000F00
+        elif addr == DP_SELECT:
+            self.select = value
+
+    def _dr_update(self):
+        if self.ir in (IR_DPACC, IR_APACC):
+            value = self.shift
+            self._dp_access(value & 1, (value >> 1 & 3) << 2, (value >> 3) & 0xFFFFFFFF)
+
+    def clock(self, tms, tdi):
+        state = self.state
+        if state == SHDR or state == SHIR:
+            self.shift = (self.shift >> 1) | (tdi << (self.shift_len - 1))
+            self.tdo = self.shift & 1
+        elif state == CAPDR:
+            self.shift, self.shift_len = self._dr_capture()
+            self.tdo = self.shift & 1
+        elif state == CAPIR:
+            self.shift, self.shift_len = 0x1, IR_LEN
+            self.tdo = 1
+        elif state == UPDR:
+            self._dr_update()
+        elif state == UPIR:
+            self.ir = self.shift & ((1 << IR_LEN) - 1)
+        elif state == TLR:
+            self.ir = IR_IDCODE
+        self.state = NEXT_STATE[state][tms]
+
+    def reset(self):
+        self.state = TLR
+        self.ir = IR_IDCODE
+
+    def run_vector(self, data, pos, out):
+        """Executes a 'V' request at data[pos], returns the position after it or None if incomplete"""
+        if len(data) < pos + 5:
+            return None
+        cycles = int.from_bytes(data[pos + 1:pos + 5], 'little')
+        nbytes = (cycles + 7) // 8
+        end = pos + 5 + 3 * nbytes
+        if len(data) < end:
+            return None
+        tms = data[pos + 5:pos + 5 + nbytes]
+        tdi = data[pos + 5 + nbytes:pos + 5 + 2 * nbytes]
+        capture = data[pos + 5 + 2 * nbytes:end]
+        tdo = 0
+        captured = 0
+        for i in range(cycles):
+            byte, bit = i // 8, 1 << (i % 8)
+            if capture[byte] & bit:
+                tdo |= self.tdo << captured
+                captured += 1
+            self.clock(1 if tms[byte] & bit else 0, 1 if tdi[byte] & bit else 0)
+        self.tck = 1
+        if captured:
+            out += tdo.to_bytes((captured + 7) // 8, 'little')
+        return end
+
+    def process(self, data):
+        """Handles a chunk of remote_bitbang commands, returns the bytes to send back."""
+        out = bytearray()
+        data = self.pending + data
+        self.pending = b''
+        pos = 0
+        while pos < len(data):
+            c = data[pos]
+            if c == 0x56 and self.vector_ext:       # 'V': vector of cycles
+                end = self.run_vector(data, pos, out)
+                if end is None:
+                    self.pending = data[pos:]
+                    break
+                pos = end
+                continue
+            pos += 1
+            if c == 0x58 and self.vector_ext:       # 'X': extension query
+                out += b'X1'
+            elif 0x30 <= c <= 0x37:                 # '0'..'7': write tck/tms/tdi
+                bits = c - 0x30
+                tck = bits >> 2
+                if tck and not self.tck:
+                    self.clock((bits >> 1) & 1, bits & 1)
+                self.tck = tck
+            elif c == 0x52:                         # 'R': read tdo
+                out.append(0x31 if self.tdo else 0x30)
+            elif 0x72 <= c <= 0x75:                 # 'r'..'u': trst/srst
+                if (c - 0x72) & 0x2:
+                    self.reset()
+            elif c == 0x51:                         # 'Q': quit
+                return out, False
+            # blink, sleep and the other commands are ignored
+        return out, True
+
+
+def serve(port, once, vector):
+    srv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    srv.bind(('127.0.0.1', port))
+    srv.listen(1)
+    print('jtag_dp_sim: listening on port %d' % srv.getsockname()[1], flush=True)
+    while True:
+        conn, _ = srv.accept()
+        conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        dp = JtagDp(vector)
+        running = True
+        while running:
+            data = conn.recv(65536)
+            if not data:
+                break
+            out, running = dp.process(data)
+            if out:
+                conn.sendall(out)
+        conn.close()
+        if once:
+            break
+    srv.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--port', type=int, default=9901, help='TCP port to listen on')
+    parser.add_argument('--once', action='store_true', help='exit after the first connection is closed')
+    parser.add_argument('--classic', action='store_true', help='do not advertise the vector extension')
+    args = parser.parse_args()
+    serve(args.port, args.once, not args.classic)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
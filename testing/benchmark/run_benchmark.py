@@ -0,0 +1,351 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+"""
+Host-side transfer benchmark for OpenOCD.
+
+Starts jtag_dp_sim.py as a remote_bitbang responder and OpenOCD with bench.cfg,
+then times the common data paths:
+
+  * target_write_buffer / target_read_buffer (load_image / dump_image)
+  * GDB 'X', 'm' and 'g' packets
+  * 'flash write_image' through the virtual flash driver (faux master bank)
+  * RTT up-channel streaming through the RTT TCP server
+
+For every test wall clock throughput and OpenOCD CPU time (user + system, read
+from /proc) per MB are reported. With --baseline the CPU cost is compared to a
+previous --json result and the script fails if it grew more than --tolerance.
+Application tracing (apptrace) needs an Espressif chip and is not covered.
+"""
+
+import argparse
+import json
+import os
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+RAM_ADDR = 0x20000000
+VIRT_FLASH_ADDR = 0x18000000
+RTT_CB_ADDR = 0x20100000
+RTT_BUF_ADDR = 0x20101000
+RTT_BUF_SIZE = 16 * 1024
+GDB_CHUNK = 1024
+GDB_G_COUNT = 500
+
+
+class TclClient:
+    TOKEN = b'\x1a'
+
+    def __init__(self, port):
+        self.sock = socket.create_connection(('127.0.0.1', port))
+
+    def cmd(self, line):
+        self.sock.sendall(line.encode() + self.TOKEN)
+        data = b''
+        while not data.endswith(self.TOKEN):
+            chunk = self.sock.recv(4096)
+            if not chunk:
+                raise RuntimeError('OpenOCD closed Tcl connection')
+            data += chunk
+        return data[:-1].decode(errors='replace')
+
+    def close(self):
+        self.sock.close()
+
+
+class GdbClient:
+    def __init__(self, port):
+        self.sock = socket.create_connection(('127.0.0.1', port))
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.buf = b''
+        self.ack = True
+        self.packet(b'qSupported:multiprocess+')
+        if self.packet(b'QStartNoAckMode') == b'OK':
+            self.ack = False
+
+    def _recv(self):
+        chunk = self.sock.recv(65536)
+        if not chunk:
+            raise RuntimeError('OpenOCD closed GDB connection')
+        self.buf += chunk
+
+    def packet(self, payload):
+        csum = sum(payload) & 0xff
+        self.sock.sendall(b'$' + payload + b'#%02x' % csum)
+        while True:
+            start = self.buf.find(b'$')
+            end = self.buf.find(b'#', start + 1) if start >= 0 else -1
+            if start >= 0 and end >= 0 and len(self.buf) >= end + 3:
+                reply = self.buf[start + 1:end]
+                self.buf = self.buf[end + 3:]
+                if self.ack:
+                    self.sock.sendall(b'+')
+                return reply
+            self._recv()
+
+    def close(self):
+        self.sock.close()
+
+
+def gdb_escape(data):
+    out = bytearray()
+    for b in data:
+        if b in (0x23, 0x24, 0x7d, 0x2a):
+            out += bytes((0x7d, b ^ 0x20))
+        else:
+            out.append(b)
+    return bytes(out)
+
+
+def cpu_seconds(pid):
+    """User + system CPU time of the process, None if /proc is not available."""
+    try:
+        with open('/proc/%d/stat' % pid) as f:
+            fields = f.read().rsplit(')', 1)[1].split()
+    except OSError:
+        return None
+    return (int(fields[11]) + int(fields[12])) / os.sysconf('SC_CLK_TCK')
+
+
+def wait_port(port, proc, timeout=30):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        if proc.poll() is not None:
+            raise RuntimeError('process exited with code %d' % proc.returncode)
+        try:
+            socket.create_connection(('127.0.0.1', port)).close()
+            return
+        except OSError:
+            time.sleep(0.1)
+    raise RuntimeError('port %d is not open after %d s' % (port, timeout))
+
+
+class Bench:
+    def __init__(self, pid):
+        self.pid = pid
+        self.results = {}
+
+    def measure(self, name, nbytes, func, ops=None):
+        cpu0 = cpu_seconds(self.pid)
+        t0 = time.perf_counter()
+        func()
+        wall = time.perf_counter() - t0
+        cpu1 = cpu_seconds(self.pid)
+        cpu = cpu1 - cpu0 if cpu0 is not None and cpu1 is not None else None
+        mb = nbytes / 1e6
+        res = {
+            'bytes': nbytes,
+            'wall_s': wall,
+            'mb_per_s': mb / wall if wall > 0 else 0,
+            'cpu_s': cpu,
+            'cpu_ms_per_mb': cpu * 1000 / mb if cpu is not None and mb > 0 else None,
+        }
+        if ops:
+            res['ops'] = ops
+            res['cpu_us_per_op'] = cpu * 1e6 / ops if cpu is not None else None
+        self.results[name] = res
+        cpu_str = '%8.1f' % res['cpu_ms_per_mb'] if res['cpu_ms_per_mb'] is not None else '     n/a'
+        print('%-22s %10d B %9.3f s %9.3f MB/s %s CPU ms/MB' % (name, nbytes, wall, res['mb_per_s'], cpu_str),
+              flush=True)
+
+
+def check(reply, what):
+    if 'rror' in reply or 'failed' in reply:
+        raise RuntimeError('%s: %s' % (what, reply.strip()))
+
+
+def run_tests(bench, tcl, gdb_port, rtt_port, size, tmpdir):
+    payload = os.urandom(size)
+    bin_path = os.path.join(tmpdir, 'payload.bin')
+    dump_path = os.path.join(tmpdir, 'dump.bin')
+    with open(bin_path, 'wb') as f:
+        f.write(payload)
+
+    bench.measure('target_write_buffer', size,
+                  lambda: check(tcl.cmd('load_image %s 0x%x bin' % (bin_path, RAM_ADDR)), 'load_image'))
+    bench.measure('target_read_buffer', size,
+                  lambda: check(tcl.cmd('dump_image %s 0x%x %d' % (dump_path, RAM_ADDR, size)), 'dump_image'))
+    with open(dump_path, 'rb') as f:
+        if f.read() != payload:
+            raise RuntimeError('read back data mismatch')
+
+    gdb = GdbClient(gdb_port)
+
+    def gdb_write():
+        for off in range(0, size, GDB_CHUNK):
+            chunk = payload[off:off + GDB_CHUNK]
+            hdr = b'X%x,%x:' % (RAM_ADDR + off, len(chunk))
+            if gdb.packet(hdr + gdb_escape(chunk)) != b'OK':
+                raise RuntimeError('GDB X packet failed')
+
+    def gdb_read():
+        for off in range(0, size, GDB_CHUNK):
+            n = min(GDB_CHUNK, size - off)
+            reply = gdb.packet(b'm%x,%x' % (RAM_ADDR + off, n))
+            if len(reply) != 2 * n:
+                raise RuntimeError('GDB m packet failed: %r' % reply[:16])
+
+    def gdb_regs():
+        for _ in range(GDB_G_COUNT):
+            if gdb.packet(b'g').startswith(b'E'):
+                raise RuntimeError('GDB g packet failed')
+
+    bench.measure('gdb_X', size, gdb_write, ops=(size + GDB_CHUNK - 1) // GDB_CHUNK)
+    bench.measure('gdb_m', size, gdb_read, ops=(size + GDB_CHUNK - 1) // GDB_CHUNK)
+    regs_len = len(gdb.packet(b'g')) // 2
+    bench.measure('gdb_g', regs_len * GDB_G_COUNT, gdb_regs, ops=GDB_G_COUNT)
+    gdb.close()
+
+    flash_size = min(size, 0x100000)
+    bench.measure('flash_write_image', flash_size,
+                  lambda: check(tcl.cmd('flash write_image erase %s 0x%x bin' % (bin_path, VIRT_FLASH_ADDR)),
+                                'flash write_image'))
+
+    run_rtt(bench, tcl, rtt_port, payload, tmpdir)
+
+
+def run_rtt(bench, tcl, rtt_port, payload, tmpdir):
+    # SEGGER RTT control block with one up and one down channel
+    name_addr = RTT_CB_ADDR + 0x80
+    # up buffer: pBuffer, SizeOfBuffer, WrOff, RdOff, Flags (block if full)
+    words = [RTT_BUF_ADDR, RTT_BUF_SIZE, 0, 0, 2]
+    tcl.cmd('write_memory 0x%x 8 {%s}' % (RTT_CB_ADDR, ' '.join(str(b) for b in b'SEGGER RTT\0\0\0\0\0\0')))
+    tcl.cmd('write_memory 0x%x 32 {1 1 0x%x %s}' % (RTT_CB_ADDR + 16, name_addr, ' '.join(str(w) for w in words)))
+    tcl.cmd('write_memory 0x%x 32 {0x%x 0x%x 16 0 0 0}' % (RTT_CB_ADDR + 16 + 8 + 24, name_addr,
+                                                         RTT_BUF_ADDR + RTT_BUF_SIZE))
+    tcl.cmd('write_memory 0x%x 8 {66 101 110 99 104 0}' % name_addr)
+    check(tcl.cmd('rtt setup 0x%x 256 "SEGGER RTT"' % RTT_CB_ADDR), 'rtt setup')
+    check(tcl.cmd('rtt polling_interval 1'), 'rtt polling_interval')
+    check(tcl.cmd('rtt start'), 'rtt start')
+    check(tcl.cmd('rtt server start %d 0' % rtt_port), 'rtt server start')
+
+    half = RTT_BUF_SIZE // 2
+    chunks = max(1, len(payload) // half)
+    chunk_paths = []
+    for i in range(2):
+        path = os.path.join(tmpdir, 'rtt%d.bin' % i)
+        with open(path, 'wb') as f:
+            f.write(payload[i * half:(i + 1) * half].ljust(half, b'\0'))
+        chunk_paths.append(path)
+
+    sock = socket.create_connection(('127.0.0.1', rtt_port))
+
+    def stream():
+        for i in range(chunks):
+            off = (i % 2) * half
+            tcl.cmd('load_image %s 0x%x bin' % (chunk_paths[i % 2], RTT_BUF_ADDR + off))
+            tcl.cmd('mww 0x%x 0x%x' % (RTT_CB_ADDR + 16 + 8 + 12, (off + half) % RTT_BUF_SIZE))
+            got = 0
+            while got < half:
+                data = sock.recv(65536)
+                if not data:
+                    raise RuntimeError('RTT server closed connection')
+                got += len(data)
+
+    try:
+        bench.measure('rtt_up_stream', chunks * half, stream)
+    finally:
+        sock.close()
+        tcl.cmd('rtt server stop %d' % rtt_port)
+        tcl.cmd('rtt stop')
+
+
+def compare(results, baseline_path, tolerance):
+    with open(baseline_path) as f:
+        baseline = json.load(f)
+    failed = False
+    for name, res in results.items():
+        base = baseline.get(name)
+        if not base or base.get('cpu_ms_per_mb') is None or res.get('cpu_ms_per_mb') is None:
+            continue
+        growth = (res['cpu_ms_per_mb'] - base['cpu_ms_per_mb']) / max(base['cpu_ms_per_mb'], 1e-9) * 100
+        status = 'REGRESSION' if growth > tolerance else 'ok'
+        print('%-22s CPU ms/MB %8.1f -> %8.1f (%+.1f%%) %s' %
+              (name, base['cpu_ms_per_mb'], res['cpu_ms_per_mb'], growth, status))
+        failed = failed or growth > tolerance
+    return not failed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--openocd', default='openocd', help='OpenOCD executable')
+    parser.add_argument('--scripts', default=os.path.join(HERE, '..', '..', 'tcl'), help='OpenOCD scripts dir')
+    parser.add_argument('--size', type=int, default=64, help='amount of data per test, KiB')
+    parser.add_argument('--sim-port', type=int, default=9901)
+    parser.add_argument('--rtt-port', type=int, default=9090)
+    parser.add_argument('--json', help='save results to this file')
+    parser.add_argument('--baseline', help='compare CPU cost with results saved by --json')
+    parser.add_argument('--tolerance', type=float, default=20.0, help='allowed CPU cost growth, percents')
+    parser.add_argument('--log', help='OpenOCD log file')
+    parser.add_argument('--adapter', default='remote_bitbang',
+                        choices=['remote_bitbang', 'remote_bitbang_classic', 'esp_remote1', 'esp_remote2',
+                                 'cmsis_dap', 'cmsis_dap_jtag'],
+                        help='adapter driver and simulator to use, remote_bitbang_classic disables the vector '
+                             'extension, esp_remoteN selects jtag_esp_remote protocol vN, cmsis_dap uses SWD '
+                             'and cmsis_dap_jtag JTAG')
+    parser.add_argument('--sim-delay-ms', type=float, default=0.0,
+                        help='round trip delay emulated by esp_remote_sim.py and cmsis_dap_sim.py')
+    parser.add_argument('--sim-packet-count', type=int, default=32,
+                        help='packet count reported by cmsis_dap_sim.py')
+    args = parser.parse_args()
+
+    size = args.size * 1024
+    procs = []
+    try:
+        if args.adapter.startswith('remote_bitbang'):
+            sim_cmd = [sys.executable, os.path.join(HERE, 'jtag_dp_sim.py')]
+        elif args.adapter.startswith('cmsis_dap'):
+            sim_cmd = [sys.executable, os.path.join(HERE, 'cmsis_dap_sim.py'),
+                       '--delay-ms', str(args.sim_delay_ms),
+                       '--packet-count', str(args.sim_packet_count)]
+        else:
+            sim_cmd = [sys.executable, os.path.join(HERE, 'esp_remote_sim.py'),
+                       '--delay-ms', str(args.sim_delay_ms)]
+        sim = subprocess.Popen(sim_cmd + ['--port', str(args.sim_port), '--once'],
+                               stdout=subprocess.PIPE, text=True)
+        procs.append(sim)
+        sim.stdout.readline()
+
+        ocd_cmd = [args.openocd, '-s', args.scripts, '-s', HERE,
+                   '-c', 'set BENCH_SIM_PORT %d' % args.sim_port]
+        if args.adapter.startswith('esp_remote'):
+            ocd_cmd += ['-c', 'set BENCH_ADAPTER esp_remote',
+                        '-c', 'set BENCH_ESP_REMOTE_VERSION %s' % args.adapter[-1]]
+        else:
+            ocd_cmd += ['-c', 'set BENCH_ADAPTER %s' % args.adapter]
+        ocd_cmd += ['-f', 'bench.cfg']
+        if args.log:
+            ocd_cmd += ['-l', args.log]
+        ocd = subprocess.Popen(ocd_cmd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        procs.append(ocd)
+        wait_port(6666, ocd)
+        wait_port(3333, ocd)
+
+        tcl = TclClient(6666)
+        bench = Bench(ocd.pid)
+        with tempfile.TemporaryDirectory() as tmpdir:
+            run_tests(bench, tcl, 3333, args.rtt_port, size, tmpdir)
+        tcl.cmd('shutdown')
+        tcl.close()
+    finally:
+        for p in reversed(procs):
+            try:
+                p.wait(timeout=5)
+            except subprocess.TimeoutExpired:
+                p.kill()
+
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump(bench.results, f, indent=2)
+    if args.baseline and not compare(bench.results, args.baseline, args.tolerance):
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())